@@ -15,6 +15,8 @@ class eCP(BaseANN):
         
         if(metric == 'angular'):
             self.metric = 1
+        elif(metric == 'hamming'):
+            self.metric = 3
         else:
             if(early_halt): 
                 self.metric = 2
@@ -22,12 +24,27 @@ class eCP(BaseANN):
                 self.metric = 0
 
     def fit(self, dataset):
+        #binary descriptors are bit-packed into bytes before indexing with the hamming metric
+        if self.metric == 3 and dataset.dtype == np.bool_:
+            dataset = np.packbits(dataset, axis=1)
+
+        #uint8 datasets (e.g. SIFT1B/BIGANN) are indexed as bytes without widening them to floats
+        self.uint8 = dataset.dtype == np.uint8
+        if self.uint8:
+            self.index = e.eCP_Index_uint8(dataset.tolist(), self.Sc, self.metric, self.batch_build)
+            return
+
         #dataset contains float32, we need to convert it to float64 for the eCP algorithm
         descriptors = dataset.astype(np.float64)
 
         self.index = e.eCP_Index(descriptors, self.Sc, self.metric, self.batch_build)
 
     def query(self, q, k):
+        if self.uint8:
+            if self.metric == 3 and q.dtype == np.bool_:
+                q = np.packbits(q)
+            return e.query_uint8(self.index, q.tolist(), k, self.b)[0]
+
         #query point is float32, convert it to float64
         query = q.astype(np.float64)
         
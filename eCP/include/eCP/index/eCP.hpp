@@ -1,7 +1,10 @@
 #ifndef ECP_H
 #define ECP_H
 
+#include <cstddef>
+#include <cstdint>
 #include <eCP/index/shared/data_structure.hpp>
+#include <string>
 #include <vector>
 
 /**
@@ -27,6 +30,49 @@ namespace eCP {
 Index* eCP_Index(const std::vector<std::vector<float>>& descriptors, unsigned cluster_size, unsigned metric,
                  bool batch_build = true);
 
+/**
+ * @brief eCP_Index will create an index from a dataset of unsigned byte descriptors e.g. SIFT/BIGANN. The
+ * descriptors are stored as bytes and compared using integer distance kernels. When metric is HAMMING the
+ * bytes are instead treated as bit-packed binary descriptors e.g. ORB/BRIEF or hash codes with 8 dimensions
+ * per byte. See above for parameters.
+ */
+Index* eCP_Index(const std::vector<std::vector<std::uint8_t>>& descriptors, unsigned cluster_size,
+                 unsigned metric, bool batch_build = true);
+
+/**
+ * @brief eCP_Index will create an index from a dataset of signed byte descriptors. The descriptors are
+ * stored as bytes and compared using integer distance kernels. See above for parameters.
+ */
+Index* eCP_Index(const std::vector<std::vector<std::int8_t>>& descriptors, unsigned cluster_size,
+                 unsigned metric, bool batch_build = true);
+
+/**
+ * @brief eCP_Index will create an index from a matrix of float descriptors, e.g. a numpy array, a mapped file
+ * or a matrix loaded by utilities::load_hdf5_dataset, without copying it into vectors first. See above for
+ * the remaining parameters.
+ * @param descriptors points to the first of n descriptors.
+ * @param n is the number of descriptors.
+ * @param dimensions is the dimensionality of the descriptors.
+ * @param stride is the number of floats from a descriptor to the next, at least dimensions. Rows padded for
+ * alignment or interleaved with other columns have a stride greater than dimensions.
+ */
+Index* eCP_Index(const float* descriptors, std::size_t n, std::size_t dimensions, std::size_t stride,
+                 unsigned cluster_size, unsigned metric, bool batch_build = true);
+
+/**
+ * @brief eCP_Index_from_file will create an index from a .fvecs or .bvecs file e.g. SIFT1B/Deep1B. The file
+ * is memory-mapped and the index built from its rows in place, thus the dataset is not copied into memory.
+ * The rows of a .bvecs file are unsigned byte descriptors, see above.
+ * @param path is the path of the file. Its extension determines its type.
+ * @param cluster_size defines the desired size of clusters and nodes.
+ * @param metric is the utilized distance function of the metric space. See the @ref{Metric} type.
+ * @param batch_build designates when true that the index should be bulk built from the file and when false
+ * that the index should be built incrementally.
+ * @returns a pointer to the constructed index.
+ */
+Index* eCP_Index_from_file(const std::string& path, unsigned cluster_size, unsigned metric,
+                           bool batch_build = true);
+
 /**
  * @brief insert will insert a descriptor into the index. It is assumed that the given descriptor is of equal
  * dimensionality to what the index already contains.
@@ -35,15 +81,330 @@ Index* eCP_Index(const std::vector<std::vector<float>>& descriptors, unsigned cl
  */
 void insert(const float* descriptor, Index* const index);
 
+/**
+ * @brief insert will insert a byte descriptor into an index built from byte descriptors of the same type.
+ * @param descriptor is the given feature descriptor to insert.
+ * @param index is the index to insert into.
+ */
+void insert(const std::uint8_t* descriptor, Index* const index);
+void insert(const std::int8_t* descriptor, Index* const index);
+
+/**
+ * @brief insert_batch will insert n descriptors at once, which is considerably faster than inserting them one
+ * at a time as the index is traversed concurrently and reclustered once per batch.
+ * @param descriptors points to n descriptors of the type of the index stored consecutively.
+ * @param n is the number of descriptors.
+ * @param index is the index to insert into.
+ */
+void insert_batch(const float* descriptors, std::size_t n, Index* const index);
+void insert_batch(const std::uint8_t* descriptors, std::size_t n, Index* const index);
+void insert_batch(const std::int8_t* descriptors, std::size_t n, Index* const index);
+
+/**
+ * @brief insert_batch_from_file will insert the rows of a memory-mapped .fvecs or .bvecs file of the type and
+ * dimensionality of the index a chunk at a time, such that only a single chunk is copied out of the file.
+ * @param path is the path of the file. Its extension determines its type.
+ * @param index is the index to insert into.
+ * @param chunk_size is the number of rows inserted at a time.
+ */
+void insert_batch_from_file(const std::string& path, Index* const index, std::size_t chunk_size = 65536);
+
+/**
+ * @brief update will replace the descriptor with the given id, e.g. a refreshed embedding, while keeping the
+ * id. Small changes are written in place while larger changes move the descriptor to its new nearest cluster.
+ * @param id is the id of the descriptor, i.e. its position in the dataset or order of insertion.
+ * @param descriptor is the new descriptor of the same type and dimensionality as the index.
+ * @param index is the index to update.
+ */
+void update(unsigned long id, const float* descriptor, Index* const index);
+void update(unsigned long id, const std::uint8_t* descriptor, Index* const index);
+void update(unsigned long id, const std::int8_t* descriptor, Index* const index);
+
+/**
+ * @brief erase will delete the descriptor with the given id from the index. Erased descriptors are no longer
+ * returned by queries, but they occupy memory until the index is compacted.
+ * @param id is the id of the descriptor, i.e. its position in the dataset or order of insertion.
+ * @param index is the index to erase from.
+ */
+void erase(unsigned long id, Index* const index);
+
+/**
+ * @brief compact will remove all erased descriptors from the index and merge clusters and nodes that have
+ * become underfilled.
+ * @param index is the index to compact.
+ */
+void compact(Index* const index);
+
+/**
+ * @brief enable_delta_buffer will make insertions return in constant time by appending the descriptor to a
+ * small buffer that queries scan exhaustively. The buffer is merged into the index at once when it holds
+ * capacity descriptors or, if max_age is given, its oldest descriptor is max_age milliseconds old.
+ * @param index is the index to insert into.
+ * @param capacity is the number of descriptors buffered before they are merged into the index.
+ * @param max_age is the age in milliseconds at which the buffer is merged, 0 for none. Checked by the
+ * background thread if background maintenance is enabled, otherwise by the next insertion or query.
+ */
+void enable_delta_buffer(Index* const index, std::size_t capacity, unsigned max_age = 0);
+
+/**
+ * @brief disable_delta_buffer will merge the buffered descriptors into the index and make insertions add
+ * directly to the index again.
+ * @param index is the index to insert into.
+ */
+void disable_delta_buffer(Index* const index);
+
+/**
+ * @brief save will write the index to a file from which it is loaded considerably faster than it is built.
+ * @param index is the index to save.
+ * @param path is the path of the file. An existing file is replaced.
+ */
+void save(Index* const index, const std::string& path);
+
+/**
+ * @brief load will read an index written by save. The metric and descriptor type of the index are restored
+ * as well, while background maintenance and the write-ahead log must be enabled again.
+ * @param path is the path of the file.
+ * @returns a pointer to the loaded index.
+ */
+Index* load(const std::string& path);
+
+/**
+ * @brief checkpoint will write the changes of the index since it was last saved or loaded to a file. The
+ * unchanged parts are referred to in the saved file, thus a checkpoint is written in time proportional to
+ * the changes rather than the size of the index.
+ * @param index is the index to checkpoint. Must have been saved or loaded.
+ * @param path is the path of the file. An existing file is replaced.
+ */
+void checkpoint(Index* const index, const std::string& path);
+
+/**
+ * @brief load_checkpoint will read an index from a checkpoint and the file it was written against. See load.
+ * @param path is the path of the checkpoint.
+ * @returns a pointer to the loaded index.
+ */
+Index* load_checkpoint(const std::string& path);
+
+/**
+ * @brief fold_checkpoint will combine a checkpoint and the file it was written against into a new file
+ * loaded by load, which later checkpoints of a loaded index are written against.
+ * @param checkpoint_path is the path of the checkpoint.
+ * @param path is the path of the new file. An existing file is replaced.
+ */
+void fold_checkpoint(const std::string& checkpoint_path, const std::string& path);
+
+/**
+ * @brief save_mapped will write the index in a read-only format that is queried directly from a memory mapped
+ * file. Opening such a file takes milliseconds regardless of its size, and processes opening the same file
+ * share one copy of it in memory.
+ * @param index is the index to save.
+ * @param path is the path of the file. An existing file is replaced.
+ */
+void save_mapped(Index* const index, const std::string& path);
+
+/**
+ * @brief open_mapped will map a file written by save_mapped for querying. The metric and descriptor type of
+ * the index are restored as well.
+ * @param path is the path of the file.
+ * @returns a pointer to the mapped index, which must be closed by close_mapped.
+ */
+MappedIndex* open_mapped(const std::string& path);
+
+/**
+ * @brief close_mapped will unmap an index opened by open_mapped.
+ * @param index is the mapped index.
+ */
+void close_mapped(MappedIndex* const index);
+
+/**
+ * @brief save_shared will write the index in the mapped format to shared memory, such that many processes
+ * query one copy of it. Building the index once and sharing it avoids a copy per process.
+ * @param index is the index to save.
+ * @param name is the name of the shared memory object. An existing object is replaced.
+ */
+void save_shared(Index* const index, const std::string& name);
+
+/**
+ * @brief open_shared will map an index written by save_shared for querying without copying it. The metric
+ * and descriptor type of the index are restored as well.
+ * @param name is the name of the shared memory object.
+ * @returns a pointer to the mapped index, which must be closed by close_mapped.
+ */
+MappedIndex* open_shared(const std::string& name);
+
+/**
+ * @brief remove_shared will remove an index written by save_shared. Processes that opened it can query it
+ * until they close it.
+ * @param name is the name of the shared memory object.
+ */
+void remove_shared(const std::string& name);
+
+/**
+ * @brief save_on_disk will write the index in a read-only format for collections larger than memory. Only the
+ * internal levels and leaders are held in memory once opened, while each cluster is stored as one block on
+ * disk and read as it is searched.
+ * @param index is the index to save.
+ * @param path is the path of the file. An existing file is replaced.
+ */
+void save_on_disk(Index* const index, const std::string& path);
+
+/**
+ * @brief build_on_disk will build the index of a .fvecs or .bvecs file larger than memory directly into the
+ * format written by save_on_disk without building it in memory. The dataset is streamed twice: first to read
+ * the leaders, from which the nodes are built in memory, then to assign each descriptor to its cluster. The
+ * assigned descriptors are spilled to a temporary file next to the path whenever they exceed the memory
+ * budget and finally merged into the clusters of the file.
+ * @param dataset_path is the path of the dataset. Its extension determines its type, see eCP_Index_from_file.
+ * @param path is the path of the index file. An existing file is replaced.
+ * @param cluster_size defines the desired size of clusters and nodes.
+ * @param metric is the utilized distance function of the metric space. See the @ref{Metric} type.
+ * @param memory_budget is the number of bytes of assigned descriptors held in memory before they are spilled.
+ */
+void build_on_disk(const std::string& dataset_path, const std::string& path, unsigned cluster_size,
+                   unsigned metric, std::size_t memory_budget = std::size_t{1} << 30);
+
+/**
+ * @brief open_on_disk will open a file written by save_on_disk for querying. The metric and descriptor type
+ * of the index are restored as well.
+ * @param path is the path of the file.
+ * @param cache_capacity is the number of bytes of the most recently searched clusters kept in memory.
+ * @param thread_count is the number of threads reading the clusters of a query in parallel.
+ * @returns a pointer to the disk index, which must be closed by close_on_disk.
+ */
+DiskIndex* open_on_disk(const std::string& path, std::size_t cache_capacity = 0, unsigned thread_count = 8);
+
+/**
+ * @brief close_on_disk will close an index opened by open_on_disk.
+ * @param index is the disk index.
+ */
+void close_on_disk(DiskIndex* const index);
+
+/**
+ * @brief enable_write_ahead_log will make insertions, updates and erases durable by appending them to a log
+ * file before they are applied. The log is written and synced every commit_interval modifications.
+ * @param index is the index to log.
+ * @param path is the path of the log file. An existing log is continued.
+ * @param commit_interval is the number of modifications synced at once. Up to commit_interval - 1 of the
+ * latest modifications may be lost on a crash.
+ */
+void enable_write_ahead_log(Index* const index, const std::string& path, unsigned commit_interval = 1);
+
+/**
+ * @brief disable_write_ahead_log will sync and close the log. Must be called before a logged index is
+ * deleted.
+ * @param index is the logged index.
+ */
+void disable_write_ahead_log(Index* const index);
+
+/**
+ * @brief recover will apply the modifications of a log to the index they were logged from, e.g. the latest
+ * saved index loaded again after a crash, before the log is enabled again.
+ * @param index is the index to recover.
+ * @param path is the path of the log file.
+ * @return the number of recovered modifications.
+ */
+unsigned long recover(Index* const index, const std::string& path);
+
+/**
+ * @brief enable_background_maintenance will make insertions return as soon as the descriptor is added to its
+ * nearest cluster. Over-full clusters are reclustered by a background thread meanwhile. Queries and
+ * modifications through this API may be issued concurrently from multiple threads while it is enabled, and
+ * insertions into different clusters proceed in parallel.
+ * @param index is the index to maintain.
+ * @param publish_interval makes queries never wait for modifications if greater than 0. They then search a
+ * copy of the index which the background thread refreshes after every publish_interval modifications, thus
+ * recent modifications may not be observed until then. Each refresh only copies the modified clusters. 0
+ * makes queries wait for modifications instead.
+ */
+void enable_background_maintenance(Index* const index, unsigned publish_interval = 0);
+
+/**
+ * @brief disable_background_maintenance will finish all pending reclusterings and stop the background thread.
+ * Must be called before an index with background maintenance enabled is deleted.
+ * @param index is the maintained index.
+ */
+void disable_background_maintenance(Index* const index);
+
+/**
+ * @brief enable_compression trains a scalar quantizer on the descriptors of the index and stores the
+ * compressed codes of the descriptors of each cluster consecutively. Descriptors inserted afterwards are
+ * compressed as well. Queries will then scan clusters using the codes and re-rank the best candidates using
+ * the full-precision descriptors.
+ * @param index is the index to compress.
+ */
+void enable_compression(Index* const index);
+
 /**
  * @brief query queries in the index structure and returns the k nearest points.
  * @param index is the index structure used to make queries on.
  * @param query is the query point we are looking for k-nn for.
  * @param k is the number of k-nn to return.
  * @param b is the number of clusters to search.
+ * @param rerank_factor is the expansion factor r such that k * r candidates are gathered from the compressed
+ * codes and re-ranked. Only used when compression is enabled. 0 scans the full-precision descriptors.
  * @return collection of tuples containing index in data set and distance to query point
  */
 std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<float> query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor = 4);
+
+/**
+ * @brief query queries an index built from byte descriptors of the same type as the query. See above for
+ * parameters. Byte descriptors are never compressed, thus there is no re-ranking factor.
+ */
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<std::uint8_t> query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<std::int8_t> query,
+                                                               unsigned int k, unsigned int b);
+
+/**
+ * @brief query queries with a descriptor stored elsewhere, e.g. a row of a matrix, which is read in place
+ * instead of being copied into a vector. See above for parameters.
+ */
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, const float* query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor = 4);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, const std::uint8_t* query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, const std::int8_t* query,
+                                                               unsigned int k, unsigned int b);
+
+/**
+ * @brief query queries a mapped index like the index it was saved from. See above for parameters.
+ */
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, std::vector<float> query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor = 4);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index,
+                                                               std::vector<std::uint8_t> query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index,
+                                                               std::vector<std::int8_t> query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, const float* query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor = 4);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, const std::uint8_t* query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, const std::int8_t* query,
+                                                               unsigned int k, unsigned int b);
+
+/**
+ * @brief query queries a disk index like the index it was saved from at full precision. See above for
+ * parameters.
+ */
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, std::vector<float> query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index,
+                                                               std::vector<std::uint8_t> query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index,
+                                                               std::vector<std::int8_t> query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, const float* query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, const std::uint8_t* query,
+                                                               unsigned int k, unsigned int b);
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, const std::int8_t* query,
                                                                unsigned int k, unsigned int b);
 
 }  // namespace eCP
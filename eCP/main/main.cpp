@@ -3,8 +3,21 @@
 #include <eCP/debugging/debug_tools.hpp>
 #include <eCP/index/eCP.hpp>
 #include <eCP/utilities/utilities.hpp>
+#include <algorithm>
 #include <iostream>
 
+/**
+ * @brief to_matrix copies descriptors into a contiguous matrix.
+ */
+static utilities::Matrix to_matrix(const std::vector<std::vector<float>>& descriptors)
+{
+  auto matrix = utilities::allocate_matrix(descriptors.size(), descriptors[0].size());
+  for (std::size_t i = 0; i < matrix.rows; ++i) {
+    std::copy(descriptors[i].begin(), descriptors[i].end(), matrix.data.get() + i * matrix.cols);
+  }
+  return matrix;
+}
+
 int main(int argc, char* argv[])
 {
   // clang-format off
@@ -40,8 +53,8 @@ int main(int argc, char* argv[])
   __itt_string_handle* handle_build = __itt_string_handle_create("ecp_build");
   __itt_string_handle* handle_query = __itt_string_handle_create("ecp_query");
 
-  std::vector<std::vector<float>> S;
-  std::vector<std::vector<float>> queries;
+  utilities::Matrix S{};
+  utilities::Matrix queries{};
 
   /* Handling of program arguments */
   if (argc > 1 && argc % 2 != 0) {
@@ -52,11 +65,9 @@ int main(int argc, char* argv[])
       if (flag == "-f") {
         std::cout << "Running with hdf5 file: " << argv[j] << std::endl;
         std::string file = std::string(argv[j]);
-        std::string dataset = "train";
-        S = utilities::load_hdf5_file(file, dataset);
-        dataset = "test";
-        queries = utilities::load_hdf5_file(file, dataset);
-        p = S.size();
+        S = utilities::load_hdf5_dataset(file, "train");
+        queries = utilities::load_hdf5_dataset(file, "test");
+        p = S.rows;
         hdf5 = true;
       }
       else if (flag == "-k") {
@@ -83,19 +94,19 @@ int main(int argc, char* argv[])
               << std::endl;
 
     /* Generate dummy data */
-    S = utilities::generate_descriptors(p, d, r);
-    queries = utilities::generate_descriptors(qs, d, r);
+    S = to_matrix(utilities::generate_descriptors(p, d, r));
+    queries = to_matrix(utilities::generate_descriptors(qs, d, r));
   }
 
   /* Index build instrumentation */
   __itt_task_begin(domain_build, __itt_null, __itt_null, handle_build);
-  Index* index = eCP::eCP_Index(S, sc, metric, batch_build);
+  Index* index = eCP::eCP_Index(S.data.get(), S.rows, S.cols, S.cols, sc, metric, batch_build);
   __itt_task_end(domain_build);
 
   /* Query instrumentation */
   __itt_task_begin(domain_query, __itt_null, __itt_null, handle_query);
-  for (auto& q : queries) {
-    auto result = eCP::query(index, q, k, b);
+  for (std::size_t i = 0; i < queries.rows; ++i) {
+    auto result = eCP::query(index, queries.data.get() + i * queries.cols, k, b);
     //        debugging::print_query_results(result, q, k, S);   // debugging
   }
   __itt_task_end(domain_query);
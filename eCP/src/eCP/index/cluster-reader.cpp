@@ -0,0 +1,220 @@
+#include <eCP/index/cluster-reader.hpp>
+#include <eCP/index/shared/globals.hpp>
+#include <stdexcept>
+#include <unistd.h>
+
+/*
+ * Namespace containing testable helpers of the cluster reader. Compilation unit only.
+ */
+namespace cluster_reader_helpers {
+
+/**
+ * @brief read_block reads the block of a cluster from the file of the index.
+ * @param index is the index to read from.
+ * @param node is the position of the cluster among the nodes.
+ * @return the block.
+ */
+cluster_reader::ClusterBlock read_block(const DiskIndex& index, std::uint64_t node)
+{
+  const std::size_t length = cluster_reader::block_size(index.nodes[node].point_count);
+  auto block = std::make_shared<std::vector<char>>(length);
+  std::size_t offset{0};
+
+  while (offset < length) {
+    const ssize_t bytes_read =
+        ::pread(index.file, block->data() + offset, length - offset, index.block_offsets[node] + offset);
+    if (bytes_read <= 0) {
+      throw std::runtime_error("cluster_reader: Could not read the block of a cluster.");
+    }
+    offset += bytes_read;
+  }
+
+  return block;
+}
+
+/**
+ * @brief remember caches a block and evicts the least recently used blocks beyond the capacity of the cache.
+ * @param reader is the reader, which must be locked.
+ * @param node is the position of the cluster among the nodes.
+ * @param block is the block of the cluster.
+ */
+void remember(cluster_reader::ClusterReader* const reader, std::uint64_t node,
+              cluster_reader::ClusterBlock block)
+{
+  if (block->size() > reader->cache_capacity || reader->cache.count(node) > 0) {
+    return;
+  }
+
+  reader->recency.push_front(node);
+  reader->cache_size += block->size();
+  reader->cache.emplace(node, cluster_reader::CachedCluster{std::move(block), reader->recency.begin()});
+
+  while (reader->cache_size > reader->cache_capacity) {
+    const auto evicted = reader->cache.find(reader->recency.back());
+    reader->cache_size -= evicted->second.block->size();
+    reader->cache.erase(evicted);
+    reader->recency.pop_back();
+  }
+}
+
+/**
+ * @brief recall looks up a cached block and marks it as the most recently used.
+ * @param reader is the reader, which must be locked.
+ * @param node is the position of the cluster among the nodes.
+ * @return the block, or nullptr if it is not cached.
+ */
+cluster_reader::ClusterBlock recall(cluster_reader::ClusterReader* const reader, std::uint64_t node)
+{
+  const auto cached = reader->cache.find(node);
+  if (cached == reader->cache.end()) {
+    return nullptr;
+  }
+
+  reader->recency.splice(reader->recency.begin(), reader->recency, cached->second.recency);
+  return cached->second.block;
+}
+
+/**
+ * @brief run_reader is the loop of a reading thread. Reads the requested blocks and delivers them to their
+ * fetch until stopped.
+ * @param index is the index to read from.
+ */
+void run_reader(const DiskIndex* const index)
+{
+  auto* reader = index->reader;
+
+  while (true) {
+    cluster_reader::ReadRequest request;
+    {
+      std::unique_lock<std::mutex> lock(reader->mutex);
+      reader->requests_available.wait(lock,
+                                      [reader] { return reader->stopping || !reader->requests.empty(); });
+      if (reader->stopping) {
+        return;
+      }
+      request = std::move(reader->requests.front());
+      reader->requests.pop_front();
+    }
+
+    auto& fetch = *request.fetch;
+    try {
+      auto block = read_block(*index, request.node);
+      std::lock_guard<std::mutex> lock(fetch.mutex);
+      fetch.blocks.emplace_back(request.node, std::move(block));
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(fetch.mutex);
+      fetch.error = std::current_exception();
+    }
+    fetch.blocks_available.notify_one();
+  }
+}
+
+}  // namespace cluster_reader_helpers
+
+namespace cluster_reader {
+
+void start(DiskIndex* const index, std::size_t cache_capacity, unsigned thread_count)
+{
+  index->reader = new ClusterReader{};  // Value initialized i.e. not stopping and empty.
+  index->reader->cache_capacity = cache_capacity;
+
+  for (unsigned i = 0; i < thread_count; ++i) {
+    index->reader->threads.emplace_back(cluster_reader_helpers::run_reader, index);
+  }
+}
+
+void stop(DiskIndex* const index)
+{
+  auto* reader = index->reader;
+  if (!reader) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(reader->mutex);
+    reader->stopping = true;
+  }
+  reader->requests_available.notify_all();
+  for (auto& thread : reader->threads) {
+    thread.join();
+  }
+
+  index->reader = nullptr;
+  delete reader;
+}
+
+void fetch_clusters(DiskIndex& index, const std::vector<const MappedNode*>& clusters,
+                    const std::function<void(const char*, std::uint64_t)>& scan)
+{
+  auto* reader = index.reader;
+  auto fetch = std::make_shared<Fetch>();
+  std::vector<std::pair<std::uint64_t, ClusterBlock>> cached;
+  std::vector<std::uint64_t> uncached;  // Read by the querying thread if there are no reading threads.
+  std::size_t requested{0};
+
+  {
+    std::lock_guard<std::mutex> lock(reader->mutex);
+    for (const MappedNode* cluster : clusters) {
+      const std::uint64_t node = cluster - index.nodes.data();
+      if (cluster->point_count == 0) {
+        continue;
+      }
+
+      if (auto block = cluster_reader_helpers::recall(reader, node)) {
+        cached.emplace_back(node, std::move(block));
+      }
+      else if (reader->threads.empty()) {
+        uncached.emplace_back(node);
+      }
+      else {
+        reader->requests.push_back(ReadRequest{node, fetch});
+        ++requested;
+      }
+    }
+  }
+
+  if (requested > 0) {
+    reader->requests_available.notify_all();
+  }
+
+  // Scan the cached blocks while the others are read.
+  for (const auto& block : cached) {
+    scan(block.second->data(), index.nodes[block.first].point_count);
+  }
+
+  auto scan_read_block = [&index, reader, &scan](std::uint64_t node, ClusterBlock block) {
+    scan(block->data(), index.nodes[node].point_count);
+    std::lock_guard<std::mutex> lock(reader->mutex);
+    cluster_reader_helpers::remember(reader, node, std::move(block));
+  };
+
+  for (auto node : uncached) {
+    scan_read_block(node, cluster_reader_helpers::read_block(index, node));
+  }
+
+  std::vector<std::pair<std::uint64_t, ClusterBlock>> arrived;
+  while (requested > 0) {
+    {
+      std::unique_lock<std::mutex> lock(fetch->mutex);
+      fetch->blocks_available.wait(lock, [&fetch] { return fetch->error || !fetch->blocks.empty(); });
+      if (fetch->error) {
+        std::rethrow_exception(fetch->error);
+      }
+      arrived.swap(fetch->blocks);
+    }
+
+    for (auto& block : arrived) {
+      scan_read_block(block.first, std::move(block.second));
+    }
+    requested -= arrived.size();
+    arrived.clear();
+  }
+}
+
+std::size_t block_size(std::uint64_t point_count)
+{
+  return point_count * (sizeof(std::uint64_t) + globals::descriptor_size_in_bytes());
+}
+
+}  // namespace cluster_reader
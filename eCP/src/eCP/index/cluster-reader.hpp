@@ -0,0 +1,104 @@
+#ifndef CLUSTER_READER_HPP
+#define CLUSTER_READER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <eCP/index/shared/data_structure.hpp>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Namespace contains the reading of the clusters of a DiskIndex. The blocks of the clusters searched by a
+ * query are read in parallel by a pool of threads while the query scans the blocks that have already arrived
+ * or are cached, such that reading overlaps with scanning.
+ */
+namespace cluster_reader {
+
+/**
+ * @brief ClusterBlock is the block of a cluster read from disk. Shared by the cache and the queries scanning
+ * it, such that a block evicted from the cache stays valid until it is scanned.
+ */
+typedef std::shared_ptr<const std::vector<char>> ClusterBlock;
+
+/**
+ * @brief The Fetch struct collects the blocks read for a single query.
+ */
+struct Fetch {
+  std::mutex mutex;                                            // Guards the members below.
+  std::condition_variable blocks_available;                    // Signaled when a block is read or failed.
+  std::vector<std::pair<std::uint64_t, ClusterBlock>> blocks;  // Read blocks by node position, not scanned.
+  std::exception_ptr error;                                    // The first failed read, if any.
+};
+
+/**
+ * @brief The ReadRequest struct is a block to be read by the threads of the reader.
+ */
+struct ReadRequest {
+  std::uint64_t node;            // Position of the cluster among the nodes.
+  std::shared_ptr<Fetch> fetch;  // The fetch the block is delivered to.
+};
+
+/**
+ * @brief The CachedCluster struct is a block held by the cache.
+ */
+struct CachedCluster {
+  ClusterBlock block;
+  std::list<std::uint64_t>::iterator recency;  // Position in the recency list of the cache.
+};
+
+/**
+ * @brief The ClusterReader struct holds the threads reading blocks and the cache of the most recently used
+ * blocks. Shared by all queries of a DiskIndex.
+ */
+struct ClusterReader {
+  std::mutex mutex;                                        // Guards the members below.
+  std::condition_variable requests_available;              // Signaled on a queued request or on stopping.
+  std::deque<ReadRequest> requests;                        // Blocks to be read in the order of requesting.
+  bool stopping;                                           // The threads return once it is set.
+  std::vector<std::thread> threads;                        // The threads reading blocks.
+  std::size_t cache_capacity;                              // Bytes of blocks cached at most. 0 if none.
+  std::size_t cache_size;                                  // Bytes of blocks cached.
+  std::list<std::uint64_t> recency;                        // Positions of cached clusters, most recent first.
+  std::unordered_map<std::uint64_t, CachedCluster> cache;  // Cached blocks by position of the cluster.
+};
+
+/**
+ * @brief start starts the reader of a DiskIndex.
+ * @param index is the opened index without a reader.
+ * @param cache_capacity is the number of bytes of blocks cached, 0 to read every block from disk.
+ * @param thread_count is the number of threads reading blocks in parallel. 0 reads the blocks one at a time
+ * by the querying thread.
+ */
+void start(DiskIndex* const index, std::size_t cache_capacity, unsigned thread_count);
+
+/**
+ * @brief stop stops the threads and releases the cache of the reader of a DiskIndex.
+ * @param index is the index. No query may be in progress.
+ */
+void stop(DiskIndex* const index);
+
+/**
+ * @brief fetch_clusters scans the blocks of the given clusters. Blocks which are not cached are requested
+ * from the threads at once, then the cached blocks are scanned and afterwards each read block as soon as it
+ * arrives.
+ * @param index is the index to read from.
+ * @param clusters are the clusters to scan. Clusters without points are skipped.
+ * @param scan is called for each block with the block and the number of points of its cluster.
+ */
+void fetch_clusters(DiskIndex& index, const std::vector<const MappedNode*>& clusters,
+                    const std::function<void(const char*, std::uint64_t)>& scan);
+
+/**
+ * @brief block_size is the size in bytes of the block of a cluster with the given number of points.
+ */
+std::size_t block_size(std::uint64_t point_count);
+
+}  // namespace cluster_reader
+
+#endif  // CLUSTER_READER_HPP
@@ -1,24 +1,91 @@
+#include <algorithm>
 #include <cmath>
 #include <eCP/index/eCP.hpp>
 #include <eCP/index/maintenance.hpp>
 #include <eCP/index/pre-processing.hpp>
 #include <eCP/index/query-processing.hpp>
+#include <eCP/index/serialization.hpp>
 #include <eCP/index/shared/data_structure.hpp>
 #include <eCP/index/shared/distance.hpp>
 #include <eCP/index/shared/globals.hpp>
+#include <eCP/index/shared/quantization.hpp>
+#include <eCP/index/write-ahead-log.hpp>
+#include <eCP/utilities/utilities.hpp>
 #include <stdexcept>
 
 namespace eCP {
-Index* eCP_Index(const std::vector<std::vector<float>>& descriptors, unsigned cluster_size, unsigned metric,
-                 bool batch_build)
+
+/**
+ * @brief set_globals sets the global descriptor type, dimensionality and distance function of a new index.
+ */
+static void set_globals(std::size_t dimensions, unsigned metric, globals::DescriptorType descriptor_type)
 {
-  // Set descriptor dimension globally.
-  globals::g_vector_dimensions = descriptors[0].size();
+  // Set descriptor type and dimension globally. Binary descriptors have 8 dimensions per byte.
+  globals::g_descriptor_type = descriptor_type;
+  globals::g_vector_dimensions = dimensions;
+
+  if (descriptor_type == globals::DescriptorType::BINARY) {
+    globals::g_vector_dimensions *= 8;
+  }
 
   // Set distance function globally
   auto metric_type = static_cast<distance::Metric>(metric);
   distance::set_distance_function(metric_type);
 
+  // A new index starts out uncompressed.
+  quantization::reset();
+}
+
+/**
+ * @brief descriptor_type_of_file returns the descriptor type of the rows of a .fvecs or .bvecs file. Throws
+ * std::invalid_argument for .ivecs files, which hold e.g. ground truth rather than descriptors.
+ */
+static globals::DescriptorType descriptor_type_of_file(const utilities::VecsFile* const file, unsigned metric)
+{
+  switch (file->type) {
+    case utilities::VecsType::FVECS:
+      return globals::DescriptorType::FLOAT32;
+    case utilities::VecsType::BVECS:
+      // Bytes are bit-packed binary descriptors when compared by the Hamming distance.
+      return (metric == distance::Metric::HAMMING) ? globals::DescriptorType::BINARY
+                                                   : globals::DescriptorType::UINT8;
+    default:
+      throw std::invalid_argument("eCP: Only .fvecs and .bvecs files hold descriptors.");
+  }
+}
+
+/**
+ * @brief insert_rows inserts the rows of a mapped file from the given row onwards a chunk at a time, such
+ * that only a single chunk is copied out of the mapping.
+ * @param file is the mapped file of the descriptor type of the index.
+ * @param begin is the position of the first row to insert.
+ * @param chunk_size is the number of rows inserted at a time, 0 to insert chunks no larger than the index
+ * such that the index grows gradually.
+ * @param index is the index to insert into.
+ */
+static void insert_rows(const utilities::VecsFile* const file, std::size_t begin, std::size_t chunk_size,
+                        Index* const index)
+{
+  std::vector<float> chunk;  // Floats for alignment, the rows may be bytes.
+  while (begin < file->rows) {
+    const std::size_t count = std::min(file->rows - begin, chunk_size > 0 ? chunk_size : index->size);
+    chunk.resize((count * file->cols * file->element_size + sizeof(float) - 1) / sizeof(float));
+    utilities::copy_vecs_rows(file, begin, count, reinterpret_cast<char*>(chunk.data()));
+
+    maintenance::insert_batch(chunk.data(), count, index);
+    begin += count;
+  }
+}
+
+/**
+ * @brief build_index sets the globals and builds the index from descriptors with element type T.
+ */
+template <typename T>
+static Index* build_index(const std::vector<std::vector<T>>& descriptors, unsigned cluster_size,
+                          unsigned metric, bool batch_build, globals::DescriptorType descriptor_type)
+{
+  set_globals(descriptors[0].size(), metric, descriptor_type);
+
   // Build index
   if (batch_build) {
     Index* index = pre_processing::create_index(descriptors, cluster_size);
@@ -27,34 +94,367 @@ Index* eCP_Index(const std::vector<std::vector<float>>& descriptors, unsigned cl
 
   else {
     // Construct minimal index.
-    std::vector<std::vector<float>> initial_node{descriptors[0]};
+    std::vector<std::vector<T>> initial_node{descriptors[0]};
     Index* index = pre_processing::create_index(initial_node, cluster_size, 0.3, 0.3,
                                                 ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE);
 
-    // Insert the rest of the dataset.
-    for (unsigned i = 1; i < descriptors.size(); ++i) {
-      maintenance::insert(descriptors[i].data(), index);
+    // Insert the rest of the dataset in batches no larger than the index such that the index grows gradually.
+    std::vector<T> batch;
+    for (std::size_t begin = 1; begin < descriptors.size();) {
+      const std::size_t end = std::min<std::size_t>(descriptors.size(), begin + index->size);
+
+      batch.clear();
+      for (std::size_t i = begin; i < end; ++i) {
+        batch.insert(batch.end(), descriptors[i].begin(), descriptors[i].end());
+      }
+
+      maintenance::insert_batch(reinterpret_cast<const float*>(batch.data()), end - begin, index);
+      begin = end;
     }
 
     return index;
   }
 }
 
+Index* eCP_Index(const std::vector<std::vector<float>>& descriptors, unsigned cluster_size, unsigned metric,
+                 bool batch_build)
+{
+  return build_index(descriptors, cluster_size, metric, batch_build, globals::DescriptorType::FLOAT32);
+}
+
+Index* eCP_Index(const std::vector<std::vector<std::uint8_t>>& descriptors, unsigned cluster_size,
+                 unsigned metric, bool batch_build)
+{
+  // Bytes are bit-packed binary descriptors when compared by the Hamming distance.
+  const auto descriptor_type = (metric == distance::Metric::HAMMING) ? globals::DescriptorType::BINARY
+                                                                     : globals::DescriptorType::UINT8;
+  return build_index(descriptors, cluster_size, metric, batch_build, descriptor_type);
+}
+
+Index* eCP_Index(const std::vector<std::vector<std::int8_t>>& descriptors, unsigned cluster_size,
+                 unsigned metric, bool batch_build)
+{
+  return build_index(descriptors, cluster_size, metric, batch_build, globals::DescriptorType::INT8);
+}
+
+Index* eCP_Index(const float* descriptors, std::size_t n, std::size_t dimensions, std::size_t stride,
+                 unsigned cluster_size, unsigned metric, bool batch_build)
+{
+  set_globals(dimensions, metric, globals::DescriptorType::FLOAT32);
+
+  if (batch_build) {
+    return pre_processing::create_index(descriptors, n, dimensions, stride, cluster_size);
+  }
+
+  // Construct minimal index and insert the rest as above. Consecutive descriptors are inserted directly from
+  // the given storage, otherwise each batch is gathered first.
+  Index* index = pre_processing::create_index(descriptors, 1, dimensions, stride, cluster_size, 0.3, 0.3,
+                                              ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE);
+  std::vector<float> batch;
+  for (std::size_t begin = 1; begin < n;) {
+    const std::size_t end = std::min<std::size_t>(n, begin + index->size);
+
+    if (stride == dimensions) {
+      maintenance::insert_batch(descriptors + begin * stride, end - begin, index);
+    }
+    else {
+      batch.clear();
+      for (std::size_t i = begin; i < end; ++i) {
+        batch.insert(batch.end(), descriptors + i * stride, descriptors + i * stride + dimensions);
+      }
+      maintenance::insert_batch(batch.data(), end - begin, index);
+    }
+    begin = end;
+  }
+
+  return index;
+}
+
+Index* eCP_Index_from_file(const std::string& path, unsigned cluster_size, unsigned metric, bool batch_build)
+{
+  utilities::VecsFile* file = utilities::open_vecs_file(path);
+  Index* index{nullptr};
+
+  try {
+    if (file->rows == 0) {
+      throw std::invalid_argument("eCP: The file " + path + " holds no descriptors.");
+    }
+    set_globals(file->cols, metric, descriptor_type_of_file(file, metric));
+
+    // The points copy their descriptors, thus the file is not needed once the index is built.
+    const char* rows = utilities::vecs_row(file, 0);
+    if (batch_build) {
+      index = pre_processing::create_index(rows, file->rows, file->stride, cluster_size);
+    }
+    else {
+      index = pre_processing::create_index(rows, 1, file->stride, cluster_size, 0.3, 0.3,
+                                           ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE);
+      insert_rows(file, 1, 0, index);
+    }
+  }
+  catch (...) {
+    delete index;
+    utilities::close_vecs_file(file);
+    throw;
+  }
+
+  utilities::close_vecs_file(file);
+  return index;
+}
+
+/**
+ * @brief stores_elements_of tells whether the descriptors of the index are stored as elements of type T.
+ */
+template <typename T>
+static bool stores_elements_of();
+
+template <>
+bool stores_elements_of<float>()
+{
+  return globals::g_descriptor_type == globals::DescriptorType::FLOAT32;
+}
+
+template <>
+bool stores_elements_of<std::uint8_t>()
+{
+  // Binary descriptors are bit-packed into bytes.
+  return globals::g_descriptor_type == globals::DescriptorType::UINT8 ||
+         globals::g_descriptor_type == globals::DescriptorType::BINARY;
+}
+
+template <>
+bool stores_elements_of<std::int8_t>()
+{
+  return globals::g_descriptor_type == globals::DescriptorType::INT8;
+}
+
+/**
+ * @brief expect_element_type throws std::invalid_argument unless the descriptors of the index are stored as
+ * elements of type T, such that e.g. floats are never stored as bytes.
+ */
+template <typename T>
+static void expect_element_type()
+{
+  if (!stores_elements_of<T>()) {
+    throw std::invalid_argument("eCP: The descriptor is not of the descriptor type of the index.");
+  }
+}
+
 void insert(const float* descriptor, Index* const index)
 {
+  expect_element_type<float>();
+
   // Inserts descriptor into index.
   maintenance::insert(descriptor, index);
 }
 
-std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<float> query,
-                                                               unsigned int k, unsigned int b)
+void insert(const std::uint8_t* descriptor, Index* const index)
+{
+  expect_element_type<std::uint8_t>();
+  maintenance::insert(reinterpret_cast<const float*>(descriptor), index);
+}
+
+void insert(const std::int8_t* descriptor, Index* const index)
+{
+  expect_element_type<std::int8_t>();
+  maintenance::insert(reinterpret_cast<const float*>(descriptor), index);
+}
+
+void insert_batch(const float* descriptors, std::size_t n, Index* const index)
+{
+  expect_element_type<float>();
+  maintenance::insert_batch(descriptors, n, index);
+}
+
+void insert_batch(const std::uint8_t* descriptors, std::size_t n, Index* const index)
+{
+  expect_element_type<std::uint8_t>();
+  maintenance::insert_batch(reinterpret_cast<const float*>(descriptors), n, index);
+}
+
+void insert_batch(const std::int8_t* descriptors, std::size_t n, Index* const index)
+{
+  expect_element_type<std::int8_t>();
+  maintenance::insert_batch(reinterpret_cast<const float*>(descriptors), n, index);
+}
+
+void insert_batch_from_file(const std::string& path, Index* const index, std::size_t chunk_size)
+{
+  if (chunk_size == 0) {
+    throw std::invalid_argument("eCP: Chunks must hold at least one row.");
+  }
+
+  utilities::VecsFile* file = utilities::open_vecs_file(path);
+  try {
+    const auto descriptor_type = descriptor_type_of_file(file, distance::g_metric);
+    const std::size_t dimensions_per_element = (descriptor_type == globals::DescriptorType::BINARY) ? 8 : 1;
+    const std::size_t dimensions = file->cols * dimensions_per_element;
+    if (file->rows > 0 &&
+        (descriptor_type != globals::g_descriptor_type || dimensions != globals::g_vector_dimensions)) {
+      throw std::invalid_argument("eCP: The rows of " + path +
+                                  " are not of the type and dimensionality of the index.");
+    }
+
+    insert_rows(file, 0, chunk_size, index);
+  }
+  catch (...) {
+    utilities::close_vecs_file(file);
+    throw;
+  }
+
+  utilities::close_vecs_file(file);
+}
+
+void update(unsigned long id, const float* descriptor, Index* const index)
+{
+  expect_element_type<float>();
+  maintenance::update(id, descriptor, index);
+}
+
+void update(unsigned long id, const std::uint8_t* descriptor, Index* const index)
+{
+  expect_element_type<std::uint8_t>();
+  maintenance::update(id, reinterpret_cast<const float*>(descriptor), index);
+}
+
+void update(unsigned long id, const std::int8_t* descriptor, Index* const index)
+{
+  expect_element_type<std::int8_t>();
+  maintenance::update(id, reinterpret_cast<const float*>(descriptor), index);
+}
+
+void erase(unsigned long id, Index* const index) { maintenance::erase(id, index); }
+
+void compact(Index* const index) { maintenance::compact(index); }
+
+void enable_delta_buffer(Index* const index, std::size_t capacity, unsigned max_age)
+{
+  maintenance::enable_delta_buffer(index, capacity, max_age);
+}
+
+void disable_delta_buffer(Index* const index) { maintenance::disable_delta_buffer(index); }
+
+void save(Index* const index, const std::string& path) { serialization::save(index, path); }
+
+Index* load(const std::string& path) { return serialization::load(path); }
+
+void checkpoint(Index* const index, const std::string& path) { serialization::checkpoint(index, path); }
+
+Index* load_checkpoint(const std::string& path) { return serialization::load_checkpoint(path); }
+
+void fold_checkpoint(const std::string& checkpoint_path, const std::string& path)
+{
+  serialization::fold_checkpoint(checkpoint_path, path);
+}
+
+void save_mapped(Index* const index, const std::string& path) { serialization::save_mapped(index, path); }
+
+MappedIndex* open_mapped(const std::string& path) { return serialization::open_mapped(path); }
+
+void close_mapped(MappedIndex* const index) { serialization::close_mapped(index); }
+
+void save_shared(Index* const index, const std::string& name) { serialization::save_shared(index, name); }
+
+MappedIndex* open_shared(const std::string& name) { return serialization::open_shared(name); }
+
+void remove_shared(const std::string& name) { serialization::remove_shared(name); }
+
+void save_on_disk(Index* const index, const std::string& path) { serialization::save_on_disk(index, path); }
+
+void build_on_disk(const std::string& dataset_path, const std::string& path, unsigned cluster_size,
+                   unsigned metric, std::size_t memory_budget)
+{
+  utilities::VecsFile* file = utilities::open_vecs_file(dataset_path);
+
+  try {
+    if (file->rows == 0) {
+      throw std::invalid_argument("eCP: The file " + dataset_path + " holds no descriptors.");
+    }
+    set_globals(file->cols, metric, descriptor_type_of_file(file, metric));
+
+    auto read = [file](std::size_t begin, std::size_t count, char* destination) {
+      utilities::copy_vecs_rows(file, begin, count, destination);
+    };
+    pre_processing::create_disk_index(read, file->rows, cluster_size, memory_budget, path);
+  }
+  catch (...) {
+    utilities::close_vecs_file(file);
+    throw;
+  }
+
+  utilities::close_vecs_file(file);
+}
+
+DiskIndex* open_on_disk(const std::string& path, std::size_t cache_capacity, unsigned thread_count)
+{
+  return serialization::open_on_disk(path, cache_capacity, thread_count);
+}
+
+void close_on_disk(DiskIndex* const index) { serialization::close_on_disk(index); }
+
+void enable_write_ahead_log(Index* const index, const std::string& path, unsigned commit_interval)
+{
+  write_ahead_log::enable(index, path, commit_interval);
+}
+
+void disable_write_ahead_log(Index* const index) { write_ahead_log::disable(index); }
+
+unsigned long recover(Index* const index, const std::string& path)
+{
+  return write_ahead_log::replay(path, index);
+}
+
+void enable_background_maintenance(Index* const index, unsigned publish_interval)
+{
+  maintenance::enable_background_maintenance(index, publish_interval);
+}
+
+void disable_background_maintenance(Index* const index)
+{
+  maintenance::disable_background_maintenance(index);
+}
+
+/**
+ * @brief collect_clusters appends pointers to all clusters below node.
+ */
+static void collect_clusters(Node& node, std::vector<Node*>& clusters)
+{
+  if (node.children.empty()) {
+    clusters.emplace_back(&node);
+  }
+
+  for (auto& child : node.children) {
+    collect_clusters(child, clusters);
+  }
+}
+
+void enable_compression(Index* const index)
 {
-  // internal data structure uses float pointer instead of vectors
-  float* q = query.data();
+  auto lock = maintenance::write_lock(index);
+  std::vector<Node*> clusters;
+  collect_clusters(index->root, clusters);
+
+  std::vector<const float*> descriptors;
+  descriptors.reserve(index->size);
+  for (Node* cluster : clusters) {
+    for (auto& point : cluster->points) {
+      descriptors.emplace_back(point.descriptor);
+    }
+  }
+
+  quantization::train(descriptors);
 
-  auto nearest_points = query_processing::k_nearest_neighbors(index->root.children, q, k, b, index->L);
+  for (Node* cluster : clusters) {
+    cluster->encode_points();
+  }
+}
 
-  // unzip since id are only needed for ANN-Benchmarks
+/**
+ * @brief unzip splits the (id, distance) pairs of a search since ids are only needed for ANN-Benchmarks.
+ */
+static std::pair<std::vector<unsigned int>, std::vector<float>> unzip(
+    std::vector<std::pair<unsigned int, float>> nearest_points)
+{
   std::vector<unsigned int> nearest_indexes = {};
   std::vector<float> nearest_dist = {};
 
@@ -68,4 +468,174 @@ std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std
   return make_pair(nearest_indexes, nearest_dist);
 }
 
+/**
+ * @brief search runs the k-nn search for a query in the storage format of the global descriptor type and
+ * unzips the result.
+ */
+static std::pair<std::vector<unsigned int>, std::vector<float>> search(Index* index, const float* query,
+                                                                      unsigned int k, unsigned int b,
+                                                                      unsigned int rerank_factor)
+{
+  // The search only reads the query, it is passed on as the pointer type of the internal data structure.
+  float* q = const_cast<float*>(query);
+
+  if (!index->maintainer) {
+    maintenance::merge_expired_delta_buffer(index);  // Otherwise merged by the background thread.
+  }
+
+  // Read the latest published version if any, otherwise lock the index itself.
+  auto version = maintenance::read_version(index);
+  auto lock = version ? maintenance::ReadLock{} : maintenance::read_lock(index);
+  const std::vector<bool>& erased = version ? version->tombstones : index->tombstones;
+  const DeltaBuffer& buffered = version ? version->delta : index->delta;
+
+  // Only pass tombstones and the delta buffer if anything has been erased or buffered.
+  const std::vector<bool>* tombstones = erased.empty() ? nullptr : &erased;
+  const DeltaBuffer* delta = buffered.ids.empty() ? nullptr : &buffered;
+
+  if (version) {
+    return unzip(query_processing::k_nearest_neighbors(*version->root, q, k, b, version->L, rerank_factor,
+                                                       tombstones, delta));
+  }
+  return unzip(query_processing::k_nearest_neighbors(index->root.children, q, k, b, index->L, rerank_factor,
+                                                     tombstones, delta));
+}
+
+/**
+ * @brief search runs the k-nn search for a query on a mapped index and unzips the result.
+ */
+static std::pair<std::vector<unsigned int>, std::vector<float>> search(MappedIndex* index, const float* query,
+                                                                      unsigned int k, unsigned int b,
+                                                                      unsigned int rerank_factor)
+{
+  float* q = const_cast<float*>(query);
+  return unzip(query_processing::k_nearest_neighbors(*index, q, k, b, rerank_factor));
+}
+
+/**
+ * @brief search runs the k-nn search for a query on a disk index and unzips the result.
+ */
+static std::pair<std::vector<unsigned int>, std::vector<float>> search(DiskIndex* index, const float* query,
+                                                                      unsigned int k, unsigned int b)
+{
+  float* q = const_cast<float*>(query);
+  return unzip(query_processing::k_nearest_neighbors(*index, q, k, b));
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<float> query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor)
+{
+  return search(index, query.data(), k, b, rerank_factor);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<std::uint8_t> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query.data()), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<std::int8_t> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query.data()), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, std::vector<float> query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor)
+{
+  return search(index, query.data(), k, b, rerank_factor);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index,
+                                                               std::vector<std::uint8_t> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query.data()), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index,
+                                                               std::vector<std::int8_t> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query.data()), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, std::vector<float> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, query.data(), k, b);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index,
+                                                               std::vector<std::uint8_t> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query.data()), k, b);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index,
+                                                               std::vector<std::int8_t> query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query.data()), k, b);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, const float* query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor)
+{
+  return search(index, query, k, b, rerank_factor);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, const std::uint8_t* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, const std::int8_t* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, const float* query,
+                                                               unsigned int k, unsigned int b,
+                                                               unsigned int rerank_factor)
+{
+  return search(index, query, k, b, rerank_factor);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, const std::uint8_t* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, const std::int8_t* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query), k, b, 0);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, const float* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, query, k, b);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, const std::uint8_t* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query), k, b);
+}
+
+std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, const std::int8_t* query,
+                                                               unsigned int k, unsigned int b)
+{
+  return search(index, reinterpret_cast<const float*>(query), k, b);
+}
+
 }  // namespace eCP
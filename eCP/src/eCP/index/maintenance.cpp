@@ -1,9 +1,18 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <eCP/index/maintenance.hpp>
+#include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/quantization.hpp>
 #include <eCP/index/shared/traversal.hpp>
+#include <eCP/index/write-ahead-log.hpp>
 #include <eCP/utilities/utilities.hpp>
+#include <functional>
+#include <numeric>
 #include <stack>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace maintenance_helpers {
 
@@ -19,10 +28,12 @@ void grow_index(Node* current_root, Index* const index)
   const auto random_index = utilities::get_random_unique_indexes(1, current_root->children.size()).front();
   auto new_root_point = *current_root->children.at(random_index).get_leader();
   auto new_root = Node{new_root_point};
+  new_root.point_count = current_root->point_count;
+  new_root.grandchild_count = current_root->children.size();
 
   // Insert new root into index.
-  new_root.children.emplace_back(*current_root);  // Add old root to the children list.
-  index->root = new_root;
+  new_root.children.emplace_back(std::move(*current_root));  // Add old root to the children list.
+  index->root = std::move(new_root);
   index->L++;
 }
 
@@ -48,62 +59,197 @@ const std::vector<unsigned> generate_indexes_for_optimal_level_size(unsigned chi
   return indexes;
 }
 
-void recluster_internal_node(Node* const node_parent, unsigned node_lo_size, unsigned node_hi_size)
+/**
+ * @brief The ClusterPlan struct describes how a set of points or nodes is redistributed below new leaders.
+ */
+struct ClusterPlan {
+  std::vector<unsigned> leaders;      // Indexes of the points picked as leaders of the new clusters.
+  std::vector<unsigned> assignments;  // For each point the index into leaders of its new cluster.
+};
+
+/**
+ * @brief find_nearest_leader finds the leader nearest to the descriptor.
+ * @param descriptor is the descriptor to find the nearest leader of.
+ * @param leaders are the descriptors of the leaders. Must not be empty.
+ * @return the index into leaders of the nearest leader.
+ */
+unsigned find_nearest_leader(const float* descriptor, const std::vector<const float*>& leaders)
 {
-  std::vector<Node*> children;  // Total number of children of all children under parent.
-  children.reserve((node_hi_size + 1) * node_parent->children.size());  // Reserve max + 1 due to grown nodes.
+  unsigned nearest_leader{0};
+  float nearest = globals::FLOAT_MAX;
 
-  for (auto& parent_child : node_parent->children) {  // Collect all parent->children->children
-    for (auto& child : parent_child.children) {
-      children.emplace_back(&child);
+  for (unsigned j = 0; j < leaders.size(); ++j) {
+    const float distance = distance::g_distance_function(descriptor, leaders[j], nearest);
+
+    if (distance < nearest) {
+      nearest = distance;
+      nearest_leader = j;
+    }
+  }
+
+  return nearest_leader;
+}
+
+/**
+ * @brief plan_clusters picks l random leaders from the descriptors and assigns every descriptor to the
+ * cluster of its nearest leader. This is the expensive part of a reclustering.
+ * @param descriptors is the set of descriptors to redistribute.
+ * @param cluster_lo_size is the optimal size of a cluster.
+ * @return the plan to be applied using apply_cluster_plan or apply_node_plan.
+ */
+ClusterPlan plan_clusters(const std::vector<const float*>& descriptors, unsigned cluster_lo_size)
+{
+  ClusterPlan plan;
+  plan.leaders = generate_indexes_for_optimal_level_size(descriptors.size(), cluster_lo_size);
+  plan.assignments.resize(descriptors.size());
+
+  std::vector<bool> is_leader(descriptors.size(), false);
+  std::vector<const float*> leaders;
+  leaders.reserve(plan.leaders.size());
+
+  for (unsigned i = 0; i < plan.leaders.size(); ++i) {
+    plan.assignments[plan.leaders[i]] = i;
+    is_leader[plan.leaders[i]] = true;
+    leaders.emplace_back(descriptors[plan.leaders[i]]);
+  }
+
+  for (unsigned i = 0; i < descriptors.size(); ++i) {
+    if (!is_leader[i]) {
+      plan.assignments[i] = find_nearest_leader(descriptors[i], leaders);
     }
   }
 
-  const auto indexes = generate_indexes_for_optimal_level_size(children.size(), node_lo_size);
+  return plan;
+}
+
+/**
+ * @brief recount recomputes the counts of a node from its children, whose counts must be correct.
+ * @param node is the node whose children have been changed.
+ */
+void recount(Node& node)
+{
+  if (node.children.empty()) {
+    node.point_count = node.points.size();
+    node.grandchild_count = 0;
+    return;
+  }
+
+  node.point_count = 0;
+  node.grandchild_count = 0;
+
+  for (auto& child : node.children) {
+    node.point_count += child.point_count;
+    node.grandchild_count += child.children.size();
+  }
+}
+
+/**
+ * @brief apply_node_plan substitutes the children of the parent by new nodes led by copies of the leaders of
+ * the planned leader nodes and moves every node below its new leader.
+ * @param node_parent is the node whose children are substituted.
+ * @param nodes are the children of the children of the parent in the order the plan was made from.
+ * @param plan is the plan made by plan_clusters from the descriptors of the leaders of the nodes.
+ */
+void apply_node_plan(Node* const node_parent, const std::vector<Node*>& nodes, const ClusterPlan& plan)
+{
   std::vector<Node> leaders;
-  leaders.reserve(indexes.size());
+  leaders.reserve(plan.leaders.size());
 
-  for (unsigned index : indexes) {  // Pick l random new Nodes as leaders.
-    leaders.emplace_back(Node{*children[index]->get_leader()});
+  for (unsigned index : plan.leaders) {  // Pick l random new Nodes as leaders.
+    leaders.emplace_back(Node{*nodes[index]->get_leader()});
   }
 
   // Add each node/subtree to its nearest parent
-  for (Node* node : children) {
-    traversal::get_closest_node(node->get_leader()->descriptor, leaders)->children.emplace_back(*node);
+  for (unsigned i = 0; i < nodes.size(); ++i) {
+    leaders[plan.assignments[i]].children.emplace_back(std::move(*nodes[i]));
+  }
+
+  for (auto& leader : leaders) {  // The same nodes are below the parent thus its counts are unchanged.
+    recount(leader);
   }
 
   node_parent->children.swap(leaders);
+  node_parent->mark_changed();
 }
 
-void recluster_cluster(Node* const cluster_parent, unsigned cluster_lo_size, unsigned cluster_hi_size)
+void recluster_internal_node(Node* const node_parent, unsigned node_lo_size, unsigned node_hi_size)
 {
-  std::vector<Point*> descriptors;  // Total number of descriptors of all children under parent.
-  descriptors.reserve((cluster_hi_size + 1) * cluster_parent->children.size());  // + 1 due to grown nodes.
+  std::vector<Node*> children;  // Total number of children of all children under parent.
+  children.reserve((node_hi_size + 1) * node_parent->children.size());  // Reserve max + 1 due to grown nodes.
 
-  for (auto& cluster : cluster_parent->children) {  // Collect all descriptors as pointers.
-    for (auto& point : cluster.points) {
-      descriptors.emplace_back(&point);
+  for (auto& parent_child : node_parent->children) {  // Collect all parent->children->children
+    for (auto& child : parent_child.children) {
+      children.emplace_back(&child);
     }
   }
 
-  const auto indexes = generate_indexes_for_optimal_level_size(descriptors.size(), cluster_lo_size);
+  std::vector<const float*> descriptors;
+  descriptors.reserve(children.size());
+  for (Node* child : children) {
+    descriptors.emplace_back(child->get_leader()->descriptor);
+  }
+
+  apply_node_plan(node_parent, children, plan_clusters(descriptors, node_lo_size));
+}
+
+/**
+ * @brief apply_cluster_plan moves the points into the new clusters of the plan which substitute the children
+ * of the parent. Points beyond the size of the plan, i.e. added after it was made, are added to their nearest
+ * new cluster.
+ * @param cluster_parent is the node whose children are substituted.
+ * @param points are the points of the children of the parent in the order the plan was made from.
+ * @param plan is the plan made by plan_clusters.
+ * @param cluster_hi_size is the maximum size of a cluster used as allocation size.
+ */
+void apply_cluster_plan(Node* const cluster_parent, const std::vector<Point*>& points,
+                        const ClusterPlan& plan, unsigned cluster_hi_size)
+{
   std::vector<Node> leaders;  // Revised set of leaders to substitute the children of parent.
-  leaders.reserve(indexes.size());
+  leaders.reserve(plan.leaders.size());
 
-  for (unsigned index : indexes) {  // Pick l random leaders from set of descriptors.
-    auto node = Node{*descriptors[index]};
+  for (unsigned index : plan.leaders) {
+    auto node = Node{std::move(*points[index])};
     node.points.reserve(cluster_hi_size);  // Allocate max potential size.
-    leaders.emplace_back(node);
-    descriptors[index] = nullptr;  // Because it will make it easier to circumvent duplicates below.
+    leaders.emplace_back(std::move(node));
   }
 
-  for (Point* point : descriptors) {  // Redistribute all points to the new closest clusters.
-    if (point) {                      // Using nullptr to not re-add points used in Nodes above.
-      traversal::find_nearest_leaf(point->descriptor, leaders)->points.emplace_back(*point);
+  for (unsigned i = 0; i < points.size(); ++i) {  // Redistribute all points to the new closest clusters.
+    if (i >= plan.assignments.size()) {
+      traversal::find_nearest_leaf(points[i]->descriptor, leaders)
+          ->points.emplace_back(std::move(*points[i]));
     }
+    else if (plan.leaders[plan.assignments[i]] != i) {  // Not re-adding points used in Nodes above.
+      leaders[plan.assignments[i]].points.emplace_back(std::move(*points[i]));
+    }
+  }
+
+  for (auto& leader : leaders) {
+    recount(leader);
+    leader.encode_points();
   }
 
   cluster_parent->children.swap(leaders);
+  cluster_parent->mark_changed();
+}
+
+void recluster_cluster(Node* const cluster_parent, unsigned cluster_lo_size, unsigned cluster_hi_size)
+{
+  std::vector<Point*> points;  // Total number of descriptors of all children under parent.
+  points.reserve((cluster_hi_size + 1) * cluster_parent->children.size());  // + 1 due to grown nodes.
+
+  for (auto& cluster : cluster_parent->children) {  // Collect all descriptors as pointers.
+    for (auto& point : cluster.points) {
+      points.emplace_back(&point);
+    }
+  }
+
+  std::vector<const float*> descriptors;
+  descriptors.reserve(points.size());
+  for (Point* point : points) {
+    descriptors.emplace_back(point->descriptor);
+  }
+
+  apply_cluster_plan(cluster_parent, points, plan_clusters(descriptors, cluster_lo_size), cluster_hi_size);
 }
 
 /**
@@ -143,21 +289,34 @@ unsigned count_nodes_of_children(const Node* parent)
  */
 typedef unsigned (*count_descendants_function)(const Node* parent);
 
+/**
+ * @brief counted_points_of_children is the O(1) counterpart of count_points_of_children using the count
+ * maintained by the parent. Used as the typdef count_descendants_function.
+ */
+unsigned counted_points_of_children(const Node* parent) { return parent->point_count; }
+
+/**
+ * @brief counted_nodes_of_children is the O(1) counterpart of count_nodes_of_children using the count
+ * maintained by the parent. Used as the typdef count_descendants_function.
+ */
+unsigned counted_nodes_of_children(const Node* parent) { return parent->grandchild_count; }
+
 /**
  * @brief is_reclustering_required computes whether a reclustering is necessary based on the given
- * ReclusteringPolicy.
- * @param count_descendants_func is a function used if the AVERAGE policy is used.
+ * ReclusteringPolicy and counts of the parent, e.g. as read while holding its latch.
+ * @param descendants is the number of descendants counted by the parent, used if the AVERAGE policy is used.
+ * @param siblings is the number of children of the parent, used if the AVERAGE policy is used.
  * @param number_of_children is the size (number of children) of the cluster or node being checked.
- * @param parent is the parent of the initiating node used to check if the AVERAGE policy is used.
  * @param policy is the policy used.
- * @param hi_bound is the maximum size of a node/cluster used if the ABSOLUTE policy is used.
+ * @param hi_bound is the maximum size of a node/cluster.
  * @return true if a reclustering is necessary otherwise false.
  */
-bool is_reclustering_required(count_descendants_function count_descendants_func, unsigned number_of_children,
-                              Node* const parent, ReclusteringPolicy policy, unsigned hi_bound)
+bool is_reclustering_required(unsigned descendants, std::size_t siblings, unsigned number_of_children,
+                              ReclusteringPolicy policy, unsigned hi_bound)
 {
   switch (policy) {
-    case ReclusteringPolicy::ABSOLUTE: {
+    case ReclusteringPolicy::ABSOLUTE:
+    case ReclusteringPolicy::SPLIT: {
       if (number_of_children > hi_bound) {
         return true;
       }
@@ -165,10 +324,9 @@ bool is_reclustering_required(count_descendants_function count_descendants_func,
     }
 
     case ReclusteringPolicy::AVERAGE: {
-      auto subtree_max{parent->children.size() * hi_bound};  // Theoretical max based on hi bound.
-      auto subtree_actual{count_descendants_func(parent)};
+      auto subtree_max{siblings * hi_bound};  // Theoretical max based on hi bound.
 
-      if (subtree_actual > subtree_max) {
+      if (descendants > subtree_max) {
         return true;
       }
 
@@ -182,7 +340,200 @@ bool is_reclustering_required(count_descendants_function count_descendants_func,
   return false;
 }
 
-void recursively_recluster_index(Node* initiating_node, std::stack<Node*>& path, Index* index,
+/**
+ * @brief is_reclustering_required computes whether a reclustering is necessary based on the given
+ * ReclusteringPolicy.
+ * @param count_descendants_func is a function used if the AVERAGE policy is used.
+ * @param number_of_children is the size (number of children) of the cluster or node being checked.
+ * @param parent is the parent of the initiating node used to check if the AVERAGE policy is used.
+ * @param policy is the policy used.
+ * @param hi_bound is the maximum size of a node/cluster used if the ABSOLUTE policy is used.
+ * @return true if a reclustering is necessary otherwise false.
+ */
+bool is_reclustering_required(count_descendants_function count_descendants_func, unsigned number_of_children,
+                              Node* const parent, ReclusteringPolicy policy, unsigned hi_bound)
+{
+  const unsigned descendants = (policy == ReclusteringPolicy::AVERAGE) ? count_descendants_func(parent) : 0;
+  return is_reclustering_required(descendants, parent->children.size(), number_of_children, policy, hi_bound);
+}
+
+/**
+ * @brief locate_cluster_points records the PointLocation of all points in the given cluster.
+ * @param cluster is the cluster containing the points.
+ * @param index is the index whose locations are updated.
+ */
+void locate_cluster_points(Node& cluster, Index* const index)
+{
+  if (index->locations.size() < index->size) {
+    index->locations.resize(index->size);
+  }
+
+  const float* leader = cluster.get_leader()->descriptor;
+  for (auto& point : cluster.points) {
+    index->locations[point.id] = PointLocation{point.descriptor, leader};
+  }
+}
+
+/**
+ * @brief locate_last_point records the PointLocation of the point most recently added to the cluster.
+ * @param cluster is the cluster containing the point.
+ * @param index is the index whose locations are updated.
+ */
+void locate_last_point(Node& cluster, Index* const index)
+{
+  if (index->locations.size() < index->size) {
+    index->locations.resize(index->size);
+  }
+
+  const Point& point = cluster.points.back();
+  index->locations[point.id] = PointLocation{point.descriptor, cluster.get_leader()->descriptor};
+}
+
+/**
+ * @brief locate_points records the PointLocation of all points in the clusters below node.
+ * @param node is the root of the subtree containing the points.
+ * @param index is the index whose locations are updated.
+ */
+void locate_points(Node& node, Index* const index)
+{
+  if (node.children.empty()) {
+    locate_cluster_points(node, index);
+  }
+
+  for (auto& child : node.children) {
+    locate_points(child, index);
+  }
+}
+
+/**
+ * @brief find_farthest_member finds the descriptor farthest from the first one. Together they form the
+ * leaders of a split.
+ * @param descriptors are the descriptors to search. Must contain at least 2 descriptors.
+ * @return the index of the farthest descriptor, never 0.
+ */
+unsigned find_farthest_member(const std::vector<const float*>& descriptors)
+{
+  unsigned farthest{1};
+  float farthest_distance{-1};
+
+  for (unsigned i = 1; i < descriptors.size(); ++i) {
+    const float distance = distance::g_distance_function(descriptors[0], descriptors[i], globals::FLOAT_MAX);
+
+    if (distance > farthest_distance) {
+      farthest_distance = distance;
+      farthest = i;
+    }
+  }
+
+  return farthest;
+}
+
+/**
+ * @brief plan_split divides descriptors between the first descriptor and the one farthest from it such that
+ * each goes to the nearer of the two. Ties stay with the first descriptor.
+ * @param descriptors are the descriptors to divide. Must contain at least 2 descriptors.
+ * @return the plan with 2 leaders where leader 0 is the first descriptor.
+ */
+ClusterPlan plan_split(const std::vector<const float*>& descriptors)
+{
+  ClusterPlan plan;
+  plan.leaders = {0, find_farthest_member(descriptors)};
+  plan.assignments.resize(descriptors.size(), 0);
+
+  const float* kept = descriptors[0];
+  const float* split = descriptors[plan.leaders[1]];
+
+  for (unsigned i = 1; i < descriptors.size(); ++i) {
+    const float kept_distance = distance::g_distance_function(descriptors[i], kept, globals::FLOAT_MAX);
+    if (distance::g_distance_function(descriptors[i], split, kept_distance) < kept_distance) {
+      plan.assignments[i] = 1;
+    }
+  }
+  plan.assignments[plan.leaders[1]] = 1;
+
+  return plan;
+}
+
+/**
+ * @brief split_cluster divides an over-full cluster in two using plan_split. The cluster keeps its leader and
+ * the points nearer to it, the rest form a new cluster led by the point farthest from the leader which is
+ * added to the parent. Only the points of the cluster itself are visited.
+ * @param cluster is the cluster to split. Must be a child of cluster_parent.
+ * @param cluster_parent is the parent of the cluster.
+ * @param cluster_hi_size is the maximum size of a cluster used as allocation size.
+ * @param index is the index worked on. Locations of the moved points are updated.
+ */
+void split_cluster(Node* const cluster, Node* const cluster_parent, unsigned cluster_hi_size,
+                   Index* const index)
+{
+  std::vector<const float*> descriptors;
+  descriptors.reserve(cluster->points.size());
+  for (auto& point : cluster->points) {
+    descriptors.emplace_back(point.descriptor);
+  }
+
+  const auto plan = plan_split(descriptors);
+  auto split = Node{std::move(cluster->points[plan.leaders[1]])};
+  split.points.reserve(cluster_hi_size);
+  std::vector<Point> kept;
+  kept.reserve(cluster_hi_size);
+
+  for (unsigned i = 0; i < cluster->points.size(); ++i) {
+    if (plan.assignments[i] == 0) {
+      kept.emplace_back(std::move(cluster->points[i]));
+    }
+    else if (i != plan.leaders[1]) {
+      split.points.emplace_back(std::move(cluster->points[i]));
+    }
+  }
+
+  cluster->points.swap(kept);
+  cluster->mark_changed();
+  cluster_parent->mark_changed();
+  recount(*cluster);
+  recount(split);
+  cluster->encode_points();
+  split.encode_points();
+  cluster_parent->children.emplace_back(std::move(split));  // Invalidates cluster.
+
+  if (!index->locations.empty()) {
+    locate_cluster_points(cluster_parent->children.back(), index);
+  }
+}
+
+/**
+ * @brief split_node divides an over-full internal node in two using plan_split on the leaders of its
+ * children. The new node is led by a copy of the leader of the child farthest from the leader of the node.
+ * @param node is the node to split. Must be a child of node_parent.
+ * @param node_parent is the parent of the node.
+ */
+void split_node(Node* const node, Node* const node_parent)
+{
+  std::vector<const float*> descriptors;
+  descriptors.reserve(node->children.size());
+  for (auto& child : node->children) {
+    descriptors.emplace_back(child.get_leader()->descriptor);
+  }
+
+  const auto plan = plan_split(descriptors);
+  auto split = Node{*node->children[plan.leaders[1]].get_leader()};
+  std::vector<Node> kept;
+  kept.reserve(node->children.size());
+
+  for (unsigned i = 0; i < node->children.size(); ++i) {
+    auto& target = (plan.assignments[i] == 0) ? kept : split.children;
+    target.emplace_back(std::move(node->children[i]));
+  }
+
+  node->children.swap(kept);
+  node->mark_changed();
+  node_parent->mark_changed();
+  recount(*node);
+  recount(split);
+  node_parent->children.emplace_back(std::move(split));  // Invalidates node.
+}
+
+void recursively_recluster_index(Node* initiating_node, NodePath& path, Index* index,
                                  unsigned optimal_node_size, unsigned max_node_size)
 {
   // Root is reached. Check whether the index is required to grow and recluster.
@@ -191,7 +542,13 @@ void recursively_recluster_index(Node* initiating_node, std::stack<Node*>& path,
 
     if (must_index_grow(current_root, max_node_size)) {
       grow_index(current_root, index);
-      recluster_internal_node(&index->root, optimal_node_size, max_node_size);
+
+      if (index->scheme.node_policy == ReclusteringPolicy::SPLIT) {  // The old root is the only child.
+        split_node(&index->root.children.front(), &index->root);
+      }
+      else {
+        recluster_internal_node(&index->root, optimal_node_size, max_node_size);
+      }
     }
   }
 
@@ -199,16 +556,22 @@ void recursively_recluster_index(Node* initiating_node, std::stack<Node*>& path,
   else {
     path.pop();  // Pop the previous parent to get next.
     auto initiating_node_parent = path.top();
+    recount(*initiating_node_parent);  // The number of children of the initiating node has changed.
 
-    if (is_reclustering_required(count_nodes_of_children, initiating_node->children.size(),
+    if (is_reclustering_required(counted_nodes_of_children, initiating_node->children.size(),
                                  initiating_node_parent, index->scheme.node_policy, max_node_size)) {
-      recluster_internal_node(initiating_node_parent, optimal_node_size, max_node_size);
+      if (index->scheme.node_policy == ReclusteringPolicy::SPLIT) {
+        split_node(initiating_node, initiating_node_parent);
+      }
+      else {
+        recluster_internal_node(initiating_node_parent, optimal_node_size, max_node_size);
+      }
       recursively_recluster_index(initiating_node_parent, path, index, optimal_node_size, max_node_size);
     }
   }
 }
 
-void initiate_index_reclustering(std::stack<Node*>& path, Index* index)
+void initiate_index_reclustering(NodePath& path, Index* index)
 {
   const unsigned max_node_size = index->scheme.hi_bound;
   const unsigned optimal_node_size = index->scheme.lo_bound;
@@ -218,39 +581,2110 @@ void initiate_index_reclustering(std::stack<Node*>& path, Index* index)
 
   auto cluster_parent = path.top();  // Valid b/c there will always be a root node initially.
 
-  if (is_reclustering_required(count_points_of_children, cluster->points.size(), cluster_parent,
+  if (is_reclustering_required(counted_points_of_children, cluster->points.size(), cluster_parent,
                                index->scheme.cluster_policy, max_node_size)) {
-    recluster_cluster(cluster_parent, optimal_node_size, max_node_size);
+    if (index->scheme.cluster_policy == ReclusteringPolicy::SPLIT) {
+      split_cluster(cluster, cluster_parent, max_node_size, index);
+    }
+    else {
+      recluster_cluster(cluster_parent, optimal_node_size, max_node_size);
+
+      if (!index->locations.empty()) {  // Points have new leaders. Reclustering nodes moves whole clusters.
+        locate_points(*cluster_parent, index);
+      }
+    }
+
     recursively_recluster_index(cluster_parent, path, index, optimal_node_size, max_node_size);
   }
 }
 
-std::stack<Node*> collect_path_to_nearest_cluster(const float* query, Node* const root,
-                                                  std::stack<Node*> parents = std::stack<Node*>{})
+/**
+ * @brief collect_path_to_nearest_cluster descends from the root to the cluster nearest to the query.
+ * @param query is the descriptor to find the nearest cluster of.
+ * @param root is the root of the index.
+ * @param path is the path to push the nodes from the root to the cluster onto.
+ */
+void collect_path_to_nearest_cluster(const float* query, Node* const root, NodePath& path)
 {
-  parents.emplace(root);
+  Node* node = root;
+  path.emplace(node);
 
-  if (!root->children.empty()) {
-    Node* closest_child = traversal::get_closest_node(query, root->children);
-    return collect_path_to_nearest_cluster(query, closest_child, parents);
+  while (!node->children.empty()) {
+    node = traversal::get_closest_node(query, node->children);
+    path.emplace(node);
   }
+}
 
-  return parents;
+NodePath collect_path_to_nearest_cluster(const float* query, Node* const root)
+{
+  NodePath path;
+  collect_path_to_nearest_cluster(query, root, path);
+  return path;
 }
 
-}  // namespace maintenance_helpers
+/**
+ * @brief log_modification appends a modification to the write-ahead log of the index if enabled and commits
+ * it once due. Must be called before the modification is applied.
+ */
+void log_modification(Index* const index, write_ahead_log::Operation operation, unsigned long id,
+                      const float* descriptor)
+{
+  if (index->log && write_ahead_log::append(index, operation, id, descriptor)) {
+    write_ahead_log::commit(index);
+  }
+}
 
-namespace maintenance {
+/**
+ * @brief queue_reclustering queues a job for the background thread unless already queued.
+ * @param leader is the storage of the leader descriptor identifying the parent of the clusters to recluster.
+ * @param maintainer is the background maintenance state.
+ */
+void queue_reclustering(const float* leader, maintenance::BackgroundMaintainer* const maintainer)
+{
+  {
+    std::lock_guard<std::mutex> lock(maintainer->jobs_mutex);
+    if (std::find(maintainer->jobs.begin(), maintainer->jobs.end(), leader) != maintainer->jobs.end()) {
+      return;  // Already queued.
+    }
+    maintainer->jobs.emplace_back(leader);
+  }
+  maintainer->jobs_available.notify_one();
+}
 
-void insert(const float* descriptor, Index* index)
+/**
+ * @brief defer_reclustering is the counterpart of initiate_index_reclustering when background maintenance is
+ * enabled. Queues the parent of the cluster that has just been added to if the cluster level must be
+ * reclustered. The parent is identified by the storage of its leader since Nodes move as the index changes.
+ * @param path is the path from the root to the cluster.
+ * @param index is the index worked on.
+ */
+void defer_reclustering(NodePath& path, Index* const index)
 {
-  if (index->size < 1)
-    throw std::invalid_argument(
-        "maintenance: It is required that the index contains at least a root node in order to insert.");
+  auto cluster = path.top();
+  path.pop();
+  auto cluster_parent = path.top();
+
+  if (!is_reclustering_required(counted_points_of_children, cluster->points.size(), cluster_parent,
+                                index->scheme.cluster_policy, index->scheme.hi_bound)) {
+    return;
+  }
+
+  queue_reclustering(cluster_parent->get_leader()->descriptor, index->maintainer);
+}
+
+/**
+ * @brief match_cluster_points collects the points of the clusters below the parent in the order they had when
+ * a reclustering was planned, followed by the points added since.
+ * @param cluster_parent is the node whose clusters are planned.
+ * @param sizes is the number of points of each cluster when planned.
+ * @param identities is the storage of the descriptors of the points when planned. Only compared.
+ * @param points is the collection of points to append to.
+ * @return false if the clusters have been changed other than by appending points, otherwise true.
+ */
+bool match_cluster_points(Node* const cluster_parent, const std::vector<unsigned>& sizes,
+                          const std::vector<const float*>& identities, std::vector<Point*>& points)
+{
+  if (cluster_parent->children.size() != sizes.size()) {
+    return false;
+  }
+
+  std::vector<Point*> added;
+  std::size_t next{0};
+
+  for (std::size_t c = 0; c < sizes.size(); ++c) {
+    auto& cluster = cluster_parent->children[c];
+    if (!cluster.children.empty() || cluster.points.size() < sizes[c]) {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < cluster.points.size(); ++i) {
+      if (i >= sizes[c]) {
+        added.emplace_back(&cluster.points[i]);
+      }
+      else if (cluster.points[i].descriptor == identities[next++]) {
+        points.emplace_back(&cluster.points[i]);
+      }
+      else {
+        return false;
+      }
+    }
+  }
+
+  points.insert(points.end(), added.begin(), added.end());
+  return true;
+}
+
+/**
+ * @brief match_child_nodes collects the children of the children of the parent if they are the same as when a
+ * reclustering was planned.
+ * @param node_parent is the node whose children are planned.
+ * @param sizes is the number of children of each child when planned.
+ * @param identities is the storage of the leader descriptors of the children when planned. Only compared.
+ * @param nodes is the collection of nodes to append to.
+ * @return false if the children have been changed, otherwise true.
+ */
+bool match_child_nodes(Node* const node_parent, const std::vector<unsigned>& sizes,
+                       const std::vector<const float*>& identities, std::vector<Node*>& nodes)
+{
+  if (node_parent->children.size() != sizes.size()) {
+    return false;
+  }
+
+  std::size_t next{0};
+
+  for (std::size_t c = 0; c < sizes.size(); ++c) {
+    auto& parent_child = node_parent->children[c];
+    if (parent_child.children.size() != sizes[c]) {
+      return false;
+    }
+
+    for (auto& child : parent_child.children) {
+      if (child.get_leader()->descriptor != identities[next++]) {
+        return false;
+      }
+      nodes.emplace_back(&child);
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief start_incremental_reclustering records the members of the children of the node on top of the path
+ * and picks the leaders of the new children among them. Nothing in the index is changed.
+ * @param path is the path from the root to the node to recluster.
+ * @param index is the index worked on.
+ */
+void start_incremental_reclustering(NodePath path, Index* const index)
+{
+  Node* parent = path.top();
+  const bool is_cluster_parent = parent->children.front().children.empty();
+
+  ReclusteringProgress progress{};
+  progress.path = std::move(path);
+
+  for (auto& child : parent->children) {
+    if (is_cluster_parent) {
+      progress.sizes.emplace_back(child.points.size());
+      for (auto& point : child.points) {
+        progress.members.emplace_back(point.descriptor);
+      }
+    }
+    else {
+      progress.sizes.emplace_back(child.children.size());
+      for (auto& node : child.children) {
+        progress.members.emplace_back(node.get_leader()->descriptor);
+      }
+    }
+  }
+
+  const unsigned lo_bound = index->scheme.lo_bound;
+  progress.leaders = generate_indexes_for_optimal_level_size(progress.members.size(), lo_bound);
+  progress.assignments.resize(progress.members.size(), 0);
+
+  // Leaders are copied as their Points may be updated before the reclustering finishes.
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const std::size_t floats = (bytes + sizeof(float) - 1) / sizeof(float);
+  progress.leader_storage.resize(progress.leaders.size() * floats);
+
+  for (unsigned i = 0; i < progress.leaders.size(); ++i) {
+    std::memcpy(progress.leader_storage.data() + i * floats, progress.members[progress.leaders[i]], bytes);
+    progress.assignments[progress.leaders[i]] = i;
+  }
+
+  index->progress = std::move(progress);
+}
+
+/**
+ * @brief start_reclustering_above is the counterpart of recursively_recluster_index for incremental
+ * reclusterings. Checks whether the level above the node on top of the path must be reclustered or the index
+ * must grow and starts the corresponding reclustering. Splits are cheap and carried out at once.
+ * @param path is the path from the root to the node whose number of children has grown.
+ * @param index is the index worked on. No reclustering may be in progress.
+ */
+void start_reclustering_above(NodePath path, Index* const index)
+{
+  const unsigned max_node_size = index->scheme.hi_bound;
+  Node* node = path.top();
 
-  auto path = maintenance_helpers::collect_path_to_nearest_cluster(descriptor, &index->root);
-  path.top()->points.emplace_back(Point{descriptor, index->size++});  // Insert descriptor and incr. size.
-  maintenance_helpers::initiate_index_reclustering(path, index);
+  if (index->scheme.node_policy == ReclusteringPolicy::SPLIT) {
+    recursively_recluster_index(node, path, index, index->scheme.lo_bound, max_node_size);
+  }
+  else if (path.size() == 1) {
+    if (must_index_grow(node, max_node_size)) {
+      grow_index(node, index);
+      NodePath root_path;
+      root_path.emplace(&index->root);
+      start_incremental_reclustering(std::move(root_path), index);
+    }
+  }
+  else {
+    path.pop();
+    recount(*path.top());
+    if (is_reclustering_required(counted_nodes_of_children, node->children.size(), path.top(),
+                                 index->scheme.node_policy, max_node_size)) {
+      start_incremental_reclustering(std::move(path), index);
+    }
+  }
+}
+
+/**
+ * @brief finish_incremental_reclustering substitutes the children of the reclustered node by the new children
+ * and checks whether the level above must be reclustered or the index must grow, in which case the next
+ * reclustering is started. The reclustering is restarted if the children were changed other than by
+ * insertions of points since it started.
+ * @param index is the index worked on.
+ */
+void finish_incremental_reclustering(Index* const index)
+{
+  auto progress = std::move(index->progress);
+  index->progress = ReclusteringProgress{};
+
+  auto& path = progress.path;
+  Node* parent = path.top();
+  const unsigned max_node_size = index->scheme.hi_bound;
+  ClusterPlan plan{std::move(progress.leaders), std::move(progress.assignments)};
+
+  if (parent->children.front().children.empty()) {
+    std::vector<Point*> points;
+    if (!match_cluster_points(parent, progress.sizes, progress.members, points)) {
+      start_incremental_reclustering(std::move(path), index);
+      return;
+    }
+
+    apply_cluster_plan(parent, points, plan, max_node_size);
+
+    if (!index->locations.empty()) {
+      locate_points(*parent, index);
+    }
+  }
+  else {
+    std::vector<Node*> nodes;
+    if (!match_child_nodes(parent, progress.sizes, progress.members, nodes)) {
+      start_incremental_reclustering(std::move(path), index);
+      return;
+    }
+
+    apply_node_plan(parent, nodes, plan);
+  }
+
+  start_reclustering_above(std::move(path), index);
+}
+
+/**
+ * @brief continue_incremental_reclustering assigns the members of the next children_per_insert children of
+ * the node being reclustered to their nearest new leader and finishes the reclustering when all are assigned.
+ * @param index is the index worked on.
+ */
+void continue_incremental_reclustering(Index* const index)
+{
+  auto& progress = index->progress;
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const std::size_t floats = (bytes + sizeof(float) - 1) / sizeof(float);
+
+  std::vector<const float*> leaders;
+  leaders.reserve(progress.leaders.size());
+  for (unsigned i = 0; i < progress.leaders.size(); ++i) {
+    leaders.emplace_back(progress.leader_storage.data() + i * floats);
+  }
+
+  std::vector<unsigned> sorted_leaders(progress.leaders);  // Members already assigned to themselves.
+  std::sort(sorted_leaders.begin(), sorted_leaders.end());
+
+  const unsigned children = progress.sizes.size();
+  const unsigned last_child = std::min(children, progress.next_child + index->scheme.children_per_insert);
+
+  for (; progress.next_child < last_child; ++progress.next_child) {
+    for (unsigned i = 0; i < progress.sizes[progress.next_child]; ++i, ++progress.next_member) {
+      const unsigned member = progress.next_member;
+      if (!std::binary_search(sorted_leaders.begin(), sorted_leaders.end(), member)) {
+        progress.assignments[member] = find_nearest_leader(progress.members[member], leaders);
+      }
+    }
+  }
+
+  if (progress.next_child == children) {
+    finish_incremental_reclustering(index);
+  }
+}
+
+/**
+ * @brief advance_incremental_reclustering is the counterpart of initiate_index_reclustering when the scheme
+ * limits the children reclustered per insertion. Starts reclustering the clusters of the parent of the
+ * cluster that has just been added to if necessary and no other reclustering is in progress, and continues
+ * the reclustering in progress.
+ * @param path is the path from the root to the cluster.
+ * @param index is the index worked on.
+ */
+void advance_incremental_reclustering(NodePath& path, Index* const index)
+{
+  if (index->progress.path.empty()) {
+    auto cluster = path.top();
+    path.pop();
+
+    if (!is_reclustering_required(counted_points_of_children, cluster->points.size(), path.top(),
+                                  index->scheme.cluster_policy, index->scheme.hi_bound)) {
+      return;
+    }
+
+    if (index->scheme.cluster_policy == ReclusteringPolicy::SPLIT) {
+      split_cluster(cluster, path.top(), index->scheme.hi_bound, index);
+      start_reclustering_above(path, index);
+    }
+    else {
+      start_incremental_reclustering(path, index);
+    }
+  }
+
+  if (!index->progress.path.empty()) {
+    continue_incremental_reclustering(index);
+  }
+}
+
+/**
+ * @brief abort_incremental_reclustering discards the reclustering in progress if the descriptor is one of its
+ * members. Must be called before a Point is removed from a cluster.
+ * @param descriptor is the storage of the descriptor of the Point.
+ * @param index is the index worked on.
+ */
+void abort_incremental_reclustering(const float* descriptor, Index* const index)
+{
+  const auto& members = index->progress.members;
+  if (std::find(members.begin(), members.end(), descriptor) != members.end()) {
+    index->progress = ReclusteringProgress{};
+  }
+}
+
+/**
+ * @brief recluster_if_required reclusters the levels along a path to a cluster that has just been added to,
+ * deferred to the background thread, incrementally or at once depending on how the index is maintained.
+ * @param path is the path from the root to the cluster. Is consumed.
+ * @param index is the index worked on.
+ */
+void recluster_if_required(NodePath& path, Index* const index)
+{
+  if (index->maintainer && index->scheme.cluster_policy != ReclusteringPolicy::SPLIT) {
+    defer_reclustering(path, index);  // Splits are cheap enough to be done by the inserting thread.
+  }
+  else if (!index->maintainer && index->scheme.children_per_insert > 0) {
+    advance_incremental_reclustering(path, index);
+  }
+  else {
+    if (!index->progress.path.empty()) {
+      index->progress = ReclusteringProgress{};  // Only continued while the limit is set.
+    }
+    initiate_index_reclustering(path, index);
+  }
+}
+
+/**
+ * @brief insert_point adds a descriptor to its nearest cluster and initiates a reclustering if necessary. The
+ * path is collected into the path buffer of the index and the Point is constructed in place taking its
+ * storage from the descriptor pool, thus nothing is allocated unless a cluster or slab is full or a
+ * reclustering is necessary.
+ * @param descriptor is the descriptor to insert.
+ * @param id is the id of the descriptor. Must be below the size of the index.
+ * @param index is the index to insert into.
+ */
+void insert_point(const float* descriptor, unsigned long id, Index* const index)
+{
+  auto& path = index->insert_path;
+  while (!path.empty()) {
+    path.pop();
+  }
+
+  Node* cluster = &index->root;
+  path.emplace(cluster);
+  ++cluster->point_count;
+
+  while (!cluster->children.empty()) {  // Same as collect_path_to_nearest_cluster while counting the point.
+    cluster = traversal::get_closest_node(descriptor, cluster->children);
+    path.emplace(cluster);
+    ++cluster->point_count;
+  }
+
+  cluster->points.emplace_back(descriptor, id);
+  cluster->encode_points(cluster->points.size() - 1);
+  cluster->mark_changed();
+
+  if (!index->locations.empty()) {
+    locate_last_point(*cluster, index);
+  }
+
+  recluster_if_required(path, index);
+}
+
+/**
+ * @brief The WorkerPool struct holds threads that are started on first use and reused by every batch, such
+ * that a batch does not pay for starting and joining threads. A job is split into chunks that are taken in
+ * turn by the workers and the thread that posted the job.
+ */
+struct WorkerPool {
+  std::mutex mutex;                                   // Guards the job and the state below.
+  std::mutex posting_mutex;                           // Held by the thread whose job is posted.
+  std::condition_variable job_available;              // Signaled when a job is posted or on stopping.
+  std::condition_variable job_finished;               // Signaled when the last chunk of the job is done.
+  std::function<void(std::size_t, std::size_t)> job;  // Called with the bounds of a chunk.
+  std::size_t n;                                      // Number of items of the job, 0 if none is posted.
+  std::size_t chunk_size;                             // Number of items per chunk.
+  std::size_t next;                                   // First item of the next chunk to take.
+  std::size_t unfinished;                             // Number of chunks not finished yet.
+  bool stopping;                                      // Set when the program exits.
+  std::vector<std::thread> threads;                   // One less than the hardware threads.
+
+  WorkerPool();
+  ~WorkerPool();
+};
+
+/**
+ * @brief run_chunk takes the next chunk of the posted job and runs it without holding the lock of the pool.
+ * @param lock is the held lock of the pool.
+ * @param pool is the pool whose job has chunks left.
+ */
+void run_chunk(std::unique_lock<std::mutex>& lock, WorkerPool* const pool)
+{
+  const std::size_t begin = pool->next;
+  const std::size_t end = std::min(pool->n, begin + pool->chunk_size);
+  pool->next = end;
+
+  lock.unlock();
+  pool->job(begin, end);
+  lock.lock();
+
+  if (--pool->unfinished == 0) {
+    pool->job_finished.notify_all();
+  }
+}
+
+/**
+ * @brief run_worker runs chunks of posted jobs until the pool is stopped.
+ */
+void run_worker(WorkerPool* const pool)
+{
+  std::unique_lock<std::mutex> lock(pool->mutex);
+  while (true) {
+    pool->job_available.wait(lock, [pool] { return pool->stopping || pool->next < pool->n; });
+    if (pool->stopping) {
+      return;
+    }
+    run_chunk(lock, pool);
+  }
+}
+
+WorkerPool::WorkerPool()
+    : n(0)
+    , chunk_size(1)
+    , next(0)
+    , unfinished(0)
+    , stopping(false)
+{
+  const unsigned hardware = std::thread::hardware_concurrency();
+  for (unsigned t = 1; t < hardware; ++t) {
+    threads.emplace_back(run_worker, this);
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  job_available.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+/**
+ * @brief worker_pool is the pool shared by all batches, started on first use and stopped on exit.
+ */
+WorkerPool& worker_pool()
+{
+  static WorkerPool pool;
+  return pool;
+}
+
+/**
+ * @brief parallel_chunks splits [0, n) into contiguous chunks and calls work(begin, end) for each chunk on
+ * the threads of the worker pool and the calling thread. Runs work(0, n) on the calling thread if there are
+ * too few items or the pool is busy with the job of another thread.
+ * @param n is the number of items.
+ * @param min_per_chunk is the least number of items worth handing to another thread.
+ * @param work is called for each chunk and must only write to state owned by its chunk. Must not throw.
+ */
+template <typename Work>
+void parallel_chunks(std::size_t n, std::size_t min_per_chunk, Work work)
+{
+  auto& pool = worker_pool();
+  const std::size_t chunk_count = std::min<std::size_t>(pool.threads.size() + 1, n / min_per_chunk);
+  std::unique_lock<std::mutex> posting(pool.posting_mutex, std::try_to_lock);
+  if (chunk_count < 2 || !posting) {
+    work(std::size_t{0}, n);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  pool.job = [&work](std::size_t begin, std::size_t end) { work(begin, end); };
+  pool.chunk_size = (n + chunk_count - 1) / chunk_count;
+  pool.unfinished = (n + pool.chunk_size - 1) / pool.chunk_size;
+  pool.next = 0;
+  pool.n = n;
+  pool.job_available.notify_all();
+
+  while (pool.next < pool.n) {
+    run_chunk(lock, &pool);
+  }
+  pool.job_finished.wait(lock, [&pool] { return pool.unfinished == 0; });
+  pool.n = 0;
+  pool.next = 0;
+  pool.job = nullptr;
+}
+
+/**
+ * @brief find_nearest_clusters finds the nearest cluster of each descriptor. The descriptors are divided
+ * between the threads of the worker pool as the index is only read.
+ * @param descriptors points to n descriptors stored consecutively.
+ * @param n is the number of descriptors.
+ * @param root is the root of the index.
+ * @return the nearest cluster of each descriptor.
+ */
+std::vector<Node*> find_nearest_clusters(const char* descriptors, std::size_t n, Node* const root)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const std::size_t min_per_chunk = 256;  // Fewer are not worth waking a thread for.
+
+  std::vector<Node*> clusters(n);
+  auto find_range = [&clusters, descriptors, bytes, root](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      auto* descriptor = reinterpret_cast<const float*>(descriptors + i * bytes);
+      clusters[i] = root->children.empty() ? root : traversal::find_nearest_leaf(descriptor, root->children);
+    }
+  };
+  parallel_chunks(n, min_per_chunk, find_range);
+
+  return clusters;
+}
+
+/**
+ * @brief path_to_levels turns a path into a vector indexed by level with the root at 0.
+ */
+std::vector<Node*> path_to_levels(NodePath path)
+{
+  std::vector<Node*> levels(path.size());
+  for (std::size_t level = path.size(); !path.empty(); path.pop()) {
+    levels[--level] = path.top();
+  }
+  return levels;
+}
+
+/**
+ * @brief split_over_full_children splits the children of the parent, including those split off, until none
+ * has more than hi_bound points or children.
+ * @param parent is the node whose children are split.
+ * @param index is the index worked on.
+ */
+void split_over_full_children(Node* const parent, Index* const index)
+{
+  const unsigned hi_bound = index->scheme.hi_bound;
+
+  for (std::size_t i = 0; i < parent->children.size(); ++i) {
+    while (parent->children[i].children.empty() && parent->children[i].points.size() > hi_bound) {
+      split_cluster(&parent->children[i], parent, hi_bound, index);
+    }
+    while (parent->children[i].children.size() > hi_bound) {
+      split_node(&parent->children[i], parent);
+    }
+  }
+}
+
+/**
+ * @brief recluster_after_batch is the counterpart of initiate_index_reclustering for a batch of insertions.
+ * Each touched level is checked once bottom-up and every node whose children must be reclustered is
+ * reclustered once, no matter how many of its children the batch has overfilled. The index grows as many
+ * levels as needed.
+ * @param paths are the paths from the root to every cluster the batch was added to, indexed by level.
+ * @param index is the index worked on.
+ */
+void recluster_after_batch(const std::vector<std::vector<Node*>>& paths, Index* const index)
+{
+  const auto& scheme = index->scheme;
+  const std::size_t depth = paths.front().size() - 1;  // Level of the clusters.
+  std::vector<Node*> changed;                          // Nodes whose number of children has changed.
+  std::unordered_set<Node*> is_changed;
+
+  for (auto& path : paths) {
+    Node* cluster_parent = path[depth - 1];
+    if (!is_changed.count(cluster_parent) &&
+        is_reclustering_required(counted_points_of_children, path[depth]->points.size(), cluster_parent,
+                                 scheme.cluster_policy, scheme.hi_bound)) {
+      changed.emplace_back(cluster_parent);
+      is_changed.emplace(cluster_parent);
+    }
+  }
+
+  for (Node* cluster_parent : changed) {
+    if (scheme.cluster_policy == ReclusteringPolicy::SPLIT) {
+      split_over_full_children(cluster_parent, index);
+    }
+    else {
+      recluster_cluster(cluster_parent, scheme.lo_bound, scheme.hi_bound);
+
+      if (!index->locations.empty()) {
+        locate_points(*cluster_parent, index);
+      }
+    }
+  }
+
+  // Ascend one level at a time. Nodes above the current level are not moved by reclustering it.
+  for (std::size_t level = depth - 1; level > 0 && !changed.empty(); --level) {
+    std::unordered_map<Node*, Node*> parent_of;
+    for (auto& path : paths) {
+      parent_of.emplace(path[level], path[level - 1]);
+    }
+
+    for (Node* node : changed) {
+      recount(*parent_of[node]);
+    }
+
+    std::vector<Node*> next_changed;
+    std::unordered_set<Node*> is_next_changed;
+
+    for (Node* node : changed) {
+      Node* parent = parent_of[node];
+      if (!is_next_changed.count(parent) &&
+          is_reclustering_required(counted_nodes_of_children, node->children.size(), parent,
+                                   scheme.node_policy, scheme.hi_bound)) {
+        next_changed.emplace_back(parent);
+        is_next_changed.emplace(parent);
+      }
+    }
+
+    for (Node* parent : next_changed) {
+      if (scheme.node_policy == ReclusteringPolicy::SPLIT) {
+        split_over_full_children(parent, index);
+      }
+      else {
+        recluster_internal_node(parent, scheme.lo_bound, scheme.hi_bound);
+      }
+    }
+
+    changed.swap(next_changed);
+  }
+
+  while (must_index_grow(&index->root, scheme.hi_bound)) {
+    grow_index(&index->root, index);
+
+    if (scheme.node_policy == ReclusteringPolicy::SPLIT) {
+      split_over_full_children(&index->root, index);
+    }
+    else {
+      recluster_internal_node(&index->root, scheme.lo_bound, scheme.hi_bound);
+    }
+  }
+}
+
+/**
+ * @brief add_batch adds n descriptors to the index at once. The nearest clusters of all descriptors are found
+ * concurrently, the descriptors are appended grouped by cluster and each touched cluster and parent is
+ * checked for reclustering once.
+ * @param rows points to n descriptors stored consecutively, each of descriptor_size_in_bytes() bytes.
+ * @param n is the number of descriptors. Must be greater than 0.
+ * @param ids is the id of each descriptor. Must be below the size of the index.
+ * @param index is the index to add to.
+ */
+void add_batch(const char* rows, std::size_t n, const unsigned long* ids, Index* const index)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const auto clusters = find_nearest_clusters(rows, n, &index->root);
+
+  // Group the descriptors by cluster in order of first appearance.
+  std::unordered_map<Node*, std::size_t> group_of;
+  std::vector<std::vector<std::size_t>> groups;
+  for (std::size_t i = 0; i < n; ++i) {
+    auto inserted = group_of.emplace(clusters[i], groups.size());
+    if (inserted.second) {
+      groups.emplace_back();
+    }
+    groups[inserted.first->second].emplace_back(i);
+  }
+
+  // Append each group to its cluster and count the points along its path.
+  std::vector<std::vector<Node*>> paths;
+  paths.reserve(groups.size());
+
+  for (auto& group : groups) {
+    auto* first = reinterpret_cast<const float*>(rows + group.front() * bytes);
+    paths.emplace_back(path_to_levels(collect_path_to_nearest_cluster(first, &index->root)));
+
+    Node* cluster = paths.back().back();
+    cluster->mark_changed();
+    const std::size_t first_added = cluster->points.size();
+    for (std::size_t i : group) {
+      cluster->points.emplace_back(reinterpret_cast<const float*>(rows + i * bytes), ids[i]);
+
+      if (!index->locations.empty()) {
+        locate_last_point(*cluster, index);
+      }
+    }
+    cluster->encode_points(first_added);
+
+    for (Node* node : paths.back()) {
+      node->point_count += group.size();
+    }
+  }
+
+  if (index->maintainer && index->scheme.cluster_policy != ReclusteringPolicy::SPLIT) {
+    for (auto& path : paths) {
+      NodePath cluster_path;
+      for (Node* node : path) {
+        cluster_path.emplace(node);
+      }
+      defer_reclustering(cluster_path, index);
+    }
+    return;
+  }
+
+  index->progress = ReclusteringProgress{};  // The batch is reclustered at once.
+  recluster_after_batch(paths, index);
+}
+
+/**
+ * @brief merge_delta_buffer adds all buffered descriptors to the clusters of the index as a single batch and
+ * empties the buffer.
+ * @param index is the index worked on.
+ */
+void merge_delta_buffer(Index* const index)
+{
+  auto& delta = index->delta;
+  if (delta.ids.empty()) {
+    return;
+  }
+
+  std::vector<char> storage;
+  std::vector<unsigned long> ids;
+  storage.swap(delta.storage);
+  ids.swap(delta.ids);
+
+  add_batch(storage.data(), ids.size(), ids.data(), index);
+}
+
+/**
+ * @brief now_in_milliseconds is the time of a monotonic clock used to age the delta buffer.
+ */
+long long now_in_milliseconds()
+{
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+/**
+ * @brief is_delta_buffer_due tells whether the delta buffer must be merged, i.e. it is full or its oldest
+ * descriptor has expired.
+ * @param delta is the delta buffer.
+ * @param now is the time of now_in_milliseconds, only read if the buffer has a maximum age.
+ */
+bool is_delta_buffer_due(const DeltaBuffer& delta, long long now)
+{
+  return !delta.ids.empty() &&
+         (delta.ids.size() >= delta.capacity || (delta.max_age > 0 && now - delta.oldest >= delta.max_age));
+}
+
+/**
+ * @brief schedule_delta_merge wakes the background thread at the given time to merge an expired delta buffer.
+ * An earlier scheduled time is kept.
+ * @param deadline is the time of now_in_milliseconds at which the oldest buffered descriptor expires.
+ * @param maintainer is the background maintenance state.
+ */
+void schedule_delta_merge(long long deadline, maintenance::BackgroundMaintainer* const maintainer)
+{
+  {
+    std::lock_guard<std::mutex> lock(maintainer->jobs_mutex);
+    if (maintainer->delta_deadline == 0 || deadline < maintainer->delta_deadline) {
+      maintainer->delta_deadline = deadline;
+    }
+  }
+  maintainer->jobs_available.notify_one();
+}
+
+/**
+ * @brief append_to_delta_buffer appends a descriptor to the delta buffer in O(1). The merge of the buffer is
+ * scheduled with the background thread, if any, once the first descriptor is appended.
+ * @param descriptor is the descriptor to buffer.
+ * @param id is the id of the descriptor. Must be larger than the buffered ids.
+ * @param index is the index worked on. Must have the delta buffer enabled.
+ * @return true if the buffer must be merged, see is_delta_buffer_due.
+ */
+bool append_to_delta_buffer(const float* descriptor, unsigned long id, Index* const index)
+{
+  auto& delta = index->delta;
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const long long now = delta.max_age > 0 ? now_in_milliseconds() : 0;
+
+  if (delta.ids.empty()) {
+    delta.storage.reserve(delta.capacity * bytes);
+    delta.ids.reserve(delta.capacity);
+    delta.oldest = now;
+
+    if (index->maintainer && delta.max_age > 0) {
+      schedule_delta_merge(now + delta.max_age, index->maintainer);
+    }
+  }
+
+  const auto* row = reinterpret_cast<const char*>(descriptor);
+  delta.storage.insert(delta.storage.end(), row, row + bytes);
+  delta.ids.emplace_back(id);
+
+  return is_delta_buffer_due(delta, now);
+}
+
+/**
+ * @brief buffer_descriptor appends a descriptor to the delta buffer in O(1) and merges the buffer into the
+ * clusters when it is full or its oldest descriptor has expired.
+ * @param descriptor is the descriptor to buffer.
+ * @param id is the id of the descriptor. Must be below the size of the index.
+ * @param index is the index worked on. Must have the delta buffer enabled.
+ */
+void buffer_descriptor(const float* descriptor, unsigned long id, Index* const index)
+{
+  if (append_to_delta_buffer(descriptor, id, index)) {
+    merge_delta_buffer(index);
+  }
+}
+
+/**
+ * @brief merge_expired_delta_buffer merges the delta buffer if its oldest descriptor has expired. Otherwise
+ * the merge is scheduled again with the background thread, if any, as the buffer may have been merged and
+ * refilled since the merge was scheduled.
+ * @param index is the index worked on.
+ */
+void merge_expired_delta_buffer(Index* const index)
+{
+  auto& delta = index->delta;
+  if (delta.max_age == 0 || delta.ids.empty()) {
+    return;
+  }
+
+  const long long now = now_in_milliseconds();
+  if (now - delta.oldest >= delta.max_age) {
+    merge_delta_buffer(index);
+  }
+  else if (index->maintainer) {
+    schedule_delta_merge(delta.oldest + delta.max_age, index->maintainer);
+  }
+}
+
+/**
+ * @brief latch_of is the latch guarding the points, counts and children of a node while the index lock is
+ * held shared. The latches are striped by the address of the node within the bank of its depth, thus latches
+ * acquired top-down, and by increasing stripe within a depth, are never waited for in a cycle.
+ * @param node is the node to latch.
+ * @param depth is the depth of the node, 0 for the root. Must be below the number of latched depths.
+ * @param maintainer is the background maintenance state holding the latches.
+ * @return the latch of the node, which is shared with the nodes of the same depth and stripe.
+ */
+std::mutex& latch_of(const Node* node, std::size_t depth, maintenance::BackgroundMaintainer* const maintainer)
+{
+  auto& bank = maintainer->latches[depth];
+  const auto address = reinterpret_cast<std::uintptr_t>(node) / sizeof(Node);
+  return bank[address % bank.size()];
+}
+
+/**
+ * @brief is_latched reports whether the nodes of every depth of the index have latches.
+ */
+bool is_latched(const Index* const index)
+{
+  return index->L < index->maintainer->latches.size();
+}
+
+/**
+ * @brief modifier_phase admits a modification holding the index lock shared. Queries only read the index, and
+ * must be excluded, if versions are not published.
+ */
+maintenance::Phase modifier_phase(Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  return maintainer->publish_interval > 0 ? maintenance::Phase{} : maintenance::Phase{maintainer, false};
+}
+
+/**
+ * @brief insert_point_in_parallel is the counterpart of insert_point for insertions running in parallel. The
+ * index lock is held shared and the path is descended with latch coupling, counting the point in each node
+ * while holding its latch. The latch of the parent of the cluster is released before the point is appended
+ * unless the storage of the points must grow, as traversals of the parent read the leader of the cluster.
+ * All reclusterings, including splits, are deferred to the background thread. If the delta buffer is enabled
+ * the descriptor is appended to it instead together with the assignment of its id, and only a merge of the
+ * buffer holds the index lock exclusively.
+ * @param descriptor is the descriptor to insert.
+ * @param index is the index to insert into. Must be maintained in the background.
+ * @return false if nothing is inserted, as the index is empty or too deep to be latched, otherwise true.
+ */
+bool insert_point_in_parallel(const float* descriptor, Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  std::shared_lock<std::shared_timed_mutex> lock(maintainer->index_mutex);
+  if (!is_latched(index)) {
+    return false;
+  }
+  auto phase = modifier_phase(index);
+
+  unsigned long id;
+  bool is_merge_due{false};
+  bool is_commit_due{false};
+  {
+    std::lock_guard<std::mutex> ids_lock(maintainer->ids_mutex);
+    if (index->size < 1) {
+      return false;  // Thrown on by the exclusive path.
+    }
+    id = index->size++;
+    if (index->log) {  // Logged in order of ids, while the log is synced once the ids are unlocked.
+      is_commit_due = write_ahead_log::append(index, write_ahead_log::Operation::INSERT, id, descriptor);
+    }
+
+    if (index->delta.capacity > 0) {  // Buffered ids must be increasing.
+      is_merge_due = append_to_delta_buffer(descriptor, id, index);
+    }
+  }
+
+  if (is_commit_due) {
+    write_ahead_log::commit(index);
+  }
+
+  if (index->delta.capacity > 0) {
+    if (is_merge_due) {
+      phase = maintenance::Phase{};
+      lock.unlock();
+      auto exclusive_lock = maintenance::write_lock(index);
+
+      if (is_delta_buffer_due(index->delta, now_in_milliseconds())) {  // Unless merged meanwhile.
+        merge_delta_buffer(index);
+      }
+    }
+    return true;
+  }
+
+  Node* node = &index->root;
+  std::size_t depth{0};
+  std::unique_lock<std::mutex> parent_latch;
+  std::unique_lock<std::mutex> latch(latch_of(node, depth, maintainer));
+  unsigned parent_count{0};
+  std::size_t siblings{0};
+  const float* parent_leader{nullptr};
+
+  while (!node->children.empty()) {  // Same as collect_path_to_nearest_cluster while counting the point.
+    ++node->point_count;
+    parent_count = node->point_count;
+    siblings = node->children.size();
+    parent_leader = node->get_leader()->descriptor;
+
+    node = traversal::get_closest_node(descriptor, node->children);
+    parent_latch = std::move(latch);  // Releases the latch of the grandparent.
+    latch = std::unique_lock<std::mutex>(latch_of(node, ++depth, maintainer));
+  }
+
+  Node* cluster = node;
+  if (cluster->points.size() < cluster->points.capacity()) {
+    parent_latch.unlock();
+  }
+
+  cluster->points.emplace_back(descriptor, id);
+  cluster->encode_points(cluster->points.size() - 1);
+  cluster->mark_changed();
+  ++cluster->point_count;
+
+  {
+    std::lock_guard<std::mutex> ids_lock(maintainer->ids_mutex);
+    if (!index->locations.empty()) {
+      locate_last_point(*cluster, index);
+    }
+  }
+
+  const bool is_required = is_reclustering_required(parent_count, siblings, cluster->points.size(),
+                                                    index->scheme.cluster_policy, index->scheme.hi_bound);
+  latch.unlock();
+
+  if (is_required) {
+    queue_reclustering(parent_leader, maintainer);
+  }
+  return true;
+}
+
+/**
+ * @brief is_buffered tells whether the descriptor with the given id is in the delta buffer.
+ */
+bool is_buffered(unsigned long id, const DeltaBuffer& delta)
+{
+  return std::binary_search(delta.ids.begin(), delta.ids.end(), id);
+}
+
+/**
+ * @brief collect_path_to_leaf_led_by searches the subtree for the cluster whose leader has the given
+ * descriptor storage.
+ * @param leader is the storage of the descriptor of the leader.
+ * @param node is the root of the subtree to search.
+ * @param path is the path from the root to the found cluster with the cluster on top.
+ * @return true if the cluster is found otherwise false and path is unchanged.
+ */
+bool collect_path_to_leaf_led_by(const float* leader, Node* const node, NodePath& path)
+{
+  path.emplace(node);
+
+  if (node->children.empty() && node->get_leader()->descriptor == leader) {
+    return true;
+  }
+
+  for (auto& child : node->children) {
+    if (collect_path_to_leaf_led_by(leader, &child, path)) {
+      return true;
+    }
+  }
+
+  path.pop();
+  return false;
+}
+
+/**
+ * @brief collect_path_to_cluster_led_by finds the cluster whose leader has the given descriptor storage. The
+ * path to the nearest cluster of the leader is tried first as it usually leads to the cluster itself.
+ * @param leader is the storage of the descriptor of the leader.
+ * @param root is the root of the index.
+ * @return the path from the root to the cluster or an empty path if no cluster is led by the descriptor.
+ */
+NodePath collect_path_to_cluster_led_by(const float* leader, Node* const root)
+{
+  auto path = collect_path_to_nearest_cluster(leader, root);
+  if (path.top()->get_leader()->descriptor == leader) {
+    return path;
+  }
+
+  path = NodePath{};
+  collect_path_to_leaf_led_by(leader, root, path);
+  return path;
+}
+
+/**
+ * @brief publishes_versions tells whether the index publishes IndexVersions for queries.
+ */
+bool publishes_versions(const Index* const index)
+{
+  return index->maintainer && index->maintainer->publish_interval > 0;
+}
+
+/**
+ * @brief refresh_updated_point recomputes the code of a point whose descriptor was overwritten in place and
+ * marks its cluster as unpublished. The cluster is found by the path to its leader.
+ * @param location is the location of the point.
+ * @param index is the index containing the point.
+ */
+void refresh_updated_point(const PointLocation& location, Index* const index)
+{
+  const auto path = collect_path_to_cluster_led_by(location.leader, &index->root);
+  assert(!path.empty());
+  Node* cluster = path.top();
+  cluster->unpublished = true;  // Not dirty as checkpoints find the cluster by its leader.
+  if (cluster->codes.empty()) {
+    return;
+  }
+
+  const std::size_t dimensions = globals::g_vector_dimensions;
+  for (std::size_t i = 0; i < cluster->points.size(); ++i) {
+    if (cluster->points[i].descriptor == location.descriptor) {
+      quantization::encode(location.descriptor, cluster->codes.data() + i * dimensions);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief reelect_leaders_led_by makes the nodes of a path that are led by a copy of the given point be led by
+ * a copy of the leader of their first child instead. Bottom up, thus the leaders stay within their subtrees.
+ * @param levels are the nodes of a path indexed by level with the root at 0.
+ * @param last is the level of the lowest node to re-elect the leader of.
+ * @param id is the id of the point the nodes must no longer be led by.
+ */
+void reelect_leaders_led_by(const std::vector<Node*>& levels, std::size_t last, unsigned long id)
+{
+  for (std::size_t level = last + 1; level-- > 0;) {
+    Node* node = levels[level];
+    if (node->get_leader()->id == id) {
+      node->points.front() = Point{*node->children.front().get_leader()};
+      node->mark_changed();
+    }
+  }
+}
+
+/**
+ * @brief reroute_cluster restores the routing to a cluster whose leader has changed. The subtree holding the
+ * cluster is moved below the nearest node of its parent's level, and internal nodes led by a copy of the
+ * former leader are led by a copy of the new leader inside the subtree and re-elected outside of it. The
+ * subtree is the cluster, or its highest ancestor whose parent has no other children such that no internal
+ * node is left without children.
+ * @param path is the path from the root to the cluster.
+ * @param former_id is the id of the former leader of the cluster.
+ * @param index is the index containing the cluster.
+ */
+void reroute_cluster(const NodePath& path, unsigned long former_id, Index* const index)
+{
+  const auto levels = path_to_levels(path);
+
+  std::size_t moved = levels.size() - 1;
+  while (moved > 1 && levels[moved - 1]->children.size() == 1) {
+    --moved;
+  }
+
+  const std::size_t first_copy = moved < 2 ? 0 : moved;  // The root is the only node of its level.
+  for (std::size_t level = levels.size() - 1; level-- > first_copy;) {  // Bottom up, thus of the new leader.
+    if (levels[level]->get_leader()->id == former_id) {
+      levels[level]->points.front() = Point{*levels[level + 1]->get_leader()};
+      levels[level]->mark_changed();
+    }
+  }
+  if (moved < 2) {
+    return;
+  }
+
+  // Detach the subtree such that the nodes led by copies of its former leader do not attract it.
+  Node* parent = levels[moved - 1];
+  Node subtree = std::move(*levels[moved]);
+  parent->children.erase(parent->children.begin() + (levels[moved] - parent->children.data()));
+  for (std::size_t level = 0; level < moved; ++level) {
+    levels[level]->point_count -= subtree.point_count;
+  }
+  --levels[moved - 2]->grandchild_count;
+  parent->grandchild_count -= subtree.children.size();
+  parent->mark_changed();
+  reelect_leaders_led_by(levels, moved - 1, former_id);
+
+  const float* leader = subtree.get_leader()->descriptor;
+  std::vector<Node*> targets{&index->root};
+  while (targets.size() < moved) {
+    targets.emplace_back(traversal::get_closest_node(leader, targets.back()->children));
+  }
+  for (Node* target : targets) {
+    target->point_count += subtree.point_count;
+  }
+  ++targets[moved - 2]->grandchild_count;
+  targets.back()->grandchild_count += subtree.children.size();
+  targets.back()->children.emplace_back(std::move(subtree));
+  targets.back()->mark_changed();
+  index->progress = ReclusteringProgress{};  // Nodes have moved.
+
+  NodePath target_path;  // The subtree is a chain of single children down to the cluster.
+  for (Node* node : targets) {
+    target_path.emplace(node);
+  }
+  Node* node = &targets.back()->children.back();
+  target_path.emplace(node);
+  while (!node->children.empty()) {
+    node = &node->children.front();
+    target_path.emplace(node);
+  }
+  recluster_if_required(target_path, index);
+}
+
+/**
+ * @brief is_erased tells whether the id is marked as erased in the tombstones of the index.
+ */
+bool is_erased(unsigned long id, const std::vector<bool>& tombstones)
+{
+  return id < tombstones.size() && tombstones[id];
+}
+
+/**
+ * @brief remove_erased_points removes all erased points of a cluster while preserving the order of the rest.
+ * If the leader is erased the first remaining point thereby becomes the new leader. The erased leader is
+ * kept when no other point remains such that the cluster can still route queries until it is removed.
+ * @param cluster is the cluster to remove points from.
+ * @param tombstones are the erased ids of the index.
+ * @return true if no points that are not erased remain in the cluster otherwise false.
+ */
+bool remove_erased_points(Node& cluster, const std::vector<bool>& tombstones)
+{
+  auto erased = [&tombstones](const Point& point) { return is_erased(point.id, tombstones); };
+  auto first_kept = std::find_if_not(cluster.points.begin(), cluster.points.end(), erased);
+
+  if (first_kept == cluster.points.end()) {
+    cluster.points.erase(cluster.points.begin() + 1, cluster.points.end());  // Keep leader only.
+    cluster.encode_points();
+    cluster.mark_changed();
+    return true;
+  }
+
+  const auto removed = std::remove_if(cluster.points.begin(), cluster.points.end(), erased);
+  if (removed != cluster.points.end()) {
+    cluster.points.erase(removed, cluster.points.end());
+    cluster.encode_points();
+    cluster.mark_changed();
+  }
+  return false;
+}
+
+/**
+ * @brief must_level_shrink determines whether the children of a node would fit into fewer nodes when
+ * redistributed using the optimal node size, i.e. the children have fallen under the lo bound on average.
+ * @param count_descendants_func is used to count the descendants of the children of parent.
+ * @param parent is the node whose children are checked.
+ * @param optimal_size is the lo bound of the index.
+ * @return true if the level should be reclustered into fewer nodes otherwise false.
+ */
+bool must_level_shrink(count_descendants_function count_descendants_func, const Node* parent,
+                       unsigned optimal_size)
+{
+  const unsigned descendants = count_descendants_func(parent);
+  const unsigned l = std::ceil(descendants / static_cast<float>(optimal_size));
+  return l < parent->children.size();
+}
+
+/**
+ * @brief compact_subtree removes erased points from all clusters below node. Clusters and nodes left without
+ * points are removed unless they are the only child of their parent. Levels that have fallen under the lo
+ * bound are reclustered such that their nodes are merged into fewer nodes. A node led by a copy of an erased
+ * point is led by a copy of the leader of its first child instead, such that queries are no longer routed by
+ * erased points.
+ * @param node is the root of the subtree to compact.
+ * @param index is the index worked on.
+ * @return true if no points that are not erased remain in the subtree otherwise false.
+ */
+bool compact_subtree(Node& node, Index* const index)
+{
+  if (node.children.empty()) {
+    return remove_erased_points(node, index->tombstones);
+  }
+
+  const bool is_cluster_parent = node.children.front().children.empty();
+  std::vector<Node> kept;
+  kept.reserve(node.children.size());
+
+  for (auto& child : node.children) {
+    if (!compact_subtree(child, index)) {
+      kept.emplace_back(std::move(child));
+    }
+  }
+
+  if (kept.empty()) {
+    node.children.erase(node.children.begin() + 1, node.children.end());  // Keep a single empty child.
+    node.mark_changed();
+    return true;
+  }
+
+  if (kept.size() < node.children.size()) {
+    node.mark_changed();
+  }
+  node.children.swap(kept);
+
+  const unsigned lo_bound = index->scheme.lo_bound;
+  const unsigned hi_bound = index->scheme.hi_bound;
+
+  if (is_cluster_parent && must_level_shrink(count_points_of_children, &node, lo_bound)) {
+    recluster_cluster(&node, lo_bound, hi_bound);
+  }
+  else if (!is_cluster_parent && must_level_shrink(count_nodes_of_children, &node, lo_bound)) {
+    recluster_internal_node(&node, lo_bound, hi_bound);
+  }
+
+  if (is_erased(node.get_leader()->id, index->tombstones)) {  // The first child kept points thus a leader.
+    node.points.front() = Point{*node.children.front().get_leader()};
+    node.mark_changed();
+  }
+
+  return false;
+}
+
+/**
+ * @brief collect_erased_points marks the erased points that are still contained in the clusters below node.
+ * @param node is the root of the subtree to search.
+ * @param tombstones are the erased ids of the index.
+ * @param contained is marked by the id of each erased point found. Must have the size of the tombstones.
+ */
+void collect_erased_points(const Node& node, const std::vector<bool>& tombstones,
+                           std::vector<bool>& contained)
+{
+  if (node.children.empty()) {
+    for (const auto& point : node.points) {
+      if (is_erased(point.id, tombstones)) {
+        contained[point.id] = true;
+      }
+    }
+  }
+
+  for (const auto& child : node.children) {
+    collect_erased_points(child, tombstones, contained);
+  }
+}
+
+/**
+ * @brief clear_removed_tombstones clears the tombstones of the points removed by a compaction. Only erased
+ * leaders kept by clusters without other points remain erased. The tombstones are released if none remain,
+ * such that queries no longer check them.
+ * @param index is the compacted index.
+ */
+void clear_removed_tombstones(Index* const index)
+{
+  std::vector<bool> contained(index->tombstones.size(), false);
+  collect_erased_points(index->root, index->tombstones, contained);
+
+  if (std::find(contained.begin(), contained.end(), true) == contained.end()) {
+    std::vector<bool>().swap(index->tombstones);
+  }
+  else {
+    index->tombstones.swap(contained);
+  }
+}
+
+/**
+ * @brief shrink_index is the reverse of grow_index. Removes the top level of the index as long as the root
+ * has a single child only.
+ * @param index is the index worked on and modified.
+ */
+void shrink_index(Index* const index)
+{
+  while (index->L > 1 && index->root.children.size() == 1) {
+    auto grandchildren = std::move(index->root.children.front().children);
+    index->root.children = std::move(grandchildren);
+    index->root.mark_changed();
+    index->L--;
+  }
+}
+
+/**
+ * @brief collect_path_to_cluster_parent_led_by finds the parent of clusters whose leader has the given
+ * descriptor storage. Only the nodes above the clusters are visited, whose leaders and children are neither
+ * moved nor changed by modifications holding the index lock shared.
+ * @param leader is the storage of the descriptor of the leader.
+ * @param node is the root of the subtree to search.
+ * @param levels is the number of levels between the node and the clusters. Must be at least 1.
+ * @param path is the path from the root to the found node with the node on top.
+ * @return true if the node is found otherwise false and path is unchanged.
+ */
+bool collect_path_to_cluster_parent_led_by(const float* leader, Node* const node, unsigned levels,
+                                           NodePath& path)
+{
+  path.emplace(node);
+
+  if (levels == 1 && node->get_leader()->descriptor == leader) {
+    return true;
+  }
+
+  if (levels > 1) {
+    for (auto& child : node->children) {
+      if (collect_path_to_cluster_parent_led_by(leader, &child, levels - 1, path)) {
+        return true;
+      }
+    }
+  }
+
+  path.pop();
+  return false;
+}
+
+/**
+ * @brief is_cluster_reclustering_required checks whether the clusters of a parent must be reclustered.
+ * @param cluster_parent is the node that must have clusters as children.
+ * @param index is the index worked on.
+ * @return true if the parent has clusters as children that must be reclustered otherwise false.
+ */
+bool is_cluster_reclustering_required(Node* const cluster_parent, Index* const index)
+{
+  if (cluster_parent->children.empty() || !cluster_parent->children.front().children.empty()) {
+    return false;
+  }
+
+  std::size_t largest{0};
+  for (auto& cluster : cluster_parent->children) {
+    largest = std::max(largest, cluster.points.size());
+  }
+
+  return is_reclustering_required(counted_points_of_children, largest, cluster_parent,
+                                  index->scheme.cluster_policy, index->scheme.hi_bound);
+}
+
+/**
+ * @brief The ClusterSnapshot struct is a copy of the descriptors in the clusters of a node such that a
+ * reclustering can be planned without holding the index lock.
+ */
+struct ClusterSnapshot {
+  std::vector<unsigned> sizes;           // Number of points of each cluster.
+  std::vector<const float*> identities;  // Storage of the descriptors in the index. Only compared.
+  std::vector<float> storage;            // Copy of the descriptors.
+  std::vector<const float*> descriptors;  // Pointers into storage in the order of identities.
+};
+
+/**
+ * @brief take_cluster_snapshot copies the descriptors of all clusters below the parent.
+ */
+ClusterSnapshot take_cluster_snapshot(Node* const cluster_parent)
+{
+  ClusterSnapshot snapshot;
+
+  for (auto& cluster : cluster_parent->children) {
+    snapshot.sizes.emplace_back(cluster.points.size());
+    for (auto& point : cluster.points) {
+      snapshot.identities.emplace_back(point.descriptor);
+    }
+  }
+
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const std::size_t floats = (bytes + sizeof(float) - 1) / sizeof(float);
+  snapshot.storage.resize(snapshot.identities.size() * floats);
+  snapshot.descriptors.reserve(snapshot.identities.size());
+
+  for (std::size_t i = 0; i < snapshot.identities.size(); ++i) {
+    float* copy = snapshot.storage.data() + i * floats;
+    std::memcpy(copy, snapshot.identities[i], bytes);
+    snapshot.descriptors.emplace_back(copy);
+  }
+
+  return snapshot;
+}
+
+/**
+ * @brief The SubtreeLock struct locks the index while the clusters of a node are replaced. The index lock is
+ * held shared and the node, its parent and its clusters are latched, unless the index is too deep to be
+ * latched in which case the index lock is held exclusively.
+ */
+struct SubtreeLock {
+  std::shared_lock<std::shared_timed_mutex> shared;     // Held if the index is latched.
+  std::unique_lock<std::shared_timed_mutex> exclusive;  // Held otherwise.
+  maintenance::Phase phase;                             // Excludes queries of the index if modifying.
+  std::vector<std::unique_lock<std::mutex>> latches;    // Latches of the subtree in the order acquired.
+};
+
+/**
+ * @brief lock_subtree_index locks the index for a SubtreeLock before the subtree is searched.
+ * @param index is the index worked on.
+ * @param is_modifying is whether the subtree is modified or only read.
+ * @return the lock without latches, see latch_subtree.
+ */
+SubtreeLock lock_subtree_index(Index* const index, bool is_modifying)
+{
+  auto* maintainer = index->maintainer;
+  SubtreeLock lock;
+  lock.shared = std::shared_lock<std::shared_timed_mutex>(maintainer->index_mutex);
+
+  if (!is_latched(index)) {
+    lock.shared.unlock();
+    lock.exclusive = std::unique_lock<std::shared_timed_mutex>(maintainer->index_mutex);
+  }
+  else if (is_modifying) {
+    lock.phase = modifier_phase(index);
+  }
+  return lock;
+}
+
+/**
+ * @brief latch_subtree latches the parent of the clusters, its parent if any and its clusters in the order of
+ * latch_of. Nothing is latched if the index lock is held exclusively.
+ * @param lock is the lock of the index to add the latches to.
+ * @param levels are the nodes from the root to the parent of the clusters.
+ * @param maintainer is the background maintenance state holding the latches.
+ */
+void latch_subtree(SubtreeLock& lock, const std::vector<Node*>& levels,
+                   maintenance::BackgroundMaintainer* const maintainer)
+{
+  if (lock.exclusive) {
+    return;
+  }
+
+  const std::size_t depth = levels.size() - 1;
+  if (depth > 0) {
+    lock.latches.emplace_back(latch_of(levels[depth - 1], depth - 1, maintainer));
+  }
+  lock.latches.emplace_back(latch_of(levels[depth], depth, maintainer));
+
+  std::vector<std::mutex*> cluster_latches;  // Read once the parent is latched.
+  for (auto& cluster : levels[depth]->children) {
+    cluster_latches.emplace_back(&latch_of(&cluster, depth + 1, maintainer));
+  }
+  std::sort(cluster_latches.begin(), cluster_latches.end(), std::less<std::mutex*>());
+  cluster_latches.erase(std::unique(cluster_latches.begin(), cluster_latches.end()), cluster_latches.end());
+
+  for (std::mutex* latch : cluster_latches) {
+    lock.latches.emplace_back(*latch);
+  }
+}
+
+/**
+ * @brief recluster_in_background reclusters the clusters of the node led by the given leader in three
+ * steps: 1) Copy the clusters while they are latched. 2) Plan the new clusters without holding a lock.
+ * 3) Apply the plan while holding a SubtreeLock, thus insertions into other subtrees proceed meanwhile. The
+ * levels above are reclustered while holding the index lock exclusively if the new number of clusters
+ * requires it. The job is queued again if the clusters were changed other than by insertions in between.
+ * Splits skip the first two steps.
+ * @param leader is the storage of the leader descriptor identifying the parent of the clusters.
+ * @param index is the index worked on.
+ */
+void recluster_in_background(const float* leader, Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  const unsigned max_node_size = index->scheme.hi_bound;
+  const unsigned optimal_node_size = index->scheme.lo_bound;
+  const bool is_split = index->scheme.cluster_policy == ReclusteringPolicy::SPLIT;
+
+  // ** 1)
+  ClusterSnapshot snapshot;
+  if (!is_split) {
+    auto lock = lock_subtree_index(index, false);
+    NodePath path;
+
+    if (!collect_path_to_cluster_parent_led_by(leader, &index->root, index->L, path)) {
+      return;  // Reclustered or removed meanwhile.
+    }
+    latch_subtree(lock, path_to_levels(path), maintainer);
+
+    if (!is_cluster_reclustering_required(path.top(), index)) {
+      return;
+    }
+    snapshot = take_cluster_snapshot(path.top());
+  }
+
+  // ** 2)
+  const auto plan = is_split ? ClusterPlan{} : plan_clusters(snapshot.descriptors, optimal_node_size);
+
+  // ** 3)
+  bool is_above_required;
+  {
+    auto lock = lock_subtree_index(index, true);
+    NodePath path;
+
+    if (!collect_path_to_cluster_parent_led_by(leader, &index->root, index->L, path)) {
+      return;
+    }
+    const auto levels = path_to_levels(path);
+    latch_subtree(lock, levels, maintainer);
+
+    Node* cluster_parent = levels.back();
+    const std::size_t clusters = cluster_parent->children.size();
+
+    if (is_split) {
+      std::lock_guard<std::mutex> ids_lock(maintainer->ids_mutex);  // Splits locate the moved points.
+      split_over_full_children(cluster_parent, index);
+    }
+    else {
+      std::vector<Point*> points;
+      if (!match_cluster_points(cluster_parent, snapshot.sizes, snapshot.identities, points)) {
+        std::lock_guard<std::mutex> jobs_lock(maintainer->jobs_mutex);
+        maintainer->jobs.emplace_back(leader);
+        return;
+      }
+
+      apply_cluster_plan(cluster_parent, points, plan, max_node_size);
+
+      std::lock_guard<std::mutex> ids_lock(maintainer->ids_mutex);
+      if (!index->locations.empty()) {
+        locate_points(*cluster_parent, index);
+      }
+    }
+
+    // The parent of the clusters is latched, thus its count is adjusted rather than recounted.
+    if (levels.size() == 1) {
+      is_above_required = must_index_grow(cluster_parent, max_node_size);
+    }
+    else {
+      Node* parent = levels[levels.size() - 2];
+      parent->grandchild_count = parent->grandchild_count - clusters + cluster_parent->children.size();
+      is_above_required = is_reclustering_required(counted_nodes_of_children, cluster_parent->children.size(),
+                                                   parent, index->scheme.node_policy, max_node_size);
+    }
+  }
+
+  if (!is_above_required) {
+    return;
+  }
+
+  std::unique_lock<std::shared_timed_mutex> lock(maintainer->index_mutex);
+  NodePath path;
+
+  if (!collect_path_to_cluster_parent_led_by(leader, &index->root, index->L, path)) {
+    return;
+  }
+
+  // Clusters added to since the subtree was unlocked may be moved below other nodes, and their jobs lost.
+  Node* cluster_parent = path.top();
+  if (is_cluster_reclustering_required(cluster_parent, index)) {
+    if (is_split) {
+      split_over_full_children(cluster_parent, index);
+    }
+    else {
+      recluster_cluster(cluster_parent, optimal_node_size, max_node_size);
+
+      if (!index->locations.empty()) {
+        locate_points(*cluster_parent, index);
+      }
+    }
+  }
+  recursively_recluster_index(cluster_parent, path, index, optimal_node_size, max_node_size);
+}
+
+/**
+ * @brief publish_subtree copies the nodes of a subtree that changed since they were published, or whose
+ * children did, into VersionNodes. The VersionNodes of unchanged subtrees are shared with the last version.
+ * @param node is the root of the subtree.
+ * @return the copy of the subtree.
+ */
+std::shared_ptr<const VersionNode> publish_subtree(Node& node)
+{
+  bool changed =
+      node.unpublished || !node.published || node.published->children.size() != node.children.size();
+  std::vector<std::shared_ptr<const VersionNode>> children;
+  children.reserve(node.children.size());
+  for (std::size_t i = 0; i < node.children.size(); ++i) {
+    children.emplace_back(publish_subtree(node.children[i]));
+    changed = changed || children.back() != node.published->children[i];
+  }
+
+  if (!changed) {
+    return node.published;
+  }
+
+  auto copy = std::make_shared<Node>();
+  copy->points = node.points;
+  copy->codes = node.codes;
+  copy->point_count = node.point_count;
+  copy->grandchild_count = node.grandchild_count;
+
+  auto version = std::make_shared<VersionNode>();
+  version->node = std::move(copy);
+  version->children = std::move(children);
+  node.published = version;
+  node.unpublished = false;
+  return node.published;
+}
+
+/**
+ * @brief publish_version copies the changed parts of the index into a new IndexVersion, swaps it in for
+ * queries and releases the replaced versions no query reads anymore. A retired version only referenced by
+ * retired cannot be pinned again, thus it is released by the publisher rather than by the last query.
+ * @param index is the index worked on. Must not be locked by the calling thread.
+ */
+void publish_version(Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  auto version = std::make_shared<maintenance::IndexVersion>();
+  std::lock_guard<std::mutex> versions_lock(maintainer->versions_mutex);
+  {
+    std::unique_lock<std::shared_timed_mutex> lock(maintainer->index_mutex);  // Insertions append if shared.
+    version->L = index->L;
+    version->root = publish_subtree(index->root);
+    version->tombstones = index->tombstones;
+    version->delta = index->delta;
+  }
+
+  auto& retired = maintainer->retired;
+  retired.emplace_back(std::atomic_exchange(&maintainer->version, std::move(version)));
+  auto is_unpinned = [](const std::shared_ptr<maintenance::IndexVersion>& v) { return v.use_count() <= 1; };
+  retired.erase(std::remove_if(retired.begin(), retired.end(), is_unpinned), retired.end());
+}
+
+/**
+ * @brief record_modifications counts modifications of the index towards the next published version and wakes
+ * the background thread if a version is due.
+ * @param count is the number of modified descriptors.
+ * @param index is the index worked on.
+ */
+void record_modifications(unsigned long count, Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  if (!maintainer || maintainer->publish_interval == 0) {
+    return;
+  }
+
+  bool is_due;
+  {
+    std::lock_guard<std::mutex> lock(maintainer->jobs_mutex);
+    maintainer->modifications += count;
+    is_due = maintainer->modifications >= maintainer->publish_interval;
+  }
+
+  if (is_due) {
+    maintainer->jobs_available.notify_one();
+  }
+}
+
+/**
+ * @brief run_background_maintainer is the loop of the background thread. Publishes a version when due, merges
+ * the delta buffer when its oldest descriptor expires and otherwise processes the next job. Returns when
+ * stopped and all jobs are processed.
+ * @param index is the maintained index.
+ */
+void run_background_maintainer(Index* const index)
+{
+  auto* maintainer = index->maintainer;
+
+  while (true) {
+    const float* leader;
+    {
+      std::unique_lock<std::mutex> lock(maintainer->jobs_mutex);
+      auto is_version_due = [maintainer] {
+        return maintainer->publish_interval > 0 && maintainer->modifications >= maintainer->publish_interval;
+      };
+      auto is_merge_due = [maintainer] {
+        return maintainer->delta_deadline > 0 && now_in_milliseconds() >= maintainer->delta_deadline;
+      };
+
+      // Waited for in steps as the deadline of the merge may be scheduled while waiting.
+      while (!maintainer->stopping && maintainer->jobs.empty() && !is_version_due() && !is_merge_due()) {
+        if (maintainer->delta_deadline > 0) {
+          const std::chrono::milliseconds deadline{maintainer->delta_deadline};
+          maintainer->jobs_available.wait_until(lock, std::chrono::steady_clock::time_point{deadline});
+        }
+        else {
+          maintainer->jobs_available.wait(lock);
+        }
+      }
+
+      if (is_version_due()) {
+        maintainer->modifications = 0;
+        lock.unlock();
+        publish_version(index);
+        continue;
+      }
+
+      if (is_merge_due()) {
+        maintainer->delta_deadline = 0;
+        lock.unlock();
+        maintenance::merge_expired_delta_buffer(index);
+        continue;
+      }
+
+      if (maintainer->jobs.empty()) {
+        return;
+      }
+
+      leader = maintainer->jobs.front();
+      maintainer->jobs.pop_front();
+    }
+
+    recluster_in_background(leader, index);
+  }
+}
+
+}  // namespace maintenance_helpers
+
+namespace maintenance {
+
+Phase::Phase() : maintainer(nullptr), is_reader(false) {}
+
+Phase::Phase(BackgroundMaintainer* maintainer_, bool is_reader_)
+    : maintainer(maintainer_)
+    , is_reader(is_reader_)
+{
+  std::unique_lock<std::mutex> lock(maintainer->phase_mutex);
+
+  if (is_reader) {
+    ++maintainer->waiting_readers;
+    maintainer->phase_ended.wait(lock, [this] { return maintainer->modifiers == 0; });
+    --maintainer->waiting_readers;
+    ++maintainer->readers;
+  }
+  else {
+    maintainer->phase_ended.wait(
+        lock, [this] { return maintainer->readers == 0 && maintainer->waiting_readers == 0; });
+    ++maintainer->modifiers;
+  }
+}
+
+Phase::Phase(Phase&& other) noexcept : maintainer(other.maintainer), is_reader(other.is_reader)
+{
+  other.maintainer = nullptr;
+}
+
+Phase& Phase::operator=(Phase&& other) noexcept  // Swapped such that other leaves the replaced phase.
+{
+  std::swap(maintainer, other.maintainer);
+  std::swap(is_reader, other.is_reader);
+  return *this;
+}
+
+Phase::~Phase()
+{
+  if (!maintainer) {
+    return;
+  }
+
+  bool is_last;
+  {
+    std::lock_guard<std::mutex> lock(maintainer->phase_mutex);
+    auto& count = is_reader ? maintainer->readers : maintainer->modifiers;
+    is_last = --count == 0;
+  }
+
+  if (is_last) {
+    maintainer->phase_ended.notify_all();
+  }
+}
+
+void insert(const float* descriptor, Index* index)
+{
+  if (index->maintainer && maintenance_helpers::insert_point_in_parallel(descriptor, index)) {
+    maintenance_helpers::record_modifications(1, index);
+    return;
+  }
+
+  auto lock = write_lock(index);
+
+  if (index->size < 1)
+    throw std::invalid_argument(
+        "maintenance: It is required that the index contains at least a root node in order to insert.");
+
+  maintenance_helpers::log_modification(index, write_ahead_log::Operation::INSERT, index->size, descriptor);
+
+  if (index->delta.capacity > 0) {
+    maintenance_helpers::buffer_descriptor(descriptor, index->size++, index);
+  }
+  else {
+    maintenance_helpers::insert_point(descriptor, index->size++, index);  // Insert and incr. size.
+  }
+  maintenance_helpers::record_modifications(1, index);
+}
+
+void insert_batch(const float* descriptors, std::size_t n, Index* const index)
+{
+  auto lock = write_lock(index);
+
+  if (index->size < 1) {
+    throw std::invalid_argument(
+        "maintenance: It is required that the index contains at least a root node in order to insert.");
+  }
+
+  if (n == 0) {
+    return;
+  }
+
+  maintenance_helpers::merge_delta_buffer(index);  // Keeps the ids of the clusters in order of insertion.
+
+  std::vector<unsigned long> ids(n);
+  std::iota(ids.begin(), ids.end(), index->size);
+  index->size += n;
+
+  const auto* rows = reinterpret_cast<const char*>(descriptors);
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  for (std::size_t i = 0; i < n; ++i) {
+    maintenance_helpers::log_modification(index, write_ahead_log::Operation::INSERT, ids[i],
+                                          reinterpret_cast<const float*>(rows + i * bytes));
+  }
+
+  maintenance_helpers::add_batch(rows, n, ids.data(), index);
+  maintenance_helpers::record_modifications(n, index);
+}
+
+void update(unsigned long id, const float* descriptor, Index* const index)
+{
+  auto lock = write_lock(index);
+
+  if (id >= index->size || maintenance_helpers::is_erased(id, index->tombstones)) {
+    throw std::invalid_argument("maintenance: The given id is not contained in the index.");
+  }
+
+  if (maintenance_helpers::is_buffered(id, index->delta)) {
+    maintenance_helpers::merge_delta_buffer(index);
+  }
+
+  if (index->locations.empty()) {
+    maintenance_helpers::locate_points(index->root, index);
+  }
+
+  const PointLocation location = index->locations[id];
+  if (!location.descriptor) {  // Removed by a compaction, which clears its tombstone.
+    throw std::invalid_argument("maintenance: The given id is not contained in the index.");
+  }
+
+  maintenance_helpers::log_modification(index, write_ahead_log::Operation::UPDATE, id, descriptor);
+  maintenance_helpers::record_modifications(1, index);  // Published once the lock is released.
+
+  // Overwrite in place if the descriptor is at least as close to its leader as before.
+  if (location.descriptor != location.leader) {
+    const float old_distance =
+        distance::g_distance_function(location.leader, location.descriptor, globals::FLOAT_MAX);
+
+    if (distance::g_distance_function(location.leader, descriptor, old_distance) <= old_distance) {
+      std::memcpy(location.descriptor, descriptor, globals::descriptor_size_in_bytes());
+      if (quantization::is_enabled() || maintenance_helpers::publishes_versions(index)) {
+        maintenance_helpers::refresh_updated_point(location, index);
+      }
+      if (!index->base.path.empty()) {  // The cluster is not known without a path, thus its leader is kept.
+        index->base.updated_leaders.emplace(location.leader);
+      }
+      return;
+    }
+  }
+
+  auto path = maintenance_helpers::collect_path_to_cluster_led_by(location.leader, &index->root);
+  assert(!path.empty());
+  Node* cluster = path.top();
+  cluster->mark_changed();
+
+  // The descriptor is the only one of its cluster thus the cluster moves along with it.
+  if (cluster->points.size() == 1) {
+    Point* point = cluster->get_leader();
+    std::memcpy(point->descriptor, descriptor, globals::descriptor_size_in_bytes());
+    cluster->encode_points();
+    maintenance_helpers::reroute_cluster(path, id, index);
+    return;
+  }
+
+  // Move the descriptor to its nearest cluster. The next point leads the cluster if it was the leader.
+  auto it = std::find_if(cluster->points.begin(), cluster->points.end(),
+                         [id](const Point& point) { return point.id == id; });
+  const bool was_leader = it == cluster->points.begin();
+  maintenance_helpers::abort_incremental_reclustering(it->descriptor, index);
+  cluster->erase_point(it - cluster->points.begin());
+
+  for (auto counted = path; !counted.empty(); counted.pop()) {
+    --counted.top()->point_count;
+  }
+
+  if (was_leader) {  // Internal nodes may be led by copies of the descriptor, and the cluster by another one.
+    maintenance_helpers::locate_cluster_points(*cluster, index);
+    maintenance_helpers::reroute_cluster(path, id, index);
+  }
+
+  maintenance_helpers::insert_point(descriptor, id, index);
+}
+
+void erase(unsigned long id, Index* const index)
+{
+  auto lock = write_lock(index);
+
+  if (id >= index->size) {
+    throw std::invalid_argument("maintenance: The given id is not contained in the index.");
+  }
+
+  maintenance_helpers::log_modification(index, write_ahead_log::Operation::ERASE, id, nullptr);
+
+  if (index->tombstones.size() < index->size) {
+    index->tombstones.resize(index->size, false);
+  }
+
+  index->tombstones[id] = true;
+  maintenance_helpers::record_modifications(1, index);
+}
+
+void compact(Index* const index)
+{
+  auto lock = write_lock(index);
+
+  if (index->tombstones.empty()) {
+    return;
+  }
+
+  maintenance_helpers::merge_delta_buffer(index);  // Erased descriptors are only removed from clusters.
+  index->progress = ReclusteringProgress{};  // Nodes are removed and reclustered.
+  maintenance_helpers::compact_subtree(index->root, index);
+  maintenance_helpers::shrink_index(index);
+  maintenance_helpers::clear_removed_tombstones(index);
+  index->root.count_subtree();
+  index->locations.clear();  // Rebuilt on the next update.
+}
+
+void enable_delta_buffer(Index* const index, std::size_t capacity, unsigned max_age)
+{
+  auto lock = write_lock(index);
+
+  if (capacity == 0) {
+    throw std::invalid_argument("maintenance: The capacity of the delta buffer must be larger than 0.");
+  }
+
+  index->delta.capacity = capacity;
+  index->delta.max_age = max_age;
+
+  if (index->delta.ids.size() >= capacity) {
+    maintenance_helpers::merge_delta_buffer(index);
+  }
+}
+
+void disable_delta_buffer(Index* const index)
+{
+  auto lock = write_lock(index);
+  maintenance_helpers::merge_delta_buffer(index);
+  index->delta.capacity = 0;
+}
+
+void merge_delta_buffer(Index* const index)
+{
+  auto lock = write_lock(index);
+  maintenance_helpers::merge_delta_buffer(index);
+}
+
+void merge_expired_delta_buffer(Index* const index)
+{
+  auto lock = write_lock(index);
+  maintenance_helpers::merge_expired_delta_buffer(index);
+}
+
+void enable_background_maintenance(Index* const index, unsigned publish_interval)
+{
+  if (index->maintainer) {
+    return;
+  }
+
+  index->progress = ReclusteringProgress{};  // Not continued by the background thread.
+  index->maintainer = new BackgroundMaintainer{};  // Value initialized i.e. not stopping.
+  index->maintainer->publish_interval = publish_interval;
+
+  if (publish_interval > 0) {
+    maintenance_helpers::publish_version(index);  // Queries never find no version.
+  }
+
+  index->maintainer->worker = std::thread(maintenance_helpers::run_background_maintainer, index);
+}
+
+void disable_background_maintenance(Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  if (!maintainer) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(maintainer->jobs_mutex);
+    maintainer->stopping = true;
+  }
+  maintainer->jobs_available.notify_all();
+  maintainer->worker.join();
+
+  index->maintainer = nullptr;
+  delete maintainer;
+}
+
+void publish(Index* const index)
+{
+  if (!index->maintainer || index->maintainer->publish_interval == 0) {
+    return;
+  }
+
+  maintenance_helpers::publish_version(index);
+}
+
+std::shared_ptr<IndexVersion> read_version(Index* const index)
+{
+  if (!index->maintainer || index->maintainer->publish_interval == 0) {
+    return nullptr;
+  }
+  return std::atomic_load(&index->maintainer->version);
+}
+
+ReadLock read_lock(Index* const index)
+{
+  auto* maintainer = index->maintainer;
+  ReadLock lock;
+  if (!maintainer) {
+    return lock;
+  }
+
+  lock.lock = std::shared_lock<std::shared_timed_mutex>{maintainer->index_mutex};
+  if (maintainer->publish_interval == 0) {
+    lock.phase = Phase{maintainer, true};
+  }
+  return lock;
+}
+
+std::unique_lock<std::shared_timed_mutex> write_lock(Index* const index)
+{
+  if (!index->maintainer) {
+    return std::unique_lock<std::shared_timed_mutex>{};
+  }
+  return std::unique_lock<std::shared_timed_mutex>{index->maintainer->index_mutex};
 }
 
 }  // namespace maintenance
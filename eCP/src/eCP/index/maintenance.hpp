@@ -1,19 +1,231 @@
 #ifndef MAINTENANCE_HPP
 #define MAINTENANCE_HPP
 
+#include <array>
+#include <condition_variable>
 #include <deque>
 #include <eCP/index/shared/data_structure.hpp>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
 namespace maintenance {
 
 /**
- * @brief insert inserts a given descriptor to the index and initiates a reclustering if necessary.
+ * @brief The IndexVersion struct is an immutable copy of the searchable part of an index. Queries read the
+ * latest published version without waiting for the writers of the index. The tree is shared with the
+ * previous version except for the clusters changed since and the paths to them.
+ */
+struct IndexVersion {
+  unsigned L;                               // Depth of the copied index.
+  std::shared_ptr<const VersionNode> root;  // Copy of the root of the index.
+  std::vector<bool> tombstones;             // Copy of the erased ids.
+  DeltaBuffer delta;                        // Copy of the buffered descriptors.
+};
+
+/**
+ * @brief The BackgroundMaintainer struct holds the state of deferred reclustering. Insertions only append to
+ * the nearest cluster and queue the parent of the cluster if it must be reclustered. A background thread
+ * computes the new clusters from a snapshot without blocking insertions and publishes them under the index
+ * lock. Internal nodes above are reclustered synchronously by the background thread as they are small.
+ * If a publish interval is given the background thread also publishes a new IndexVersion whenever the index
+ * has been modified that many times. Replaced versions are released by the background thread once the last
+ * query reading them has finished, such that queries neither wait for writers nor free memory. Queries pin
+ * a version by an atomic load of its shared pointer, which the standard library guards by a mutex held only
+ * while the pointer is copied, thus queries only contend with each other and the publisher for that copy.
+ * Insertions only hold the index lock shared and descend with latch coupling, i.e. the latch of a node is
+ * released once the latch of the next node is held, such that insertions into different clusters proceed in
+ * parallel. A reclustering of the clusters of a node latches the node, its parent and its clusters while
+ * holding the index lock shared. Only reclusterings of the levels above hold the index lock exclusively.
+ * Unless versions are published, queries of the index exclude these modifications through a Phase.
+ */
+struct BackgroundMaintainer {
+  std::shared_timed_mutex index_mutex;     // Exclusive when modifying the index, shared when reading it.
+  std::mutex jobs_mutex;                   // Guards jobs, stopping, modifications and delta_deadline.
+  std::condition_variable jobs_available;  // Signaled on queued jobs and merges, due versions and stopping.
+  std::deque<const float*> jobs;           // Parents of over-full clusters identified by leader storage.
+  bool stopping;                           // Remaining jobs are processed before the thread stops.
+  std::thread worker;                      // The background thread processing the jobs.
+  unsigned publish_interval;               // Modifications per published version, 0 if queries lock.
+  unsigned long modifications;             // Modifications since the last published version.
+  long long delta_deadline;                // Time the delta buffer expires in milliseconds, 0 if none.
+  std::mutex versions_mutex;               // Guards retired and serializes publishing.
+  std::shared_ptr<IndexVersion> version;   // Latest published version. Only accessed atomically.
+  std::vector<std::shared_ptr<IndexVersion>> retired;  // Replaced versions possibly still read.
+  std::mutex ids_mutex;                    // Guards the size, locations and delta buffer for insertions.
+  std::mutex phase_mutex;                  // Guards readers, modifiers and waiting_readers.
+  std::condition_variable phase_ended;     // Signaled when the last reader or modifier leaves.
+  unsigned readers;                        // Queries reading the index while versions are not published.
+  unsigned modifiers;                      // Modifications holding the index lock shared.
+  unsigned waiting_readers;                // Queries waiting for the modifiers to leave.
+  std::array<std::array<std::mutex, 32>, 16> latches;  // Guard the nodes of each depth, striped by address.
+};
+
+/**
+ * @brief The Phase struct admits either readers or modifiers of an index that hold its lock shared, any
+ * number of each at a time. Modifiers only latch the nodes they modify and readers of the index do not, thus
+ * they must not overlap. Waiting readers are admitted first such that insertions do not starve queries.
+ * Nothing is admitted if no maintainer is given.
+ */
+struct Phase {
+  BackgroundMaintainer* maintainer;  // The admitting maintainer, nullptr if not admitted.
+  bool is_reader;                    // Whether admitted as reader or as modifier.
+
+  Phase();
+  Phase(BackgroundMaintainer* maintainer, bool is_reader);
+  Phase(Phase&& other) noexcept;
+  Phase& operator=(Phase&& other) noexcept;
+  ~Phase();
+};
+
+/**
+ * @brief The ReadLock struct holds the index lock shared and, unless versions are published, the reader
+ * Phase. Is empty if background maintenance is not enabled.
+ */
+struct ReadLock {
+  std::shared_lock<std::shared_timed_mutex> lock;  // Acquired before the phase and released after it.
+  Phase phase;
+};
+
+/**
+ * @brief insert inserts a given descriptor to the index and initiates a reclustering if necessary. May be
+ * called from several threads in parallel while background maintenance is enabled.
  * @param descriptor is the descriptor to insert. It it assumed that the descriptor has the exact same
  * dimensionality as the dataset the index was initially constructed from.
  * @param index is the index to insert into.
  */
 void insert(const float* descriptor, Index* const index);
 
+/**
+ * @brief insert_batch inserts n descriptors at once. The nearest clusters of all descriptors are found
+ * concurrently by a pool of threads reused across batches, the descriptors are appended grouped by cluster
+ * and each touched cluster and parent is checked for reclustering once, such that a node whose children are
+ * overfilled by the batch is reclustered in a single pass. Ids are assigned in the order of the descriptors.
+ * @param descriptors points to n descriptors stored consecutively, each of descriptor_size_in_bytes() bytes.
+ * @param n is the number of descriptors.
+ * @param index is the index to insert into.
+ */
+void insert_batch(const float* descriptors, std::size_t n, Index* const index);
+
+/**
+ * @brief update replaces the descriptor with the given id while keeping the id. If the new descriptor is at
+ * least as close to the leader of its cluster as the old one it is overwritten in place without traversing
+ * the index, except to the cluster holding its code if compression is enabled. Otherwise the descriptor is
+ * moved to its nearest cluster which may initiate a reclustering. If the descriptor led its cluster, the
+ * cluster is moved below the nearest node of its parent's level by its new leader, and internal nodes led by
+ * copies of the descriptor are given new leaders. The first update records the location of every descriptor,
+ * which is afterwards maintained by insertions.
+ * @param id is the id of the descriptor to update. Must not be erased.
+ * @param descriptor is the new descriptor of the same dimensionality as the index.
+ * @param index is the index to update.
+ */
+void update(unsigned long id, const float* descriptor, Index* const index);
+
+/**
+ * @brief erase marks the descriptor with the given id as deleted in O(1). The descriptor is skipped by
+ * queries but is only physically removed from its cluster by the next compaction. Ids are never reused.
+ * @param id is the id of the descriptor to erase. Erasing an already erased id has no effect.
+ * @param index is the index to erase from.
+ */
+void erase(unsigned long id, Index* const index);
+
+/**
+ * @brief compact physically removes all erased descriptors from the index. A cluster whose leader is erased
+ * gets a new leader among its remaining points, and levels whose nodes have fallen under the lo bound of the
+ * ReclusteringScheme are reclustered into fewer nodes. Empty top levels are removed. Internal nodes whose
+ * leader is erased are routed by the leader of their first child, and the tombstones of the removed
+ * descriptors are cleared. Intended to be run periodically, e.g. in a maintenance window, instead of
+ * rebuilding the index.
+ * @param index is the index to compact.
+ */
+void compact(Index* const index);
+
+/**
+ * @brief enable_delta_buffer makes insertions append to a flat buffer in O(1) instead of traversing the
+ * index. The buffer is merged into the clusters as a single batch, see insert_batch, when it holds capacity
+ * descriptors or its oldest descriptor has been buffered for max_age milliseconds. The age is checked by the
+ * background thread if background maintenance is enabled, otherwise on insertion and by
+ * merge_expired_delta_buffer. Queries scan the buffer exhaustively, thus buffered descriptors are found at
+ * once.
+ * @param index is the index to insert into.
+ * @param capacity is the number of descriptors buffered before merging. Must be larger than 0.
+ * @param max_age is the time in milliseconds after which the buffer is merged. 0 if only the capacity is
+ * considered.
+ */
+void enable_delta_buffer(Index* const index, std::size_t capacity, unsigned max_age = 0);
+
+/**
+ * @brief disable_delta_buffer merges the delta buffer into the clusters and makes insertions traverse the
+ * index again.
+ * @param index is the index to insert into.
+ */
+void disable_delta_buffer(Index* const index);
+
+/**
+ * @brief merge_delta_buffer merges the buffered descriptors into the clusters at once, e.g. when the index is
+ * idle.
+ * @param index is the index to merge into.
+ */
+void merge_delta_buffer(Index* const index);
+
+/**
+ * @brief merge_expired_delta_buffer merges the buffered descriptors if the oldest of them has been buffered
+ * for the maximum age of the delta buffer. Called by queries unless background maintenance is enabled.
+ * @param index is the index to merge into.
+ */
+void merge_expired_delta_buffer(Index* const index);
+
+/**
+ * @brief enable_background_maintenance starts a background thread that reclusters the index such that
+ * insertions return as soon as the descriptor is appended to its nearest cluster. While enabled the index
+ * must only be modified using the functions of this namespace and read while holding read_lock, or through
+ * read_version if versions are published.
+ * @param index is the index to maintain. Has no effect if background maintenance is already enabled.
+ * @param publish_interval is the number of modifications after which the background thread publishes a new
+ * IndexVersion. Queries then read the latest version without waiting for writers at the cost of a copy of
+ * the clusters changed since the previous version and of not seeing the latest modifications. 0 disables
+ * versions.
+ */
+void enable_background_maintenance(Index* const index, unsigned publish_interval = 0);
+
+/**
+ * @brief disable_background_maintenance processes all queued reclusterings and stops the background thread.
+ * Insertions afterwards recluster synchronously. Must be called before the index is deleted.
+ * @param index is the maintained index. Has no effect if background maintenance is not enabled.
+ */
+void disable_background_maintenance(Index* const index);
+
+/**
+ * @brief publish copies the changed parts of the index into a new IndexVersion read by subsequent queries at
+ * once, e.g. such that queries observe the preceding modifications. Is otherwise done by the background
+ * thread.
+ * @param index is the maintained index. Has no effect if versions are not published.
+ */
+void publish(Index* const index);
+
+/**
+ * @brief read_version pins the latest published IndexVersion. The version is not modified and remains valid
+ * as long as the returned pointer is held.
+ * @param index is the index to read.
+ * @return the latest version, or nullptr if versions are not published in which case read_lock is used.
+ */
+std::shared_ptr<IndexVersion> read_version(Index* const index);
+
+/**
+ * @brief read_lock locks the index for reading while background maintenance is enabled.
+ * @param index is the index to read.
+ * @return a lock which is empty if background maintenance is not enabled.
+ */
+ReadLock read_lock(Index* const index);
+
+/**
+ * @brief write_lock locks the index for modification while background maintenance is enabled.
+ * @param index is the index to modify.
+ * @return an exclusive lock which is empty if background maintenance is not enabled.
+ */
+std::unique_lock<std::shared_timed_mutex> write_lock(Index* const index);
+
 }  // namespace maintenance
 
 #endif  // MAINTENANCE_HPP
@@ -1,10 +1,21 @@
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <eCP/index/cluster-reader.hpp>
 #include <eCP/index/pre-processing.hpp>
+#include <eCP/index/serialization.hpp>
 #include <eCP/index/shared/distance.hpp>
 #include <eCP/index/shared/globals.hpp>
 #include <eCP/index/shared/traversal.hpp>
 #include <eCP/utilities/utilities.hpp>
+#include <exception>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
 
 /*
  * Namespace containing testable helpers used to build the index. Compilation unit only.
@@ -95,36 +106,75 @@ IndexInitParams calculate_initial_index_params(unsigned dataset_size, unsigned s
   return IndexInitParams{level_sizes, L, lo_bound, hi_bound, lo, hi};
 }
 
-}  // namespace pre_processing_helpers
-
-namespace pre_processing {
+const std::size_t MIN_ROWS_PER_THREAD = 1 << 12;  // Fewer descriptors per thread are not worth a thread.
+const unsigned NO_LEAF = std::numeric_limits<unsigned>::max();
 
-/*
- * This function will create an index by a 3-step process:
- * 1) Generate random indexes used to pick leaders for each level.
- * 2) Built index bottom-up. Each level is constructed from the level
- * below. Initially the bottom level L is constructed from the input dataset.
- * Then level L-1 is constructed similarly, but from nodes from level L. Now all
- * nodes from level L are added to level L-1 using the distance function to
- * place them correctly. This process repeats for all levels up to and inclusive
- * level 1.
- * 3) All input vectors are added to the index except those that are
- * already there due to the Node constructor adding the leader to the Points vector.
- * Finally the nested levels are added as children of a single Node which acts root.
+/**
+ * @brief build_thread_count is the number of threads used to build an index of the given size, such that each
+ * thread is given at least MIN_ROWS_PER_THREAD descriptors.
+ * @param dataset_size is the size of the input dataset.
+ * @return the number of threads, at least 1 and at most the number of hardware threads.
  */
-Index* create_index(const std::vector<std::vector<float>>& dataset, unsigned cluster_size, float lo, float hi,
-                    ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+unsigned build_thread_count(std::size_t dataset_size)
+{
+  const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+  return std::max<std::size_t>(1, std::min(hardware, dataset_size / MIN_ROWS_PER_THREAD));
+}
 
+/**
+ * @brief parallel_chunks splits [0, n) into contiguous chunks of nearly equal size and calls work(chunk,
+ * begin, end) for each chunk on its own thread. The first chunk is done by the calling thread.
+ * @param n is the number of items.
+ * @param thread_count is the number of chunks, which is reduced to n if there are fewer items.
+ * @param work is called for each chunk and must only write to state owned by its chunk.
+ * @throws the first exception thrown by work once every thread has finished.
+ */
+template <typename Work>
+void parallel_chunks(std::size_t n, unsigned thread_count, Work work)
 {
-  // ** 1)
-  const auto index_params =
-      pre_processing_helpers::calculate_initial_index_params(dataset.size(), cluster_size, lo, hi);
+  const unsigned chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(thread_count, n));
+  std::vector<std::exception_ptr> errors(chunk_count);
+  auto run = [n, chunk_count, &work, &errors](unsigned chunk) {
+    try {
+      work(chunk, n * chunk / chunk_count, n * (chunk + 1) / chunk_count);
+    }
+    catch (...) {
+      errors[chunk] = std::current_exception();
+    }
+  };
 
-  const auto random_leader_indexes = pre_processing_helpers::generate_leaders_indexes(
-      dataset.size(), index_params.level_sizes, index_params.L);
+  std::vector<std::thread> threads;
+  threads.reserve(chunk_count - 1);
+  for (unsigned chunk = 1; chunk < chunk_count; ++chunk) {
+    threads.emplace_back(run, chunk);
+  }
+  run(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
 
-  // ** 2)
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
 
+/**
+ * @brief build_levels builds the levels of the index bottom-up from the randomly picked leaders, which is
+ * step 2 of build_index below.
+ * @param row returns the storage of the descriptor with the given id in the global descriptor type. Only
+ * called for the leaders of the bottom level.
+ * @param random_leader_indexes are the leaders of each level generated by generate_leaders_indexes.
+ * @param hi_bound is the number of points each cluster is allocated for.
+ * @param thread_count is the number of threads assigning the nodes of a level to the level above.
+ * @return the top level, i.e. the children of the root.
+ */
+template <typename RowFunction>
+std::vector<Node> build_levels(RowFunction row,
+                               const std::vector<std::vector<unsigned>>& random_leader_indexes,
+                               unsigned hi_bound, unsigned thread_count)
+{
   // Used to maintain the level below when building current level
   std::vector<Node> previous_level;
 
@@ -137,8 +187,8 @@ Index* create_index(const std::vector<std::vector<float>>& dataset, unsigned clu
     if (previous_level.size() == 0) {
       for (auto index : *it) {
         // Pick from input dataset using index as Id of Point
-        auto cluster = Node{Point{dataset[index].data(), index}};
-        cluster.points.reserve(index_params.hi_bound);
+        auto cluster = Node{Point{row(index), index}};
+        cluster.points.reserve(hi_bound);
         current_level.emplace_back(std::move(cluster));
       }
     }
@@ -152,39 +202,537 @@ Index* create_index(const std::vector<std::vector<float>>& dataset, unsigned clu
         current_level.emplace_back(Node{Point{*node->get_leader()}});
       }
 
-      // Add all nodes from below level as children of current level
-      for (auto node : previous_level) {
-        traversal::get_closest_node(node.get_leader()->descriptor, current_level)
-            ->children.emplace_back(std::move(node));
+      // Add all nodes from below level as children of current level. The closest nodes are found in
+      // parallel, while the nodes are moved in order such that the children do not depend on the threads.
+      std::vector<std::size_t> parents(previous_level.size());
+      auto find_parents = [&previous_level, &current_level, &parents](unsigned, std::size_t begin,
+                                                                      std::size_t end) {
+        for (auto i = begin; i < end; ++i) {
+          const float* leader = previous_level[i].get_leader()->descriptor;
+          parents[i] = traversal::get_closest_node(leader, current_level) - current_level.data();
+        }
+      };
+      parallel_chunks(previous_level.size(), thread_count, find_parents);
+
+      for (std::size_t i = 0; i < previous_level.size(); ++i) {
+        current_level[parents[i]].children.emplace_back(std::move(previous_level[i]));
       }
     }
     previous_level.swap(current_level);
   }
 
+  return previous_level;
+}
+
+/**
+ * @brief build_root picks a random node of the top level as the leader of the root and places the top level
+ * below the root.
+ * @param top_level is the top level built by build_levels.
+ * @return the root.
+ */
+Node build_root(std::vector<Node>& top_level)
+{
+  const auto root_node_index = utilities::get_random_unique_indexes(1, top_level.size()).front();
+  auto root_point = top_level[root_node_index].get_leader();
+  auto root_node = Node{*root_point};
+  root_node.children.swap(top_level);  // Insert index levels as children of new root.
+  root_node.count_subtree();
+  return root_node;
+}
+
+/**
+ * @brief collect_leaves collects the clusters below the given nodes depth-first.
+ * @param nodes are the nodes, e.g. the top level.
+ * @param leaves receives the clusters.
+ */
+void collect_leaves(std::vector<Node>& nodes, std::vector<Node*>& leaves)
+{
+  for (auto& node : nodes) {
+    if (node.children.empty()) {
+      leaves.emplace_back(&node);
+    }
+    else {
+      collect_leaves(node.children, leaves);
+    }
+  }
+}
+
+/**
+ * @brief assign_points adds every descriptor which is not a leader to its nearest cluster, which is step 3 of
+ * build_index below. The dataset is split into one chunk per thread and each thread finds the clusters of its
+ * chunk and counts the points of each cluster. A prefix sum over the counts by cluster and then by thread
+ * gives every thread its own positions in an array of ids ordered by cluster, which the threads scatter their
+ * ids into without locking. Finally the threads create the points of disjoint ranges of clusters. The points
+ * of each cluster are in increasing order of id regardless of the number of threads.
+ * @param row returns the storage of the descriptor with the given id in the global descriptor type.
+ * @param dataset_size is the size of the input dataset.
+ * @param is_leader marks the ids already added to a cluster as its leader.
+ * @param top_level is the top level built by build_levels.
+ * @param thread_count is the number of threads.
+ */
+template <typename RowFunction>
+void assign_points(RowFunction row, std::size_t dataset_size, const std::vector<bool>& is_leader,
+                   std::vector<Node>& top_level, unsigned thread_count)
+{
+  std::vector<Node*> leaves;
+  collect_leaves(top_level, leaves);
+  std::unordered_map<const Node*, unsigned> leaf_numbers;
+  for (unsigned i = 0; i < leaves.size(); ++i) {
+    leaf_numbers.emplace(leaves[i], i);
+  }
+
+  // Find the cluster of each descriptor and count the points of each cluster by chunk.
+  thread_count = std::max<std::size_t>(1, std::min<std::size_t>(thread_count, dataset_size));
+  std::vector<unsigned> leaf_of(dataset_size, NO_LEAF);
+  std::vector<std::vector<unsigned>> offsets(thread_count, std::vector<unsigned>(leaves.size(), 0));
+
+  parallel_chunks(dataset_size, thread_count, [&](unsigned chunk, std::size_t begin, std::size_t end) {
+    auto& counts = offsets[chunk];
+    for (auto id = begin; id < end; ++id) {
+      if (!is_leader[id]) {
+        leaf_of[id] = leaf_numbers.at(traversal::find_nearest_leaf(row(id), top_level));
+        ++counts[leaf_of[id]];
+      }
+    }
+  });
+
+  // Turn the counts into the position of the first id of each chunk within each cluster.
+  std::vector<unsigned> leaf_begin(leaves.size() + 1, 0);
+  unsigned position{0};
+  for (std::size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+    leaf_begin[leaf] = position;
+    for (auto& chunk_offsets : offsets) {
+      const unsigned count = chunk_offsets[leaf];
+      chunk_offsets[leaf] = position;
+      position += count;
+    }
+  }
+  leaf_begin.back() = position;
+
+  std::vector<unsigned> ids(position);
+  parallel_chunks(dataset_size, thread_count, [&](unsigned chunk, std::size_t begin, std::size_t end) {
+    auto& chunk_offsets = offsets[chunk];
+    for (auto id = begin; id < end; ++id) {
+      if (leaf_of[id] != NO_LEAF) {
+        ids[chunk_offsets[leaf_of[id]]++] = id;
+      }
+    }
+  });
+  std::vector<std::vector<unsigned>>().swap(offsets);
+  std::vector<unsigned>().swap(leaf_of);
+
+  parallel_chunks(leaves.size(), thread_count, [&](unsigned, std::size_t begin, std::size_t end) {
+    for (auto leaf = begin; leaf < end; ++leaf) {
+      auto& points = leaves[leaf]->points;
+      points.reserve(points.size() + leaf_begin[leaf + 1] - leaf_begin[leaf]);
+      for (auto i = leaf_begin[leaf]; i < leaf_begin[leaf + 1]; ++i) {
+        points.emplace_back(Point{row(ids[i]), ids[i]});
+      }
+      leaves[leaf]->encode_points();
+    }
+  });
+}
+
+/*
+ * This function will create an index by a 3-step process:
+ * 1) Generate random indexes used to pick leaders for each level.
+ * 2) Built index bottom-up. Each level is constructed from the level
+ * below. Initially the bottom level L is constructed from the input dataset.
+ * Then level L-1 is constructed similarly, but from nodes from level L. Now all
+ * nodes from level L are added to level L-1 using the distance function to
+ * place them correctly. This process repeats for all levels up to and inclusive
+ * level 1.
+ * 3) All input vectors are added to the index except those that are
+ * already there due to the Node constructor adding the leader to the Points vector.
+ * The assignments of step 2 and 3 are done in parallel by build_thread_count threads.
+ * Finally the nested levels are added as children of a single Node which acts root.
+ *
+ * The dataset is accessed through row(i) which returns a pointer to the storage of descriptor i in the global
+ * descriptor type.
+ */
+template <typename RowFunction>
+Index* build_index(RowFunction row, std::size_t dataset_size, unsigned cluster_size, float lo, float hi,
+                   ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+{
+  // ** 1)
+  const auto index_params = calculate_initial_index_params(dataset_size, cluster_size, lo, hi);
+
+  const auto random_leader_indexes =
+      generate_leaders_indexes(dataset_size, index_params.level_sizes, index_params.L);
+
+  const unsigned thread_count = build_thread_count(dataset_size);
+
+  // ** 2)
+  auto top_level = build_levels(row, random_leader_indexes, index_params.hi_bound, thread_count);
+
   // ** 3)
 
   // Add all points from input dataset to the index.
-  // FIXME: Optional optimization: Use a set to contain id's.
-  unsigned id{0};
-  for (auto& descriptor : dataset) {
-    auto* leaf = traversal::find_nearest_leaf(descriptor.data(), previous_level);
-    // Only add if id was not added to as leader of the cluster when the index was built
-    if (id != leaf->get_leader()->id) {
-      leaf->points.emplace_back(Point{descriptor.data(), id});
-    }
-    id++;
+  // Only add if id was not added as leader of a cluster when the index was built. A leader is not necessarily
+  // found as the nearest leaf of itself, thus the leaders are looked up by id.
+  std::vector<bool> is_leader(dataset_size, false);
+  for (auto index : random_leader_indexes.front()) {
+    is_leader[index] = true;
   }
 
+  assign_points(row, dataset_size, is_leader, top_level, thread_count);
+
   // Pick random node from top_level children to be used as root of index.
-  const auto root_node_index = utilities::get_random_unique_indexes(1, previous_level.size()).front();
-  auto root_point = previous_level[root_node_index].get_leader();
-  auto root_node = Node{*root_point};
-  root_node.children.swap(previous_level);  // Insert index levels as children of new root.
+  auto root_node = build_root(top_level);
 
   // Create reclustering scheme based on input.
   auto scheme = ReclusteringScheme{index_params.lo_bound, index_params.hi_bound, cluster_policy, node_policy};
 
-  return new Index{index_params.L, dataset.size(), root_node, scheme};
+  return new Index{index_params.L, dataset_size, std::move(root_node), scheme};
+}
+
+const std::size_t STREAM_CHUNK_SIZE = 1 << 24;  // Bytes of descriptors read at a time by create_disk_index.
+const std::size_t RUN_BUFFER_SIZE = 1 << 20;    // Bytes read at a time from each run when merging.
+const std::uint64_t NO_CLUSTER = std::numeric_limits<std::uint64_t>::max();
+
+/**
+ * @brief The Spill struct holds the buckets of the clusters during the second pass of create_disk_index and
+ * the runs they were spilled as. A run holds the number, the number of records and the records of each
+ * cluster with a non-empty bucket in order of the clusters. A record is the id of a descriptor followed by
+ * the descriptor.
+ */
+struct Spill {
+  int file;                                // The temporary file holding the runs.
+  std::uint64_t size;                      // Bytes written to the file.
+  std::vector<std::uint64_t> run_offsets;  // Offset of each run in the file.
+  std::vector<std::vector<char>> buckets;  // Records of each cluster since the last run.
+  std::size_t buffered;                    // Bytes held by the buckets.
+};
+
+/**
+ * @brief spill_run writes the buckets to the end of the spill file as a run and releases them.
+ * @param spill is the spill.
+ */
+void spill_run(Spill& spill)
+{
+  const std::size_t record_size = sizeof(std::uint64_t) + globals::descriptor_size_in_bytes();
+  std::vector<char> run;
+  run.reserve(spill.buffered + 2 * sizeof(std::uint64_t) * spill.buckets.size());
+
+  auto append = [&run](const void* bytes, std::size_t n) {
+    run.insert(run.end(), static_cast<const char*>(bytes), static_cast<const char*>(bytes) + n);
+  };
+
+  for (std::uint64_t cluster = 0; cluster < spill.buckets.size(); ++cluster) {
+    auto& bucket = spill.buckets[cluster];
+    if (bucket.empty()) {
+      continue;
+    }
+
+    const std::uint64_t count = bucket.size() / record_size;
+    append(&cluster, sizeof(cluster));
+    append(&count, sizeof(count));
+    append(bucket.data(), bucket.size());
+    std::vector<char>().swap(bucket);  // Release the memory of the bucket.
+  }
+
+  const char* bytes = run.data();
+  std::size_t n = run.size();
+  while (n > 0) {
+    const ssize_t written = ::write(spill.file, bytes, n);
+    if (written < 0) {
+      throw std::runtime_error("pre_processing: Could not spill the clusters to disk.");
+    }
+    bytes += written;
+    n -= written;
+  }
+
+  spill.run_offsets.emplace_back(spill.size);
+  spill.size += run.size();
+  spill.buffered = 0;
+}
+
+/**
+ * @brief The RunReader struct reads a run of the spill file sequentially through a buffer.
+ */
+struct RunReader {
+  int file;
+  std::uint64_t position;  // Offset of the next byte to read into the buffer.
+  std::uint64_t end;       // Offset of the end of the run.
+  std::vector<char> buffer;
+  std::size_t begin;       // First unread byte of the buffer.
+  std::uint64_t cluster;   // Number of the next cluster of the run, NO_CLUSTER at its end.
+  std::uint64_t count;     // Number of records of the next cluster.
+
+  /**
+   * @brief read consumes the next n bytes of the run.
+   */
+  void read(void* destination, std::size_t n)
+  {
+    auto* bytes = static_cast<char*>(destination);
+    while (n > 0) {
+      if (begin == buffer.size()) {
+        buffer.resize(std::min<std::uint64_t>(RUN_BUFFER_SIZE, end - position));
+        std::size_t filled{0};
+        while (filled < buffer.size()) {
+          const ssize_t bytes_read = ::pread(file, buffer.data() + filled, buffer.size() - filled,
+                                             position + filled);
+          if (bytes_read <= 0) {
+            throw std::runtime_error("pre_processing: Could not read the spilled clusters.");
+          }
+          filled += bytes_read;
+        }
+        position += buffer.size();
+        begin = 0;
+      }
+
+      const std::size_t available = std::min(n, buffer.size() - begin);
+      std::memcpy(bytes, buffer.data() + begin, available);
+      begin += available;
+      bytes += available;
+      n -= available;
+    }
+  }
+
+  /**
+   * @brief advance reads the number and record count of the next cluster of the run.
+   */
+  void advance()
+  {
+    if (position == end && begin == buffer.size()) {
+      cluster = NO_CLUSTER;
+      return;
+    }
+    read(&cluster, sizeof(cluster));
+    read(&count, sizeof(count));
+  }
+};
+
+/**
+ * @brief place_records copies records of a cluster into its block, where the ids precede the descriptors.
+ * @param records are the records.
+ * @param count is the number of records.
+ * @param block is the block of the cluster.
+ * @param point_count is the number of points of the cluster.
+ * @param placed is the number of points already placed in the block, which is advanced by count.
+ */
+void place_records(const char* records, std::uint64_t count, char* block, std::uint64_t point_count,
+                   std::uint64_t& placed)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  char* descriptors = block + point_count * sizeof(std::uint64_t);
+
+  for (std::uint64_t i = 0; i < count; ++i, ++placed, records += sizeof(std::uint64_t) + bytes) {
+    std::memcpy(block + placed * sizeof(std::uint64_t), records, sizeof(std::uint64_t));
+    std::memcpy(descriptors + placed * bytes, records + sizeof(std::uint64_t), bytes);
+  }
+}
+
+/**
+ * @brief number_clusters numbers the clusters below the root breadth-first, which is the order of the
+ * clusters in the disk format.
+ * @param root is the root of the index.
+ * @return the number of each cluster.
+ */
+std::unordered_map<const Node*, std::uint64_t> number_clusters(const Node& root)
+{
+  std::unordered_map<const Node*, std::uint64_t> clusters;
+  std::vector<const Node*> nodes{&root};
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    for (const auto& child : nodes[i]->children) {
+      nodes.emplace_back(&child);
+    }
+    if (nodes[i]->children.empty()) {
+      clusters.emplace(nodes[i], clusters.size());
+    }
+  }
+  return clusters;
+}
+
+}  // namespace pre_processing_helpers
+
+namespace pre_processing {
+
+Index* create_index(const std::vector<std::vector<float>>& dataset, unsigned cluster_size, float lo, float hi,
+                    ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+{
+  auto row = [&dataset](std::size_t i) { return dataset[i].data(); };
+  return pre_processing_helpers::build_index(row, dataset.size(), cluster_size, lo, hi, cluster_policy,
+                                             node_policy);
+}
+
+Index* create_index(const std::vector<std::vector<std::uint8_t>>& dataset, unsigned cluster_size, float lo,
+                    float hi, ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+{
+  auto row = [&dataset](std::size_t i) { return reinterpret_cast<const float*>(dataset[i].data()); };
+  return pre_processing_helpers::build_index(row, dataset.size(), cluster_size, lo, hi, cluster_policy,
+                                             node_policy);
+}
+
+Index* create_index(const std::vector<std::vector<std::int8_t>>& dataset, unsigned cluster_size, float lo,
+                    float hi, ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+{
+  auto row = [&dataset](std::size_t i) { return reinterpret_cast<const float*>(dataset[i].data()); };
+  return pre_processing_helpers::build_index(row, dataset.size(), cluster_size, lo, hi, cluster_policy,
+                                             node_policy);
+}
+
+Index* create_index(const float* dataset, std::size_t dataset_size, std::size_t dimensions,
+                    std::size_t stride, unsigned cluster_size, float lo, float hi,
+                    ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+{
+  if (dimensions != globals::g_vector_dimensions || stride < dimensions) {
+    throw std::invalid_argument("pre_processing: The descriptors must be of the global dimensionality and "
+                                "the stride at least the dimensionality.");
+  }
+
+  auto row = [dataset, stride](std::size_t i) { return dataset + i * stride; };
+  return pre_processing_helpers::build_index(row, dataset_size, cluster_size, lo, hi, cluster_policy,
+                                             node_policy);
+}
+
+Index* create_index(const char* dataset, std::size_t dataset_size, std::size_t stride, unsigned cluster_size,
+                    float lo, float hi, ReclusteringPolicy cluster_policy, ReclusteringPolicy node_policy)
+{
+  auto row = [dataset, stride](std::size_t i) {
+    return reinterpret_cast<const float*>(dataset + i * stride);
+  };
+  return pre_processing_helpers::build_index(row, dataset_size, cluster_size, lo, hi, cluster_policy,
+                                             node_policy);
+}
+
+void create_disk_index(const DescriptorReader& read, std::size_t dataset_size, unsigned cluster_size,
+                       std::size_t memory_budget, const std::string& path, float lo, float hi)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const std::size_t record_size = sizeof(std::uint64_t) + bytes;
+
+  const auto index_params =
+      pre_processing_helpers::calculate_initial_index_params(dataset_size, cluster_size, lo, hi);
+  const auto random_leader_indexes = pre_processing_helpers::generate_leaders_indexes(
+      dataset_size, index_params.level_sizes, index_params.L);
+
+  // First pass: read the leaders of the clusters in increasing order and build the levels from them.
+  auto leader_ids = random_leader_indexes.front();
+  std::sort(leader_ids.begin(), leader_ids.end());
+
+  std::vector<float> leaders((leader_ids.size() * bytes + sizeof(float) - 1) / sizeof(float));
+  std::unordered_map<unsigned, std::size_t> leader_positions;
+  for (std::size_t i = 0; i < leader_ids.size(); ++i) {
+    read(leader_ids[i], 1, reinterpret_cast<char*>(leaders.data()) + i * bytes);
+    leader_positions.emplace(leader_ids[i], i);
+  }
+
+  auto row = [&leaders, &leader_positions, bytes](std::size_t id) {
+    return reinterpret_cast<const float*>(reinterpret_cast<const char*>(leaders.data()) +
+                                          leader_positions.at(id) * bytes);
+  };
+  const unsigned thread_count = pre_processing_helpers::build_thread_count(dataset_size);
+  auto top_level = pre_processing_helpers::build_levels(row, random_leader_indexes, 0, thread_count);
+  auto root = pre_processing_helpers::build_root(top_level);
+  leader_positions.clear();
+  std::vector<float>().swap(leaders);  // The nodes hold copies of the leaders.
+
+  // The leader of each cluster is its first point.
+  const auto clusters = pre_processing_helpers::number_clusters(root);
+  std::vector<std::uint64_t> point_counts(clusters.size(), 0);
+
+  const auto spill_path = path + ".spill";
+  pre_processing_helpers::Spill spill{::open(spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600), 0, {},
+                                      std::vector<std::vector<char>>(clusters.size()), 0};
+  if (spill.file < 0) {
+    throw std::runtime_error("pre_processing: Could not create the spill file " + spill_path + ".");
+  }
+
+  auto append = [&spill, &point_counts, bytes](std::uint64_t cluster, std::uint64_t id,
+                                               const char* descriptor) {
+    auto& bucket = spill.buckets[cluster];
+    const auto* id_bytes = reinterpret_cast<const char*>(&id);
+    bucket.insert(bucket.end(), id_bytes, id_bytes + sizeof(id));
+    bucket.insert(bucket.end(), descriptor, descriptor + bytes);
+    spill.buffered += sizeof(id) + bytes;
+    ++point_counts[cluster];
+  };
+
+  try {
+    for (const auto& cluster : clusters) {
+      const auto& leader = cluster.first->points.front();
+      append(cluster.second, leader.id, reinterpret_cast<const char*>(leader.descriptor));
+    }
+
+    // Second pass: append every other descriptor to the bucket of its nearest cluster a chunk at a time.
+    const std::size_t chunk_size =
+        std::max<std::size_t>(1, pre_processing_helpers::STREAM_CHUNK_SIZE / bytes);
+    std::vector<float> chunk((chunk_size * bytes + sizeof(float) - 1) / sizeof(float));
+    std::vector<const Node*> nearest(chunk_size);
+    auto next_leader = leader_ids.begin();
+
+    for (std::size_t begin = 0; begin < dataset_size; begin += chunk_size) {
+      const std::size_t count = std::min(chunk_size, dataset_size - begin);
+      read(begin, count, reinterpret_cast<char*>(chunk.data()));
+
+      // The clusters of the chunk are found in parallel and the descriptors appended in order of id.
+      auto find_nearest = [&chunk, &nearest, &root, bytes](unsigned, std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; ++i) {
+          const auto* descriptor =
+              reinterpret_cast<const float*>(reinterpret_cast<const char*>(chunk.data()) + i * bytes);
+          nearest[i] = traversal::find_nearest_leaf(descriptor, root.children);
+        }
+      };
+      pre_processing_helpers::parallel_chunks(count, thread_count, find_nearest);
+
+      for (std::size_t i = 0; i < count; ++i) {
+        const std::uint64_t id = begin + i;
+        if (next_leader != leader_ids.end() && *next_leader == id) {
+          ++next_leader;
+          continue;
+        }
+
+        const char* descriptor = reinterpret_cast<const char*>(chunk.data()) + i * bytes;
+        append(clusters.at(nearest[i]), id, descriptor);
+
+        if (spill.buffered > memory_budget) {
+          pre_processing_helpers::spill_run(spill);
+        }
+      }
+    }
+
+    // Merge the runs and the buckets not spilled cluster by cluster into the blocks of the file.
+    std::vector<pre_processing_helpers::RunReader> runs;
+    for (std::size_t i = 0; i < spill.run_offsets.size(); ++i) {
+      const std::uint64_t end = (i + 1 < spill.run_offsets.size()) ? spill.run_offsets[i + 1] : spill.size;
+      runs.emplace_back(
+          pre_processing_helpers::RunReader{spill.file, spill.run_offsets[i], end, {}, 0, 0, 0});
+      runs.back().advance();
+    }
+
+    const Index routing{index_params.L, dataset_size, std::move(root),
+                        ReclusteringScheme{index_params.lo_bound, index_params.hi_bound,
+                                           ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE}};
+    std::vector<char> records;
+
+    serialization::save_on_disk(&routing, point_counts, [&](std::size_t cluster, char* block) {
+      std::uint64_t placed{0};
+      for (auto& run : runs) {
+        if (run.cluster != cluster) {
+          continue;
+        }
+        records.resize(run.count * record_size);
+        run.read(records.data(), records.size());
+        pre_processing_helpers::place_records(records.data(), run.count, block, point_counts[cluster],
+                                              placed);
+        run.advance();
+      }
+
+      auto& bucket = spill.buckets[cluster];
+      pre_processing_helpers::place_records(bucket.data(), bucket.size() / record_size, block,
+                                            point_counts[cluster], placed);
+      std::vector<char>().swap(bucket);
+    }, path);
+  }
+  catch (...) {
+    ::close(spill.file);
+    std::remove(spill_path.c_str());
+    throw;
+  }
+
+  ::close(spill.file);
+  std::remove(spill_path.c_str());
 }
 
 }  // namespace pre_processing
@@ -1,7 +1,11 @@
 #ifndef PRE_PROCESSING_H
 #define PRE_PROCESSING_H
 
+#include <cstddef>
+#include <cstdint>
 #include <eCP/index/shared/data_structure.hpp>
+#include <functional>
+#include <string>
 #include <vector>
 
 /*
@@ -9,6 +13,12 @@
  */
 namespace pre_processing {
 
+/**
+ * @brief DescriptorReader reads count consecutive descriptors of a dataset starting at position begin into
+ * destination in the global descriptor type, e.g. from a mapped file.
+ */
+typedef std::function<void(std::size_t begin, std::size_t count, char* destination)> DescriptorReader;
+
 /**
  */
 
@@ -34,6 +44,69 @@ Index* create_index(const std::vector<std::vector<float>>& dataset, unsigned clu
                     float hi = 0.0, ReclusteringPolicy cluster_policy = ReclusteringPolicy::AVERAGE,
                     ReclusteringPolicy node_policy = ReclusteringPolicy::AVERAGE);
 
+/**
+ * @brief create_index creates the index from a dataset of UINT8 descriptors. See above for the parameters.
+ * NB: Assumes that g_descriptor_type is set to UINT8.
+ */
+Index* create_index(const std::vector<std::vector<std::uint8_t>>& dataset, unsigned cluster_size,
+                    float lo = 0.0, float hi = 0.0,
+                    ReclusteringPolicy cluster_policy = ReclusteringPolicy::AVERAGE,
+                    ReclusteringPolicy node_policy = ReclusteringPolicy::AVERAGE);
+
+/**
+ * @brief create_index creates the index from a dataset of INT8 descriptors. See above for the parameters.
+ * NB: Assumes that g_descriptor_type is set to INT8.
+ */
+Index* create_index(const std::vector<std::vector<std::int8_t>>& dataset, unsigned cluster_size,
+                    float lo = 0.0, float hi = 0.0,
+                    ReclusteringPolicy cluster_policy = ReclusteringPolicy::AVERAGE,
+                    ReclusteringPolicy node_policy = ReclusteringPolicy::AVERAGE);
+
+/**
+ * @brief create_index creates the index from a matrix of FLOAT32 descriptors, e.g. a numpy array, a mapped
+ * file or a loaded HDF5 dataset, without copying it into vectors first. See above for the other parameters.
+ * Throws std::invalid_argument if dimensions is not g_vector_dimensions or stride is less than dimensions.
+ * @param dataset points to the first of dataset_size descriptors.
+ * @param dataset_size is the number of descriptors.
+ * @param dimensions is the number of floats of every descriptor.
+ * @param stride is the number of floats from a descriptor to the next, dimensions if they are consecutive.
+ */
+Index* create_index(const float* dataset, std::size_t dataset_size, std::size_t dimensions,
+                    std::size_t stride, unsigned cluster_size, float lo = 0.0, float hi = 0.0,
+                    ReclusteringPolicy cluster_policy = ReclusteringPolicy::AVERAGE,
+                    ReclusteringPolicy node_policy = ReclusteringPolicy::AVERAGE);
+
+/**
+ * @brief create_index creates the index from descriptors in the global descriptor type stored stride bytes
+ * apart, e.g. the rows of a mapped .fvecs or .bvecs file, without copying them. See above for the parameters.
+ * @param dataset points to the first of dataset_size descriptors.
+ * @param dataset_size is the number of descriptors.
+ * @param stride is the number of bytes from a descriptor to the next.
+ */
+Index* create_index(const char* dataset, std::size_t dataset_size, std::size_t stride, unsigned cluster_size,
+                    float lo = 0.0, float hi = 0.0,
+                    ReclusteringPolicy cluster_policy = ReclusteringPolicy::AVERAGE,
+                    ReclusteringPolicy node_policy = ReclusteringPolicy::AVERAGE);
+
+/**
+ * @brief create_disk_index builds the index of a dataset larger than memory and writes it in the format of a
+ * DiskIndex. A first pass over the dataset reads the randomly picked leaders, from which the levels are built
+ * in memory like create_index. A second pass streams the dataset, appending each descriptor to the bucket of
+ * its nearest cluster. Whenever the buckets exceed the memory budget they are spilled to a temporary file
+ * next to the path as a run ordered by cluster, and finally the runs are merged cluster by cluster into the
+ * blocks of the file. Thus only the nodes, the leaders and the buckets are held in memory.
+ * NB: Assumes that g_descriptor_type, g_vector_dimensions and the distance function are set.
+ * @param read reads the descriptors of the dataset. Each pass reads them in increasing order.
+ * @param dataset_size is the number of descriptors.
+ * @param cluster_size is the size of each cluster, see create_index.
+ * @param memory_budget is the number of bytes the buckets may hold before they are spilled.
+ * @param path is the path of the file, which is replaced as a whole.
+ * @param lo see create_index.
+ * @param hi see create_index.
+ */
+void create_disk_index(const DescriptorReader& read, std::size_t dataset_size, unsigned cluster_size,
+                       std::size_t memory_budget, const std::string& path, float lo = 0.0, float hi = 0.0);
+
 }  // namespace pre_processing
 
 #endif  // PRE_PROCESSING_H
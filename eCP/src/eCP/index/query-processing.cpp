@@ -1,8 +1,10 @@
 #include <algorithm>
 #include <cassert>
+#include <eCP/index/cluster-reader.hpp>
 #include <eCP/index/pre-processing.hpp>
 #include <eCP/index/query-processing.hpp>
 #include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/quantization.hpp>
 
 /*
  * Traverse the index to find the nearest leaf at the bottom level.
@@ -13,22 +15,124 @@ std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(std::vector<Node
                                                                 const unsigned int k,
                                                                 const unsigned int b = 1, unsigned int L = 1)
 {
-  // find b nearest clusters
-  std::vector<Node*> b_nearest_clusters{find_b_nearest_clusters(root, query, b, L)};
+  return k_nearest_neighbors(root, query, k, b, L, 0, nullptr);
+}
 
-  // go trough b clusters to obtain k nearest neighbors
-  std::vector<std::pair<unsigned int, float>> k_nearest_points;
-  k_nearest_points.reserve(k);
+/*
+ * Scans the b nearest clusters found by either kind of index tree, and the delta buffer, for the k nearest
+ * neighbors, in two stages if compression is enabled.
+ */
+static std::vector<std::pair<unsigned int, float>> search_clusters(
+    const std::vector<Node*>& b_nearest_clusters, float*& query, const unsigned int k,
+    const unsigned int rerank_factor, const std::vector<bool>* tombstones, const DeltaBuffer* delta)
+{
+  if (!quantization::is_enabled() || rerank_factor == 0) {
+    // go trough b clusters to obtain k nearest neighbors
+    std::vector<std::pair<unsigned int, float>> k_nearest_points;
+    k_nearest_points.reserve(k);
+    for (Node* cluster : b_nearest_clusters) {
+      scan_leaf_node(query, cluster->points, k, k_nearest_points, tombstones);
+    }
+    if (delta) {
+      scan_delta_buffer(query, *delta, k, k_nearest_points, tombstones);
+    }
+
+    // sort by distance - O(N * log(N)) where N = smallest_distance(a,b) comparisons
+    sort(k_nearest_points.begin(), k_nearest_points.end(), smallest_distance);
+
+    return k_nearest_points;
+  }
+
+  // gather k * r candidates from the compressed codes
+  const unsigned int n = k * rerank_factor;
+  const auto code_query = distance::prepare_code_query(query);
+  std::vector<std::pair<float, Point*>> candidates;
+  candidates.reserve(n);
   for (Node* cluster : b_nearest_clusters) {
-    scan_leaf_node(query, cluster->points, k, k_nearest_points);
+    scan_leaf_node_compressed(query, code_query, *cluster, n, candidates, tombstones);
   }
 
-  // sort by distance - O(N * log(N)) where N = smallest_distance(a,b) comparisons
-  sort(k_nearest_points.begin(), k_nearest_points.end(), smallest_distance);
+  auto k_nearest_points = rerank_candidates(query, candidates, k);
+
+  // buffered descriptors are not compressed, merge them into the re-ranked points
+  if (delta) {
+    scan_delta_buffer(query, *delta, k, k_nearest_points, tombstones);
+    sort(k_nearest_points.begin(), k_nearest_points.end(), smallest_distance);
+  }
 
   return k_nearest_points;
 }
 
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(std::vector<Node>& root, float*& query,
+                                                                const unsigned int k, const unsigned int b,
+                                                                unsigned int L,
+                                                                const unsigned int rerank_factor,
+                                                                const std::vector<bool>* tombstones,
+                                                                const DeltaBuffer* delta)
+{
+  return search_clusters(find_b_nearest_clusters(root, query, b, L), query, k, rerank_factor, tombstones,
+                         delta);
+}
+
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(const VersionNode& root, float*& query,
+                                                                const unsigned int k, const unsigned int b,
+                                                                unsigned int L,
+                                                                const unsigned int rerank_factor,
+                                                                const std::vector<bool>* tombstones,
+                                                                const DeltaBuffer* delta)
+{
+  return search_clusters(find_b_nearest_clusters(root, query, b, L), query, k, rerank_factor, tombstones,
+                         delta);
+}
+
+/*
+ * Traverses the children of the copied nodes one level at a time to find the b nearest, as scan_node does.
+ */
+std::vector<Node*> find_b_nearest_clusters(const VersionNode& root, float*& query, unsigned int b,
+                                           unsigned int L)
+{
+  std::vector<const VersionNode*> b_best{&root};
+
+  for (; L > 0; --L) {
+    std::vector<const VersionNode*> new_best_nodes;
+    std::vector<Node*> new_best_copies;  // The copies of new_best_nodes, whose leaders are compared.
+    new_best_nodes.reserve(b);
+    new_best_copies.reserve(b);
+
+    for (const VersionNode* node : b_best) {
+      std::pair<int, float> furthest_node = std::make_pair(-1, -1.0);
+      if (new_best_copies.size() >= b) {
+        furthest_node = find_furthest_node(query, new_best_copies);
+      }
+
+      for (const auto& child : node->children) {
+        if (new_best_copies.size() < b) {
+          new_best_nodes.emplace_back(child.get());
+          new_best_copies.emplace_back(child->node.get());
+          if (new_best_copies.size() == b) {
+            furthest_node = find_furthest_node(query, new_best_copies);
+          }
+        }
+        else if (distance::g_distance_function(query, child->node->points[0].descriptor,
+                                               furthest_node.second) <= furthest_node.second) {
+          new_best_nodes[furthest_node.first] = child.get();
+          new_best_copies[furthest_node.first] = child->node.get();
+          furthest_node = find_furthest_node(query, new_best_copies);
+        }
+      }
+    }
+
+    b_best = new_best_nodes;
+  }
+
+  std::vector<Node*> clusters;
+  clusters.reserve(b_best.size());
+  for (const VersionNode* node : b_best) {
+    clusters.emplace_back(node->node.get());
+  }
+  return clusters;
+}
+
 /*
  * Traverses node children one level at a time to find b nearest
  */
@@ -112,11 +216,20 @@ std::pair<int, float> find_furthest_node(float*& query, std::vector<Node*>& node
   return worst;
 }
 
+/*
+ * Erased points stay in their cluster until compaction and must not be part of any result.
+ */
+static inline bool is_tombstoned(const Point& point, const std::vector<bool>* tombstones)
+{
+  return tombstones && point.id < tombstones->size() && (*tombstones)[point.id];
+}
+
 /*
  * Compares query point to each point in cluster and accumulates the k nearest points in 'nearest_points'.
  */
 void scan_leaf_node(float*& query, std::vector<Point>& points, const unsigned int k,
-                    std::vector<std::pair<unsigned int, float>>& nearest_points)
+                    std::vector<std::pair<unsigned int, float>>& nearest_points,
+                    const std::vector<bool>* tombstones)
 {
   float max_distance = globals::FLOAT_MAX;
 
@@ -126,6 +239,10 @@ void scan_leaf_node(float*& query, std::vector<Point>& points, const unsigned in
   }
 
   for (Point& point : points) {
+    if (is_tombstoned(point, tombstones)) {
+      continue;
+    }
+
     // not enough points yet, just add
     if (nearest_points.size() < k) {
       float dist = distance::g_distance_function(query, point.descriptor, globals::FLOAT_MAX);
@@ -150,6 +267,314 @@ void scan_leaf_node(float*& query, std::vector<Point>& points, const unsigned in
   }
 }
 
+/*
+ * Compares query point to each buffered descriptor and accumulates the k nearest points in 'nearest_points'.
+ */
+void scan_delta_buffer(float*& query, const DeltaBuffer& delta, const unsigned int k,
+                       std::vector<std::pair<unsigned int, float>>& nearest_points,
+                       const std::vector<bool>* tombstones)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  float max_distance = globals::FLOAT_MAX;
+
+  if (nearest_points.size() >= k) {
+    max_distance = nearest_points[index_to_max_element(nearest_points)].second;
+  }
+
+  for (std::size_t i = 0; i < delta.ids.size(); ++i) {
+    const unsigned long id = delta.ids[i];
+    if (tombstones && id < tombstones->size() && (*tombstones)[id]) {
+      continue;
+    }
+
+    const auto* descriptor = reinterpret_cast<const float*>(delta.storage.data() + i * bytes);
+    const float dist = distance::g_distance_function(query, descriptor, max_distance);
+
+    if (nearest_points.size() < k) {
+      nearest_points.emplace_back(id, dist);
+      if (nearest_points.size() == k) {
+        max_distance = nearest_points[index_to_max_element(nearest_points)].second;
+      }
+    }
+    else if (dist < max_distance) {
+      nearest_points[index_to_max_element(nearest_points)] = std::make_pair(id, dist);
+      max_distance = nearest_points[index_to_max_element(nearest_points)].second;
+    }
+  }
+}
+
+/*
+ * Keeps the n nearest candidates as a max-heap on distance such that the furthest candidate is at the front.
+ */
+void scan_leaf_node_compressed(float*& query, const distance::CodeQuery& code_query, Node& cluster,
+                               const unsigned int n, std::vector<std::pair<float, Point*>>& candidates,
+                               const std::vector<bool>* tombstones)
+{
+  const unsigned int dimensions = globals::g_vector_dimensions;
+  const bool compressed = cluster.codes.size() == cluster.points.size() * dimensions;
+  float max_distance = candidates.size() < n ? globals::FLOAT_MAX : candidates.front().first;
+
+  for (std::size_t i = 0; i < cluster.points.size(); ++i) {
+    Point& point = cluster.points[i];
+    if (is_tombstoned(point, tombstones)) {
+      continue;
+    }
+
+    const float dist =
+        compressed ? distance::g_code_distance_function(code_query, cluster.codes.data() + i * dimensions,
+                                                        max_distance)
+                   : distance::g_distance_function(query, point.descriptor, max_distance);
+
+    if (candidates.size() < n) {
+      candidates.emplace_back(dist, &point);
+      std::push_heap(candidates.begin(), candidates.end());
+    }
+    else if (dist < max_distance) {
+      std::pop_heap(candidates.begin(), candidates.end());
+      candidates.back() = std::make_pair(dist, &point);
+      std::push_heap(candidates.begin(), candidates.end());
+    }
+    else {
+      continue;
+    }
+
+    if (candidates.size() == n) {
+      max_distance = candidates.front().first;
+    }
+  }
+}
+
+/*
+ * Computes the exact distance for each candidate and keeps the k nearest.
+ */
+std::vector<std::pair<unsigned int, float>> rerank_candidates(
+    float*& query, std::vector<std::pair<float, Point*>>& candidates, const unsigned int k)
+{
+  std::vector<std::pair<unsigned int, float>> k_nearest_points;
+  k_nearest_points.reserve(candidates.size());
+
+  for (auto& candidate : candidates) {
+    Point* point = candidate.second;
+    const float dist = distance::g_distance_function(query, point->descriptor, globals::FLOAT_MAX);
+    k_nearest_points.emplace_back(point->id, dist);
+  }
+
+  const auto keep = std::min<std::size_t>(k, k_nearest_points.size());
+  std::partial_sort(k_nearest_points.begin(), k_nearest_points.begin() + keep, k_nearest_points.end(),
+                    smallest_distance);
+  k_nearest_points.resize(keep);
+
+  return k_nearest_points;
+}
+
+/*
+ * Searches a mapped index like k_nearest_neighbors searches the index it was saved from. The buffered points
+ * at the end of the points are scanned exhaustively.
+ */
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(const MappedIndex& index, float*& query,
+                                                                const unsigned int k, const unsigned int b,
+                                                                const unsigned int rerank_factor)
+{
+  const auto b_nearest_clusters = find_b_nearest_clusters(index, query, b);
+  const std::uint64_t first_buffered = index.point_count - index.buffered_count;
+
+  if (!index.codes || !quantization::is_enabled() || rerank_factor == 0) {
+    std::vector<std::pair<unsigned int, float>> k_nearest_points;
+    k_nearest_points.reserve(k);
+    for (const MappedNode* cluster : b_nearest_clusters) {
+      scan_mapped_points(query, index, cluster->first_point, cluster->point_count, k, k_nearest_points);
+    }
+    scan_mapped_points(query, index, first_buffered, index.buffered_count, k, k_nearest_points);
+
+    sort(k_nearest_points.begin(), k_nearest_points.end(), smallest_distance);
+    return k_nearest_points;
+  }
+
+  // gather k * r candidates from the compressed codes and re-rank them
+  const unsigned int n = k * rerank_factor;
+  const auto code_query = distance::prepare_code_query(query);
+  std::vector<std::pair<float, std::uint64_t>> candidates;
+  candidates.reserve(n);
+  for (const MappedNode* cluster : b_nearest_clusters) {
+    scan_mapped_points_compressed(code_query, index, cluster->first_point, cluster->point_count, n,
+                                  candidates);
+  }
+
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  std::vector<std::pair<unsigned int, float>> k_nearest_points;
+  k_nearest_points.reserve(candidates.size());
+  for (const auto& candidate : candidates) {
+    const auto* descriptor = reinterpret_cast<const float*>(index.descriptors + candidate.second * bytes);
+    k_nearest_points.emplace_back(index.ids[candidate.second],
+                                  distance::g_distance_function(query, descriptor, globals::FLOAT_MAX));
+  }
+
+  const auto keep = std::min<std::size_t>(k, k_nearest_points.size());
+  std::partial_sort(k_nearest_points.begin(), k_nearest_points.begin() + keep, k_nearest_points.end(),
+                    smallest_distance);
+  k_nearest_points.resize(keep);
+
+  // buffered points are not compressed, merge them into the re-ranked points
+  if (index.buffered_count > 0) {
+    scan_mapped_points(query, index, first_buffered, index.buffered_count, k, k_nearest_points);
+    sort(k_nearest_points.begin(), k_nearest_points.end(), smallest_distance);
+  }
+
+  return k_nearest_points;
+}
+
+/*
+ * Routes the query through the nodes held in memory, then scans each block as a mapped index holding only the
+ * points of the block.
+ */
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(DiskIndex& index, float*& query,
+                                                                const unsigned int k, const unsigned int b)
+{
+  const auto b_nearest_clusters = find_b_nearest_clusters(index.routing, query, b);
+  std::vector<std::pair<unsigned int, float>> k_nearest_points;
+  k_nearest_points.reserve(k);
+
+  auto scan_block = [&query, k, &k_nearest_points](const char* block, std::uint64_t point_count) {
+    MappedIndex points{};
+    points.ids = reinterpret_cast<const std::uint64_t*>(block);
+    points.descriptors = block + point_count * sizeof(std::uint64_t);
+    scan_mapped_points(query, points, 0, point_count, k, k_nearest_points);
+  };
+
+  cluster_reader::fetch_clusters(index, b_nearest_clusters, scan_block);
+  scan_block(index.buffered.data(), index.buffered_count);
+
+  sort(k_nearest_points.begin(), k_nearest_points.end(), smallest_distance);
+  return k_nearest_points;
+}
+
+/*
+ * Traverses the levels of a mapped index one at a time to find the b nearest clusters.
+ */
+std::vector<const MappedNode*> find_b_nearest_clusters(const MappedIndex& index, float*& query,
+                                                       unsigned int b)
+{
+  const MappedNode& root = index.nodes[0];
+  std::vector<std::pair<const MappedNode*, float>> b_best;
+  b_best.reserve(b);
+  scan_mapped_nodes(query, index, root.first_child, root.child_count, b, b_best);
+
+  for (unsigned int level = 1; level < index.L; ++level) {
+    std::vector<std::pair<const MappedNode*, float>> new_best_nodes;
+    new_best_nodes.reserve(b);
+    for (const auto& node : b_best) {
+      scan_mapped_nodes(query, index, node.first->first_child, node.first->child_count, b, new_best_nodes);
+    }
+    b_best.swap(new_best_nodes);
+  }
+
+  std::vector<const MappedNode*> clusters;
+  clusters.reserve(b_best.size());
+  for (const auto& node : b_best) {
+    clusters.emplace_back(node.first);
+  }
+  return clusters;
+}
+
+/*
+ * Compares the leaders of consecutive mapped nodes to the query like scan_node, keeping the distance of each
+ * accumulated node such that the furthest is found without computing its distance again.
+ */
+void scan_mapped_nodes(float*& query, const MappedIndex& index, const std::uint64_t first,
+                       const std::uint64_t count, const unsigned int b,
+                       std::vector<std::pair<const MappedNode*, float>>& nodes_accumulated)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  auto furthest = [&nodes_accumulated] {
+    return std::max_element(
+        nodes_accumulated.begin(), nodes_accumulated.end(),
+        [](const std::pair<const MappedNode*, float>& a, const std::pair<const MappedNode*, float>& b) {
+          return a.second < b.second;
+        });
+  };
+
+  for (std::uint64_t i = first; i < first + count; ++i) {
+    const auto* leader = reinterpret_cast<const float*>(index.leaders + i * bytes);
+
+    if (nodes_accumulated.size() < b) {
+      nodes_accumulated.emplace_back(&index.nodes[i],
+                                     distance::g_distance_function(query, leader, globals::FLOAT_MAX));
+      continue;
+    }
+
+    // only replace if better
+    const auto furthest_node = furthest();
+    const float dist = distance::g_distance_function(query, leader, furthest_node->second);
+    if (dist <= furthest_node->second) {
+      *furthest_node = std::make_pair(&index.nodes[i], dist);
+    }
+  }
+}
+
+/*
+ * Compares query point to consecutive mapped points and accumulates the k nearest points in 'nearest_points'.
+ */
+void scan_mapped_points(float*& query, const MappedIndex& index, const std::uint64_t first,
+                        const std::uint64_t count, const unsigned int k,
+                        std::vector<std::pair<unsigned int, float>>& nearest_points)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  float max_distance = globals::FLOAT_MAX;
+
+  if (nearest_points.size() >= k) {
+    max_distance = nearest_points[index_to_max_element(nearest_points)].second;
+  }
+
+  for (std::uint64_t i = first; i < first + count; ++i) {
+    const auto* descriptor = reinterpret_cast<const float*>(index.descriptors + i * bytes);
+    const float dist = distance::g_distance_function(query, descriptor, max_distance);
+
+    if (nearest_points.size() < k) {
+      nearest_points.emplace_back(index.ids[i], dist);
+      if (nearest_points.size() == k) {
+        max_distance = nearest_points[index_to_max_element(nearest_points)].second;
+      }
+    }
+    else if (dist < max_distance) {
+      nearest_points[index_to_max_element(nearest_points)] = std::make_pair(index.ids[i], dist);
+      max_distance = nearest_points[index_to_max_element(nearest_points)].second;
+    }
+  }
+}
+
+/*
+ * Keeps the n nearest candidates as a max-heap on distance such that the furthest candidate is at the front.
+ */
+void scan_mapped_points_compressed(const distance::CodeQuery& code_query, const MappedIndex& index,
+                                   const std::uint64_t first, const std::uint64_t count, const unsigned int n,
+                                   std::vector<std::pair<float, std::uint64_t>>& candidates)
+{
+  const unsigned int dimensions = globals::g_vector_dimensions;
+  float max_distance = candidates.size() < n ? globals::FLOAT_MAX : candidates.front().first;
+
+  for (std::uint64_t i = first; i < first + count; ++i) {
+    const float dist =
+        distance::g_code_distance_function(code_query, index.codes + i * dimensions, max_distance);
+
+    if (candidates.size() < n) {
+      candidates.emplace_back(dist, i);
+      std::push_heap(candidates.begin(), candidates.end());
+    }
+    else if (dist < max_distance) {
+      std::pop_heap(candidates.begin(), candidates.end());
+      candidates.back() = std::make_pair(dist, i);
+      std::push_heap(candidates.begin(), candidates.end());
+    }
+    else {
+      continue;
+    }
+
+    if (candidates.size() == n) {
+      max_distance = candidates.front().first;
+    }
+  }
+}
+
 // Assumes point_pairs contains at least 1 point.
 unsigned index_to_max_element(std::vector<std::pair<unsigned int, float>>& point_pairs)
 {
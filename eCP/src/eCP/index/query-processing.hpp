@@ -2,6 +2,7 @@
 #define QUERY_PROCESSING_H
 
 #include <eCP/index/shared/data_structure.hpp>
+#include <eCP/index/shared/distance.hpp>
 #include <vector>
 
 namespace query_processing {
@@ -18,6 +19,117 @@ std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(std::vector<Node
                                                                 unsigned int k, unsigned int b,
                                                                 unsigned int L);
 
+/**
+ * search the index for k nearest neighbors in two stages. The b nearest clusters are first scanned using the
+ * compressed codes of their points to gather k * rerank_factor candidates, which are then re-ranked against
+ * their full-precision descriptors. Is equal to the exact search when compression is not enabled.
+ * @param root index top level
+ * @param query query point
+ * @param k amount of nearest neighbors to look for
+ * @param b amount of leaves to search
+ * @param L index depth
+ * @param rerank_factor expansion factor r of the candidate set gathered from the compressed scan
+ * @param tombstones erased ids of the index that are skipped, may be nullptr
+ * @param delta buffered descriptors of the index that are scanned exhaustively, may be nullptr
+ * @return vector of (index,distance) pairs sorted by lowest distance
+ */
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(
+    std::vector<Node>& root, float*& query, unsigned int k, unsigned int b, unsigned int L,
+    unsigned int rerank_factor, const std::vector<bool>* tombstones = nullptr,
+    const DeltaBuffer* delta = nullptr);
+
+/**
+ * search a published version of an index for k nearest neighbors, equal to the search of the index when the
+ * version was published
+ * @param root copy of the root of the index
+ * @param query query point
+ * @param k amount of nearest neighbors to look for
+ * @param b amount of leaves to search
+ * @param L index depth
+ * @param rerank_factor expansion factor r of the candidate set gathered from the compressed scan
+ * @param tombstones erased ids of the version that are skipped, may be nullptr
+ * @param delta buffered descriptors of the version that are scanned exhaustively, may be nullptr
+ * @return vector of (index,distance) pairs sorted by lowest distance
+ */
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(
+    const VersionNode& root, float*& query, unsigned int k, unsigned int b, unsigned int L,
+    unsigned int rerank_factor, const std::vector<bool>* tombstones = nullptr,
+    const DeltaBuffer* delta = nullptr);
+
+/**
+ * search a mapped index for k nearest neighbors. Equal to the search of the index the mapping was saved from,
+ * including the two stages if compression is enabled.
+ * @param index mapped index
+ * @param query query point
+ * @param k amount of nearest neighbors to look for
+ * @param b amount of leaves to search
+ * @param rerank_factor expansion factor r of the candidate set gathered from the compressed scan
+ * @return vector of (index,distance) pairs sorted by lowest distance
+ */
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(const MappedIndex& index, float*& query,
+                                                                unsigned int k, unsigned int b,
+                                                                unsigned int rerank_factor);
+
+/**
+ * search a disk index for k nearest neighbors. The b nearest clusters are read from disk or the cache of the
+ * index in parallel and scanned as they arrive, thus the search is equal to the exact search of the index
+ * the file was saved from.
+ * @param index disk index
+ * @param query query point
+ * @param k amount of nearest neighbors to look for
+ * @param b amount of leaves to search
+ * @return vector of (index,distance) pairs sorted by lowest distance
+ */
+std::vector<std::pair<unsigned int, float>> k_nearest_neighbors(DiskIndex& index, float*& query,
+                                                                unsigned int k, unsigned int b);
+
+/**
+ * find the b nearest leaves of a mapped index
+ * @param index mapped index
+ * @param query query point
+ * @param b number of leaf clusters to return
+ * @return b leaf clusters
+ */
+std::vector<const MappedNode*> find_b_nearest_clusters(const MappedIndex& index, float*& query,
+                                                       unsigned int b);
+
+/*
+ * scan the consecutive nodes of a mapped index for b nearest clusters
+ * @param query query point
+ * @param index mapped index
+ * @param first first node to be searched
+ * @param count number of nodes to be searched
+ * @param b number of clusters to obtain
+ * @param nodes_accumulated accumulator for b nearest (node, distance) pairs
+ */
+void scan_mapped_nodes(float*& query, const MappedIndex& index, std::uint64_t first, std::uint64_t count,
+                       unsigned int b, std::vector<std::pair<const MappedNode*, float>>& nodes_accumulated);
+
+/**
+ * find k the nearest (point,distances) to the query point among consecutive points of a mapped index
+ * @param query query point
+ * @param index mapped index
+ * @param first first point to search
+ * @param count number of points to search
+ * @param k amount of nearest points to return
+ * @param nearest_points accumulator of k nearest neighbors
+ */
+void scan_mapped_points(float*& query, const MappedIndex& index, std::uint64_t first, std::uint64_t count,
+                        unsigned int k, std::vector<std::pair<unsigned int, float>>& nearest_points);
+
+/**
+ * find the n nearest points to the query point among consecutive points of a mapped index using their codes
+ * @param code_query query point transformed by prepare_code_query
+ * @param index mapped index with codes
+ * @param first first point to search
+ * @param count number of points to search
+ * @param n amount of candidates to keep
+ * @param candidates max-heap of (distance, point position) pairs accumulating the n nearest candidates
+ */
+void scan_mapped_points_compressed(const distance::CodeQuery& code_query, const MappedIndex& index,
+                                   std::uint64_t first, std::uint64_t count, unsigned int n,
+                                   std::vector<std::pair<float, std::uint64_t>>& candidates);
+
 /**
  * find the index of the pair with the largest distance
  * @param point_pairs vector of tuples of (index,distance)
@@ -36,6 +148,17 @@ unsigned int index_to_max_element(std::vector<std::pair<unsigned int, float>>& p
 std::vector<Node*> find_b_nearest_clusters(std::vector<Node>& root, float*& query, unsigned int b,
                                            unsigned int L);
 
+/**
+ * find the b nearest leaves of a published version of an index
+ * @param root copy of the root of the index
+ * @param query query point
+ * @param b number of leaf clusters to return
+ * @param L index depth
+ * @return the copies of b leaf clusters
+ */
+std::vector<Node*> find_b_nearest_clusters(const VersionNode& root, float*& query, unsigned int b,
+                                           unsigned int L);
+
 /*
  * scan nodes for b nearest clusters
  * @param query query point
@@ -59,9 +182,47 @@ std::pair<int, float> find_furthest_node(float*& query, std::vector<Node*>& node
  * @param points vector of points to search
  * @param k amount of nearest points to return
  * @param nearest_points accumulator of k nearest neighbors
+ * @param tombstones erased ids that are skipped, may be nullptr
  */
 void scan_leaf_node(float*& query, std::vector<Point>& points, unsigned int k,
-                    std::vector<std::pair<unsigned int, float>>& nearest_points);
+                    std::vector<std::pair<unsigned int, float>>& nearest_points,
+                    const std::vector<bool>* tombstones = nullptr);
+
+/**
+ * find k the nearest (point,distances) to the query point among the buffered descriptors
+ * @param query query point
+ * @param delta buffer of descriptors stored consecutively
+ * @param k amount of nearest points to return
+ * @param nearest_points accumulator of k nearest neighbors
+ * @param tombstones erased ids that are skipped, may be nullptr
+ */
+void scan_delta_buffer(float*& query, const DeltaBuffer& delta, unsigned int k,
+                       std::vector<std::pair<unsigned int, float>>& nearest_points,
+                       const std::vector<bool>* tombstones = nullptr);
+
+/**
+ * find the n nearest points of a cluster to the query point using the compressed codes of the cluster. The
+ * points of a cluster without codes are compared using their full-precision descriptors.
+ * @param query query point
+ * @param code_query query point transformed by prepare_code_query
+ * @param cluster cluster to search
+ * @param n amount of candidates to keep
+ * @param candidates max-heap of (distance, point) pairs accumulating the n nearest candidates
+ * @param tombstones erased ids that are skipped, may be nullptr
+ */
+void scan_leaf_node_compressed(float*& query, const distance::CodeQuery& code_query, Node& cluster,
+                               unsigned int n, std::vector<std::pair<float, Point*>>& candidates,
+                               const std::vector<bool>* tombstones = nullptr);
+
+/**
+ * re-rank candidates by their full-precision distance to the query point
+ * @param query query point
+ * @param candidates (distance, point) pairs gathered by the compressed scan
+ * @param k amount of nearest points to return
+ * @return vector of k (index,distance) pairs sorted by lowest distance
+ */
+std::vector<std::pair<unsigned int, float>> rerank_candidates(
+    float*& query, std::vector<std::pair<float, Point*>>& candidates, unsigned int k);
 
 /*
  * comparator for sorting
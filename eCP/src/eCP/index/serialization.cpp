@@ -0,0 +1,1308 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <eCP/index/cluster-reader.hpp>
+#include <eCP/index/maintenance.hpp>
+#include <eCP/index/serialization.hpp>
+#include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/globals.hpp>
+#include <eCP/index/shared/quantization.hpp>
+#include <eCP/index/write-ahead-log.hpp>
+#include <fcntl.h>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Namespace containing testable helpers of the index file format. Compilation unit only.
+ *
+ * All integers are stored in their native representation with fixed widths. The file starts with the magic
+ * bytes and the format version followed by the header fields in the order of write_header. The tree follows
+ * in pre-order, where each node is its number of children and points as 32 and 64 bit integers followed by
+ * the 64 bit id and the descriptor of each point.
+ *
+ * The mapped format starts with a MappedHeader followed by the sections it locates, each aligned to
+ * SECTION_ALIGNMENT bytes.
+ *
+ * A checkpoint starts with its magic bytes and format version followed by the identifier and path of the base
+ * snapshot and a header as written by write_header. The tree follows in pre-order, where each node is tagged
+ * NODE_INLINE and written like write_node writes it, or tagged NODE_IN_BASE and located in the base snapshot
+ * along with the nodes below it.
+ *
+ * The disk format starts with a DiskHeader followed by the nodes, the leaders, the block offsets and the
+ * block of the buffered points, which are read into memory when the index is opened. The block of each
+ * cluster follows aligned to CLUSTER_ALIGNMENT bytes and is read as the cluster is searched.
+ */
+namespace serialization_helpers {
+
+const char MAGIC[8] = {'e', 'C', 'P', 'I', 'N', 'D', 'E', 'X'};
+const std::uint32_t FORMAT_VERSION = 3;  // Version 1 lacks the identifier, version 2 the log sequence.
+const std::size_t BLOCK_SIZE = 1 << 22;  // Bytes read or written at once.
+const char MAPPED_MAGIC[8] = {'e', 'C', 'P', 'M', 'A', 'P', 'P', 'D'};
+const std::uint32_t MAPPED_FORMAT_VERSION = 1;
+const std::size_t SECTION_ALIGNMENT = 64;  // Cache line, such that sections never share a line.
+const char DISK_MAGIC[8] = {'e', 'C', 'P', 'O', 'N', 'D', 'S', 'K'};
+const std::uint32_t DISK_FORMAT_VERSION = 1;
+const std::size_t CLUSTER_ALIGNMENT = 4096;  // Disk page, such that a cluster is read without partial pages.
+const char SHARED_MEMORY_DIRECTORY[] = "/dev/shm/";  // Where POSIX shared memory objects are files.
+const char CHECKPOINT_MAGIC[8] = {'e', 'C', 'P', 'C', 'H', 'K', 'P', 'T'};
+const std::uint32_t CHECKPOINT_FORMAT_VERSION = 1;
+const std::uint8_t NODE_INLINE = 0;   // Checkpointed node followed by its children.
+const std::uint8_t NODE_IN_BASE = 1;  // Offset and size of a subtree unchanged in the base snapshot.
+
+/**
+ * @brief The Writer struct buffers writes to a file into blocks of BLOCK_SIZE bytes.
+ */
+struct Writer {
+  int file;
+  std::vector<char> block;
+  std::uint64_t position;  // Number of bytes written including the buffered bytes.
+
+  /**
+   * @brief write appends n bytes to the file. Writes of whole blocks bypass the buffer.
+   */
+  void write(const void* bytes, std::size_t n)
+  {
+    const auto* begin = static_cast<const char*>(bytes);
+    position += n;
+    if (block.size() + n > BLOCK_SIZE) {
+      flush();
+    }
+
+    if (n >= BLOCK_SIZE) {
+      write_fully(begin, n);
+    }
+    else {
+      block.insert(block.end(), begin, begin + n);
+    }
+  }
+
+  template <typename T>
+  void write_value(const T& value)
+  {
+    write(&value, sizeof(T));
+  }
+
+  /**
+   * @brief pad_to writes zeros up to the given position.
+   */
+  void pad_to(std::uint64_t offset)
+  {
+    const std::vector<char> zeros(offset - position, 0);
+    write(zeros.data(), zeros.size());
+  }
+
+  /**
+   * @brief flush writes the buffered bytes to the file.
+   */
+  void flush()
+  {
+    write_fully(block.data(), block.size());
+    block.clear();
+  }
+
+  void write_fully(const char* bytes, std::size_t n)
+  {
+    while (n > 0) {
+      const ssize_t written = ::write(file, bytes, n);
+      if (written < 0) {
+        throw std::runtime_error("serialization: Could not write the index.");
+      }
+      bytes += written;
+      n -= written;
+    }
+  }
+};
+
+/**
+ * @brief The Reader struct reads a file in blocks of at least BLOCK_SIZE bytes and hands out views of the
+ * bytes in the block.
+ */
+struct Reader {
+  int file;
+  std::vector<char> block;
+  std::size_t begin;           // First unread byte of the block.
+  std::size_t end;             // End of the bytes read into the block.
+  std::uint64_t position = 0;  // Offset of the first unread byte in the file.
+
+  /**
+   * @brief view consumes the next n bytes of the file.
+   * @return a pointer to the n bytes stored consecutively, valid until the next call.
+   */
+  const char* view(std::size_t n)
+  {
+    if (end - begin < n) {
+      refill(n);
+    }
+
+    const char* bytes = &block[begin];
+    begin += n;
+    position += n;
+    return bytes;
+  }
+
+  template <typename T>
+  T read_value()
+  {
+    T value;
+    std::memcpy(&value, view(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  /**
+   * @brief refill moves the unread bytes to the front of the block and reads until n bytes are unread.
+   */
+  void refill(std::size_t n)
+  {
+    std::memmove(block.data(), block.data() + begin, end - begin);
+    end -= begin;
+    begin = 0;
+
+    if (block.size() < n) {
+      block.resize(n);
+    }
+
+    while (end < n) {
+      const ssize_t bytes_read = ::read(file, &block[end], block.size() - end);
+      if (bytes_read < 0) {
+        throw std::runtime_error("serialization: Could not read the index.");
+      }
+      if (bytes_read == 0) {
+        throw std::invalid_argument("serialization: The index file is truncated.");
+      }
+      end += bytes_read;
+    }
+  }
+};
+
+/**
+ * @brief write_header writes the format, the global state and the members of the index besides the tree.
+ */
+void write_header(Writer& writer, const Index* const index)
+{
+  writer.write(MAGIC, sizeof(MAGIC));
+  writer.write_value(FORMAT_VERSION);
+  writer.write_value(index->base.identifier);
+  writer.write_value(index->log_sequence);
+  writer.write_value(static_cast<std::uint32_t>(globals::g_descriptor_type));
+  writer.write_value(static_cast<std::uint32_t>(globals::g_vector_dimensions));
+  writer.write_value(static_cast<std::uint32_t>(distance::g_metric));
+
+  // Quantizer, which is empty if compression is not enabled.
+  const auto& quantizer = quantization::g_quantizer;
+  const std::uint32_t quantized_dimensions = quantization::is_enabled() ? globals::g_vector_dimensions : 0;
+  writer.write_value(quantized_dimensions);
+  writer.write(quantizer.offsets.data(), quantized_dimensions * sizeof(float));
+  writer.write(quantizer.scales.data(), quantized_dimensions * sizeof(float));
+
+  writer.write_value(static_cast<std::uint32_t>(index->L));
+  writer.write_value(static_cast<std::uint64_t>(index->size));
+
+  const auto& scheme = index->scheme;
+  writer.write_value(static_cast<std::uint32_t>(scheme.lo_bound));
+  writer.write_value(static_cast<std::uint32_t>(scheme.hi_bound));
+  writer.write_value(static_cast<std::uint32_t>(scheme.cluster_policy));
+  writer.write_value(static_cast<std::uint32_t>(scheme.node_policy));
+  writer.write_value(static_cast<std::uint32_t>(scheme.children_per_insert));
+
+  // Tombstones packed into 64 bit words.
+  const auto& tombstones = index->tombstones;
+  std::vector<std::uint64_t> words((tombstones.size() + 63) / 64, 0);
+  for (std::size_t id = 0; id < tombstones.size(); ++id) {
+    if (tombstones[id]) {
+      words[id / 64] |= std::uint64_t{1} << (id % 64);
+    }
+  }
+  writer.write_value(static_cast<std::uint64_t>(tombstones.size()));
+  writer.write(words.data(), words.size() * sizeof(std::uint64_t));
+
+  const auto& delta = index->delta;
+  std::vector<std::uint64_t> delta_ids(delta.ids.begin(), delta.ids.end());
+  writer.write_value(static_cast<std::uint64_t>(delta.capacity));
+  writer.write_value(static_cast<std::uint32_t>(delta.max_age));
+  writer.write_value(static_cast<std::uint64_t>(delta_ids.size()));
+  writer.write(delta_ids.data(), delta_ids.size() * sizeof(std::uint64_t));
+  writer.write(delta.storage.data(), delta.storage.size());
+}
+
+/**
+ * @brief read_header validates the format, sets the global state and reads the members of the index besides
+ * the tree.
+ */
+void read_header(Reader& reader, Index* const index)
+{
+  if (!std::equal(MAGIC, MAGIC + sizeof(MAGIC), reader.view(sizeof(MAGIC)))) {
+    throw std::invalid_argument("serialization: The file is not an index.");
+  }
+
+  const auto version = reader.read_value<std::uint32_t>();
+  if (version < 1 || version > FORMAT_VERSION) {
+    throw std::invalid_argument("serialization: The format version of the index is not supported.");
+  }
+  index->base.identifier = version < 2 ? 0 : reader.read_value<std::uint64_t>();
+  index->log_sequence = version < 3 ? 0 : reader.read_value<std::uint64_t>();
+
+  const auto descriptor_type = reader.read_value<std::uint32_t>();
+  if (descriptor_type > globals::DescriptorType::BINARY) {
+    throw std::invalid_argument("serialization: The descriptor type of the index is not supported.");
+  }
+  globals::g_descriptor_type = static_cast<globals::DescriptorType>(descriptor_type);
+  globals::g_vector_dimensions = reader.read_value<std::uint32_t>();
+  distance::set_distance_function(static_cast<distance::Metric>(reader.read_value<std::uint32_t>()));
+
+  // Points read afterwards are compressed if the quantizer is given.
+  quantization::reset();
+  const auto quantized_dimensions = reader.read_value<std::uint32_t>();
+  auto& quantizer = quantization::g_quantizer;
+  for (auto* values : {&quantizer.offsets, &quantizer.scales}) {
+    const auto* floats = reader.view(quantized_dimensions * sizeof(float));
+    values->resize(quantized_dimensions);
+    std::memcpy(values->data(), floats, quantized_dimensions * sizeof(float));
+  }
+
+  index->L = reader.read_value<std::uint32_t>();
+  index->size = reader.read_value<std::uint64_t>();
+
+  auto& scheme = index->scheme;
+  scheme.lo_bound = reader.read_value<std::uint32_t>();
+  scheme.hi_bound = reader.read_value<std::uint32_t>();
+  scheme.cluster_policy = static_cast<ReclusteringPolicy>(reader.read_value<std::uint32_t>());
+  scheme.node_policy = static_cast<ReclusteringPolicy>(reader.read_value<std::uint32_t>());
+  scheme.children_per_insert = reader.read_value<std::uint32_t>();
+
+  const auto tombstone_count = reader.read_value<std::uint64_t>();
+  index->tombstones.assign(tombstone_count, false);
+  for (std::uint64_t word = 0; word < (tombstone_count + 63) / 64; ++word) {
+    const auto bits = reader.read_value<std::uint64_t>();
+    for (std::uint64_t id = word * 64; id < std::min(tombstone_count, word * 64 + 64); ++id) {
+      index->tombstones[id] = (bits >> (id % 64)) & 1;
+    }
+  }
+
+  auto& delta = index->delta;
+  delta.capacity = reader.read_value<std::uint64_t>();
+  delta.max_age = reader.read_value<std::uint32_t>();
+  const auto delta_count = reader.read_value<std::uint64_t>();
+  for (std::uint64_t i = 0; i < delta_count; ++i) {
+    delta.ids.emplace_back(reader.read_value<std::uint64_t>());
+  }
+  const std::size_t delta_bytes = delta_count * globals::descriptor_size_in_bytes();
+  const char* storage = reader.view(delta_bytes);
+  delta.storage.assign(storage, storage + delta_bytes);
+
+  // The buffered descriptors age from when they are loaded.
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  delta.oldest = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+/**
+ * @brief write_node_record writes the number of children and points of a node followed by its points.
+ */
+void write_node_record(Writer& writer, const Node& node)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  writer.write_value(static_cast<std::uint32_t>(node.children.size()));
+  writer.write_value(static_cast<std::uint64_t>(node.points.size()));
+
+  for (const auto& point : node.points) {
+    writer.write_value(static_cast<std::uint64_t>(point.id));
+    writer.write(point.descriptor, bytes);
+  }
+}
+
+/**
+ * @brief write_node writes a node and the nodes below it in pre-order.
+ */
+void write_node(Writer& writer, const Node& node)
+{
+  write_node_record(writer, node);
+
+  for (const auto& child : node.children) {
+    write_node(writer, child);
+  }
+}
+
+/**
+ * @brief read_node_record reads the points of a node written by write_node_record. The points of clusters
+ * are allocated for hi_bound points like a built index.
+ * @return the number of children of the node, which are not read.
+ */
+std::uint32_t read_node_record(Reader& reader, Node& node, unsigned hi_bound)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const auto child_count = reader.read_value<std::uint32_t>();
+  const auto point_count = reader.read_value<std::uint64_t>();
+
+  node.points.reserve(child_count == 0 ? std::max<std::uint64_t>(point_count, hi_bound) : point_count);
+  for (std::uint64_t i = 0; i < point_count; ++i) {
+    const char* point = reader.view(sizeof(std::uint64_t) + bytes);
+    std::uint64_t id;
+    std::memcpy(&id, point, sizeof(id));
+    node.points.emplace_back(Point{reinterpret_cast<const float*>(point + sizeof(id)), id});
+  }
+  if (child_count == 0) {
+    node.encode_points();  // Compressed if the quantizer was read before.
+  }
+
+  return child_count;
+}
+
+/**
+ * @brief read_node reads a node and the nodes below it written by write_node. The nodes are located in the
+ * file as not dirty, i.e. the file is their base snapshot.
+ */
+void read_node(Reader& reader, Node& node, unsigned hi_bound)
+{
+  node.base_offset = reader.position;
+  node.children.resize(read_node_record(reader, node, hi_bound));
+  for (auto& child : node.children) {
+    read_node(reader, child, hi_bound);
+  }
+
+  node.base_size = reader.position - node.base_offset;
+  node.dirty = false;
+}
+
+/**
+ * @brief locate_in_base marks a node and the nodes below it as not dirty and locates them in a base snapshot
+ * written by write_node at the given offset.
+ * @return the offset following the subtree.
+ */
+std::uint64_t locate_in_base(Node& node, std::uint64_t offset)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  std::uint64_t end = offset + sizeof(std::uint32_t) + sizeof(std::uint64_t);
+  end += node.points.size() * (sizeof(std::uint64_t) + bytes);
+
+  for (auto& child : node.children) {
+    end = locate_in_base(child, end);
+  }
+
+  node.dirty = false;
+  node.base_offset = offset;
+  node.base_size = end - offset;
+  return end;
+}
+
+/**
+ * @brief carry_dirty_up marks the nodes above dirty nodes as dirty, such that the subtree of a node that is
+ * not dirty is unchanged. Clusters whose leader is among the given leaders are marked as well.
+ * @param node is the root of the subtree.
+ * @param updated_leaders are the leaders of clusters updated in place.
+ * @return whether the node is dirty.
+ */
+bool carry_dirty_up(Node& node, const std::unordered_set<const float*>& updated_leaders)
+{
+  if (node.children.empty() && updated_leaders.count(node.points.front().descriptor) > 0) {
+    node.dirty = true;
+  }
+
+  for (auto& child : node.children) {
+    node.dirty |= carry_dirty_up(child, updated_leaders);
+  }
+
+  return node.dirty;
+}
+
+/**
+ * @brief write_checkpoint_node writes the dirty nodes of a subtree in pre-order and locates the largest
+ * subtrees that are not dirty in the base snapshot. Dirty nodes must have been carried up.
+ */
+void write_checkpoint_node(Writer& writer, const Node& node)
+{
+  if (!node.dirty) {
+    writer.write_value(NODE_IN_BASE);
+    writer.write_value(node.base_offset);
+    writer.write_value(node.base_size);
+    return;
+  }
+
+  writer.write_value(NODE_INLINE);
+  write_node_record(writer, node);
+  for (const auto& child : node.children) {
+    write_checkpoint_node(writer, child);
+  }
+}
+
+/**
+ * @brief new_identifier draws the identifier of a new base snapshot.
+ */
+std::uint64_t new_identifier()
+{
+  std::random_device device;
+  return (std::uint64_t{device()} << 32) | device();
+}
+
+/**
+ * @brief The Checkpoint struct is an opened checkpoint and its base snapshot.
+ */
+struct Checkpoint {
+  int file;
+  int base_file;
+  std::string base_path;
+  std::uint64_t base_identifier;
+};
+
+/**
+ * @brief open_checkpoint opens a checkpoint and its base snapshot and reads up to the header of the index.
+ * The base snapshot must have the identifier recorded in the checkpoint.
+ * @param path is the path of the checkpoint.
+ * @param reader is the reader of the checkpoint, which is positioned at the header.
+ * @return the opened files, which are closed by close_checkpoint.
+ */
+Checkpoint open_checkpoint(const std::string& path, Reader& reader)
+{
+  Checkpoint checkpoint{::open(path.c_str(), O_RDONLY), -1, {}, 0};
+  if (checkpoint.file < 0) {
+    throw std::runtime_error("serialization: Could not open the checkpoint file " + path + ".");
+  }
+  reader.file = checkpoint.file;
+
+  try {
+    if (!std::equal(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + sizeof(CHECKPOINT_MAGIC),
+                    reader.view(sizeof(CHECKPOINT_MAGIC)))) {
+      throw std::invalid_argument("serialization: The file is not a checkpoint.");
+    }
+    if (reader.read_value<std::uint32_t>() != CHECKPOINT_FORMAT_VERSION) {
+      throw std::invalid_argument("serialization: The format version of the checkpoint is not supported.");
+    }
+
+    checkpoint.base_identifier = reader.read_value<std::uint64_t>();
+    const auto length = reader.read_value<std::uint32_t>();
+    const char* base_path = reader.view(length);
+    checkpoint.base_path.assign(base_path, base_path + length);
+
+    checkpoint.base_file = ::open(checkpoint.base_path.c_str(), O_RDONLY);
+    if (checkpoint.base_file < 0) {
+      throw std::runtime_error("serialization: Could not open the base snapshot " + checkpoint.base_path +
+                               ".");
+    }
+
+    // The identifier follows the magic bytes and the format version.
+    char start[sizeof(MAGIC) + sizeof(std::uint32_t) + sizeof(std::uint64_t)];
+    std::uint64_t identifier;
+    if (::pread(checkpoint.base_file, start, sizeof(start), 0) != sizeof(start) ||
+        !std::equal(MAGIC, MAGIC + sizeof(MAGIC), start)) {
+      throw std::invalid_argument("serialization: The base snapshot of the checkpoint is not an index.");
+    }
+    std::memcpy(&identifier, start + sizeof(MAGIC) + sizeof(std::uint32_t), sizeof(identifier));
+    if (identifier != checkpoint.base_identifier) {
+      throw std::invalid_argument("serialization: The base snapshot " + checkpoint.base_path +
+                                  " has been replaced since the checkpoint was written.");
+    }
+  }
+  catch (...) {
+    ::close(checkpoint.file);
+    if (checkpoint.base_file >= 0) {
+      ::close(checkpoint.base_file);
+    }
+    throw;
+  }
+
+  return checkpoint;
+}
+
+void close_checkpoint(const Checkpoint& checkpoint)
+{
+  ::close(checkpoint.file);
+  ::close(checkpoint.base_file);
+}
+
+/**
+ * @brief read_checkpoint_node reads a subtree written by write_checkpoint_node. Nodes tagged NODE_INLINE are
+ * dirty while subtrees tagged NODE_IN_BASE are read from the base snapshot.
+ */
+void read_checkpoint_node(Reader& reader, int base_file, Node& node, unsigned hi_bound)
+{
+  if (reader.read_value<std::uint8_t>() == NODE_IN_BASE) {
+    const auto offset = reader.read_value<std::uint64_t>();
+    const auto size = reader.read_value<std::uint64_t>();
+
+    ::lseek(base_file, offset, SEEK_SET);
+    Reader base_reader{base_file, std::vector<char>(std::min<std::uint64_t>(size, BLOCK_SIZE)), 0, 0, offset};
+    read_node(base_reader, node, hi_bound);
+    if (node.base_size != size) {
+      throw std::invalid_argument("serialization: The checkpoint does not match its base snapshot.");
+    }
+    return;
+  }
+
+  node.children.resize(read_node_record(reader, node, hi_bound));
+  for (auto& child : node.children) {
+    read_checkpoint_node(reader, base_file, child, hi_bound);
+  }
+}
+
+/**
+ * @brief fold_checkpoint_node copies a subtree written by write_checkpoint_node in the format of write_node,
+ * where subtrees tagged NODE_IN_BASE are copied from the base snapshot as they are.
+ */
+void fold_checkpoint_node(Reader& reader, int base_file, Writer& writer)
+{
+  if (reader.read_value<std::uint8_t>() == NODE_IN_BASE) {
+    auto offset = reader.read_value<std::uint64_t>();
+    auto size = reader.read_value<std::uint64_t>();
+    std::vector<char> block(std::min<std::uint64_t>(size, BLOCK_SIZE));
+
+    while (size > 0) {
+      const std::size_t n = std::min<std::uint64_t>(size, block.size());
+      const ssize_t bytes_read = ::pread(base_file, block.data(), n, offset);
+      if (bytes_read <= 0) {
+        throw std::runtime_error("serialization: Could not read the base snapshot.");
+      }
+      writer.write(block.data(), bytes_read);
+      offset += bytes_read;
+      size -= bytes_read;
+    }
+    return;
+  }
+
+  const auto child_count = reader.read_value<std::uint32_t>();
+  const auto point_count = reader.read_value<std::uint64_t>();
+  writer.write_value(child_count);
+  writer.write_value(point_count);
+
+  const std::size_t point_size = sizeof(std::uint64_t) + globals::descriptor_size_in_bytes();
+  for (std::uint64_t i = 0; i < point_count; ++i) {
+    writer.write(reader.view(point_size), point_size);
+  }
+
+  for (std::uint32_t i = 0; i < child_count; ++i) {
+    fold_checkpoint_node(reader, base_file, writer);
+  }
+}
+
+/**
+ * @brief write_file writes a file next to the path, syncs it and renames it to the path, such that an
+ * existing file at the path is either kept or replaced as a whole.
+ * @param path is the path of the file.
+ * @param write_contents is called with a Writer of the file to write the contents.
+ */
+template <typename WriteFunction>
+void write_file(const std::string& path, WriteFunction write_contents)
+{
+  const auto temporary_path = path + ".tmp";
+  const int file = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (file < 0) {
+    throw std::runtime_error("serialization: Could not create the index file " + path + ".");
+  }
+
+  try {
+    Writer writer{file, {}, 0};
+    writer.block.reserve(BLOCK_SIZE);
+    write_contents(writer);
+    writer.flush();
+
+    if (::fdatasync(file) != 0) {
+      throw std::runtime_error("serialization: Could not sync the index file " + path + ".");
+    }
+  }
+  catch (...) {
+    ::close(file);
+    std::remove(temporary_path.c_str());
+    throw;
+  }
+
+  ::close(file);
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    std::remove(temporary_path.c_str());
+    throw std::runtime_error("serialization: Could not replace the index file " + path + ".");
+  }
+}
+
+/**
+ * @brief The MappedHeader struct is the start of a mapped index file. Locates the sections of the file by
+ * their offset from its start.
+ */
+struct MappedHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t descriptor_type;
+  std::uint32_t dimensions;
+  std::uint32_t metric;
+  std::uint32_t L;
+  std::uint32_t quantized_dimensions;  // 0 if not compressed.
+  std::uint64_t size;
+  std::uint64_t node_count;
+  std::uint64_t point_count;         // Including the buffered points.
+  std::uint64_t buffered_count;
+  std::uint64_t quantizer_offset;    // Offsets followed by scales of the quantizer.
+  std::uint64_t nodes_offset;
+  std::uint64_t leaders_offset;
+  std::uint64_t ids_offset;
+  std::uint64_t descriptors_offset;
+  std::uint64_t codes_offset;        // 0 if not compressed.
+  std::uint64_t file_size;
+};
+
+/**
+ * @brief align_section rounds an offset up to the next multiple of SECTION_ALIGNMENT.
+ */
+std::uint64_t align_section(std::uint64_t offset)
+{
+  return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+/**
+ * @brief collect_nodes_breadth_first collects the root and the nodes below it level by level, such that the
+ * children of each node are consecutive.
+ */
+std::vector<const Node*> collect_nodes_breadth_first(const Node& root)
+{
+  std::vector<const Node*> nodes{&root};
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    for (const auto& child : nodes[i]->children) {
+      nodes.emplace_back(&child);
+    }
+  }
+  return nodes;
+}
+
+/**
+ * @brief is_erased tells whether the descriptor with the given id is erased.
+ */
+bool is_erased(unsigned long id, const std::vector<bool>& tombstones)
+{
+  return id < tombstones.size() && tombstones[id];
+}
+
+/**
+ * @brief number_nodes locates the consecutive children of each node among the nodes and the points of each
+ * cluster among the points, which are numbered cluster by cluster in the order of the nodes. Erased points
+ * are not numbered.
+ * @param nodes are the nodes collected by collect_nodes_breadth_first.
+ * @param tombstones are the erased ids of the index.
+ * @return the MappedNode of each node.
+ */
+std::vector<MappedNode> number_nodes(const std::vector<const Node*>& nodes,
+                                     const std::vector<bool>& tombstones)
+{
+  std::vector<MappedNode> mapped_nodes(nodes.size(), MappedNode{0, 0, 0, 0});
+  std::uint64_t next_child{1};
+  std::uint64_t next_point{0};
+  auto is_kept = [&tombstones](const Point& point) { return !is_erased(point.id, tombstones); };
+
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    auto& mapped_node = mapped_nodes[i];
+    mapped_node.first_child = next_child;
+    mapped_node.child_count = nodes[i]->children.size();
+    mapped_node.first_point = next_point;
+    next_child += mapped_node.child_count;
+
+    if (nodes[i]->children.empty()) {
+      mapped_node.point_count = std::count_if(nodes[i]->points.begin(), nodes[i]->points.end(), is_kept);
+      next_point += mapped_node.point_count;
+    }
+  }
+
+  return mapped_nodes;
+}
+
+/**
+ * @brief collect_buffered collects the positions of the buffered descriptors that are not erased.
+ */
+std::vector<std::size_t> collect_buffered(const DeltaBuffer& delta, const std::vector<bool>& tombstones)
+{
+  std::vector<std::size_t> buffered;
+  for (std::size_t i = 0; i < delta.ids.size(); ++i) {
+    if (!is_erased(delta.ids[i], tombstones)) {
+      buffered.emplace_back(i);
+    }
+  }
+  return buffered;
+}
+
+/**
+ * @brief write_mapped writes the index in the mapped format. Points are written cluster by cluster in the
+ * order of the nodes, followed by the buffered points, and erased points are left out.
+ */
+void write_mapped(Writer& writer, const Index* const index)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const auto& tombstones = index->tombstones;
+  const auto& delta = index->delta;
+  auto is_erased = [&tombstones](unsigned long id) {
+    return serialization_helpers::is_erased(id, tombstones);
+  };
+
+  const auto nodes = collect_nodes_breadth_first(index->root);
+  const auto mapped_nodes = number_nodes(nodes, tombstones);
+  const auto buffered = collect_buffered(delta, tombstones);
+  const std::uint64_t cluster_point_count = mapped_nodes.back().first_point + mapped_nodes.back().point_count;
+
+  auto for_each_cluster_point = [&nodes, &is_erased](std::function<void(const Point&)> function) {
+    for (const Node* node : nodes) {
+      if (!node->children.empty()) {
+        continue;
+      }
+      for (const auto& point : node->points) {
+        if (!is_erased(point.id)) {
+          function(point);
+        }
+      }
+    }
+  };
+
+  // Locate the sections.
+  MappedHeader header{};
+  std::memcpy(header.magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC));
+  header.version = MAPPED_FORMAT_VERSION;
+  header.descriptor_type = globals::g_descriptor_type;
+  header.dimensions = globals::g_vector_dimensions;
+  header.metric = distance::g_metric;
+  header.L = index->L;
+  header.quantized_dimensions = quantization::is_enabled() ? globals::g_vector_dimensions : 0;
+  header.size = index->size;
+  header.node_count = nodes.size();
+  header.point_count = cluster_point_count + buffered.size();
+  header.buffered_count = buffered.size();
+
+  const std::size_t quantizer_size = 2 * header.quantized_dimensions * sizeof(float);
+  header.quantizer_offset = align_section(sizeof(MappedHeader));
+  header.nodes_offset = align_section(header.quantizer_offset + quantizer_size);
+  header.leaders_offset = align_section(header.nodes_offset + header.node_count * sizeof(MappedNode));
+  header.ids_offset = align_section(header.leaders_offset + header.node_count * bytes);
+  header.descriptors_offset = align_section(header.ids_offset + header.point_count * sizeof(std::uint64_t));
+  header.file_size = header.descriptors_offset + header.point_count * bytes;
+  if (header.quantized_dimensions > 0) {
+    header.codes_offset = align_section(header.file_size);
+    header.file_size = header.codes_offset + cluster_point_count * header.quantized_dimensions;
+  }
+
+  writer.write_value(header);
+  writer.pad_to(header.quantizer_offset);
+  writer.write(quantization::g_quantizer.offsets.data(), header.quantized_dimensions * sizeof(float));
+  writer.write(quantization::g_quantizer.scales.data(), header.quantized_dimensions * sizeof(float));
+
+  writer.pad_to(header.nodes_offset);
+  writer.write(mapped_nodes.data(), mapped_nodes.size() * sizeof(MappedNode));
+
+  writer.pad_to(header.leaders_offset);
+  for (const Node* node : nodes) {
+    writer.write(node->points.front().descriptor, bytes);
+  }
+
+  writer.pad_to(header.ids_offset);
+  for_each_cluster_point([&writer](const Point& point) { writer.write_value<std::uint64_t>(point.id); });
+  for (auto i : buffered) {
+    writer.write_value<std::uint64_t>(delta.ids[i]);
+  }
+
+  writer.pad_to(header.descriptors_offset);
+  for_each_cluster_point([&writer, bytes](const Point& point) { writer.write(point.descriptor, bytes); });
+  for (auto i : buffered) {
+    writer.write(&delta.storage[i * bytes], bytes);
+  }
+
+  if (header.quantized_dimensions > 0) {
+    writer.pad_to(header.codes_offset);
+    std::vector<std::uint8_t> code(header.quantized_dimensions);
+    for (const Node* node : nodes) {
+      if (!node->children.empty()) {
+        continue;
+      }
+      const bool compressed = node->codes.size() == node->points.size() * code.size();
+      for (std::size_t i = 0; i < node->points.size(); ++i) {
+        if (is_erased(node->points[i].id)) {
+          continue;
+        }
+        if (compressed) {
+          writer.write(node->codes.data() + i * code.size(), code.size());
+        }
+        else {
+          quantization::encode(node->points[i].descriptor, code.data());
+          writer.write(code.data(), code.size());
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief map_index validates the header of a mapped index file, sets the global state and locates the
+ * sections of the file in the mapping.
+ * @param mapping is the start of the mapped file.
+ * @param length is the length of the mapped file in bytes. At least the size of the header.
+ * @param index is the mapped index to locate the sections in.
+ */
+void map_index(const char* mapping, std::size_t length, MappedIndex* const index)
+{
+  MappedHeader header;
+  std::memcpy(&header, mapping, sizeof(MappedHeader));
+
+  if (!std::equal(MAPPED_MAGIC, MAPPED_MAGIC + sizeof(MAPPED_MAGIC), header.magic)) {
+    throw std::invalid_argument("serialization: The file is not a mapped index.");
+  }
+  if (header.version != MAPPED_FORMAT_VERSION) {
+    throw std::invalid_argument("serialization: The format version of the mapped index is not supported.");
+  }
+  if (header.descriptor_type > globals::DescriptorType::BINARY) {
+    throw std::invalid_argument("serialization: The descriptor type of the index is not supported.");
+  }
+  if (header.file_size > length) {
+    throw std::invalid_argument("serialization: The mapped index file is truncated.");
+  }
+
+  globals::g_descriptor_type = static_cast<globals::DescriptorType>(header.descriptor_type);
+  globals::g_vector_dimensions = header.dimensions;
+  distance::set_distance_function(static_cast<distance::Metric>(header.metric));
+
+  quantization::reset();
+  const auto* quantizer = reinterpret_cast<const float*>(mapping + header.quantizer_offset);
+  quantization::g_quantizer.offsets.assign(quantizer, quantizer + header.quantized_dimensions);
+  quantization::g_quantizer.scales.assign(quantizer + header.quantized_dimensions,
+                                          quantizer + 2 * header.quantized_dimensions);
+
+  index->L = header.L;
+  index->size = header.size;
+  index->nodes = reinterpret_cast<const MappedNode*>(mapping + header.nodes_offset);
+  index->leaders = mapping + header.leaders_offset;
+  index->ids = reinterpret_cast<const std::uint64_t*>(mapping + header.ids_offset);
+  index->descriptors = mapping + header.descriptors_offset;
+  index->codes =
+      header.codes_offset ? reinterpret_cast<const std::uint8_t*>(mapping + header.codes_offset) : nullptr;
+  index->buffered_count = header.buffered_count;
+  index->point_count = header.point_count;
+}
+
+/**
+ * @brief shared_path is the path of the shared memory object with the given name.
+ */
+std::string shared_path(const std::string& name)
+{
+  if (name.empty() || name.find('/') != std::string::npos) {
+    throw std::invalid_argument("serialization: The name of a shared index must be a non-empty file name.");
+  }
+  return SHARED_MEMORY_DIRECTORY + name;
+}
+
+/**
+ * @brief The DiskHeader struct is the start of a disk index file.
+ */
+struct DiskHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t descriptor_type;
+  std::uint32_t dimensions;
+  std::uint32_t metric;
+  std::uint32_t L;
+  std::uint32_t padding;
+  std::uint64_t size;
+  std::uint64_t node_count;
+  std::uint64_t buffered_count;
+};
+
+/**
+ * @brief write_on_disk writes the index in the disk format with the blocks of the clusters supplied by the
+ * given function.
+ * @param writer is the writer of the file.
+ * @param index is the index, whose points are only written through write_block.
+ * @param nodes are the nodes collected by collect_nodes_breadth_first.
+ * @param mapped_nodes are the nodes numbered with the number of points of each cluster.
+ * @param write_block is called with the position of each cluster among the nodes in order to write its block.
+ */
+void write_on_disk(Writer& writer, const Index* const index, const std::vector<const Node*>& nodes,
+                   const std::vector<MappedNode>& mapped_nodes,
+                   const std::function<void(Writer&, std::size_t)>& write_block)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const auto& delta = index->delta;
+  const auto buffered = collect_buffered(delta, index->tombstones);
+
+  DiskHeader header{};
+  std::memcpy(header.magic, DISK_MAGIC, sizeof(DISK_MAGIC));
+  header.version = DISK_FORMAT_VERSION;
+  header.descriptor_type = globals::g_descriptor_type;
+  header.dimensions = globals::g_vector_dimensions;
+  header.metric = distance::g_metric;
+  header.L = index->L;
+  header.size = index->size;
+  header.node_count = nodes.size();
+  header.buffered_count = buffered.size();
+
+  // Locate the blocks of the clusters after the sections read at opening.
+  std::vector<std::uint64_t> block_offsets(nodes.size(), 0);
+  const std::size_t node_size = sizeof(MappedNode) + bytes + sizeof(std::uint64_t);
+  std::uint64_t offset = sizeof(DiskHeader) + nodes.size() * node_size;
+  offset += cluster_reader::block_size(buffered.size());
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i]->children.empty()) {
+      offset = (offset + CLUSTER_ALIGNMENT - 1) / CLUSTER_ALIGNMENT * CLUSTER_ALIGNMENT;
+      block_offsets[i] = offset;
+      offset += cluster_reader::block_size(mapped_nodes[i].point_count);
+    }
+  }
+
+  writer.write_value(header);
+  writer.write(mapped_nodes.data(), mapped_nodes.size() * sizeof(MappedNode));
+  for (const Node* node : nodes) {
+    writer.write(node->points.front().descriptor, bytes);
+  }
+  writer.write(block_offsets.data(), block_offsets.size() * sizeof(std::uint64_t));
+
+  for (auto i : buffered) {
+    writer.write_value<std::uint64_t>(delta.ids[i]);
+  }
+  for (auto i : buffered) {
+    writer.write(&delta.storage[i * bytes], bytes);
+  }
+
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i]->children.empty()) {
+      writer.pad_to(block_offsets[i]);
+      write_block(writer, i);
+    }
+  }
+}
+
+/**
+ * @brief write_on_disk writes the index in the disk format. The points of each cluster are written as its
+ * block, and erased points are left out.
+ */
+void write_on_disk(Writer& writer, const Index* const index)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  const auto& tombstones = index->tombstones;
+  const auto nodes = collect_nodes_breadth_first(index->root);
+
+  write_on_disk(writer, index, nodes, number_nodes(nodes, tombstones), [&](Writer& writer, std::size_t i) {
+    for (const auto& point : nodes[i]->points) {
+      if (!is_erased(point.id, tombstones)) {
+        writer.write_value<std::uint64_t>(point.id);
+      }
+    }
+    for (const auto& point : nodes[i]->points) {
+      if (!is_erased(point.id, tombstones)) {
+        writer.write(point.descriptor, bytes);
+      }
+    }
+  });
+}
+
+/**
+ * @brief read_on_disk validates the header of a disk index file, sets the global state and reads the
+ * sections held in memory.
+ */
+void read_on_disk(Reader& reader, DiskIndex* const index)
+{
+  DiskHeader header = reader.read_value<DiskHeader>();
+
+  if (!std::equal(DISK_MAGIC, DISK_MAGIC + sizeof(DISK_MAGIC), header.magic)) {
+    throw std::invalid_argument("serialization: The file is not a disk index.");
+  }
+  if (header.version != DISK_FORMAT_VERSION) {
+    throw std::invalid_argument("serialization: The format version of the disk index is not supported.");
+  }
+  if (header.descriptor_type > globals::DescriptorType::BINARY) {
+    throw std::invalid_argument("serialization: The descriptor type of the index is not supported.");
+  }
+
+  globals::g_descriptor_type = static_cast<globals::DescriptorType>(header.descriptor_type);
+  globals::g_vector_dimensions = header.dimensions;
+  distance::set_distance_function(static_cast<distance::Metric>(header.metric));
+  quantization::reset();  // Clusters are scanned at full precision.
+
+  auto read_section = [&reader](void* section, std::size_t n) {
+    std::memcpy(section, reader.view(n), n);
+  };
+
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  index->nodes.resize(header.node_count);
+  index->leaders.resize(header.node_count * bytes);
+  index->block_offsets.resize(header.node_count);
+  index->buffered.resize(cluster_reader::block_size(header.buffered_count));
+  index->buffered_count = header.buffered_count;
+  read_section(index->nodes.data(), index->nodes.size() * sizeof(MappedNode));
+  read_section(index->leaders.data(), index->leaders.size());
+  read_section(index->block_offsets.data(), index->block_offsets.size() * sizeof(std::uint64_t));
+  read_section(index->buffered.data(), index->buffered.size());
+
+  auto& routing = index->routing;
+  routing.L = header.L;
+  routing.size = header.size;
+  routing.nodes = index->nodes.data();
+  routing.leaders = index->leaders.data();
+}
+
+}  // namespace serialization_helpers
+
+namespace serialization {
+
+void save(Index* const index, const std::string& path)
+{
+  const auto lock = maintenance::write_lock(index);  // Insertions append if the lock is shared.
+  const auto previous_identifier = index->base.identifier;
+  index->base.identifier = serialization_helpers::new_identifier();
+  std::uint64_t root_offset;
+
+  try {
+    serialization_helpers::write_file(path, [index, &root_offset](serialization_helpers::Writer& writer) {
+      serialization_helpers::write_header(writer, index);
+      root_offset = writer.position;
+      serialization_helpers::write_node(writer, index->root);
+    });
+  }
+  catch (...) {
+    index->base.identifier = previous_identifier;
+    throw;
+  }
+
+  // The saved file is the base snapshot of the next checkpoints, and contains the logged modifications.
+  serialization_helpers::locate_in_base(index->root, root_offset);
+  index->base.path = path;
+  index->base.updated_leaders.clear();
+  write_ahead_log::truncate(index);
+}
+
+Index* load(const std::string& path)
+{
+  const int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("serialization: Could not open the index file " + path + ".");
+  }
+  ::posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  auto* index = new Index{};
+  try {
+    serialization_helpers::Reader reader{file, std::vector<char>(serialization_helpers::BLOCK_SIZE), 0, 0};
+    serialization_helpers::read_header(reader, index);
+    serialization_helpers::read_node(reader, index->root, index->scheme.hi_bound);
+  }
+  catch (...) {
+    ::close(file);
+    delete index;
+    throw;
+  }
+
+  ::close(file);
+  index->root.count_subtree();
+  if (index->base.identifier != 0) {  // Files of version 1 cannot be identified as a base snapshot.
+    index->base.path = path;
+  }
+  return index;
+}
+
+void checkpoint(Index* const index, const std::string& path)
+{
+  const auto lock = maintenance::write_lock(index);
+  if (index->base.path.empty()) {
+    throw std::invalid_argument("serialization: The index has no base snapshot to checkpoint against.");
+  }
+
+  serialization_helpers::carry_dirty_up(index->root, index->base.updated_leaders);
+  index->base.updated_leaders.clear();
+
+  serialization_helpers::write_file(path, [index](serialization_helpers::Writer& writer) {
+    writer.write(serialization_helpers::CHECKPOINT_MAGIC, sizeof(serialization_helpers::CHECKPOINT_MAGIC));
+    writer.write_value(serialization_helpers::CHECKPOINT_FORMAT_VERSION);
+    writer.write_value(index->base.identifier);
+    writer.write_value(static_cast<std::uint32_t>(index->base.path.size()));
+    writer.write(index->base.path.data(), index->base.path.size());
+
+    serialization_helpers::write_header(writer, index);
+    serialization_helpers::write_checkpoint_node(writer, index->root);
+  });
+}
+
+Index* load_checkpoint(const std::string& path)
+{
+  serialization_helpers::Reader reader{-1, std::vector<char>(serialization_helpers::BLOCK_SIZE), 0, 0};
+  const auto checkpoint = serialization_helpers::open_checkpoint(path, reader);
+  ::posix_fadvise(checkpoint.file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  auto* index = new Index{};
+  try {
+    serialization_helpers::read_header(reader, index);
+    serialization_helpers::read_checkpoint_node(reader, checkpoint.base_file, index->root,
+                                                index->scheme.hi_bound);
+  }
+  catch (...) {
+    serialization_helpers::close_checkpoint(checkpoint);
+    delete index;
+    throw;
+  }
+
+  serialization_helpers::close_checkpoint(checkpoint);
+  index->root.count_subtree();
+  index->base.path = checkpoint.base_path;  // Later checkpoints are written against the same base snapshot.
+  index->base.identifier = checkpoint.base_identifier;
+  return index;
+}
+
+void fold_checkpoint(const std::string& checkpoint_path, const std::string& path)
+{
+  serialization_helpers::Reader reader{-1, std::vector<char>(serialization_helpers::BLOCK_SIZE), 0, 0};
+  const auto checkpoint = serialization_helpers::open_checkpoint(checkpoint_path, reader);
+  ::posix_fadvise(checkpoint.file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  try {
+    Index header{};  // Holds the members besides the tree only.
+    serialization_helpers::read_header(reader, &header);
+    header.base.identifier = serialization_helpers::new_identifier();
+
+    serialization_helpers::write_file(path, [&](serialization_helpers::Writer& writer) {
+      serialization_helpers::write_header(writer, &header);
+      serialization_helpers::fold_checkpoint_node(reader, checkpoint.base_file, writer);
+    });
+  }
+  catch (...) {
+    serialization_helpers::close_checkpoint(checkpoint);
+    throw;
+  }
+
+  serialization_helpers::close_checkpoint(checkpoint);
+}
+
+void save_mapped(Index* const index, const std::string& path)
+{
+  const auto lock = maintenance::write_lock(index);
+  serialization_helpers::write_file(path, [index](serialization_helpers::Writer& writer) {
+    serialization_helpers::write_mapped(writer, index);
+  });
+}
+
+MappedIndex* open_mapped(const std::string& path)
+{
+  const int file = ::open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (file < 0 || ::fstat(file, &status) != 0) {
+    if (file >= 0) {
+      ::close(file);
+    }
+    throw std::runtime_error("serialization: Could not open the mapped index file " + path + ".");
+  }
+
+  const std::size_t length = status.st_size;
+  if (length < sizeof(serialization_helpers::MappedHeader)) {
+    ::close(file);
+    throw std::invalid_argument("serialization: The file is not a mapped index.");
+  }
+
+  void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+  ::close(file);  // The mapping keeps the file open.
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("serialization: Could not map the index file " + path + ".");
+  }
+
+  auto* index = new MappedIndex{};
+  index->mapping = mapping;
+  index->mapping_size = length;
+
+  try {
+    serialization_helpers::map_index(static_cast<const char*>(mapping), length, index);
+  }
+  catch (...) {
+    close_mapped(index);
+    throw;
+  }
+
+  return index;
+}
+
+void close_mapped(MappedIndex* const index)
+{
+  ::munmap(index->mapping, index->mapping_size);
+  delete index;
+}
+
+void save_shared(Index* const index, const std::string& name)
+{
+  save_mapped(index, serialization_helpers::shared_path(name));
+}
+
+MappedIndex* open_shared(const std::string& name)
+{
+  return open_mapped(serialization_helpers::shared_path(name));
+}
+
+void remove_shared(const std::string& name)
+{
+  if (std::remove(serialization_helpers::shared_path(name).c_str()) != 0) {
+    throw std::runtime_error("serialization: Could not remove the shared index " + name + ".");
+  }
+}
+
+void save_on_disk(Index* const index, const std::string& path)
+{
+  const auto lock = maintenance::write_lock(index);
+  serialization_helpers::write_file(path, [index](serialization_helpers::Writer& writer) {
+    serialization_helpers::write_on_disk(writer, index);
+  });
+}
+
+DiskIndex* open_on_disk(const std::string& path, std::size_t cache_capacity, unsigned thread_count)
+{
+  const int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("serialization: Could not open the disk index file " + path + ".");
+  }
+
+  auto* index = new DiskIndex{};
+  index->file = file;
+
+  try {
+    serialization_helpers::Reader reader{file, std::vector<char>(serialization_helpers::BLOCK_SIZE), 0, 0};
+    serialization_helpers::read_on_disk(reader, index);
+  }
+  catch (...) {
+    close_on_disk(index);
+    throw;
+  }
+
+  // Clusters are read at random as they are searched.
+  ::posix_fadvise(file, 0, 0, POSIX_FADV_RANDOM);
+  cluster_reader::start(index, cache_capacity, thread_count);
+  return index;
+}
+
+void save_on_disk(const Index* const routing, const std::vector<std::uint64_t>& point_counts,
+                  const std::function<void(std::size_t, char*)>& fill_block, const std::string& path)
+{
+  const auto nodes = serialization_helpers::collect_nodes_breadth_first(routing->root);
+  auto mapped_nodes = serialization_helpers::number_nodes(nodes, routing->tombstones);
+
+  // Number the points by the given counts instead of the points held by the clusters.
+  std::uint64_t next_point{0};
+  std::vector<std::size_t> clusters;  // Position of each cluster among the nodes.
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    mapped_nodes[i].first_point = next_point;
+    if (nodes[i]->children.empty()) {
+      if (clusters.size() == point_counts.size()) {
+        throw std::invalid_argument("serialization: A point count must be given for every cluster.");
+      }
+      mapped_nodes[i].point_count = point_counts[clusters.size()];
+      next_point += mapped_nodes[i].point_count;
+      clusters.emplace_back(i);
+    }
+  }
+  if (clusters.size() != point_counts.size()) {
+    throw std::invalid_argument("serialization: A point count must be given for every cluster.");
+  }
+
+  std::vector<char> block;
+  std::size_t cluster{0};
+  serialization_helpers::write_file(path, [&](serialization_helpers::Writer& writer) {
+    serialization_helpers::write_on_disk(
+        writer, routing, nodes, mapped_nodes, [&](serialization_helpers::Writer& writer, std::size_t) {
+          block.resize(cluster_reader::block_size(point_counts[cluster]));
+          fill_block(cluster++, block.data());
+          writer.write(block.data(), block.size());
+        });
+  });
+}
+
+void close_on_disk(DiskIndex* const index)
+{
+  cluster_reader::stop(index);
+  ::close(index->file);
+  delete index;
+}
+
+}  // namespace serialization
@@ -0,0 +1,168 @@
+#ifndef SERIALIZATION_HPP
+#define SERIALIZATION_HPP
+
+#include <cstdint>
+#include <eCP/index/shared/data_structure.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Namespace contains the binary file format of an index such that a built index is saved once and loaded
+ * instead of being built again. The file holds the global descriptor type, dimensionality and metric, the
+ * quantizer if compression is enabled, L, size, the ReclusteringScheme, the tombstones, the delta buffer and
+ * the tree in pre-order with the descriptors of each node stored next to their ids. Files are read and
+ * written sequentially in large blocks.
+ *
+ * The latest saved or loaded file of an index is its base snapshot. A checkpoint only writes the nodes that
+ * changed since the base snapshot was written and refers to the base snapshot for the rest, thus its size
+ * follows the amount of change rather than the size of the index. The base snapshot and the latest
+ * checkpoint are folded into a new base snapshot to keep checkpoints small.
+ *
+ * An index can also be saved in a read-only format that is memory mapped and queried as a MappedIndex
+ * without being read into memory first, or in a disk format queried as a DiskIndex, which keeps only the
+ * nodes and leaders in memory and reads the clusters from disk as they are searched.
+ *
+ * A mapped index saved to shared memory is served to many processes from a single copy, as each process maps
+ * the same pages read-only.
+ */
+namespace serialization {
+
+/**
+ * @brief save writes the index to a file. The file is written next to the path and renamed once synced, thus
+ * an existing file at the path is either kept or replaced as a whole. A reclustering spread over insertions
+ * is not saved as it is started again by the next insertion. The file becomes the base snapshot of the
+ * following checkpoints of the index.
+ * @param index is the index to save. Modifications wait until it is saved.
+ * @param path is the path of the file.
+ */
+void save(Index* const index, const std::string& path);
+
+/**
+ * @brief load reads an index saved by save and sets the global descriptor type, dimensionality, distance
+ * function and quantizer to those of the index. Background maintenance and the write-ahead log are not part
+ * of the file and must be enabled again, while a log is replayed onto the loaded index to recover the
+ * modifications logged since it was saved.
+ * @param path is the path of the file.
+ * @return a pointer to the loaded index.
+ */
+Index* load(const std::string& path);
+
+/**
+ * @brief checkpoint writes the changes of the index since its base snapshot to a file. Each checkpoint holds
+ * all changes since the base snapshot, thus only the latest checkpoint is needed to restore the index. Like
+ * save the file is replaced as a whole.
+ * @param index is the index to checkpoint. Must have a base snapshot. Modifications wait until it is written.
+ * @param path is the path of the file.
+ */
+void checkpoint(Index* const index, const std::string& path);
+
+/**
+ * @brief load_checkpoint reads an index from a checkpoint and its base snapshot, which must not have been
+ * replaced since. Sets the global state like load, and the base snapshot stays the base of the index.
+ * @param path is the path of the checkpoint.
+ * @return a pointer to the loaded index.
+ */
+Index* load_checkpoint(const std::string& path);
+
+/**
+ * @brief fold_checkpoint writes the index of a checkpoint and its base snapshot to a new file in the format
+ * of save without reading the index into memory. The subtrees unchanged since the base snapshot are copied
+ * as they are. Sets the global state like load.
+ * @param checkpoint_path is the path of the checkpoint.
+ * @param path is the path of the new base snapshot, which may be the path of the previous one.
+ */
+void fold_checkpoint(const std::string& checkpoint_path, const std::string& path);
+
+/**
+ * @brief save_mapped writes the index in the format of a MappedIndex. Like save the file is replaced as a
+ * whole. Erased descriptors are left out, and buffered descriptors are scanned by every query as in the
+ * index.
+ * @param index is the index to save. Modifications wait until it is saved.
+ * @param path is the path of the file.
+ */
+void save_mapped(Index* const index, const std::string& path);
+
+/**
+ * @brief open_mapped maps a file written by save_mapped read-only and sets the global descriptor type,
+ * dimensionality, distance function and quantizer to those of the index. Takes constant time as the file is
+ * only read as it is queried.
+ * @param path is the path of the file.
+ * @return a pointer to the mapped index, which is released by close_mapped.
+ */
+MappedIndex* open_mapped(const std::string& path);
+
+/**
+ * @brief close_mapped unmaps and deletes a mapped index.
+ * @param index is the mapped index. No query may read it anymore.
+ */
+void close_mapped(MappedIndex* const index);
+
+/**
+ * @brief save_shared writes the index in the format of a MappedIndex to a POSIX shared memory object, which
+ * lives in memory until it is removed. Like save the object is replaced as a whole, while processes that
+ * opened the replaced object keep querying it until they close it.
+ * @param index is the index to save. Modifications wait until it is saved.
+ * @param name is the name of the object without a leading slash.
+ */
+void save_shared(Index* const index, const std::string& name);
+
+/**
+ * @brief open_shared maps a shared memory object written by save_shared read-only like open_mapped. Every
+ * process opening the object shares its pages, thus the index is held in memory once.
+ * @param name is the name of the object.
+ * @return a pointer to the mapped index, which is released by close_mapped.
+ */
+MappedIndex* open_shared(const std::string& name);
+
+/**
+ * @brief remove_shared removes a shared memory object written by save_shared. Its memory is freed once every
+ * process has closed it.
+ * @param name is the name of the object.
+ */
+void remove_shared(const std::string& name);
+
+/**
+ * @brief save_on_disk writes the index in the format of a DiskIndex, where the points of each cluster are
+ * stored consecutively as one block. Like save the file is replaced as a whole and erased descriptors are
+ * left out. Compressed codes are not written as the clusters are scanned at full precision.
+ * @param index is the index to save. Modifications wait until it is saved.
+ * @param path is the path of the file.
+ */
+void save_on_disk(Index* const index, const std::string& path);
+
+/**
+ * @brief save_on_disk writes an index whose points are held elsewhere in the format of a DiskIndex, e.g. by
+ * an out-of-core build where only the nodes fit in memory. The block of each cluster is filled one at a time
+ * in the order of the clusters. See above for the file.
+ * @param routing is the index of the nodes. Its clusters are numbered breadth-first and their points ignored.
+ * @param point_counts is the number of points of each cluster by number.
+ * @param fill_block is called with the number of each cluster in order and the storage of its block, which it
+ * fills with the ids of its points followed by their descriptors.
+ * @param path is the path of the file.
+ */
+void save_on_disk(const Index* const routing, const std::vector<std::uint64_t>& point_counts,
+                  const std::function<void(std::size_t, char*)>& fill_block, const std::string& path);
+
+/**
+ * @brief open_on_disk reads the nodes, leaders and buffered descriptors of a file written by save_on_disk and
+ * starts the reader of its clusters. Sets the global descriptor type, dimensionality and distance function
+ * to those of the index and disables compression.
+ * @param path is the path of the file.
+ * @param cache_capacity is the number of bytes of clusters cached in memory, 0 to read every searched cluster
+ * from disk.
+ * @param thread_count is the number of threads reading clusters in parallel, 0 to read them one at a time
+ * by the querying thread.
+ * @return a pointer to the opened index, which is released by close_on_disk.
+ */
+DiskIndex* open_on_disk(const std::string& path, std::size_t cache_capacity, unsigned thread_count);
+
+/**
+ * @brief close_on_disk stops the reader, closes the file and deletes a disk index.
+ * @param index is the disk index. No query may be in progress.
+ */
+void close_on_disk(DiskIndex* const index);
+
+}  // namespace serialization
+
+#endif  // SERIALIZATION_HPP
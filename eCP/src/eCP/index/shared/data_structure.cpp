@@ -1,30 +1,133 @@
+#include <algorithm>
 #include <eCP/index/shared/data_structure.hpp>
+#include <eCP/index/shared/quantization.hpp>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 /*
  * Point data type
  */
+
+/**
+ * @brief The DescriptorPool struct hands out the storage of descriptors carved from large slabs, such that
+ * constructing a Point only allocates when a slab is used up. Released storage is kept in a free list per
+ * block size and reused by the next Point of that size. Each block starts with a header holding its size,
+ * and the link to the next free block while released. Slabs are never released, thus the memory of deleted
+ * indexes is reused by later Points rather than returned.
+ */
+struct DescriptorPool {
+  std::mutex mutex;                              // Guards the pool as Points are created from many threads.
+  std::vector<float*> free_lists;                // First released block indexed by block size in floats.
+  std::vector<std::unique_ptr<float[]>> slabs;  // The storage all blocks are carved from.
+  float* slab_position{nullptr};                 // Start of the unused rest of the last slab.
+  float* slab_end{nullptr};                      // End of the last slab.
+};
+
+static const std::size_t HEADER_FLOATS = 4;     // Size and link of a block, a multiple of 16 bytes.
+static const std::size_t SLAB_FLOATS = 1 << 16;  // 256 KiB per slab.
+
+/**
+ * @brief descriptor_pool is the pool shared by all Points. Never destroyed as Points of static objects may
+ * be destroyed after it.
+ */
+static DescriptorPool& descriptor_pool()
+{
+  static auto* pool = new DescriptorPool{};
+  return *pool;
+}
+
+/**
+ * @brief allocate_descriptor takes float aligned storage of the given size from the descriptor pool.
+ * @param floats is the number of floats to store.
+ * @return the storage, to be released by release_descriptor.
+ */
+static float* allocate_descriptor(std::size_t floats)
+{
+  const std::size_t block = HEADER_FLOATS + (floats + HEADER_FLOATS - 1) / HEADER_FLOATS * HEADER_FLOATS;
+  auto& pool = descriptor_pool();
+  float* storage;
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (block < pool.free_lists.size() && pool.free_lists[block]) {
+      storage = pool.free_lists[block];
+      std::memcpy(&pool.free_lists[block], storage + 2, sizeof(float*));
+    }
+    else {
+      if (static_cast<std::size_t>(pool.slab_end - pool.slab_position) < block) {
+        const std::size_t slab_floats = std::max(SLAB_FLOATS, block);  // The rest of the last slab is unused.
+        pool.slabs.emplace_back(new float[slab_floats]);
+        pool.slab_position = pool.slabs.back().get();
+        pool.slab_end = pool.slab_position + slab_floats;
+      }
+      storage = pool.slab_position;
+      pool.slab_position += block;
+    }
+  }
+
+  std::memcpy(storage, &block, sizeof(block));
+  return storage + HEADER_FLOATS;
+}
+
+/**
+ * @brief allocate_descriptor takes storage for a descriptor of the global descriptor type from the pool.
+ */
+static float* allocate_descriptor()
+{
+  return allocate_descriptor((globals::descriptor_size_in_bytes() + sizeof(float) - 1) / sizeof(float));
+}
+
+/**
+ * @brief release_descriptor returns storage taken by allocate_descriptor to the pool.
+ * @param descriptor is the storage to release. Nothing is done for nullptr.
+ */
+static void release_descriptor(float* descriptor)
+{
+  if (!descriptor) {
+    return;
+  }
+
+  float* storage = descriptor - HEADER_FLOATS;
+  std::size_t block;
+  std::memcpy(&block, storage, sizeof(block));
+
+  auto& pool = descriptor_pool();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  if (pool.free_lists.size() <= block) {
+    pool.free_lists.resize(block + 1, nullptr);
+  }
+  std::memcpy(storage + 2, &pool.free_lists[block], sizeof(float*));
+  pool.free_lists[block] = storage;
+}
+
 Point::Point(const float* descriptor_, unsigned long id_)
-    : descriptor(new float[globals::g_vector_dimensions])
+    : descriptor(allocate_descriptor())
     , id(id_)
 {
-  std::copy(descriptor_, descriptor_ + globals::g_vector_dimensions, descriptor);
+  std::memcpy(descriptor, descriptor_, globals::descriptor_size_in_bytes());
+}
+
+Point::Point(const std::uint8_t* descriptor_, unsigned long id_)
+    : Point(reinterpret_cast<const float*>(descriptor_), id_)
+{
 }
 
 Point::Point(const std::vector<float> descriptor_, unsigned long id_)
-    : descriptor(new float[globals::g_vector_dimensions])
+    : descriptor(allocate_descriptor(std::max<std::size_t>(descriptor_.size(), globals::g_vector_dimensions)))
     , id(id_)
 {
   std::copy(descriptor_.begin(), descriptor_.end(), descriptor);
 }
 
-Point::~Point() { delete[] descriptor; }
+Point::~Point() { release_descriptor(descriptor); }
 
 // Copy constructor.
 Point::Point(const Point& other)
-    : Point(other.descriptor, other.id)
+    : descriptor(allocate_descriptor())
+    , id(other.id)
 {
+  std::memcpy(descriptor, other.descriptor, globals::descriptor_size_in_bytes());
 }
 
 // Move constructor.
@@ -52,24 +155,89 @@ void swap(Point& fst, Point& snd)
 /*
  * Node data type
  */
-Node::Node() {}
+Node::Node()
+    : point_count(0)
+    , grandchild_count(0)
+    , dirty(true)
+    , unpublished(true)
+    , base_offset(0)
+    , base_size(0)
+{
+}
 
 Node::Node(Point p)
-    : points{std::move(p)}
+    : point_count(1)
+    , grandchild_count(0)
+    , dirty(true)
+    , unpublished(true)
+    , base_offset(0)
+    , base_size(0)
 {
+  points.emplace_back(std::move(p));
 }
 
 Point* Node::get_leader() { return &points[0]; }
 
+void Node::count_subtree()
+{
+  if (children.empty()) {
+    point_count = points.size();
+    grandchild_count = 0;
+    return;
+  }
+
+  point_count = 0;
+  grandchild_count = 0;
+
+  for (auto& child : children) {
+    child.count_subtree();
+    point_count += child.point_count;
+    grandchild_count += child.children.size();
+  }
+}
+
+void Node::encode_points(std::size_t first)
+{
+  if (!quantization::is_enabled()) {
+    codes.clear();
+    return;
+  }
+
+  const std::size_t dimensions = globals::g_vector_dimensions;
+  first = std::min(first, codes.size() / dimensions);
+  codes.resize(points.size() * dimensions);
+
+  for (std::size_t i = first; i < points.size(); ++i) {
+    quantization::encode(points[i].descriptor, codes.data() + i * dimensions);
+  }
+}
+
+void Node::erase_point(std::size_t position)
+{
+  points.erase(points.begin() + position);
+
+  if (!codes.empty()) {
+    const std::size_t dimensions = globals::g_vector_dimensions;
+    codes.erase(codes.begin() + position * dimensions, codes.begin() + (position + 1) * dimensions);
+  }
+}
+
+void Node::mark_changed()
+{
+  dirty = true;
+  unpublished = true;
+}
+
 /*
  * ReclusteringScheme default constructor.
  */
 ReclusteringScheme::ReclusteringScheme(unsigned sc_, unsigned hi_bound_, ReclusteringPolicy cluster_policy_,
-                                       ReclusteringPolicy node_policy_)
+                                       ReclusteringPolicy node_policy_, unsigned children_per_insert_)
     : lo_bound(sc_)
     , hi_bound(hi_bound_)
     , cluster_policy(cluster_policy_)
     , node_policy(node_policy_)
+    , children_per_insert(children_per_insert_)
 {
 }
 
@@ -81,6 +249,7 @@ ReclusteringScheme::ReclusteringScheme()
     , hi_bound(100 * (1 + 0.3))
     , cluster_policy(ReclusteringPolicy::AVERAGE)
     , node_policy(ReclusteringPolicy::ABSOLUTE)
+    , children_per_insert(0)
 {
 }
 
@@ -92,6 +261,12 @@ Index::Index()
     , size(0)
     , scheme(ReclusteringScheme{})
     , root(Node{})
+    , maintainer(nullptr)
+    , progress()
+    , delta()
+    , log(nullptr)
+    , log_sequence(0)
+    , base()
 {
 }
 
@@ -99,6 +274,12 @@ Index::Index(unsigned L_, unsigned long index_size, Node root_node, Reclustering
     : L(L_)
     , size(index_size)
     , scheme(scheme_)
-    , root(root_node)
+    , root(std::move(root_node))
+    , maintainer(nullptr)
+    , progress()
+    , delta()
+    , log(nullptr)
+    , log_sequence(0)
+    , base()
 {
 }
@@ -1,10 +1,15 @@
 #ifndef DATA_STRUCTURE_H
 #define DATA_STRUCTURE_H
 
+#include <cstdint>
 #include <cstring>
 #include <eCP/index/shared/globals.hpp>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <stack>
+#include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -14,7 +19,9 @@
 
 /**
  * Represents a point in high-dimensional space.
- * @param descriptor pointer to first element of feature vector>
+ * @param descriptor pointer to first element of feature vector>. The storage holds descriptor_size_in_bytes()
+ * bytes of the global descriptor type, i.e. the elements are only floats for the FLOAT32 type. The storage is
+ * taken from a pool of slabs shared by all Points and does not move while the Point exists.
  * @param id index in data set.
  */
 struct Point {
@@ -22,14 +29,21 @@ struct Point {
   unsigned long id;
 
   /**
-   * @brief Point constructor. NB: Assumes that g_vector_dimensions is set.
+   * @brief Point constructor. NB: Assumes that g_vector_dimensions and g_descriptor_type is set.
    * @param descriptor_ is a pointer to the descriptor the Point should contain.
    * @param id_ is the id of the Point.
    */
   explicit Point(const float* descriptor_, unsigned long id_);
 
   /**
-   * @brief Point constructor. NB: Assumes that g_vector_dimensions is set.
+   * @brief Point constructor for byte descriptors i.e. the UINT8 and INT8 descriptor types.
+   * @param descriptor_ is a pointer to the descriptor the Point should contain.
+   * @param id_ is the id of the Point.
+   */
+  explicit Point(const std::uint8_t* descriptor_, unsigned long id_);
+
+  /**
+   * @brief Point constructor. NB: Assumes that g_vector_dimensions is set and the FLOAT32 descriptor type.
    * @param descriptor_ is a reference to a vector of floats that will be
    * copied into the point.
    * @param id_ is the id of the Point.
@@ -57,15 +71,39 @@ struct Point {
   friend void swap(Point& fst, Point& snd);
 };
 
+struct VersionNode;
+
 /**
  * Represents nodes and clusters in index. Will not have children at bottom level.
  * First element of points is always the representative.
  * @param children nodes at next level.
  * @param points in high-dimensional space. First element is always the node representative.
+ * @param point_count is the number of points in the clusters below, i.e. points.size() for a cluster.
+ * @param grandchild_count is the number of children of the children. Both counts are maintained by insertions
+ * and reclusterings such that checking whether a level must be reclustered does not visit the level.
+ * @param dirty marks a node whose points or children have changed since the base snapshot of the index. New
+ * nodes are dirty. Set on the changed node only and carried up to its ancestors when a checkpoint is written.
+ * @param base_offset is the offset of the subtree in the base snapshot if the node is not dirty.
+ * @param base_size is the number of bytes of the subtree in the base snapshot if the node is not dirty.
+ * @param codes holds the compressed code of each point of a cluster consecutively when compression is
+ * enabled, such that a compressed scan reads a single array. Empty for internal nodes and uncompressed
+ * clusters.
+ * @param published is the copy of the node in the last published version of the index, if any.
+ * @param unpublished marks a node whose points or children have changed since it was published. New nodes
+ * are unpublished. Set on the changed node only, the paths to it are copied when the next version is
+ * published.
  */
 struct Node {
   std::vector<Node> children;
   std::vector<Point> points;
+  std::vector<std::uint8_t> codes;
+  std::size_t point_count;
+  std::size_t grandchild_count;
+  bool dirty;
+  std::shared_ptr<const VersionNode> published;
+  bool unpublished;
+  std::uint64_t base_offset;
+  std::uint64_t base_size;
   explicit Node();
   explicit Node(Point p);
 
@@ -74,6 +112,44 @@ struct Node {
    * @return a Point* which is the leader of the node in which this Point resides.
    */
   Point* get_leader();
+
+  /**
+   * @brief count_subtree recomputes the counts of the Node and all Nodes below it. Only needed when a tree is
+   * assembled without maintaining the counts.
+   */
+  void count_subtree();
+
+  /**
+   * @brief encode_points encodes the points of a cluster from the given position onwards into the codes, such
+   * that the codes again match the points after points were added or replaced from that position. Clears the
+   * codes if compression is not enabled.
+   * @param first is the position of the first point whose code is (re)computed.
+   */
+  void encode_points(std::size_t first = 0);
+
+  /**
+   * @brief erase_point removes the point at the given position from a cluster along with its code.
+   * @param position is the position of the point in points.
+   */
+  void erase_point(std::size_t position);
+
+  /**
+   * @brief mark_changed marks the node as changed since both the base snapshot and the published version.
+   */
+  void mark_changed();
+};
+
+/**
+ * @brief The VersionNode struct is an immutable copy of a Node in a published version of an index. A Node
+ * that is unchanged between versions keeps its VersionNode, thus publishing a version only copies the changed
+ * clusters and the paths to them while the rest of the tree is shared with the previous version.
+ * @param node is a copy of the Node without its children, i.e. of the points and codes of a cluster or of the
+ * leader of an internal node. Never modified.
+ * @param children are the copies of the children of the Node.
+ */
+struct VersionNode {
+  std::shared_ptr<Node> node;
+  std::vector<std::shared_ptr<const VersionNode>> children;
 };
 
 /**
@@ -82,21 +158,87 @@ struct Node {
  * threshold.
  * If ABSOLUTE then a reclustering is initiated whenever the number of children for any child node grows
  * beyond some threshold.
+ * If SPLIT then a child node growing beyond the threshold is split in two instead of reclustering all the
+ * children of its parent.
  */
-enum ReclusteringPolicy { AVERAGE = 1, ABSOLUTE };
+enum ReclusteringPolicy { AVERAGE = 1, ABSOLUTE, SPLIT };
 
 /**
  * @brief The ReclusteringScheme struct is the combined amount of information needed to decide whether a
- * reclustering should happen when an insertion has happened.
+ * reclustering should happen when an insertion has happened, and how much of it is done per insertion.
  */
 struct ReclusteringScheme {
   unsigned lo_bound;                  // Lower size boundary of nodes/clusters. (min)
   unsigned hi_bound;                  // Higher size boundary of nodes/clusters. (max)
   ReclusteringPolicy cluster_policy;  // Reclustering policy for clusters.
-  ReclusteringPolicy node_policy;     // Reclustering policy for internal nodes.
+  ReclusteringPolicy node_policy;  // Reclustering policy for internal nodes.
+  unsigned children_per_insert;       // Children reclustered per insertion. 0 reclusters all at once.
   explicit ReclusteringScheme();
   explicit ReclusteringScheme(unsigned lo_bound, unsigned hi_bound, ReclusteringPolicy cluster_policy_,
-                              ReclusteringPolicy node_policy_);
+                              ReclusteringPolicy node_policy_, unsigned children_per_insert_ = 0);
+};
+
+/**
+ * Path from the root of the index to a node with the node on top. Backed by a vector such that a reused path
+ * keeps its capacity.
+ */
+typedef std::stack<Node*, std::vector<Node*>> NodePath;
+
+/**
+ * @brief The ReclusteringProgress struct is the state of a reclustering spread over several insertions. The
+ * members of the children of a node, i.e. their points or child nodes, are assigned to new leaders a bounded
+ * number of children at a time. The new children substitute the old ones at once when all members are
+ * assigned, thus queries never observe a partially reclustered node.
+ */
+struct ReclusteringProgress {
+  NodePath path;                      // Path from the root to the node being reclustered. Empty if idle.
+  std::vector<unsigned> sizes;        // Number of members of each child when the reclustering started.
+  std::vector<const float*> members;  // Storage of the descriptor of each member. The leader for nodes.
+  std::vector<unsigned> leaders;      // Indexes of the members picked as leaders of the new children.
+  std::vector<float> leader_storage;  // Copy of the descriptors of the leaders.
+  std::vector<unsigned> assignments;  // For each member the index into leaders of its new child.
+  unsigned next_child;                // First child whose members are not yet assigned.
+  unsigned next_member;               // First member of that child.
+};
+
+/**
+ * @brief The DeltaBuffer struct holds recently inserted descriptors in a flat append-only storage until they
+ * are merged into the clusters of the index in a single batch. Queries scan it exhaustively in addition to
+ * the clusters such that buffered descriptors are found at once.
+ */
+struct DeltaBuffer {
+  std::vector<char> storage;       // Buffered descriptors stored consecutively in the global descriptor type.
+  std::vector<unsigned long> ids;  // Id of each buffered descriptor in increasing order.
+  std::size_t capacity;            // Descriptors buffered before they are merged. 0 if disabled.
+  unsigned max_age;                // Milliseconds a descriptor is buffered before merging. 0 if unlimited.
+  long long oldest;                // Time the oldest buffered descriptor was inserted in milliseconds.
+};
+
+/**
+ * @brief The BaseSnapshot struct is the snapshot of an index written by save or read by load, which
+ * checkpoints of the index are written against. Nodes that are not dirty are stored unchanged in it.
+ */
+struct BaseSnapshot {
+  std::string path;                                  // Path of the snapshot, empty if none.
+  std::uint64_t identifier;                          // Stored in the snapshot and its checkpoints.
+  std::unordered_set<const float*> updated_leaders;  // Leaders of clusters updated in place since.
+};
+
+namespace maintenance {
+struct BackgroundMaintainer;  // Defined in maintenance.hpp.
+}
+
+namespace write_ahead_log {
+struct Log;  // Defined in write-ahead-log.hpp.
+}
+
+/**
+ * @brief The PointLocation struct locates the storage of a Point and the leader of its cluster without
+ * traversing the index. Stays valid as the index relocates Points by moving them, which keeps their storage.
+ */
+struct PointLocation {
+  float* descriptor;    // Storage of the descriptor of the Point.
+  const float* leader;  // Storage of the descriptor of the leader of the cluster containing the Point.
 };
 
 /**
@@ -104,19 +246,108 @@ struct ReclusteringScheme {
  * single level with a single Node with a single Point. The struct is used to hold the neededed data to be
  * able to operate on the Index.
  * @param L is the depth of the index.
- * @param size is the total number of descriptors contained in the index.
+ * @param size is the total number of descriptors added to the index. Ids are assigned in increasing order
+ * thus size is also the id of the next inserted descriptor.
  * @param scheme is the ReclusteringScheme set for the current index. Used during dynamic insertion.
  * @param root_node is the root node of the index. The children of this node are considered the first level of
  * the index L=1.
+ * @param tombstones marks erased descriptors by id. Ids beyond its size are not erased. Empty until the first
+ * erase such that queries on indexes without deletions are not penalized.
+ * @param locations is the PointLocation of each id. Empty until the first update and afterwards maintained
+ * by insertions and reclusterings. Cleared whenever the storage of Points is replaced.
+ * @param maintainer is the state of background maintenance when enabled, otherwise nullptr and insertions
+ * recluster synchronously.
+ * @param progress is the reclustering in progress when the scheme limits the children reclustered per
+ * insertion. Only used without background maintenance.
+ * @param insert_path is reused by insertions to collect the path to the nearest cluster without allocating.
+ * @param delta is the buffer of inserted descriptors not yet merged into the clusters when enabled.
+ * @param log is the write-ahead log modifications are appended to when enabled, otherwise nullptr.
+ * @param log_sequence is the sequence number of the latest logged modification applied to the index, which
+ * is saved along with it such that replaying skips the records it contains.
+ * @param base is the snapshot checkpoints are written against.
  */
 struct Index {
-  unsigned L;                 // Current depth
-  unsigned long size;         // Number of feature descriptors contained in index.
-  ReclusteringScheme scheme;  // Scheme used for reclustering.
-  Node root;                  // The initial top/root node of the index.
+  unsigned L;                                     // Current depth
+  unsigned long size;                             // Number of feature descriptors added to index.
+  ReclusteringScheme scheme;                      // Scheme used for reclustering.
+  Node root;                                      // The initial top/root node of the index.
+  std::vector<bool> tombstones;                   // Erased ids. Points are kept until removed by compaction.
+  std::vector<PointLocation> locations;           // Storage of each id used to update descriptors in place.
+  maintenance::BackgroundMaintainer* maintainer;  // Deferred reclustering, nullptr if synchronous.
+  ReclusteringProgress progress;                  // Reclustering spread over insertions.
+  NodePath insert_path;                           // Path buffer of insertions.
+  DeltaBuffer delta;                              // Recent insertions scanned exhaustively by queries.
+  write_ahead_log::Log* log;                      // Durable log of modifications, nullptr if not logged.
+  std::uint64_t log_sequence;                     // Sequence number of the latest logged modification.
+  BaseSnapshot base;                              // Snapshot written by the latest save or read by load.
 
   explicit Index();  // Possibly required by SWIG.
   explicit Index(unsigned L, unsigned long index_size, Node root_node, ReclusteringScheme scheme);
 };
 
+/**
+ * @brief The MappedNode struct is a node of a MappedIndex. Refers to its children and points by their
+ * position in the sections of the mapping instead of by pointers, thus it is valid wherever it is mapped.
+ */
+struct MappedNode {
+  std::uint64_t first_child;  // Position of the first child in the nodes. The children are consecutive.
+  std::uint64_t first_point;  // Position of the first point of a cluster in the points. They are consecutive.
+  std::uint32_t child_count;  // Number of children, 0 for clusters.
+  std::uint32_t point_count;  // Number of points of a cluster, 0 for internal nodes.
+};
+
+/**
+ * @brief MappedIndex is a read-only index served directly from a memory mapped file. The sections of the
+ * file are aligned arrays such that pages are only loaded as queries touch them and processes mapping the
+ * same file share one copy in the page cache. Erased points are left out of the points while the leaders of
+ * all nodes are kept for routing.
+ * @param L is the depth of the index.
+ * @param size is the number of descriptors added to the index the mapping was saved from.
+ * @param nodes holds the root followed by the nodes of each level in breadth-first order.
+ * @param leaders holds the leader descriptor of each node in the order of nodes.
+ * @param ids holds the id of each point, where the points of clusters are followed by buffered_count points
+ * which are scanned by every query like a delta buffer.
+ * @param descriptors holds the descriptor of each point.
+ * @param codes holds the compressed code of each point of a cluster when compression is enabled, otherwise
+ * nullptr.
+ */
+struct MappedIndex {
+  void* mapping;                      // Start of the mapped file.
+  std::size_t mapping_size;           // Length of the mapped file in bytes.
+  unsigned L;                         // Depth of the index.
+  unsigned long size;                 // Number of descriptors added to the saved index.
+  const MappedNode* nodes;            // Root first, then each level.
+  const char* leaders;                // Leader descriptor of each node.
+  const std::uint64_t* ids;           // Id of each point.
+  const char* descriptors;            // Descriptor of each point.
+  const std::uint8_t* codes;          // Compressed code of each point of a cluster, nullptr if uncompressed.
+  std::uint64_t buffered_count;       // Number of points at the end that are not part of any cluster.
+  std::uint64_t point_count;          // Number of points including the buffered points.
+};
+
+namespace cluster_reader {
+struct ClusterReader;  // Defined in cluster-reader.hpp.
+}
+
+/**
+ * @brief DiskIndex is a read-only index for collections larger than memory. The nodes and leaders are held in
+ * memory for routing while the points of each cluster are stored on disk as one block, such that a cluster is
+ * fetched by a single read. Clusters are read in parallel by the threads of the reader, which caches the most
+ * recently used clusters.
+ * @param routing locates the nodes and leaders in memory. Has no points, thus only routes queries.
+ * @param block_offsets is the offset of the block of each cluster in the file by position of the node. A
+ * block holds the ids of the points of the cluster followed by their descriptors.
+ * @param buffered is the block of the buffered points, which are scanned by every query.
+ */
+struct DiskIndex {
+  MappedIndex routing;                       // Nodes and leaders, stored below.
+  std::vector<MappedNode> nodes;             // Root first, then each level.
+  std::vector<char> leaders;                 // Leader descriptor of each node.
+  std::vector<std::uint64_t> block_offsets;  // Offset of the block of each cluster in the file.
+  std::vector<char> buffered;                // Block of the points not part of any cluster.
+  std::uint64_t buffered_count;              // Number of points in buffered.
+  int file;                                  // Descriptor of the file opened for reading.
+  cluster_reader::ClusterReader* reader;     // Reading threads and cache of clusters.
+};
+
 #endif  // DATA_STRUCTURE_H
@@ -1,15 +1,26 @@
+#include <immintrin.h>
+
 #include <cmath>
 #include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/quantization.hpp>
 
 namespace distance {
 
 /// Definition of global distance function, extern in header
 float (*g_distance_function)(const float*, const float*, const float&);
 
+/// Definition of global compressed distance function, extern in header
+float (*g_code_distance_function)(const CodeQuery&, const std::uint8_t*, const float&);
+
+/// Definition of global metric, extern in header
+Metric g_metric = Metric::EUCLIDEAN_OPT_UNROLL;
+
 inline float euclidean_distance_unroll_halt(const float* a, const float* b, const float& threshold)
 {
   float sum = 0;
-  for (unsigned int i = 0; i < globals::g_vector_dimensions; i = i + 8) {
+  unsigned int i = 0;
+  const unsigned int unrolled = globals::g_vector_dimensions & ~7u;  // Remaining dimensions are added below.
+  for (; i < unrolled; i = i + 8) {
     sum += ((a[i] - b[i]) * (a[i] - b[i])) + ((a[i + 1] - b[i + 1]) * (a[i + 1] - b[i + 1])) +
            ((a[i + 2] - b[i + 2]) * (a[i + 2] - b[i + 2])) + ((a[i + 3] - b[i + 3]) * (a[i + 3] - b[i + 3])) +
            ((a[i + 4] - b[i + 4]) * (a[i + 4] - b[i + 4])) + ((a[i + 5] - b[i + 5]) * (a[i + 5] - b[i + 5])) +
@@ -19,18 +30,26 @@ inline float euclidean_distance_unroll_halt(const float* a, const float* b, cons
       return globals::FLOAT_MAX;
     }
   }
-  return sum;
+  for (; i < globals::g_vector_dimensions; ++i) {
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return (sum > threshold) ? globals::FLOAT_MAX : sum;
 }
 
 inline float euclidean_distance_unroll(const float* a, const float* b, const float& threshold = -1)
 {
   float sum = 0;
-  for (unsigned int i = 0; i < globals::g_vector_dimensions; i = i + 8) {
+  unsigned int i = 0;
+  const unsigned int unrolled = globals::g_vector_dimensions & ~7u;  // Remaining dimensions are added below.
+  for (; i < unrolled; i = i + 8) {
     sum += ((a[i] - b[i]) * (a[i] - b[i])) + ((a[i + 1] - b[i + 1]) * (a[i + 1] - b[i + 1])) +
            ((a[i + 2] - b[i + 2]) * (a[i + 2] - b[i + 2])) + ((a[i + 3] - b[i + 3]) * (a[i + 3] - b[i + 3])) +
            ((a[i + 4] - b[i + 4]) * (a[i + 4] - b[i + 4])) + ((a[i + 5] - b[i + 5]) * (a[i + 5] - b[i + 5])) +
            ((a[i + 6] - b[i + 6]) * (a[i + 6] - b[i + 6])) + ((a[i + 7] - b[i + 7]) * (a[i + 7] - b[i + 7]));
   }
+  for (; i < globals::g_vector_dimensions; ++i) {
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+  }
   return sum;
 }
 
@@ -73,8 +92,308 @@ inline float angular_distance(const float* a, const float* b, const float& max_d
   return std::acos(cosine_similarity);
 }
 
+/*
+ * Distances between byte descriptors. The descriptor storage is reinterpreted as the element type given by
+ * the global descriptor type and accumulated in integers.
+ */
+template <typename T>
+inline float euclidean_distance_integer(const float* a_, const float* b_, const float& = -1)
+{
+  const T* a = reinterpret_cast<const T*>(a_);
+  const T* b = reinterpret_cast<const T*>(b_);
+
+  std::int32_t sum = 0;
+  for (unsigned int i = 0; i < globals::g_vector_dimensions; ++i) {
+    const std::int32_t delta = static_cast<std::int32_t>(a[i]) - static_cast<std::int32_t>(b[i]);
+    sum += delta * delta;
+  }
+  return static_cast<float>(sum);
+}
+
+template <typename T>
+inline float euclidean_distance_integer_halt(const float* a_, const float* b_, const float& threshold)
+{
+  const T* a = reinterpret_cast<const T*>(a_);
+  const T* b = reinterpret_cast<const T*>(b_);
+
+  std::int32_t sum = 0;
+  for (unsigned int i = 0; i < globals::g_vector_dimensions; ++i) {
+    const std::int32_t delta = static_cast<std::int32_t>(a[i]) - static_cast<std::int32_t>(b[i]);
+    sum += delta * delta;
+
+    if (sum > threshold) {
+      return globals::FLOAT_MAX;
+    }
+  }
+  return static_cast<float>(sum);
+}
+
+template <typename T>
+inline float angular_distance_integer(const float* a_, const float* b_, const float& = -1)
+{
+  const T* a = reinterpret_cast<const T*>(a_);
+  const T* b = reinterpret_cast<const T*>(b_);
+
+  std::int64_t mul = 0, d_a = 0, d_b = 0;
+  for (unsigned int i = 0; i < globals::g_vector_dimensions; ++i) {
+    mul += static_cast<std::int32_t>(a[i]) * b[i];
+    d_a += static_cast<std::int32_t>(a[i]) * a[i];
+    d_b += static_cast<std::int32_t>(b[i]) * b[i];
+  }
+
+  const float cosine_similarity = (mul / std::sqrt(static_cast<double>(d_a) * d_b));
+
+  return std::acos(cosine_similarity);
+}
+
+/*
+ * AVX2 variants of the byte distances. Each step widens 32 bytes to 16 bit lanes and accumulates the squared
+ * differences in 32 bit lanes using madd. Remaining dimensions are handled by the scalar loop.
+ */
+__attribute__((target("avx2"))) inline __m256i widen_avx2(__m128i bytes, std::uint8_t)
+{
+  return _mm256_cvtepu8_epi16(bytes);
+}
+
+__attribute__((target("avx2"))) inline __m256i widen_avx2(__m128i bytes, std::int8_t)
+{
+  return _mm256_cvtepi8_epi16(bytes);
+}
+
+__attribute__((target("avx2"))) inline std::int32_t horizontal_sum_avx2(__m256i lanes)
+{
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+template <typename T, bool halt>
+__attribute__((target("avx2"))) float euclidean_distance_integer_avx2(const float* a_, const float* b_,
+                                                                      const float& threshold)
+{
+  const T* a = reinterpret_cast<const T*>(a_);
+  const T* b = reinterpret_cast<const T*>(b_);
+  const unsigned int dimensions = globals::g_vector_dimensions;
+
+  __m256i acc = _mm256_setzero_si256();
+  unsigned int i = 0;
+
+  for (; i + 32 <= dimensions; i += 32) {
+    const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+    const __m256i lo = _mm256_sub_epi16(widen_avx2(_mm256_castsi256_si128(va), T{}),
+                                        widen_avx2(_mm256_castsi256_si128(vb), T{}));
+    const __m256i hi = _mm256_sub_epi16(widen_avx2(_mm256_extracti128_si256(va, 1), T{}),
+                                        widen_avx2(_mm256_extracti128_si256(vb, 1), T{}));
+
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(lo, lo));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(hi, hi));
+
+    if (halt && horizontal_sum_avx2(acc) > threshold) {
+      return globals::FLOAT_MAX;
+    }
+  }
+
+  std::int32_t sum = horizontal_sum_avx2(acc);
+  for (; i < dimensions; ++i) {
+    const std::int32_t delta = static_cast<std::int32_t>(a[i]) - static_cast<std::int32_t>(b[i]);
+    sum += delta * delta;
+  }
+
+  if (halt && sum > threshold) {
+    return globals::FLOAT_MAX;
+  }
+  return static_cast<float>(sum);
+}
+
+/**
+ * @brief set_integer_distance_function selects the byte distance kernels for element type T, using the AVX2
+ * variants when supported by the CPU.
+ */
+template <typename T>
+void set_integer_distance_function(Metric metric)
+{
+  const bool has_avx2 = __builtin_cpu_supports("avx2");
+
+  switch (metric) {
+    case Metric::EUCLIDEAN_OPT_UNROLL:
+      g_distance_function =
+          has_avx2 ? &euclidean_distance_integer_avx2<T, false> : &euclidean_distance_integer<T>;
+      break;
+
+    case Metric::ANGULAR:
+      g_distance_function = &angular_distance_integer<T>;
+      break;
+
+    case Metric::EUCLIDEAN_HALT_OPT_UNROLL:
+      g_distance_function =
+          has_avx2 ? &euclidean_distance_integer_avx2<T, true> : &euclidean_distance_integer_halt<T>;
+      break;
+
+    default:
+      throw std::invalid_argument("Invalid metric.");
+  }
+}
+
+/*
+ * Hamming distances between bit-packed descriptors. The generic variant is compiled for the baseline
+ * architecture and inlined into the POPCNT variant, which lets the compiler emit the POPCNT instruction. The
+ * AVX-512 variant uses VPOPCNTDQ on 64 bytes at a time.
+ */
+__attribute__((always_inline)) inline float hamming_distance(const float* a_, const float* b_,
+                                                              const float& = -1)
+{
+  const auto* a = reinterpret_cast<const std::uint8_t*>(a_);
+  const auto* b = reinterpret_cast<const std::uint8_t*>(b_);
+  const unsigned int bytes = globals::descriptor_size_in_bytes();
+
+  unsigned int count = 0;
+  unsigned int i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    std::uint64_t word_a, word_b;
+    std::memcpy(&word_a, a + i, 8);
+    std::memcpy(&word_b, b + i, 8);
+    count += __builtin_popcountll(word_a ^ word_b);
+  }
+  for (; i < bytes; ++i) {
+    count += __builtin_popcount(a[i] ^ b[i]);
+  }
+  return static_cast<float>(count);
+}
+
+__attribute__((target("popcnt"))) float hamming_distance_popcnt(const float* a, const float* b,
+                                                                const float& threshold = -1)
+{
+  return hamming_distance(a, b, threshold);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) float hamming_distance_avx512(
+    const float* a_, const float* b_, const float& = -1)
+{
+  const auto* a = reinterpret_cast<const std::uint8_t*>(a_);
+  const auto* b = reinterpret_cast<const std::uint8_t*>(b_);
+  const unsigned int bytes = globals::descriptor_size_in_bytes();
+
+  __m512i acc = _mm512_setzero_si512();
+  for (unsigned int i = 0; i < bytes; i += 64) {
+    // Mask off bytes beyond the descriptor such that they count as equal.
+    const unsigned int remaining = bytes - i;
+    const __mmask64 mask = remaining >= 64 ? ~__mmask64{0} : (__mmask64{1} << remaining) - 1;
+
+    const __m512i va = _mm512_maskz_loadu_epi8(mask, a + i);
+    const __m512i vb = _mm512_maskz_loadu_epi8(mask, b + i);
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(va, vb)));
+  }
+  alignas(64) std::uint64_t lanes[8];
+  _mm512_store_si512(lanes, acc);
+  return static_cast<float>(lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] +
+                            lanes[7]);
+}
+
+/*
+ * Compressed distances compare a transformed query to a code. A value x in dimension i is decoded as
+ * o[i] + c[i] * s[i], thus (q[i] - x)^2 = s[i]^2 * ((q[i] - o[i]) / s[i] - c[i])^2 and the Euclidean distance
+ * is a weighted distance between the levels of the query and the code. The angular distance splits the dot
+ * product into the dot product of the query and the offsets, which is constant, and of the scaled query and
+ * the code.
+ */
+CodeQuery prepare_code_query(const float* query)
+{
+  const float* offsets = quantization::g_quantizer.offsets.data();
+  const float* scales = quantization::g_quantizer.scales.data();
+  const unsigned int dimensions = globals::g_vector_dimensions;
+
+  CodeQuery code_query{std::vector<float>(dimensions), std::vector<float>(dimensions), 0, 0};
+  for (unsigned int i = 0; i < dimensions; ++i) {
+    if (g_metric == Metric::ANGULAR) {
+      code_query.values[i] = query[i] * scales[i];
+      code_query.dot_offsets += query[i] * offsets[i];
+      code_query.norm += query[i] * query[i];
+    }
+    else {
+      code_query.values[i] = (query[i] - offsets[i]) / scales[i];
+      code_query.weights[i] = scales[i] * scales[i];
+    }
+  }
+  return code_query;
+}
+
+inline float euclidean_code_distance(const CodeQuery& query, const std::uint8_t* code, const float& threshold)
+{
+  const float* values = query.values.data();
+  const float* weights = query.weights.data();
+
+  float sum = 0;
+  unsigned int i = 0;
+  const unsigned int unrolled = globals::g_vector_dimensions & ~7u;  // Remaining dimensions are added below.
+  for (; i < unrolled; i = i + 8) {
+    for (unsigned int j = i; j < i + 8; ++j) {
+      const float delta = values[j] - code[j];
+      sum += weights[j] * delta * delta;
+    }
+
+    if (sum > threshold) {
+      return globals::FLOAT_MAX;
+    }
+  }
+  for (; i < globals::g_vector_dimensions; ++i) {
+    const float delta = values[i] - code[i];
+    sum += weights[i] * delta * delta;
+  }
+  return (sum > threshold) ? globals::FLOAT_MAX : sum;
+}
+
+inline float angular_code_distance(const CodeQuery& query, const std::uint8_t* code, const float&)
+{
+  const float* values = query.values.data();
+  const float* offsets = quantization::g_quantizer.offsets.data();
+  const float* scales = quantization::g_quantizer.scales.data();
+
+  float mul = query.dot_offsets, d_b = 0.0;
+  for (unsigned int i = 0; i < globals::g_vector_dimensions; ++i) {
+    const float value = offsets[i] + code[i] * scales[i];
+    mul += values[i] * code[i];
+    d_b += value * value;
+  }
+
+  const float cosine_similarity = (mul / sqrt(query.norm * d_b));
+
+  return std::acos(cosine_similarity);
+}
+
 void set_distance_function(Metric metric)
 {
+  g_metric = metric;
+
+  switch (globals::g_descriptor_type) {
+    case globals::DescriptorType::UINT8:
+      return set_integer_distance_function<std::uint8_t>(metric);
+
+    case globals::DescriptorType::INT8:
+      return set_integer_distance_function<std::int8_t>(metric);
+
+    case globals::DescriptorType::BINARY:
+      if (metric != Metric::HAMMING) {
+        throw std::invalid_argument("Binary descriptors are only supported by the HAMMING metric.");
+      }
+
+      if (__builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512bw")) {
+        g_distance_function = &hamming_distance_avx512;
+      }
+      else if (__builtin_cpu_supports("popcnt")) {
+        g_distance_function = &hamming_distance_popcnt;
+      }
+      else {
+        g_distance_function = &hamming_distance;
+      }
+      return;
+
+    default:
+      break;
+  }
+
   auto is_dimensionality_divisable_by_8 = ((globals::g_vector_dimensions % 8) == 0) ? true : false;
 
   switch (metric) {
@@ -85,10 +404,12 @@ void set_distance_function(Metric metric)
       else {
         g_distance_function = &euclidean_distance;
       }
+      g_code_distance_function = &euclidean_code_distance;
       break;
 
     case Metric::ANGULAR:
       g_distance_function = &angular_distance;
+      g_code_distance_function = &angular_code_distance;
       break;
 
     case Metric::EUCLIDEAN_HALT_OPT_UNROLL:
@@ -98,6 +419,7 @@ void set_distance_function(Metric metric)
       else {
         g_distance_function = &euclidean_distance_halt;
       }
+      g_code_distance_function = &euclidean_code_distance;
       break;
 
     default:
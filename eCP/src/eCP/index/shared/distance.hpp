@@ -3,6 +3,7 @@
 
 #include <eCP/index/shared/data_structure.hpp>
 #include <cmath>
+#include <cstdint>
 #include <eCP/index/shared/data_structure.hpp>
 #include <vector>
 
@@ -17,12 +18,45 @@ namespace distance {
 extern float (*g_distance_function)(const float*, const float*, const float&);
 
 /**
- * @brief The Metric enum is used to define globally the type of distance function used.
+ * @brief The CodeQuery struct is a query transformed once per search for the global quantizer, such that its
+ * distance to a code is computed from the levels of the code without decoding them.
  */
-enum Metric { EUCLIDEAN_OPT_UNROLL = 0, ANGULAR, EUCLIDEAN_HALT_OPT_UNROLL };
+struct CodeQuery {
+  std::vector<float> values;   // Query in levels of the quantizer for EUCLIDEAN, scaled by them for ANGULAR.
+  std::vector<float> weights;  // Squared step size of each dimension for EUCLIDEAN.
+  float dot_offsets;           // Dot product of the query and the offsets of the quantizer for ANGULAR.
+  float norm;                  // Squared norm of the query for ANGULAR.
+};
 
 /**
- * Set the globally used distance function.
+ * @brief prepare_code_query transforms a full-precision query for g_code_distance_function. NB: Assumes that
+ * the global quantizer is trained.
+ * @param query is the query to transform.
+ * @return the transformed query.
+ */
+CodeQuery prepare_code_query(const float* query);
+
+/**
+ * External linkage. Globally scoped pointer to the distance function used between a query transformed by
+ * prepare_code_query and a compressed code of the global quantizer. Matches the metric of
+ * g_distance_function. Euclidean distances return FLOAT_MAX as soon as they exceed the threshold.
+ */
+extern float (*g_code_distance_function)(const CodeQuery&, const std::uint8_t*, const float&);
+
+/**
+ * @brief The Metric enum is used to define globally the type of distance function used. HAMMING is the only
+ * metric of BINARY descriptors.
+ */
+enum Metric { EUCLIDEAN_OPT_UNROLL = 0, ANGULAR, EUCLIDEAN_HALT_OPT_UNROLL, HAMMING };
+
+/**
+ * External linkage. Globally scoped metric of g_distance_function, e.g. such that a saved index restores it.
+ */
+extern Metric g_metric;
+
+/**
+ * Set the globally used distance function and g_metric. The kernels are chosen based on the global
+ * descriptor type.
  * @param Metric defines what functions will be used.
  */
 void set_distance_function(Metric);
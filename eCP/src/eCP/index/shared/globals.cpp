@@ -10,4 +10,24 @@ const float FLOAT_MIN = std::numeric_limits<float>::min();
  */
 unsigned int g_vector_dimensions;
 
+/**
+ * @brief g_descriptor_type is the element type of the dataset.
+ */
+DescriptorType g_descriptor_type = DescriptorType::FLOAT32;
+
+unsigned int descriptor_size_in_bytes()
+{
+  switch (g_descriptor_type) {
+    case DescriptorType::UINT8:
+    case DescriptorType::INT8:
+      return g_vector_dimensions;
+
+    case DescriptorType::BINARY:
+      return (g_vector_dimensions + 7) / 8;
+
+    default:
+      return g_vector_dimensions * sizeof(float);
+  }
+}
+
 }  // namespace globals
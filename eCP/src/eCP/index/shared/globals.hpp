@@ -13,6 +13,20 @@ extern const float FLOAT_MIN;
 
 extern unsigned int g_vector_dimensions;
 
+/**
+ * @brief The DescriptorType enum defines the element type of the feature descriptors contained in the index.
+ * BINARY descriptors are bit-packed with g_vector_dimensions being the number of bits.
+ */
+enum DescriptorType { FLOAT32 = 0, UINT8, INT8, BINARY };
+
+extern DescriptorType g_descriptor_type;
+
+/**
+ * @brief descriptor_size_in_bytes returns the storage size of a single descriptor based on the global
+ * dimensionality and descriptor type.
+ */
+unsigned int descriptor_size_in_bytes();
+
 }  // namespace globals
 
 #endif  // GLOBALS_H
\ No newline at end of file
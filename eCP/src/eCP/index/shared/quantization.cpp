@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cmath>
+#include <eCP/index/shared/globals.hpp>
+#include <eCP/index/shared/quantization.hpp>
+#include <stdexcept>
+
+namespace quantization {
+
+/// Definition of global quantizer, extern in header
+ScalarQuantizer g_quantizer;
+
+void train(const std::vector<const float*>& descriptors)
+{
+  if (descriptors.empty()) {
+    throw std::invalid_argument("quantization: Cannot train quantizer on an empty set of descriptors.");
+  }
+
+  const unsigned dimensions = globals::g_vector_dimensions;
+  std::vector<float> mins(descriptors.front(), descriptors.front() + dimensions);
+  std::vector<float> maxs(mins);
+
+  for (const float* descriptor : descriptors) {
+    for (unsigned i = 0; i < dimensions; ++i) {
+      mins[i] = std::min(mins[i], descriptor[i]);
+      maxs[i] = std::max(maxs[i], descriptor[i]);
+    }
+  }
+
+  ScalarQuantizer quantizer;
+  quantizer.offsets = mins;
+  quantizer.scales.resize(dimensions);
+
+  for (unsigned i = 0; i < dimensions; ++i) {
+    const float range = maxs[i] - mins[i];
+    quantizer.scales[i] = (range > 0) ? range / 255.0f : 1.0f;  // Constant dimensions encode as level 0.
+  }
+
+  g_quantizer = quantizer;
+}
+
+void reset() { g_quantizer = ScalarQuantizer{}; }
+
+bool is_enabled()
+{
+  return globals::g_descriptor_type == globals::DescriptorType::FLOAT32 && !g_quantizer.scales.empty() &&
+         g_quantizer.scales.size() == globals::g_vector_dimensions;
+}
+
+void encode(const float* descriptor, std::uint8_t* code)
+{
+  const float* offsets = g_quantizer.offsets.data();
+  const float* scales = g_quantizer.scales.data();
+
+  for (unsigned i = 0; i < globals::g_vector_dimensions; ++i) {
+    const float level = std::round((descriptor[i] - offsets[i]) / scales[i]);
+    code[i] = static_cast<std::uint8_t>(std::min(255.0f, std::max(0.0f, level)));
+  }
+}
+
+}  // namespace quantization
@@ -0,0 +1,59 @@
+#ifndef QUANTIZATION_HPP
+#define QUANTIZATION_HPP
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Namespace contains the compressed (scalar quantized) representation of feature descriptors used for the
+ * two-stage search, where clusters are first scanned using compact codes and only the best candidates are
+ * re-ranked against the full-precision descriptors.
+ */
+namespace quantization {
+
+/**
+ * @brief The ScalarQuantizer struct maps each dimension of a float descriptor linearly onto 256 levels such
+ * that a descriptor is represented by g_vector_dimensions bytes. A value x in dimension i is decoded as
+ * offsets[i] + code[i] * scales[i].
+ */
+struct ScalarQuantizer {
+  std::vector<float> offsets;  // Per dimension minimum value seen during training.
+  std::vector<float> scales;   // Per dimension step size between two neighbouring levels.
+};
+
+/**
+ * External linkage. Globally scoped quantizer used when compression is enabled.
+ */
+extern ScalarQuantizer g_quantizer;
+
+/**
+ * @brief train fits the global quantizer to the value range of the given descriptors and thereby enables
+ * compression for all clusters encoded afterwards, see Node::encode_points. NB: Assumes that
+ * g_vector_dimensions is set.
+ * @param descriptors is the collection of descriptors to fit the quantizer to. Must not be empty.
+ */
+void train(const std::vector<const float*>& descriptors);
+
+/**
+ * @brief reset disables compression by discarding the trained global quantizer.
+ */
+void reset();
+
+/**
+ * @brief is_enabled tells whether the global quantizer is trained for the current dimensionality. Only
+ * FLOAT32 descriptors are compressed.
+ * @return true if clusters should carry the compressed codes of their points otherwise false.
+ */
+bool is_enabled();
+
+/**
+ * @brief encode compresses a descriptor using the global quantizer. Values outside of the trained range are
+ * clamped to the nearest level.
+ * @param descriptor is the full-precision descriptor to encode.
+ * @param code is the destination of g_vector_dimensions bytes.
+ */
+void encode(const float* descriptor, std::uint8_t* code);
+
+}  // namespace quantization
+
+#endif  // QUANTIZATION_HPP
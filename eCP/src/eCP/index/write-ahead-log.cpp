@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <cstring>
+#include <eCP/index/maintenance.hpp>
+#include <eCP/index/shared/globals.hpp>
+#include <eCP/index/write-ahead-log.hpp>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+/*
+ * Namespace containing testable helpers of the write-ahead log. Compilation unit only.
+ *
+ * The log file starts with a header of the magic bytes followed by the descriptor size in bytes and the
+ * descriptor type as 32 bit integers. Each record is the 32 bit length and CRC-32 of its payload followed by
+ * the payload, which is the operation byte, the 64 bit sequence number and id and for insertions and updates
+ * the descriptor. Logs of version 01 lack the sequence number and are not read, as saving truncates a log.
+ */
+namespace write_ahead_log_helpers {
+
+const char MAGIC[8] = {'e', 'C', 'P', 'W', 'A', 'L', '0', '2'};
+const std::size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(std::uint32_t);
+const std::size_t RECORD_HEADER_SIZE = 2 * sizeof(std::uint32_t);
+const std::size_t PAYLOAD_HEADER_SIZE = sizeof(std::uint8_t) + 2 * sizeof(std::uint64_t);
+
+/**
+ * @brief crc32 computes the CRC-32 (IEEE 802.3) checksum of the given bytes.
+ */
+std::uint32_t crc32(const char* bytes, std::size_t n)
+{
+  static const auto table = [] {
+    std::vector<std::uint32_t> entries(256);
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t entry = i;
+      for (unsigned bit = 0; bit < 8; ++bit) {
+        entry = (entry & 1) ? 0xEDB88320u ^ (entry >> 1) : entry >> 1;
+      }
+      entries[i] = entry;
+    }
+    return entries;
+  }();
+
+  std::uint32_t crc = 0xFFFFFFFFu;
+  for (std::size_t i = 0; i < n; ++i) {
+    crc = table[(crc ^ static_cast<std::uint8_t>(bytes[i])) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @brief append_bytes appends the object representation of a value to the buffer.
+ */
+template <typename T>
+void append_bytes(std::vector<char>& buffer, const T& value)
+{
+  const auto* bytes = reinterpret_cast<const char*>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * @brief read_bytes reads a value from its object representation.
+ */
+template <typename T>
+T read_bytes(const char* bytes)
+{
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+/**
+ * @brief header is the header of a log of descriptors of the global descriptor type.
+ */
+std::vector<char> header()
+{
+  std::vector<char> bytes(MAGIC, MAGIC + sizeof(MAGIC));
+  append_bytes(bytes, static_cast<std::uint32_t>(globals::descriptor_size_in_bytes()));
+  append_bytes(bytes, static_cast<std::uint32_t>(globals::g_descriptor_type));
+  return bytes;
+}
+
+/**
+ * @brief The Record struct is a view of a complete and intact record in the contents of a log.
+ */
+struct Record {
+  write_ahead_log::Operation operation;
+  std::uint64_t sequence;
+  unsigned long id;
+  const char* descriptor;  // Points into the contents, thus possibly unaligned. nullptr for erases.
+};
+
+/**
+ * @brief read_records validates the header and reads the intact records of the contents of a log.
+ * @param contents is the contents of a log file.
+ * @param records is the collection of records to append to.
+ * @return the length of the contents up to and including the last intact record.
+ */
+std::size_t read_records(const std::vector<char>& contents, std::vector<Record>& records)
+{
+  const auto expected = header();
+  if (contents.size() < HEADER_SIZE || !std::equal(expected.begin(), expected.end(), contents.begin())) {
+    throw std::invalid_argument(
+        "write_ahead_log: The log is not a log of descriptors of the type and size of the index.");
+  }
+
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  std::size_t offset = HEADER_SIZE;
+
+  while (contents.size() - offset >= RECORD_HEADER_SIZE) {
+    const auto length = read_bytes<std::uint32_t>(&contents[offset]);
+    const auto checksum = read_bytes<std::uint32_t>(&contents[offset + sizeof(std::uint32_t)]);
+    const char* payload = &contents[offset + RECORD_HEADER_SIZE];
+
+    if (length < PAYLOAD_HEADER_SIZE || contents.size() - offset - RECORD_HEADER_SIZE < length ||
+        crc32(payload, length) != checksum) {
+      break;  // Torn or corrupt tail.
+    }
+
+    const auto operation = static_cast<write_ahead_log::Operation>(read_bytes<std::uint8_t>(payload));
+    const bool has_descriptor = operation != write_ahead_log::Operation::ERASE;
+    if (length != PAYLOAD_HEADER_SIZE + (has_descriptor ? bytes : 0)) {
+      break;
+    }
+
+    const char* sequence = payload + sizeof(std::uint8_t);
+    const char* descriptor = payload + PAYLOAD_HEADER_SIZE;
+    records.push_back(Record{operation, read_bytes<std::uint64_t>(sequence),
+                             read_bytes<std::uint64_t>(sequence + sizeof(std::uint64_t)),
+                             has_descriptor ? descriptor : nullptr});
+    offset += RECORD_HEADER_SIZE + length;
+  }
+
+  return offset;
+}
+
+/**
+ * @brief read_file reads the whole contents of a file.
+ * @return the contents, which are empty if the file does not exist.
+ */
+std::vector<char> read_file(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief write_fully writes all bytes to the file and syncs it.
+ */
+void write_fully(int file, const char* bytes, std::size_t n)
+{
+  while (n > 0) {
+    const ssize_t written = ::write(file, bytes, n);
+    if (written < 0) {
+      throw std::runtime_error("write_ahead_log: Could not write to the log.");
+    }
+    bytes += written;
+    n -= written;
+  }
+
+  if (::fdatasync(file) != 0) {
+    throw std::runtime_error("write_ahead_log: Could not sync the log.");
+  }
+}
+
+/**
+ * @brief flush writes and syncs the pending records. Only the file of the log is locked while syncing, thus
+ * records are appended meanwhile.
+ */
+void flush(write_ahead_log::Log* const log)
+{
+  std::lock_guard<std::mutex> file_lock(log->file_mutex);  // Groups are taken and written in order.
+  {
+    std::lock_guard<std::mutex> lock(log->mutex);
+    log->committing.clear();
+    log->committing.swap(log->pending);
+    log->pending_records = 0;
+  }
+
+  if (!log->committing.empty()) {
+    write_fully(log->file, log->committing.data(), log->committing.size());
+  }
+}
+
+}  // namespace write_ahead_log_helpers
+
+namespace write_ahead_log {
+
+void enable(Index* const index, const std::string& path, unsigned commit_interval)
+{
+  if (index->log) {
+    return;
+  }
+
+  if (commit_interval == 0) {
+    throw std::invalid_argument("write_ahead_log: The commit interval must be larger than 0.");
+  }
+
+  // Continue after the last intact record, such that a torn tail does not hide subsequent records.
+  const auto contents = write_ahead_log_helpers::read_file(path);
+  std::size_t length{0};
+  if (!contents.empty()) {
+    std::vector<write_ahead_log_helpers::Record> records;
+    length = write_ahead_log_helpers::read_records(contents, records);
+    if (!records.empty() && records.back().sequence > index->log_sequence) {
+      throw std::invalid_argument("write_ahead_log: The log must be replayed before it is enabled.");
+    }
+  }
+
+  const int file = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (file < 0 || ::ftruncate(file, length) != 0 || ::lseek(file, 0, SEEK_END) < 0) {
+    if (file >= 0) {
+      ::close(file);
+    }
+    throw std::runtime_error("write_ahead_log: Could not open the log " + path + ".");
+  }
+
+  if (length == 0) {
+    const auto header = write_ahead_log_helpers::header();
+    write_ahead_log_helpers::write_fully(file, header.data(), header.size());
+  }
+
+  auto* log = new Log{};
+  log->file = file;
+  log->commit_interval = commit_interval;
+  index->log = log;
+}
+
+void disable(Index* const index)
+{
+  auto* log = index->log;
+  if (!log) {
+    return;
+  }
+
+  commit(index);
+  ::close(log->file);
+  index->log = nullptr;
+  delete log;
+}
+
+void commit(Index* const index)
+{
+  if (!index->log) {
+    return;
+  }
+
+  write_ahead_log_helpers::flush(index->log);
+}
+
+void truncate(Index* const index)
+{
+  auto* log = index->log;
+  if (!log) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> file_lock(log->file_mutex);
+  std::lock_guard<std::mutex> lock(log->mutex);
+  log->pending.clear();
+  log->pending_records = 0;
+
+  if (::ftruncate(log->file, write_ahead_log_helpers::HEADER_SIZE) != 0 ||
+      ::lseek(log->file, 0, SEEK_END) < 0 || ::fdatasync(log->file) != 0) {
+    throw std::runtime_error("write_ahead_log: Could not truncate the log.");
+  }
+}
+
+bool append(Index* const index, Operation operation, unsigned long id, const float* descriptor)
+{
+  const std::size_t bytes = (operation == Operation::ERASE) ? 0 : globals::descriptor_size_in_bytes();
+  const std::size_t length = write_ahead_log_helpers::PAYLOAD_HEADER_SIZE + bytes;
+
+  auto* log = index->log;
+  std::lock_guard<std::mutex> lock(log->mutex);
+  auto& pending = log->pending;
+  const std::size_t start = pending.size();
+
+  write_ahead_log_helpers::append_bytes(pending, static_cast<std::uint32_t>(length));
+  write_ahead_log_helpers::append_bytes(pending, std::uint32_t{0});  // Checksum written below.
+  write_ahead_log_helpers::append_bytes(pending, static_cast<std::uint8_t>(operation));
+  write_ahead_log_helpers::append_bytes(pending, ++index->log_sequence);
+  write_ahead_log_helpers::append_bytes(pending, static_cast<std::uint64_t>(id));
+  pending.insert(pending.end(), reinterpret_cast<const char*>(descriptor),
+                 reinterpret_cast<const char*>(descriptor) + bytes);
+
+  const char* payload = &pending[start + write_ahead_log_helpers::RECORD_HEADER_SIZE];
+  const std::uint32_t checksum = write_ahead_log_helpers::crc32(payload, length);
+  std::memcpy(&pending[start + sizeof(std::uint32_t)], &checksum, sizeof(checksum));
+
+  return ++log->pending_records >= log->commit_interval;
+}
+
+unsigned long replay(const std::string& path, Index* const index)
+{
+  if (index->log) {
+    throw std::invalid_argument("write_ahead_log: A log must not be enabled while replaying a log.");
+  }
+
+  const auto contents = write_ahead_log_helpers::read_file(path);
+  if (contents.empty()) {
+    return 0;
+  }
+
+  std::vector<write_ahead_log_helpers::Record> records;
+  write_ahead_log_helpers::read_records(contents, records);
+
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  std::vector<char> batch;       // Consecutive insertions applied at once.
+  std::vector<float> descriptor((bytes + sizeof(float) - 1) / sizeof(float));  // Aligned copy for updates.
+  unsigned long applied{0};
+
+  auto insert_batch = [&batch, bytes, index] {
+    if (!batch.empty()) {
+      maintenance::insert_batch(reinterpret_cast<const float*>(batch.data()), batch.size() / bytes, index);
+      batch.clear();
+    }
+  };
+
+  for (const auto& record : records) {
+    if (record.sequence <= index->log_sequence) {
+      continue;  // Contained by the saved index.
+    }
+
+    if (record.operation == Operation::INSERT) {
+      const unsigned long next_id = index->size + batch.size() / bytes;
+      if (record.id < next_id) {
+        continue;  // Contained by the index.
+      }
+      if (record.id > next_id) {
+        throw std::invalid_argument("write_ahead_log: The log does not continue the given index.");
+      }
+
+      batch.insert(batch.end(), record.descriptor, record.descriptor + bytes);
+      ++applied;
+      continue;
+    }
+
+    insert_batch();
+    if (record.id >= index->size) {
+      throw std::invalid_argument("write_ahead_log: The log does not continue the given index.");
+    }
+
+    if (record.operation == Operation::UPDATE) {
+      if (index->tombstones.size() > record.id && index->tombstones[record.id]) {
+        continue;  // Erased later on, as the index already contains the erase.
+      }
+      std::memcpy(descriptor.data(), record.descriptor, bytes);
+      maintenance::update(record.id, descriptor.data(), index);
+    }
+    else {
+      maintenance::erase(record.id, index);
+    }
+    ++applied;
+  }
+
+  insert_batch();
+  if (!records.empty()) {
+    index->log_sequence = std::max(index->log_sequence, records.back().sequence);
+  }
+  return applied;
+}
+
+}  // namespace write_ahead_log
@@ -0,0 +1,98 @@
+#ifndef WRITE_AHEAD_LOG_HPP
+#define WRITE_AHEAD_LOG_HPP
+
+#include <cstdint>
+#include <eCP/index/shared/data_structure.hpp>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Namespace contains the write-ahead log which makes the modifications of a dynamic index durable. Every
+ * insertion, update and erase is appended to an append-only file as a checksummed record before it is
+ * applied. An index is recovered by replaying the log onto the index it was logged from, e.g. the index
+ * loaded from its latest save or built again from the same dataset.
+ *
+ * Records are numbered in sequence and an index knows the number of the latest record applied to it, which
+ * is saved along with it. Saving the index truncates its log, as the records are contained by the snapshot,
+ * and replaying a log skips the records contained by the index in case the log was not truncated.
+ */
+namespace write_ahead_log {
+
+/**
+ * @brief The Operation enum identifies the modification stored in a record.
+ */
+enum Operation : std::uint8_t { INSERT = 1, UPDATE, ERASE };
+
+/**
+ * @brief The Log struct is an open write-ahead log. Records are collected in memory and written and synced to
+ * the file together every commit_interval records, i.e. group committed, such that logging costs a copy of
+ * the record per modification and a sync per group. Records are appended while a group is being synced.
+ */
+struct Log {
+  std::mutex file_mutex;         // Guards the two members below and keeps the groups in order while syncing.
+  int file;                      // Descriptor of the log file opened for appending.
+  std::vector<char> committing;  // Group being written and synced.
+  std::mutex mutex;              // Guards the members below as insertions may be logged in parallel.
+  std::vector<char> pending;     // Records appended since the last commit.
+  unsigned pending_records;      // Number of records in pending.
+  unsigned commit_interval;      // Records per commit.
+};
+
+/**
+ * @brief enable opens the log at the given path and appends every subsequent modification of the index to
+ * it. An existing log is continued after its last complete record, thus a log is replayed before it is
+ * enabled again after a crash. Records are numbered on from the latest record applied to the index, thus
+ * enabling a log holding records not applied to the index throws.
+ * @param index is the index to log. Has no effect if a log is already enabled.
+ * @param path is the path of the log file, which is created if it does not exist.
+ * @param commit_interval is the number of records written and synced at once. Up to commit_interval - 1
+ * of the latest modifications are lost on a crash unless committed. 1 syncs every modification.
+ */
+void enable(Index* const index, const std::string& path, unsigned commit_interval = 1);
+
+/**
+ * @brief disable commits the pending records and closes the log. Must be called before the index is deleted.
+ * @param index is the logged index. Has no effect if no log is enabled.
+ */
+void disable(Index* const index);
+
+/**
+ * @brief commit writes and syncs the pending records such that all preceding modifications are durable.
+ * @param index is the logged index. Has no effect if no log is enabled.
+ */
+void commit(Index* const index);
+
+/**
+ * @brief truncate discards all records of the log. Called once the index is saved, as the snapshot contains
+ * the logged modifications, such that the log only grows with the modifications since the latest save.
+ * @param index is the logged index. Has no effect if no log is enabled.
+ */
+void truncate(Index* const index);
+
+/**
+ * @brief append logs a modification and numbers it in sequence. Called by the modifications of the
+ * maintenance namespace, which commit once a commit is due. The record is only collected in memory, thus the
+ * caller may hold its locks while appending and commit after releasing them.
+ * @param index is the logged index. Must have a log enabled.
+ * @param operation is the modification.
+ * @param id is the id of the modified descriptor.
+ * @param descriptor is the new descriptor of insertions and updates, otherwise ignored.
+ * @return true if commit_interval records are pending, thus a commit is due.
+ */
+bool append(Index* const index, Operation operation, unsigned long id, const float* descriptor);
+
+/**
+ * @brief replay applies the records of a log in order to the index they were logged from. Insertions already
+ * contained by the index are skipped, like any record numbered up to the latest record applied to the index,
+ * and consecutive insertions are applied as batches. Replaying stops at
+ * the first incomplete or corrupt record, which is expected after a crash in the middle of a commit.
+ * @param path is the path of the log file.
+ * @param index is the index to recover. Must not have a log enabled.
+ * @return the number of applied records.
+ */
+unsigned long replay(const std::string& path, Index* const index);
+
+}  // namespace write_ahead_log
+
+#endif  // WRITE_AHEAD_LOG_HPP
@@ -1,10 +1,134 @@
-#include <eCP/utilities/H5Easy/H5Easy.h>
+#include <H5Cpp.h>
+#include <algorithm>
 #include <cassert>
+#include <fcntl.h>
 #include <cmath>
+#include <cstring>
 #include <eCP/utilities/utilities.hpp>
 #include <iostream>
+#include <new>
 #include <queue>
 #include <random>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace utilities {
+
+struct Hdf5Handle {
+  H5::H5File file;
+  H5::DataSet dataset;
+  std::size_t chunk_rows;  // Capacity of the chunk buffer in rows.
+};
+
+}  // namespace utilities
+
+/*
+ * Namespace containing testable helpers of the utilities. Compilation unit only.
+ */
+namespace utilities_helpers {
+
+/**
+ * @brief is_supported_type determines whether the elements of a dataset can be read as floats by the loader,
+ * i.e. whether they are float32, float64 or uint8.
+ * @param dataset is the dataset.
+ * @return true if the type is supported.
+ */
+bool is_supported_type(const H5::DataSet& dataset)
+{
+  switch (dataset.getTypeClass()) {
+    case H5T_FLOAT: {
+      const auto size = dataset.getFloatType().getSize();
+      return size == 4 || size == 8;
+    }
+    case H5T_INTEGER: {
+      const auto type = dataset.getIntType();
+      return type.getSize() == 1 && type.getSign() == H5T_SGN_NONE;
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief read_rows reads consecutive rows of a dataset converted to floats. HDF5 converts float64 and uint8
+ * elements while reading.
+ * @param dataset is the dataset with cols columns.
+ * @param begin is the first row to read.
+ * @param count is the number of rows to read.
+ * @param cols is the number of columns of the dataset.
+ * @param destination is the storage of count * cols floats.
+ */
+void read_rows(const H5::DataSet& dataset, std::size_t begin, std::size_t count, std::size_t cols,
+               float* destination)
+{
+  const hsize_t offset[2] = {begin, 0};
+  const hsize_t extent[2] = {count, cols};
+
+  auto file_space = dataset.getSpace();
+  file_space.selectHyperslab(H5S_SELECT_SET, extent, offset);
+  H5::DataSpace memory_space(2, extent);
+
+  dataset.read(destination, H5::PredType::NATIVE_FLOAT, memory_space, file_space);
+}
+
+/**
+ * @brief open_dataset opens a dataset for reading as floats. Throws std::runtime_error if the file or dataset
+ * cannot be opened and std::invalid_argument if the dataset is not of a supported type and shape.
+ * @param path is the path of the file.
+ * @param dataset is the name of the dataset.
+ * @param extent is set to the number of rows and columns of the dataset.
+ * @return the opened file and dataset.
+ */
+utilities::Hdf5Handle* open_dataset(const std::string& path, const std::string& dataset,
+                                    hsize_t (&extent)[2])
+{
+  // Errors are reported by exceptions, thus the error stack of HDF5 is not printed.
+  H5::Exception::dontPrint();
+
+  auto* handle = new utilities::Hdf5Handle{};
+  try {
+    handle->file.openFile(path, H5F_ACC_RDONLY);
+    handle->dataset = handle->file.openDataSet(dataset);
+  }
+  catch (const H5::Exception&) {
+    delete handle;
+    throw std::runtime_error("utilities: Could not open dataset " + dataset + " of " + path + ".");
+  }
+
+  const auto space = handle->dataset.getSpace();
+  if (space.getSimpleExtentNdims() != 2 || !is_supported_type(handle->dataset)) {
+    delete handle;
+    throw std::invalid_argument("utilities: Dataset " + dataset +
+                                " is not a two-dimensional float32, float64 or uint8 dataset.");
+  }
+
+  space.getSimpleExtentDims(extent);
+  return handle;
+}
+
+/**
+ * @brief vecs_type returns the type of a .fvecs, .bvecs or .ivecs file by the extension of its path.
+ * @param path is the path of the file.
+ * @return the type. Throws std::invalid_argument if the extension is none of these.
+ */
+utilities::VecsType vecs_type(const std::string& path)
+{
+  const auto extension = path.substr(path.find_last_of('.') + 1);
+  if (extension == "fvecs") {
+    return utilities::VecsType::FVECS;
+  }
+  if (extension == "bvecs") {
+    return utilities::VecsType::BVECS;
+  }
+  if (extension == "ivecs") {
+    return utilities::VecsType::IVECS;
+  }
+  throw std::invalid_argument("utilities: " + path + " is not a .fvecs, .bvecs or .ivecs file.");
+}
+
+}  // namespace utilities_helpers
 
 namespace utilities {
 
@@ -57,12 +181,160 @@ std::vector<std::vector<float>> generate_descriptors(const unsigned int count, c
   return vector_list;
 }
 
+Matrix allocate_matrix(std::size_t rows, std::size_t cols)
+{
+  void* storage{nullptr};
+  const std::size_t bytes = std::max<std::size_t>(rows * cols * sizeof(float), 1);
+  if (posix_memalign(&storage, MATRIX_ALIGNMENT, bytes) != 0) {
+    throw std::bad_alloc();
+  }
+
+  return Matrix{std::unique_ptr<float[], FreeDeleter>(static_cast<float*>(storage)), rows, cols};
+}
+
 std::vector<std::vector<float>> load_hdf5_file(std::string& path, std::string& dataset)
 {
-  LoadH5 data;
-  data.setFileName(path);
-  data.setVarName(dataset);
-  return data.getData();
+  // Copied a chunk at a time such that only a single chunk is held in addition to the vectors.
+  std::vector<std::vector<float>> descriptors;
+  Hdf5Stream* stream = open_hdf5_stream(path, dataset);
+  descriptors.reserve(stream->rows);
+
+  while (next_chunk(stream)) {
+    for (std::size_t i = 0; i < stream->chunk.rows; ++i) {
+      const float* row = stream->chunk.data.get() + i * stream->cols;
+      descriptors.emplace_back(row, row + stream->cols);
+    }
+  }
+
+  close_hdf5_stream(stream);
+  return descriptors;
+}
+
+Matrix load_hdf5_dataset(const std::string& path, const std::string& dataset, std::size_t chunk_rows)
+{
+  if (chunk_rows == 0) {
+    throw std::invalid_argument("utilities: Chunks must hold at least one row.");
+  }
+
+  hsize_t extent[2];
+  std::unique_ptr<Hdf5Handle> handle{utilities_helpers::open_dataset(path, dataset, extent)};
+  auto matrix = allocate_matrix(extent[0], extent[1]);
+
+  try {
+    for (std::size_t begin = 0; begin < matrix.rows; begin += chunk_rows) {
+      const auto count = std::min(chunk_rows, matrix.rows - begin);
+      utilities_helpers::read_rows(handle->dataset, begin, count, matrix.cols,
+                                   matrix.data.get() + begin * matrix.cols);
+    }
+  }
+  catch (const H5::Exception&) {
+    throw std::runtime_error("utilities: Could not read dataset " + dataset + " of " + path + ".");
+  }
+
+  return matrix;
+}
+
+Hdf5Stream* open_hdf5_stream(const std::string& path, const std::string& dataset, std::size_t chunk_rows)
+{
+  if (chunk_rows == 0) {
+    throw std::invalid_argument("utilities: Chunks must hold at least one row.");
+  }
+
+  hsize_t extent[2];
+  auto* handle = utilities_helpers::open_dataset(path, dataset, extent);
+  handle->chunk_rows = std::min<std::size_t>(chunk_rows, extent[0]);
+
+  auto chunk = allocate_matrix(handle->chunk_rows, extent[1]);
+  chunk.rows = 0;
+  return new Hdf5Stream{handle, extent[0], extent[1], 0, std::move(chunk)};
+}
+
+bool next_chunk(Hdf5Stream* const stream)
+{
+  stream->begin += stream->chunk.rows;
+  stream->chunk.rows = std::min(stream->handle->chunk_rows, stream->rows - stream->begin);
+  if (stream->chunk.rows == 0) {
+    return false;
+  }
+
+  try {
+    utilities_helpers::read_rows(stream->handle->dataset, stream->begin, stream->chunk.rows, stream->cols,
+                                 stream->chunk.data.get());
+  }
+  catch (const H5::Exception&) {
+    stream->chunk.rows = 0;
+    throw std::runtime_error("utilities: Could not read the next chunk of a dataset.");
+  }
+  return true;
+}
+
+void close_hdf5_stream(Hdf5Stream* stream)
+{
+  delete stream->handle;
+  delete stream;
+}
+
+VecsFile* open_vecs_file(const std::string& path)
+{
+  const auto type = utilities_helpers::vecs_type(path);
+  const std::size_t element_size = (type == VecsType::BVECS) ? sizeof(std::uint8_t) : sizeof(float);
+
+  const int file = ::open(path.c_str(), O_RDONLY);
+  struct stat status;
+  if (file < 0 || ::fstat(file, &status) != 0) {
+    if (file >= 0) {
+      ::close(file);
+    }
+    throw std::runtime_error("utilities: Could not open the vecs file " + path + ".");
+  }
+
+  const std::size_t size = status.st_size;
+  if (size == 0) {
+    ::close(file);
+    return new VecsFile{type, nullptr, 0, 0, 0, element_size, 0};
+  }
+
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+  ::close(file);  // The mapping keeps the file open.
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("utilities: Could not map the vecs file " + path + ".");
+  }
+
+  // The dimensionality of the first row determines the size of every row.
+  std::int32_t cols{0};
+  if (size >= sizeof(cols)) {
+    std::memcpy(&cols, mapping, sizeof(cols));
+  }
+  const std::size_t row_size = sizeof(cols) + static_cast<std::size_t>(cols) * element_size;
+  if (cols <= 0 || size % row_size != 0) {
+    ::munmap(mapping, size);
+    throw std::invalid_argument("utilities: The size of " + path + " does not match rows of " +
+                                std::to_string(cols) + " elements.");
+  }
+
+  return new VecsFile{type,         static_cast<const char*>(mapping), size, size / row_size,
+                      static_cast<std::size_t>(cols), element_size,    row_size};
+}
+
+const char* vecs_row(const VecsFile* const file, std::size_t i)
+{
+  return file->mapping + i * file->stride + sizeof(std::int32_t);
+}
+
+void copy_vecs_rows(const VecsFile* const file, std::size_t begin, std::size_t count, char* destination)
+{
+  const std::size_t row_bytes = file->cols * file->element_size;
+  for (std::size_t i = begin; i < begin + count; ++i, destination += row_bytes) {
+    std::memcpy(destination, vecs_row(file, i), row_bytes);
+  }
+}
+
+void close_vecs_file(VecsFile* file)
+{
+  if (file->mapping) {
+    ::munmap(const_cast<char*>(file->mapping), file->size);
+  }
+  delete file;
 }
 
 }  // namespace utilities
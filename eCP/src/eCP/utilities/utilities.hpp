@@ -1,6 +1,10 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -10,6 +14,68 @@
  */
 namespace utilities {
 
+/**
+ * @brief MATRIX_ALIGNMENT is the alignment in bytes of the storage of a Matrix, a cache line such that rows
+ * of suitable dimensionality can be loaded with aligned vector instructions.
+ */
+constexpr std::size_t MATRIX_ALIGNMENT = 64;
+
+/**
+ * @brief The FreeDeleter struct releases storage allocated with posix_memalign.
+ */
+struct FreeDeleter {
+  void operator()(float* storage) const { std::free(storage); }
+};
+
+/**
+ * @brief The Matrix struct holds descriptors row after row in a single aligned allocation such that they can
+ * be passed on as a pointer, e.g. to a batch insertion, without any copying.
+ */
+struct Matrix {
+  std::unique_ptr<float[], FreeDeleter> data;  // Storage of rows * cols floats, aligned to MATRIX_ALIGNMENT.
+  std::size_t rows;                            // Number of descriptors.
+  std::size_t cols;                            // Dimensionality of the descriptors.
+};
+
+/**
+ * @brief Hdf5Handle holds the opened HDF5 file and dataset of a Hdf5Stream. Compilation unit only such that
+ * users of the utilities need not include the HDF5 headers.
+ */
+struct Hdf5Handle;
+
+/**
+ * @brief The Hdf5Stream struct reads a two-dimensional HDF5 dataset a chunk of rows at a time into a reused
+ * buffer. Thus a dataset larger than memory can be processed, e.g. inserted into an index, one chunk at a
+ * time.
+ */
+struct Hdf5Stream {
+  Hdf5Handle* handle;  // The opened file and dataset.
+  std::size_t rows;    // Number of descriptors in the dataset.
+  std::size_t cols;    // Dimensionality of the descriptors.
+  std::size_t begin;   // Position in the dataset of the first row of the chunk.
+  Matrix chunk;        // The last read rows. Its rows is 0 before the first and after the last chunk.
+};
+
+/**
+ * @brief VecsType is the element type of a .fvecs, .bvecs or .ivecs file, i.e. float32, uint8 or int32.
+ */
+enum class VecsType { FVECS, BVECS, IVECS };
+
+/**
+ * @brief The VecsFile struct is a memory-mapped .fvecs, .bvecs or .ivecs file. Every row is stored as its
+ * dimensionality as an int32 followed by its elements, thus the rows are views into the mapping stride bytes
+ * apart and are paged in on access rather than copied.
+ */
+struct VecsFile {
+  VecsType type;             // Element type of the rows.
+  const char* mapping;       // The mapped file, nullptr if empty.
+  std::size_t size;          // Bytes of the mapped file.
+  std::size_t rows;          // Number of rows.
+  std::size_t cols;          // Number of elements of every row.
+  std::size_t element_size;  // Bytes of an element.
+  std::size_t stride;        // Bytes from the elements of a row to the elements of the next row.
+};
+
 /**
  * @brief get_random_unique_indexes returns a set of size amount of uniquely sampled indexes from
  * the range 0..container_size.
@@ -31,6 +97,14 @@ std::vector<unsigned> get_random_unique_indexes(unsigned amount, unsigned contai
 std::vector<std::vector<float>> generate_descriptors(unsigned int count, unsigned int dimension,
                                                      unsigned int upper_bound);
 
+/**
+ * @brief allocate_matrix allocates an uninitialized matrix aligned to MATRIX_ALIGNMENT bytes.
+ * @param rows is the number of descriptors.
+ * @param cols is the dimensionality of the descriptors.
+ * @return the matrix.
+ */
+Matrix allocate_matrix(std::size_t rows, std::size_t cols);
+
 /**
  * @brief Opens .hdf5 or .h5 files and outputs the specified dataset as multidimensional vectors
  * @param path path for hdf5 file
@@ -38,6 +112,76 @@ std::vector<std::vector<float>> generate_descriptors(unsigned int count, unsigne
  * @return  multidimensional vectors of type float
  */
 std::vector<std::vector<float>> load_hdf5_file(std::string& path, std::string& dataset);
+
+/**
+ * @brief load_hdf5_dataset reads a two-dimensional float32, float64 or uint8 dataset from a .hdf5 or .h5 file
+ * into a contiguous matrix of floats. The rows are read and converted a chunk at a time directly into the
+ * matrix, thus the dataset is held in memory once.
+ * @param path is the path of the file.
+ * @param dataset is the name of the dataset.
+ * @param chunk_rows is the number of rows read at a time.
+ * @return the matrix.
+ */
+Matrix load_hdf5_dataset(const std::string& path, const std::string& dataset, std::size_t chunk_rows = 65536);
+
+/**
+ * @brief open_hdf5_stream opens a two-dimensional float32, float64 or uint8 dataset of a .hdf5 or .h5 file
+ * for reading a chunk at a time. Throws std::runtime_error if the file or dataset cannot be opened and
+ * std::invalid_argument if the dataset is not of a supported type and shape.
+ * @param path is the path of the file.
+ * @param dataset is the name of the dataset.
+ * @param chunk_rows is the number of rows read at a time.
+ * @return the stream positioned before the first chunk. Must be closed with close_hdf5_stream.
+ */
+Hdf5Stream* open_hdf5_stream(const std::string& path, const std::string& dataset,
+                             std::size_t chunk_rows = 65536);
+
+/**
+ * @brief next_chunk reads the next chunk of rows of the stream, converted to floats, into stream->chunk.
+ * @param stream is the stream to read from.
+ * @return true if a chunk was read and false if all rows have been read.
+ */
+bool next_chunk(Hdf5Stream* const stream);
+
+/**
+ * @brief close_hdf5_stream closes the file of the stream and releases it.
+ * @param stream is the stream to close.
+ */
+void close_hdf5_stream(Hdf5Stream* stream);
+
+/**
+ * @brief open_vecs_file maps a .fvecs, .bvecs or .ivecs file, the type given by the extension of its path.
+ * Every row must be of the dimensionality of the first row. Throws std::runtime_error if the file cannot be
+ * mapped and std::invalid_argument if it is not of a known type or its size does not match its rows.
+ * @param path is the path of the file.
+ * @return the mapped file. Must be closed with close_vecs_file.
+ */
+VecsFile* open_vecs_file(const std::string& path);
+
+/**
+ * @brief vecs_row returns a view of the elements of a row of a mapped file. The elements of row i + 1 follow
+ * file->stride bytes later.
+ * @param file is the mapped file.
+ * @param i is the position of the row.
+ * @return a pointer to the elements of the row.
+ */
+const char* vecs_row(const VecsFile* const file, std::size_t i);
+
+/**
+ * @brief copy_vecs_rows copies the elements of consecutive rows of a mapped file without their dimension
+ * headers, e.g. to insert a chunk of rows at once.
+ * @param file is the mapped file.
+ * @param begin is the position of the first row.
+ * @param count is the number of rows.
+ * @param destination is the storage of count * file->cols elements.
+ */
+void copy_vecs_rows(const VecsFile* const file, std::size_t begin, std::size_t count, char* destination);
+
+/**
+ * @brief close_vecs_file unmaps the file and releases it.
+ * @param file is the file to close.
+ */
+void close_vecs_file(VecsFile* file);
 }  // namespace utilities
 
 #endif  // UTILITY_H
@@ -5,8 +5,10 @@
 #include "../src/eCP/index/shared/data_structure.hpp"
 %}
 
+%include std_string.i
 %include std_vector.i
 %include std_pair.i
+%include stdint.i
 %include typemaps.i
 
 namespace std {
@@ -15,8 +17,22 @@ namespace std {
   %template(FloatFloatVector) std::vector<std::vector<float>>;
   %template(PairVector) std::pair<std::vector<unsigned int>, std::vector<float>>;
   %template(FloatPointerVector) std::vector<float*>;
+  %template(UInt8Vector) std::vector<uint8_t>;
+  %template(UInt8UInt8Vector) std::vector<std::vector<uint8_t>>;
+  %template(Int8Vector) std::vector<int8_t>;
+  %template(Int8Int8Vector) std::vector<std::vector<int8_t>>;
 }
 
+// Byte descriptor overloads get their own names since Python lists of ints would match the float overloads.
+%rename(eCP_Index_uint8) eCP::eCP_Index(const std::vector<std::vector<uint8_t>>&, unsigned, unsigned, bool);
+%rename(eCP_Index_int8) eCP::eCP_Index(const std::vector<std::vector<int8_t>>&, unsigned, unsigned, bool);
+%rename(query_uint8) eCP::query(Index*, std::vector<uint8_t>, unsigned int, unsigned int);
+%rename(query_int8) eCP::query(Index*, std::vector<int8_t>, unsigned int, unsigned int);
+%rename(query_uint8) eCP::query(MappedIndex*, std::vector<uint8_t>, unsigned int, unsigned int);
+%rename(query_int8) eCP::query(MappedIndex*, std::vector<int8_t>, unsigned int, unsigned int);
+%rename(query_uint8) eCP::query(DiskIndex*, std::vector<uint8_t>, unsigned int, unsigned int);
+%rename(query_int8) eCP::query(DiskIndex*, std::vector<int8_t>, unsigned int, unsigned int);
+
 %include "../include/eCP/index/eCP.hpp"
 %include "../src/eCP/index/shared/data_structure.hpp"
 
@@ -24,10 +40,48 @@ namespace std {
 //%typemap(newfree) Index * "free($1);";
 
 %newobject eCP::eCP_Index;
+%newobject eCP::eCP_Index_from_file;
+%newobject eCP::load;
+%newobject eCP::load_checkpoint;
 
 namespace eCP {
   Index* eCP_Index(const std::vector<std::vector<float>>& descriptors, unsigned cluster_size, unsigned int metric);
-  std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<float> query, unsigned int k, unsigned int b);
+  Index* eCP_Index(const std::vector<std::vector<uint8_t>>& descriptors, unsigned cluster_size, unsigned metric, bool batch_build = true);
+  Index* eCP_Index(const std::vector<std::vector<int8_t>>& descriptors, unsigned cluster_size, unsigned metric, bool batch_build = true);
+  Index* eCP_Index_from_file(const std::string& path, unsigned cluster_size, unsigned metric, bool batch_build = true);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<uint8_t> query, unsigned int k, unsigned int b);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<int8_t> query, unsigned int k, unsigned int b);
+  void insert_batch_from_file(const std::string& path, Index* const index, size_t chunk_size = 65536);
+  void enable_compression(Index* const index);
+  void erase(unsigned long id, Index* const index);
+  void compact(Index* const index);
+  void enable_delta_buffer(Index* const index, size_t capacity, unsigned max_age = 0);
+  void disable_delta_buffer(Index* const index);
+  void enable_background_maintenance(Index* const index, unsigned publish_interval = 0);
+  void disable_background_maintenance(Index* const index);
+  void save(Index* const index, const std::string& path);
+  Index* load(const std::string& path);
+  void checkpoint(Index* const index, const std::string& path);
+  Index* load_checkpoint(const std::string& path);
+  void fold_checkpoint(const std::string& checkpoint_path, const std::string& path);
+  void save_mapped(Index* const index, const std::string& path);
+  MappedIndex* open_mapped(const std::string& path);
+  void close_mapped(MappedIndex* const index);
+  void save_shared(Index* const index, const std::string& name);
+  MappedIndex* open_shared(const std::string& name);
+  void remove_shared(const std::string& name);
+  void save_on_disk(Index* const index, const std::string& path);
+  void build_on_disk(const std::string& dataset_path, const std::string& path, unsigned cluster_size,
+                     unsigned metric, size_t memory_budget = 1073741824);
+  DiskIndex* open_on_disk(const std::string& path, size_t cache_capacity = 0, unsigned thread_count = 8);
+  void close_on_disk(DiskIndex* const index);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(Index* index, std::vector<float> query, unsigned int k, unsigned int b, unsigned int rerank_factor = 4);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, std::vector<float> query, unsigned int k, unsigned int b, unsigned int rerank_factor = 4);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, std::vector<uint8_t> query, unsigned int k, unsigned int b);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(MappedIndex* index, std::vector<int8_t> query, unsigned int k, unsigned int b);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, std::vector<float> query, unsigned int k, unsigned int b);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, std::vector<uint8_t> query, unsigned int k, unsigned int b);
+  std::pair<std::vector<unsigned int>, std::vector<float>> query(DiskIndex* index, std::vector<int8_t> query, unsigned int k, unsigned int b);
 }
 
 // clang-format on
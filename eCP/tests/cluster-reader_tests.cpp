@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <eCP/index/eCP.hpp>
+#include <eCP/index/query-processing.hpp>
+#include <eCP/index/serialization.hpp>
+#include <eCP/index/shared/distance.hpp>
+
+// Include to test helpers, which are compilation unit only.
+#include <eCP/index/cluster-reader.cpp>
+
+/*
+ * Helpers
+ */
+
+std::vector<std::vector<float>> get_cluster_reader_test_dataset(unsigned n)
+{
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < n; ++i) {
+    dataset.push_back({static_cast<float>(i % 11), static_cast<float>(i % 7), static_cast<float>(i)});
+  }
+  return dataset;
+}
+
+std::string get_disk_index_path(const std::string& name)
+{
+  const auto path = testing::TempDir() + "eCP_" + name + ".disk";
+  std::remove(path.c_str());
+  return path;
+}
+
+cluster_reader::ClusterBlock get_block(std::size_t size)
+{
+  return std::make_shared<const std::vector<char>>(size, 0);
+}
+
+/**
+ * @brief fetch_ids fetches the given clusters and collects the ids of their points in increasing order.
+ */
+std::vector<std::uint64_t> fetch_ids(DiskIndex& index, const std::vector<const MappedNode*>& clusters)
+{
+  std::vector<std::uint64_t> ids;
+  cluster_reader::fetch_clusters(index, clusters, [&ids](const char* block, std::uint64_t point_count) {
+    const auto* block_ids = reinterpret_cast<const std::uint64_t*>(block);
+    ids.insert(ids.end(), block_ids, block_ids + point_count);
+  });
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+/*
+ * cluster_reader_tests
+ */
+
+TEST(cluster_reader_tests, fetch_clusters_given_threads_scans_same_points_as_synchronous_reads)
+{
+  const auto path = get_disk_index_path("fetch");
+  auto dataset = get_cluster_reader_test_dataset(400);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save_on_disk(index, path);
+  delete index;
+
+  DiskIndex* synchronous = serialization::open_on_disk(path, 0, 0);
+  DiskIndex* threaded = serialization::open_on_disk(path, 0, 4);
+
+  for (unsigned i = 0; i < 10; ++i) {
+    float* query = dataset[i * 37].data();
+    const auto clusters = query_processing::find_b_nearest_clusters(synchronous->routing, query, 5);
+    std::vector<const MappedNode*> threaded_clusters;
+    for (const MappedNode* cluster : clusters) {
+      threaded_clusters.emplace_back(&threaded->nodes[cluster - synchronous->nodes.data()]);
+    }
+
+    const auto ids = fetch_ids(*synchronous, clusters);
+    EXPECT_FALSE(ids.empty());
+    EXPECT_EQ(fetch_ids(*threaded, threaded_clusters), ids);
+  }
+
+  serialization::close_on_disk(synchronous);
+  serialization::close_on_disk(threaded);
+}
+
+TEST(cluster_reader_tests, query_given_threads_and_cache_returns_same_distances)
+{
+  const auto path = get_disk_index_path("query");
+  auto dataset = get_cluster_reader_test_dataset(400);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save_on_disk(index, path);
+
+  DiskIndex* disk = serialization::open_on_disk(path, 1 << 20, 4);
+
+  // The order of ties depends on the order the clusters arrive in, thus only distances are compared.
+  for (unsigned repetition = 0; repetition < 2; ++repetition) {
+    for (unsigned i = 0; i < 10; ++i) {
+      EXPECT_EQ(eCP::query(disk, dataset[i * 29], 5, 3).second,
+                eCP::query(index, dataset[i * 29], 5, 3).second);
+    }
+  }
+  EXPECT_GT(disk->reader->cache_size, 0);
+
+  serialization::close_on_disk(disk);
+  delete index;
+}
+
+TEST(cluster_reader_tests, fetch_clusters_given_unreadable_block_throws)
+{
+  const auto path = get_disk_index_path("unreadable");
+  auto dataset = get_cluster_reader_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save_on_disk(index, path);
+  delete index;
+
+  for (unsigned thread_count : {0, 2}) {
+    DiskIndex* disk = serialization::open_on_disk(path, 0, thread_count);
+    const MappedNode* cluster = &disk->nodes.back();
+    disk->block_offsets.back() = 1ul << 40;  // Beyond the end of the file.
+
+    EXPECT_THROW(fetch_ids(*disk, {cluster}), std::runtime_error);
+    serialization::close_on_disk(disk);
+  }
+}
+
+/*
+ * cluster_reader_helpers_tests
+ */
+
+TEST(cluster_reader_helpers_tests, remember_given_full_cache_evicts_least_recently_used)
+{
+  cluster_reader::ClusterReader reader{};
+  reader.cache_capacity = 100;
+
+  cluster_reader_helpers::remember(&reader, 1, get_block(40));
+  cluster_reader_helpers::remember(&reader, 2, get_block(40));
+  EXPECT_NE(cluster_reader_helpers::recall(&reader, 1), nullptr);  // 2 is now the least recently used.
+  cluster_reader_helpers::remember(&reader, 3, get_block(40));
+
+  EXPECT_NE(cluster_reader_helpers::recall(&reader, 1), nullptr);
+  EXPECT_EQ(cluster_reader_helpers::recall(&reader, 2), nullptr);
+  EXPECT_NE(cluster_reader_helpers::recall(&reader, 3), nullptr);
+  EXPECT_EQ(reader.cache_size, 80);
+  EXPECT_EQ(reader.recency, (std::list<std::uint64_t>{3, 1}));
+}
+
+TEST(cluster_reader_helpers_tests, remember_given_block_larger_than_cache_skips_it)
+{
+  cluster_reader::ClusterReader reader{};
+  reader.cache_capacity = 100;
+
+  cluster_reader_helpers::remember(&reader, 1, get_block(40));
+  cluster_reader_helpers::remember(&reader, 2, get_block(101));
+
+  EXPECT_NE(cluster_reader_helpers::recall(&reader, 1), nullptr);
+  EXPECT_EQ(cluster_reader_helpers::recall(&reader, 2), nullptr);
+  EXPECT_EQ(reader.cache_size, 40);
+}
@@ -179,3 +179,91 @@ TEST(
 
   EXPECT_EQ(distance::g_distance_function, &distance::euclidean_distance_unroll_halt);
 }
+
+TEST(distance_tests, euclidean_distance_integer_given_uint8_vectors_returns_squared_distance)
+{
+  // arrange
+  globals::g_vector_dimensions = 3;
+  std::uint8_t a[3] = {0, 255, 10};
+  std::uint8_t b[3] = {255, 0, 13};
+
+  // act
+  float actual = distance::euclidean_distance_integer<std::uint8_t>(reinterpret_cast<const float*>(a),
+                                                                    reinterpret_cast<const float*>(b));
+
+  // assert
+  EXPECT_FLOAT_EQ(actual, 255 * 255 * 2 + 9);
+}
+
+TEST(distance_tests, euclidean_distance_integer_avx2_given_int8_vectors_equals_scalar_distance)
+{
+  if (!__builtin_cpu_supports("avx2")) {
+    GTEST_SKIP();
+  }
+
+  // arrange, 70 dimensions covers two 32 byte blocks and a scalar tail.
+  globals::g_vector_dimensions = 70;
+  std::int8_t a[70], b[70];
+  for (int i = 0; i < 70; ++i) {
+    a[i] = static_cast<std::int8_t>(i * 7 - 128);
+    b[i] = static_cast<std::int8_t>(127 - i * 3);
+  }
+  auto* a_ = reinterpret_cast<const float*>(a);
+  auto* b_ = reinterpret_cast<const float*>(b);
+
+  // act
+  float expected = distance::euclidean_distance_integer<std::int8_t>(a_, b_);
+  float actual = distance::euclidean_distance_integer_avx2<std::int8_t, false>(a_, b_, globals::FLOAT_MAX);
+
+  // assert
+  EXPECT_FLOAT_EQ(actual, expected);
+  EXPECT_EQ((distance::euclidean_distance_integer_avx2<std::int8_t, true>(a_, b_, 1)), globals::FLOAT_MAX);
+}
+
+TEST(distance_tests, set_distance_function_given_UINT8_descriptor_type_sets_integer_distance)
+{
+  globals::g_vector_dimensions = 8;
+  globals::g_descriptor_type = globals::DescriptorType::UINT8;
+
+  distance::set_distance_function(distance::Metric::ANGULAR);
+
+  EXPECT_EQ(distance::g_distance_function, &distance::angular_distance_integer<std::uint8_t>);
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+}
+
+TEST(distance_tests, hamming_distance_variants_given_binary_descriptors_return_number_of_differing_bits)
+{
+  // arrange, 72 bytes covers a full 64 byte block, a full word and a tail.
+  globals::g_descriptor_type = globals::DescriptorType::BINARY;
+  globals::g_vector_dimensions = 72 * 8;
+  std::uint8_t a[72] = {}, b[72] = {};
+  a[0] = 0xFF;   // 8 bits
+  b[63] = 0x01;  // 1 bit
+  a[64] = 0x0F;  // 4 bits
+  b[71] = 0x80;  // 1 bit
+  auto* a_ = reinterpret_cast<const float*>(a);
+  auto* b_ = reinterpret_cast<const float*>(b);
+
+  // act and assert
+  EXPECT_FLOAT_EQ(distance::hamming_distance(a_, b_), 14);
+
+  if (__builtin_cpu_supports("popcnt")) {
+    EXPECT_FLOAT_EQ(distance::hamming_distance_popcnt(a_, b_), 14);
+  }
+
+  if (__builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512bw")) {
+    EXPECT_FLOAT_EQ(distance::hamming_distance_avx512(a_, b_), 14);
+  }
+
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+}
+
+TEST(distance_tests, set_distance_function_given_BINARY_descriptor_type_and_non_HAMMING_metric_throws)
+{
+  globals::g_vector_dimensions = 256;
+  globals::g_descriptor_type = globals::DescriptorType::BINARY;
+
+  EXPECT_THROW(distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL),
+               std::invalid_argument);
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+}
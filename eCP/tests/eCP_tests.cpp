@@ -1,8 +1,13 @@
-﻿#include <eCP/index/eCP.hpp>
+﻿#include <algorithm>
+#include <cstdio>
+#include <eCP/index/eCP.hpp>
+#include <eCP/index/maintenance.hpp>
 #include <eCP/index/pre-processing.hpp>
 #include <eCP/index/shared/data_structure.hpp>
+#include <eCP/index/shared/distance.hpp>
 #include <gtest/gtest.h>
 #include <helpers/testhelpers.hpp>
+#include <thread>
 
 /* Helpers */
 
@@ -18,6 +23,20 @@ Index* get_index()
   return eCP::eCP_Index(descriptors, sc, 0);
 }
 
+/**
+ * @brief write_fvecs_file writes descriptors as a .fvecs file.
+ */
+void write_fvecs_file(const std::string& path, const std::vector<std::vector<float>>& descriptors)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  for (const auto& descriptor : descriptors) {
+    const auto dimensions = static_cast<std::int32_t>(descriptor.size());
+    std::fwrite(&dimensions, sizeof(dimensions), 1, file);
+    std::fwrite(descriptor.data(), sizeof(float), descriptor.size(), file);
+  }
+  std::fclose(file);
+}
+
 /* Tests */
 
 // FIXME: Rewrite this test
@@ -91,3 +110,378 @@ TEST(ecp_tests, query_given_k_2_returns_closest_points)
   EXPECT_EQ(actual.first.size(), 2);
   EXPECT_EQ(actual.second.size(), 2);
 }
+
+TEST(ecp_tests, query_given_compressed_index_returns_same_points_as_uncompressed_index)
+{
+  Index* index = get_index();
+  std::vector<float> q = {12, 12, 12};
+  unsigned int k = 3;
+  unsigned int b = 2;
+
+  auto expected = eCP::query(index, q, k, b, 0);
+  eCP::enable_compression(index);
+  auto actual = eCP::query(index, q, k, b, 4);
+
+  EXPECT_EQ(actual.first, expected.first);
+  EXPECT_EQ(actual.second, expected.second);
+}
+
+TEST(ecp_tests, query_given_delta_buffer_returns_buffered_points)
+{
+  Index* index = get_index();
+  eCP::enable_delta_buffer(index, 10);
+
+  eCP::insert(std::vector<float>{13, 13, 13}.data(), index);
+  auto actual = eCP::query(index, std::vector<float>{12.5, 12.5, 12.5}, 1, 1);
+  eCP::enable_compression(index);
+  auto compressed = eCP::query(index, std::vector<float>{12.5, 12.5, 12.5}, 1, 1, 4);
+
+  EXPECT_EQ(index->delta.ids.size(), 1);
+  EXPECT_EQ(actual.first, (std::vector<unsigned int>{17}));
+  EXPECT_EQ(compressed.first, (std::vector<unsigned int>{17}));
+
+  delete index;
+}
+
+TEST(ecp_tests, query_given_uint8_index_returns_closest_points)
+{
+  std::vector<std::vector<std::uint8_t>> descriptors;
+  for (unsigned i = 0; i < 40; ++i) {
+    descriptors.push_back({static_cast<std::uint8_t>(i * 5), static_cast<std::uint8_t>(i * 5), 7, 255});
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 4, 0);
+  eCP::insert(std::vector<std::uint8_t>{101, 101, 7, 255}.data(), index);
+  auto actual = eCP::query(index, std::vector<std::uint8_t>{100, 100, 7, 255}, 2, descriptors.size());
+
+  EXPECT_EQ(globals::descriptor_size_in_bytes(), 4);
+  EXPECT_EQ(actual.first, (std::vector<unsigned int>{20, 40}));
+  EXPECT_EQ(actual.second, (std::vector<float>{0, 2}));
+
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  delete index;
+}
+
+TEST(ecp_tests, insert_given_descriptor_of_other_type_than_index_throws_invalid_argument)
+{
+  std::vector<std::vector<std::uint8_t>> descriptors{{1, 2, 3, 4}, {5, 6, 7, 8}};
+  Index* index = eCP::eCP_Index(descriptors, 4, 0);
+  std::vector<float> floats{1, 2, 3, 4};
+  std::vector<std::int8_t> int8s{1, 2, 3, 4};
+
+  EXPECT_THROW(eCP::insert(floats.data(), index), std::invalid_argument);
+  EXPECT_THROW(eCP::insert(int8s.data(), index), std::invalid_argument);
+  EXPECT_THROW(eCP::insert_batch(floats.data(), 1, index), std::invalid_argument);
+  EXPECT_THROW(eCP::update(0, floats.data(), index), std::invalid_argument);
+  EXPECT_EQ(index->size, 2);
+
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  delete index;
+}
+
+TEST(ecp_tests, query_given_binary_index_returns_points_by_hamming_distance)
+{
+  // 32 byte binary codes where descriptor i has its lowest i bits set.
+  std::vector<std::vector<std::uint8_t>> descriptors;
+  for (unsigned i = 0; i < 50; ++i) {
+    std::vector<std::uint8_t> code(32, 0);
+    for (unsigned bit = 0; bit < i; ++bit) {
+      code[bit / 8] |= 1 << (bit % 8);
+    }
+    descriptors.push_back(code);
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 5, distance::Metric::HAMMING);
+  auto actual = eCP::query(index, descriptors[10], 3, descriptors.size());
+
+  EXPECT_EQ(globals::g_vector_dimensions, 256);
+  EXPECT_EQ(globals::descriptor_size_in_bytes(), 32);
+  EXPECT_EQ(actual.first.front(), 10);
+  EXPECT_EQ(actual.second, (std::vector<float>{0, 1, 1}));
+
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  delete index;
+}
+
+TEST(ecp_tests, query_given_erased_descriptor_does_not_return_it_before_or_after_compaction)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 60; ++i) {
+    descriptors.push_back({static_cast<float>(i), static_cast<float>(i), static_cast<float>(i)});
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 4, 0);
+  std::vector<float> q = {20, 20, 20};
+
+  eCP::erase(20, index);
+  auto erased = eCP::query(index, q, 1, descriptors.size());
+  eCP::compact(index);
+  auto compacted = eCP::query(index, q, 1, descriptors.size());
+
+  ASSERT_EQ(erased.first.size(), 1);
+  EXPECT_NE(erased.first.front(), 20);
+  ASSERT_EQ(compacted.first.size(), 1);
+  EXPECT_NE(compacted.first.front(), 20);
+  EXPECT_EQ(compacted.second.front(), erased.second.front());
+
+  delete index;
+}
+
+TEST(ecp_tests, query_given_updated_descriptor_returns_it_at_its_new_position)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 60; ++i) {
+    descriptors.push_back({static_cast<float>(i), static_cast<float>(i), static_cast<float>(i)});
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 4, 0);
+  std::vector<float> descriptor = {40.25, 40.25, 40.25};
+
+  eCP::update(5, descriptor.data(), index);
+  auto actual = eCP::query(index, descriptor, 2, descriptors.size());
+
+  EXPECT_EQ(actual.first, (std::vector<unsigned int>{5, 40}));
+  EXPECT_EQ(actual.second.front(), 0);
+
+  delete index;
+}
+
+TEST(ecp_tests, query_given_incrementally_built_index_returns_closest_points)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 300; ++i) {
+    descriptors.push_back({static_cast<float>(i), static_cast<float>(i % 13), 0});
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 4, 0, false);
+  auto actual = eCP::query(index, std::vector<float>{100.25, 100 % 13, 0}, 2, descriptors.size());
+
+  EXPECT_EQ(index->size, 300);
+  EXPECT_EQ(actual.first, (std::vector<unsigned int>{100, 101}));
+
+  delete index;
+}
+
+TEST(ecp_tests, query_given_batch_inserted_descriptors_returns_them)
+{
+  Index* index = get_index();
+  std::vector<float> batch{100, 100, 100, 200, 200, 200, 300, 300, 300};
+
+  eCP::insert_batch(batch.data(), 3, index);
+  auto actual = eCP::query(index, std::vector<float>{199, 199, 199}, 1, index->size);
+
+  EXPECT_EQ(index->size, 20);
+  EXPECT_EQ(actual.first, (std::vector<unsigned int>{18}));
+
+  delete index;
+}
+
+TEST(ecp_tests, insert_given_background_maintenance_allows_concurrent_inserts_and_queries)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 50; ++i) {
+    descriptors.push_back({static_cast<float>(i), static_cast<float>(i % 7), 0});
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 4, 0);
+  eCP::enable_background_maintenance(index);
+
+  auto insert = [index](float offset) {
+    for (unsigned i = 0; i < 500; ++i) {
+      float descriptor[3] = {offset + i, static_cast<float>(i % 11), 1};
+      eCP::insert(descriptor, index);
+    }
+  };
+  std::thread first(insert, 0.5f);
+  std::thread second(insert, 1000.5f);
+
+  for (unsigned i = 0; i < 200; ++i) {
+    auto actual = eCP::query(index, std::vector<float>{static_cast<float>(i), 0, 0}, 3, 4);
+    EXPECT_EQ(actual.first.size(), 3);
+  }
+
+  first.join();
+  second.join();
+  eCP::disable_background_maintenance(index);
+
+  EXPECT_EQ(index->size, 1050);
+  auto actual = eCP::query(index, std::vector<float>{1499.5, 499 % 11, 1}, 1, 1050);
+  EXPECT_EQ(actual.second.front(), 0);
+
+  delete index;
+}
+
+TEST(ecp_tests, query_given_publish_interval_reads_published_versions_during_inserts)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 50; ++i) {
+    descriptors.push_back({static_cast<float>(i), static_cast<float>(i % 7), 0});
+  }
+
+  Index* index = eCP::eCP_Index(descriptors, 4, 0);
+  eCP::enable_background_maintenance(index, 100);
+
+  std::thread writer([index] {
+    for (unsigned i = 0; i < 1000; ++i) {
+      float descriptor[3] = {500.5f + i, static_cast<float>(i % 11), 1};
+      eCP::insert(descriptor, index);
+    }
+  });
+
+  for (unsigned i = 0; i < 200; ++i) {
+    auto actual = eCP::query(index, std::vector<float>{static_cast<float>(i % 50), 0, 0}, 3, 4);
+    EXPECT_EQ(actual.first.size(), 3);
+  }
+
+  writer.join();
+  eCP::disable_background_maintenance(index);      // Processes the pending reclusterings.
+  eCP::enable_background_maintenance(index, 100);  // Publishes the reclustered index.
+  auto actual = eCP::query(index, std::vector<float>{1499.5, 999 % 11, 1}, 1, 1050);
+  auto routed = eCP::query(index, std::vector<float>{700, 3, 1}, 5, 3);  // Routed through the version.
+  eCP::disable_background_maintenance(index);
+
+  EXPECT_EQ(actual.first, (std::vector<unsigned int>{1049}));
+  EXPECT_EQ(routed, eCP::query(index, std::vector<float>{700, 3, 1}, 5, 3));  // Equal to the index itself.
+
+  delete index;
+}
+
+TEST(ecp_tests, eCP_Index_from_file_given_fvecs_file_returns_closest_points)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 300; ++i) {
+    descriptors.push_back({static_cast<float>(i % 13), static_cast<float>(i % 17), static_cast<float>(i)});
+  }
+  const auto path = testing::TempDir() + "eCP_build.fvecs";
+  write_fvecs_file(path, descriptors);
+
+  for (bool batch_build : {true, false}) {
+    Index* index = eCP::eCP_Index_from_file(path, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL, batch_build);
+    EXPECT_EQ(index->size, 300);
+
+    for (unsigned i = 0; i < 300; i += 23) {
+      const auto result = eCP::query(index, descriptors[i], 1, 300);
+      EXPECT_EQ(result.first.front(), i);
+      EXPECT_FLOAT_EQ(result.second.front(), 0);
+    }
+    delete index;
+  }
+}
+
+TEST(ecp_tests, eCP_Index_from_file_given_bvecs_file_builds_byte_index)
+{
+  std::vector<std::vector<std::uint8_t>> descriptors;
+  const auto path = testing::TempDir() + "eCP_build.bvecs";
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  for (unsigned i = 0; i < 100; ++i) {
+    descriptors.push_back({static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(i % 7)});
+    const std::int32_t dimensions = 2;
+    std::fwrite(&dimensions, sizeof(dimensions), 1, file);
+    std::fwrite(descriptors.back().data(), 1, 2, file);
+  }
+  std::fclose(file);
+
+  Index* index = eCP::eCP_Index_from_file(path, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  EXPECT_EQ(globals::g_descriptor_type, globals::DescriptorType::UINT8);
+  for (unsigned i = 0; i < 100; i += 9) {
+    EXPECT_EQ(eCP::query(index, descriptors[i], 1, 100).first.front(), i);
+  }
+  delete index;
+}
+
+TEST(ecp_tests, insert_batch_from_file_given_chunks_inserts_all_rows)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 250; ++i) {
+    descriptors.push_back({static_cast<float>(i), static_cast<float>(i % 5)});
+  }
+  const auto path = testing::TempDir() + "eCP_insert.fvecs";
+  write_fvecs_file(path, std::vector<std::vector<float>>(descriptors.begin() + 50, descriptors.end()));
+
+  Index* index = eCP::eCP_Index(std::vector<std::vector<float>>(descriptors.begin(), descriptors.begin() + 50),
+                                10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  eCP::insert_batch_from_file(path, index, 64);
+  EXPECT_EQ(index->size, 250);
+
+  for (unsigned i = 0; i < 250; i += 11) {
+    EXPECT_EQ(eCP::query(index, descriptors[i], 1, 250).first.front(), i);
+  }
+
+  // Rows of another dimensionality are rejected.
+  write_fvecs_file(path, {{1, 2, 3}});
+  EXPECT_THROW(eCP::insert_batch_from_file(path, index), std::invalid_argument);
+  delete index;
+}
+
+TEST(ecp_tests, eCP_Index_given_strided_matrix_returns_same_points_as_nested_vectors)
+{
+  // Every row holds 3 dimensions followed by 2 floats of padding.
+  const std::size_t n = 200;
+  std::vector<float> matrix(n * 5, -1);
+  std::vector<std::vector<float>> descriptors;
+  for (std::size_t i = 0; i < n; ++i) {
+    descriptors.push_back({static_cast<float>(i % 9), static_cast<float>(i % 4), static_cast<float>(i)});
+    std::copy(descriptors.back().begin(), descriptors.back().end(), matrix.begin() + i * 5);
+  }
+
+  for (bool batch_build : {true, false}) {
+    Index* index =
+        eCP::eCP_Index(matrix.data(), n, 3, 5, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL, batch_build);
+    EXPECT_EQ(index->size, n);
+    EXPECT_EQ(globals::g_vector_dimensions, 3);
+
+    for (unsigned i = 0; i < n; i += 13) {
+      const auto result = eCP::query(index, matrix.data() + i * 5, 1, n);
+      EXPECT_EQ(result.first.front(), i);
+      EXPECT_FLOAT_EQ(result.second.front(), 0);
+      EXPECT_EQ(eCP::query(index, descriptors[i], 3, 4), eCP::query(index, matrix.data() + i * 5, 3, 4));
+    }
+    delete index;
+  }
+}
+
+TEST(ecp_tests, eCP_Index_given_stride_less_than_dimensions_throws_invalid_argument)
+{
+  std::vector<float> matrix(12, 1);
+  EXPECT_THROW(eCP::eCP_Index(matrix.data(), 4, 3, 2, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL),
+               std::invalid_argument);
+}
+
+TEST(ecp_tests, query_given_byte_pointer_returns_same_result_as_vector)
+{
+  std::vector<std::vector<std::uint8_t>> descriptors;
+  for (unsigned i = 0; i < 100; ++i) {
+    descriptors.push_back({static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(i % 3)});
+  }
+  Index* index = eCP::eCP_Index(descriptors, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  for (unsigned i = 0; i < 100; i += 7) {
+    const std::uint8_t* query = descriptors[i].data();
+    EXPECT_EQ(eCP::query(index, query, 5, 3), eCP::query(index, descriptors[i], 5, 3));
+  }
+  delete index;
+}
+
+TEST(ecp_tests, build_on_disk_given_fvecs_file_returns_same_distances_as_index_built_in_memory)
+{
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 0; i < 400; ++i) {
+    descriptors.push_back({static_cast<float>(i % 13), static_cast<float>(i % 17), static_cast<float>(i)});
+  }
+  const auto dataset_path = testing::TempDir() + "eCP_out_of_core.fvecs";
+  const auto path = testing::TempDir() + "eCP_out_of_core_build.disk";
+  write_fvecs_file(dataset_path, descriptors);
+
+  eCP::build_on_disk(dataset_path, path, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL, 1000);
+  DiskIndex* disk = eCP::open_on_disk(path);
+  Index* index = eCP::eCP_Index(descriptors, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  // Searching every cluster is exact, thus both return the same distances.
+  for (unsigned i = 0; i < 400; i += 31) {
+    EXPECT_EQ(eCP::query(disk, descriptors[i], 5, 1000).second,
+              eCP::query(index, descriptors[i], 5, 1000).second);
+  }
+
+  eCP::close_on_disk(disk);
+  delete index;
+}
@@ -4,6 +4,7 @@
 #include <eCP/index/shared/distance.hpp>
 #include <eCP/index/shared/globals.hpp>
 #include <helpers/testhelpers.hpp>
+#include <numeric>
 
 // Testing compilation unit
 #include <eCP/index/maintenance.cpp>
@@ -49,11 +50,116 @@ Index get_test_index_A()
   index.L = 1;
   index.size = 3;
   index.root = root;
+  index.root.count_subtree();
   index.scheme = scheme;
 
   return index;
 }
 
+/*
+ * Collects all clusters at the bottom level below node.
+ */
+std::vector<Node*> collect_clusters(Node& node)
+{
+  if (node.children.empty()) {
+    return {&node};
+  }
+
+  std::vector<Node*> clusters;
+  for (auto& child : node.children) {
+    auto child_clusters = collect_clusters(child);
+    clusters.insert(clusters.end(), child_clusters.begin(), child_clusters.end());
+  }
+  return clusters;
+}
+
+/*
+ * Expects the maintained counts of all nodes below node to equal the counts of a recount.
+ */
+void expect_counts_as_recounted(const Node& node, const Node& recounted)
+{
+  EXPECT_EQ(node.point_count, recounted.point_count);
+  EXPECT_EQ(node.grandchild_count, recounted.grandchild_count);
+
+  for (unsigned i = 0; i < node.children.size(); ++i) {
+    expect_counts_as_recounted(node.children[i], recounted.children[i]);
+  }
+}
+
+/*
+ * Expects the leaders of node and of all internal nodes below node not to be erased.
+ */
+void expect_routing_leaders_not_erased(const Node& node, const std::vector<bool>& tombstones)
+{
+  if (node.children.empty()) {
+    return;
+  }
+
+  const auto id = node.points.front().id;
+  EXPECT_FALSE(id < tombstones.size() && tombstones[id]) << "Erased routing leader " << id;
+
+  for (auto& child : node.children) {
+    expect_routing_leaders_not_erased(child, tombstones);
+  }
+}
+
+/*
+ * Creates a L1 index with 2 clusters with 2 points each. Large bounds such that no reclustering happens.
+ */
+Index get_test_index_B()
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  auto policy = ReclusteringPolicy::ABSOLUTE;
+
+  auto cluster_a = Node{Point{{0, 0, 0}, 0}};
+  cluster_a.points.emplace_back(Point{{1, 1, 1}, 1});
+  auto cluster_b = Node{Point{{10, 10, 10}, 2}};
+  cluster_b.points.emplace_back(Point{{11, 11, 11}, 3});
+
+  auto index = Index{};
+  index.L = 1;
+  index.size = 4;
+  index.root = Node{Point{{0, 0, 0}, 0}};
+  index.root.children.emplace_back(std::move(cluster_a));
+  index.root.children.emplace_back(std::move(cluster_b));
+  index.root.count_subtree();
+  index.scheme = ReclusteringScheme{10, 10, policy, policy};
+
+  return index;
+}
+
+/*
+ * Creates a L2 index with 2 internal nodes led by copies of the leaders of their first clusters. The first
+ * node has a singleton cluster and a cluster led by a descriptor near it whose other point is near the
+ * second node. Large bounds such that no reclustering happens.
+ */
+Index get_test_index_C()
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  auto policy = ReclusteringPolicy::ABSOLUTE;
+
+  auto node_a = Node{Point{{0, 0, 0}, 0}};
+  node_a.children.emplace_back(Node{Point{{0, 0, 0}, 0}});
+  node_a.children.emplace_back(Node{Point{{1, 1, 1}, 1}});
+  node_a.children.back().points.emplace_back(Point{{9, 9, 9}, 2});
+  auto node_b = Node{Point{{10, 10, 10}, 3}};
+  node_b.children.emplace_back(Node{Point{{10, 10, 10}, 3}});
+  node_b.children.emplace_back(Node{Point{{11, 11, 11}, 4}});
+
+  auto index = Index{};
+  index.L = 2;
+  index.size = 5;
+  index.root = Node{Point{{0, 0, 0}, 0}};
+  index.root.children.emplace_back(std::move(node_a));
+  index.root.children.emplace_back(std::move(node_b));
+  index.root.count_subtree();
+  index.scheme = ReclusteringScheme{10, 10, policy, policy};
+
+  return index;
+}
+
 /*
  * maintenance_tests below --------------------------------------
  */
@@ -131,6 +237,871 @@ TEST(
   EXPECT_EQ(index->size, 2);
 }
 
+TEST(maintenance_tests, insert_given_released_point_reuses_its_descriptor_storage)
+{
+  auto index = get_test_index_B();
+  const float* released;
+  {
+    Point point{{1, 1, 1}, 9};
+    released = point.descriptor;
+  }
+
+  maintenance::insert(std::vector<float>{2, 2, 2}.data(), &index);
+
+  ASSERT_EQ(index.root.children[0].points.size(), 3);
+  EXPECT_EQ(index.root.children[0].points.back().descriptor, released);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(released) % 16, 0);
+}
+
+TEST(maintenance_tests, erase_given_id_not_in_index_throws_invalid_argument)
+{
+  auto index = get_test_index_A();
+
+  EXPECT_THROW(maintenance::erase(index.size, &index), std::invalid_argument);
+  EXPECT_TRUE(index.tombstones.empty());
+}
+
+TEST(maintenance_tests, erase_given_id_marks_only_that_id_as_erased)
+{
+  auto index = get_test_index_A();
+
+  maintenance::erase(2, &index);
+
+  ASSERT_EQ(index.tombstones.size(), index.size);
+  EXPECT_EQ(index.tombstones, (std::vector<bool>{false, false, true}));
+  EXPECT_EQ(testhelpers::count_points_in_clusters(index.root), 3);  // Not removed before compaction.
+}
+
+TEST(maintenance_tests, compact_given_index_with_erased_descriptors_removes_only_erased_descriptors)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < 100; ++i) {
+    dataset.push_back({static_cast<float>(i), static_cast<float>(i), static_cast<float>(i)});
+  }
+
+  Index* index = pre_processing::create_index(dataset, 4);
+  const auto clusters_before = collect_clusters(index->root).size();
+
+  // Act
+  for (unsigned id = 0; id < 100; id += 2) {
+    maintenance::erase(id, index);
+  }
+  maintenance::compact(index);
+
+  // Assert
+  const auto clusters = collect_clusters(index->root);
+  unsigned points{0};
+  for (Node* cluster : clusters) {
+    for (auto& point : cluster->points) {
+      EXPECT_EQ(point.id % 2, 1);
+      ++points;
+    }
+  }
+
+  EXPECT_EQ(points, 50);
+  EXPECT_LT(clusters.size(), clusters_before);
+  EXPECT_EQ(testhelpers::measure_depth_from(index->root), index->L);
+  EXPECT_TRUE(index->tombstones.empty());  // No erased descriptor remains.
+
+  delete index;
+}
+
+TEST(maintenance_tests, compact_given_erased_leaders_of_internal_nodes_reelects_leaders_and_clears_tombstones)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < 200; ++i) {
+    dataset.push_back({static_cast<float>(i % 17), static_cast<float>(i % 5), static_cast<float>(i)});
+  }
+
+  Index* index = pre_processing::create_index(dataset, 3);
+  ASSERT_GT(index->L, 1);
+
+  // Act
+  for (unsigned id = 0; id < 200; id += 3) {
+    maintenance::erase(id, index);
+  }
+  maintenance::erase(index->root.get_leader()->id, index);
+  for (auto& child : index->root.children) {
+    maintenance::erase(child.get_leader()->id, index);
+  }
+  const auto erased = index->tombstones;
+  maintenance::compact(index);
+
+  // Assert
+  expect_routing_leaders_not_erased(index->root, erased);
+  EXPECT_TRUE(index->tombstones.empty());
+
+  float descriptor[3] = {1, 1, 1};
+  EXPECT_THROW(maintenance::update(0, descriptor, index), std::invalid_argument);  // Removed by compaction.
+  const auto kept = std::find(erased.begin(), erased.end(), false) - erased.begin();
+  EXPECT_NO_THROW(maintenance::update(kept, descriptor, index));
+
+  delete index;
+}
+
+TEST(maintenance_tests, compact_given_all_descriptors_erased_keeps_a_single_cluster_to_insert_into)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset{
+      {1, 2, 3}, {4, 5, 6}, {7, 8, 9}, {10, 11, 12}, {10, 11, 12}, {10, 11, 12},
+      {2, 2, 3}, {2, 5, 6}, {2, 8, 9}, {2, 11, 12},  {2, 11, 12},  {2, 11, 12},
+  };
+  Index* index = pre_processing::create_index(dataset, 2);
+
+  // Act
+  for (unsigned id = 0; id < dataset.size(); ++id) {
+    maintenance::erase(id, index);
+  }
+  maintenance::compact(index);
+  maintenance::insert(dataset[0].data(), index);
+
+  // Assert
+  EXPECT_EQ(index->L, 1);
+  EXPECT_EQ(collect_clusters(index->root).size(), 1);
+  EXPECT_EQ(testhelpers::count_points_in_clusters(index->root), 2);  // Erased leader and new descriptor.
+  EXPECT_EQ(std::count(index->tombstones.begin(), index->tombstones.end(), true), 1);  // The kept leader.
+
+  delete index;
+}
+
+TEST(maintenance_tests, update_given_descriptor_closer_to_its_leader_overwrites_it_in_place)
+{
+  auto index = get_test_index_B();
+  float* storage = index.root.children[0].points[1].descriptor;
+  float descriptor[3] = {0.5, 0.5, 0.5};
+
+  maintenance::update(1, descriptor, &index);
+
+  EXPECT_EQ(index.root.children[0].points.size(), 2);
+  EXPECT_EQ(index.root.children[0].points[1].descriptor, storage);
+  EXPECT_EQ(std::vector<float>(storage, storage + 3), (std::vector<float>{0.5, 0.5, 0.5}));
+}
+
+TEST(maintenance_tests, update_given_descriptor_far_from_its_leader_moves_it_to_nearest_cluster)
+{
+  auto index = get_test_index_B();
+  float descriptor[3] = {12, 12, 12};
+
+  maintenance::update(1, descriptor, &index);
+
+  auto& cluster_a = index.root.children[0];
+  auto& cluster_b = index.root.children[1];
+  ASSERT_EQ(cluster_a.points.size(), 1);
+  ASSERT_EQ(cluster_b.points.size(), 3);
+  EXPECT_EQ(cluster_b.points[2].id, 1);
+  EXPECT_EQ(cluster_b.points[2].descriptor[0], 12);
+  EXPECT_EQ(index.locations[1].leader, cluster_b.get_leader()->descriptor);
+  EXPECT_EQ(index.size, 4);
+}
+
+TEST(maintenance_tests, update_given_leader_moves_it_and_next_point_leads_the_cluster)
+{
+  auto index = get_test_index_B();
+  float descriptor[3] = {9, 9, 9};
+
+  maintenance::update(0, descriptor, &index);
+
+  auto& cluster_a = index.root.children[0];
+  ASSERT_EQ(cluster_a.points.size(), 1);
+  EXPECT_EQ(cluster_a.get_leader()->id, 1);
+  EXPECT_EQ(index.locations[1].leader, index.locations[1].descriptor);
+  EXPECT_EQ(index.root.children[1].points.size(), 3);
+}
+
+TEST(maintenance_tests, update_given_singleton_cluster_moves_cluster_below_nearest_node_and_reelects_leaders)
+{
+  auto index = get_test_index_C();
+  float descriptor[3] = {12, 12, 12};
+
+  maintenance::update(0, descriptor, &index);
+
+  auto& node_a = index.root.children[0];
+  auto& node_b = index.root.children[1];
+  ASSERT_EQ(node_a.children.size(), 1);
+  ASSERT_EQ(node_b.children.size(), 3);
+  EXPECT_EQ(node_b.children.back().get_leader()->id, 0);
+  EXPECT_EQ(node_a.get_leader()->id, 1);  // Re-elected among the remaining clusters.
+  EXPECT_EQ(index.root.get_leader()->id, 1);
+  EXPECT_EQ(std::vector<float>(node_b.children.back().get_leader()->descriptor,
+                               node_b.children.back().get_leader()->descriptor + 3),
+            (std::vector<float>{12, 12, 12}));
+
+  auto recounted = index.root;
+  recounted.count_subtree();
+  expect_counts_as_recounted(index.root, recounted);
+}
+
+TEST(maintenance_tests, update_given_leader_of_cluster_moves_cluster_below_node_nearest_its_new_leader)
+{
+  auto index = get_test_index_C();
+  float descriptor[3] = {0.5, 0.5, 0.5};
+
+  maintenance::update(1, descriptor, &index);
+
+  auto& node_a = index.root.children[0];
+  auto& node_b = index.root.children[1];
+  ASSERT_EQ(node_a.children.size(), 1);
+  ASSERT_EQ(node_b.children.size(), 3);
+  EXPECT_EQ(node_b.children.back().get_leader()->id, 2);
+  EXPECT_EQ(node_a.children.front().points.size(), 2);  // Moved next to the descriptor with id 0.
+  EXPECT_EQ(index.locations[2].leader, index.locations[2].descriptor);
+
+  auto recounted = index.root;
+  recounted.count_subtree();
+  expect_counts_as_recounted(index.root, recounted);
+}
+
+TEST(maintenance_tests, update_given_erased_id_throws_invalid_argument)
+{
+  auto index = get_test_index_B();
+  float descriptor[3] = {1, 1, 1};
+  maintenance::erase(1, &index);
+
+  EXPECT_THROW(maintenance::update(1, descriptor, &index), std::invalid_argument);
+}
+
+TEST(maintenance_tests, insert_given_updated_index_keeps_locations_of_all_points_through_reclusterings)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset{{0, 0, 0}};
+  Index* index = pre_processing::create_index(dataset, 3, 0.3, 0.3, ReclusteringPolicy::AVERAGE,
+                                              ReclusteringPolicy::AVERAGE);
+  maintenance::update(0, dataset[0].data(), index);  // Start recording locations.
+
+  // Act
+  for (unsigned i = 1; i < 200; ++i) {
+    float descriptor[3] = {static_cast<float>(i % 17), static_cast<float>(i % 5), static_cast<float>(i)};
+    maintenance::insert(descriptor, index);
+  }
+
+  // Assert
+  ASSERT_GT(index->L, 1);
+  ASSERT_EQ(index->locations.size(), index->size);
+
+  for (Node* cluster : collect_clusters(index->root)) {
+    for (auto& point : cluster->points) {
+      EXPECT_EQ(index->locations[point.id].descriptor, point.descriptor);
+      EXPECT_EQ(index->locations[point.id].leader, cluster->get_leader()->descriptor);
+    }
+  }
+
+  delete index;
+}
+
+TEST(maintenance_tests, insert_given_children_per_insert_reclusters_over_several_insertions)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  auto policy = ReclusteringPolicy::ABSOLUTE;
+
+  auto index = Index{};
+  index.L = 1;
+  index.root = Node{Point{{0, 0, 0}, 0}};
+  for (float leader : {0.0f, 10.0f, 20.0f}) {
+    auto cluster = Node{Point{{leader, leader, leader}, index.size++}};
+    for (float offset : {1.0f, 2.0f}) {
+      cluster.points.emplace_back(Point{{leader + offset, leader + offset, leader + offset}, index.size++});
+    }
+    index.root.children.emplace_back(std::move(cluster));
+  }
+  index.scheme = ReclusteringScheme{3, 3, policy, policy, 1};
+  std::vector<std::vector<float>> descriptors{
+      {1.5, 1.5, 1.5}, {11.5, 11.5, 11.5}, {21.5, 21.5, 21.5}, {30, 30, 30}};
+
+  // Act & Assert: The old clusters are kept until all 3 are reclustered.
+  maintenance::insert(descriptors[0].data(), &index);
+  EXPECT_FALSE(index.progress.path.empty());
+  EXPECT_EQ(index.root.children[0].points.size(), 4);
+
+  maintenance::insert(descriptors[1].data(), &index);
+  EXPECT_FALSE(index.progress.path.empty());
+  EXPECT_EQ(index.root.children[1].points.size(), 4);
+  EXPECT_EQ(testhelpers::count_points_in_clusters(index.root), 11);
+
+  // The 10 points planned form 4 clusters thus the index grows and the new root is reclustered next.
+  maintenance::insert(descriptors[2].data(), &index);
+  EXPECT_FALSE(index.progress.path.empty());
+  EXPECT_EQ(index.L, 2);
+  EXPECT_EQ(index.root.children.size(), 1);
+  EXPECT_EQ(collect_clusters(index.root).size(), 4);
+
+  maintenance::insert(descriptors[3].data(), &index);
+  EXPECT_TRUE(index.progress.path.empty());
+  EXPECT_EQ(index.root.children.size(), 2);
+
+  std::vector<unsigned long> ids;
+  for (Node* cluster : collect_clusters(index.root)) {
+    for (auto& point : cluster->points) {
+      ids.emplace_back(point.id);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  std::vector<unsigned long> expected(13);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(ids, expected);
+}
+
+TEST(maintenance_tests, insert_given_split_policy_splits_only_the_over_full_cluster)
+{
+  // Arrange
+  auto index = get_test_index_B();
+  index.scheme = ReclusteringScheme{3, 3, ReclusteringPolicy::SPLIT, ReclusteringPolicy::SPLIT};
+  index.root.children[0].points.emplace_back(Point{{0.5, 0.5, 0.5}, index.size++});
+  std::vector<float> descriptor{3, 3, 3};
+
+  // Act
+  maintenance::insert(descriptor.data(), &index);
+
+  // Assert
+  EXPECT_EQ(index.L, 1);
+  ASSERT_EQ(index.root.children.size(), 3);
+  EXPECT_EQ(index.root.children[0].points.size(), 3);
+  EXPECT_EQ(index.root.children[0].get_leader()->id, 0);
+  EXPECT_EQ(index.root.children[1].points.size(), 2);  // Sibling is untouched.
+  EXPECT_EQ(index.root.children[1].get_leader()->id, 2);
+  ASSERT_EQ(index.root.children[2].points.size(), 1);
+  EXPECT_EQ(index.root.children[2].get_leader()->id, 5);
+}
+
+TEST(maintenance_tests, insert_given_split_policy_keeps_all_clusters_and_nodes_within_hi_bound)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  auto policy = ReclusteringPolicy::SPLIT;
+  std::vector<std::vector<float>> dataset{{0, 0, 0}};
+  Index* index = pre_processing::create_index(dataset, 3, 0.0, 0.0, policy, policy);
+  std::vector<std::vector<float>> descriptors;
+  for (unsigned i = 1; i <= 60; ++i) {
+    descriptors.emplace_back(std::vector<float>{float(i % 7), float(i % 11), float(i)});
+  }
+
+  // Act
+  for (auto& descriptor : descriptors) {
+    maintenance::insert(descriptor.data(), index);
+  }
+
+  // Assert
+  EXPECT_GT(index->L, 1);
+  EXPECT_EQ(testhelpers::count_points_in_clusters(index->root), 61);
+
+  std::stack<std::pair<Node*, unsigned>> nodes;  // Node and its level.
+  nodes.emplace(&index->root, 0);
+  while (!nodes.empty()) {
+    auto node = nodes.top();
+    nodes.pop();
+
+    if (node.first->children.empty()) {
+      EXPECT_EQ(node.second, index->L);
+      EXPECT_LE(node.first->points.size(), 3);
+    }
+    else if (node.first != &index->root) {
+      EXPECT_LE(node.first->children.size(), 3);
+    }
+
+    for (auto& child : node.first->children) {
+      nodes.emplace(&child, node.second + 1);
+    }
+  }
+
+  delete index;
+}
+
+TEST(maintenance_tests, insert_and_update_given_any_scheme_maintain_counts_of_all_nodes)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < 300; ++i) {
+    dataset.emplace_back(std::vector<float>{float(i % 13), float(i % 17), float(i % 19)});
+  }
+
+  for (auto scheme : {ReclusteringScheme{3, 4, ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE},
+                      ReclusteringScheme{3, 4, ReclusteringPolicy::SPLIT, ReclusteringPolicy::AVERAGE},
+                      ReclusteringScheme{3, 4, ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE, 2}}) {
+    std::vector<std::vector<float>> initial{dataset.begin(), dataset.begin() + 20};
+    Index* index = pre_processing::create_index(initial, 3, 0.0, 0.3, scheme.cluster_policy,
+                                                scheme.node_policy);
+    index->scheme = scheme;
+
+    for (unsigned i = 20; i < dataset.size(); ++i) {
+      maintenance::insert(dataset[i].data(), index);
+    }
+    for (unsigned id = 0; id < dataset.size(); id += 7) {
+      maintenance::update(id, dataset[dataset.size() - 1 - id].data(), index);
+    }
+
+    auto recounted = index->root;
+    recounted.count_subtree();
+    EXPECT_EQ(index->root.point_count, dataset.size());
+    expect_counts_as_recounted(index->root, recounted);
+
+    delete index;
+  }
+}
+
+TEST(maintenance_tests, insert_update_and_compact_given_compressed_index_keep_codes_of_every_cluster)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < 300; ++i) {
+    dataset.emplace_back(std::vector<float>{float(i % 13), float(i % 17), float(i % 19)});
+  }
+  float lo[3] = {0, 0, 0};
+  float hi[3] = {18, 18, 18};
+
+  for (auto scheme : {ReclusteringScheme{3, 4, ReclusteringPolicy::AVERAGE, ReclusteringPolicy::AVERAGE},
+                      ReclusteringScheme{3, 4, ReclusteringPolicy::SPLIT, ReclusteringPolicy::AVERAGE}}) {
+    std::vector<std::vector<float>> initial{dataset.begin(), dataset.begin() + 20};
+    Index* index = pre_processing::create_index(initial, 3, 0.0, 0.3, scheme.cluster_policy,
+                                                scheme.node_policy);
+    index->scheme = scheme;
+    quantization::train({lo, hi});
+    for (Node* cluster : collect_clusters(index->root)) {
+      cluster->encode_points();
+    }
+
+    for (unsigned i = 20; i < dataset.size(); ++i) {
+      maintenance::insert(dataset[i].data(), index);
+    }
+    for (unsigned id = 0; id < dataset.size(); id += 7) {
+      maintenance::update(id, dataset[dataset.size() - 1 - id].data(), index);
+    }
+    for (unsigned id = 1; id < dataset.size(); id += 5) {
+      maintenance::erase(id, index);
+    }
+    maintenance::compact(index);
+
+    for (Node* cluster : collect_clusters(index->root)) {
+      auto encoded = *cluster;
+      encoded.encode_points();
+      ASSERT_EQ(cluster->codes.size(), cluster->points.size() * 3);
+      EXPECT_EQ(cluster->codes, encoded.codes);
+    }
+
+    quantization::reset();
+    delete index;
+  }
+}
+
+TEST(maintenance_tests, insert_given_delta_buffer_buffers_descriptors_until_full)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_delta_buffer(&index, 3);
+  std::vector<float> descriptors{12, 12, 12, 2, 2, 2, 13, 13, 13};
+
+  maintenance::insert(&descriptors[0], &index);
+  maintenance::insert(&descriptors[3], &index);
+  const auto buffered = index.delta.ids;
+  const auto points = index.root.point_count;
+  maintenance::insert(&descriptors[6], &index);
+
+  EXPECT_EQ(buffered, (std::vector<unsigned long>{4, 5}));
+  EXPECT_EQ(points, 4);
+  EXPECT_TRUE(index.delta.ids.empty());
+  EXPECT_TRUE(index.delta.storage.empty());
+  EXPECT_EQ(index.size, 7);
+  EXPECT_EQ(index.root.point_count, 7);
+  ASSERT_EQ(index.root.children[1].points.size(), 4);
+  EXPECT_EQ(index.root.children[1].points[3].id, 6);
+}
+
+TEST(maintenance_tests, insert_given_expired_delta_buffer_merges_it)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_delta_buffer(&index, 100, 1);
+  float descriptor[3] = {12, 12, 12};
+
+  maintenance::insert(descriptor, &index);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  maintenance::insert(descriptor, &index);
+
+  EXPECT_TRUE(index.delta.ids.empty());
+  EXPECT_EQ(index.root.point_count, 6);
+}
+
+TEST(maintenance_tests, merge_expired_delta_buffer_given_expired_buffer_merges_it)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_delta_buffer(&index, 100, 50);
+  float descriptor[3] = {12, 12, 12};
+
+  maintenance::insert(descriptor, &index);
+  maintenance::merge_expired_delta_buffer(&index);
+  EXPECT_EQ(index.delta.ids.size(), 1);  // Not expired yet.
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  maintenance::merge_expired_delta_buffer(&index);
+
+  EXPECT_TRUE(index.delta.ids.empty());
+  EXPECT_EQ(index.root.point_count, 5);
+}
+
+TEST(maintenance_tests, insert_given_parallel_insertions_into_delta_buffer_merges_it_in_background)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_delta_buffer(&index, 64, 5);
+  maintenance::enable_background_maintenance(&index);
+
+  auto insert = [&index](unsigned thread) {
+    for (unsigned i = 0; i < 100; ++i) {
+      float descriptor[3] = {static_cast<float>(i % 13), static_cast<float>(thread), static_cast<float>(i)};
+      maintenance::insert(descriptor, &index);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned thread = 0; thread < 4; ++thread) {
+    threads.emplace_back(insert, thread);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // The remainder of the buffer is merged by the background thread once expired, without further insertions.
+  bool is_merged{false};
+  for (unsigned attempt = 0; attempt < 200 && !is_merged; ++attempt) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto lock = maintenance::write_lock(&index);
+    is_merged = index.delta.ids.empty();
+  }
+  maintenance::disable_background_maintenance(&index);
+
+  EXPECT_TRUE(is_merged);
+  EXPECT_EQ(index.size, 404);
+  EXPECT_EQ(index.root.point_count, 404);
+
+  std::vector<bool> found(index.size, false);
+  for (Node* cluster : collect_clusters(index.root)) {
+    for (auto& point : cluster->points) {
+      EXPECT_FALSE(found[point.id]);
+      found[point.id] = true;
+    }
+  }
+  EXPECT_EQ(std::count(found.begin(), found.end(), true), 404);
+}
+
+TEST(maintenance_tests, update_given_buffered_id_merges_delta_buffer_and_updates)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_delta_buffer(&index, 100);
+  float descriptor[3] = {12, 12, 12};
+  float updated[3] = {2, 2, 2};
+
+  maintenance::insert(descriptor, &index);
+  maintenance::update(4, updated, &index);
+
+  EXPECT_TRUE(index.delta.ids.empty());
+  EXPECT_EQ(index.root.point_count, 5);
+  EXPECT_FLOAT_EQ(index.locations[4].descriptor[0], 2);
+}
+
+TEST(maintenance_tests, disable_delta_buffer_given_buffered_descriptors_merges_them)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_delta_buffer(&index, 100);
+  std::vector<float> descriptors{12, 12, 12, 2, 2, 2};
+
+  maintenance::insert(&descriptors[0], &index);
+  maintenance::insert_batch(&descriptors[3], 1, &index);  // Merges the buffer before the batch.
+  maintenance::insert(&descriptors[0], &index);
+  maintenance::disable_delta_buffer(&index);
+
+  EXPECT_EQ(index.delta.capacity, 0);
+  EXPECT_TRUE(index.delta.ids.empty());
+  EXPECT_EQ(index.root.point_count, 7);
+  ASSERT_EQ(index.root.children[1].points.size(), 4);
+  EXPECT_EQ(index.root.children[1].points[2].id, 4);
+  EXPECT_EQ(index.root.children[1].points[3].id, 6);
+}
+
+TEST(maintenance_tests, insert_batch_given_descriptors_appends_them_to_their_nearest_clusters_in_order)
+{
+  auto index = get_test_index_B();
+  std::vector<float> descriptors{12, 12, 12, 2, 2, 2, 13, 13, 13};
+
+  maintenance::insert_batch(descriptors.data(), 3, &index);
+
+  EXPECT_EQ(index.size, 7);
+  EXPECT_EQ(index.root.point_count, 7);
+  ASSERT_EQ(index.root.children.size(), 2);
+  ASSERT_EQ(index.root.children[0].points.size(), 3);
+  EXPECT_EQ(index.root.children[0].points[2].id, 5);
+  ASSERT_EQ(index.root.children[1].points.size(), 4);
+  EXPECT_EQ(index.root.children[1].points[2].id, 4);
+  EXPECT_EQ(index.root.children[1].points[3].id, 6);
+  EXPECT_EQ(index.root.children[1].point_count, 4);
+}
+
+TEST(maintenance_tests, find_nearest_clusters_given_batch_split_between_workers_finds_nearest_cluster_of_each)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < 200; ++i) {
+    dataset.push_back({float(i % 11), float(i % 13), float(i)});
+  }
+  Index* index = pre_processing::create_index(dataset, 4);
+  std::vector<float> descriptors;
+  for (unsigned i = 0; i < 3000; ++i) {
+    descriptors.insert(descriptors.end(), {float(i % 17), float(i % 7), float(i % 211)});
+  }
+
+  for (unsigned repeat = 0; repeat < 2; ++repeat) {  // The workers are reused by the second batch.
+    const auto clusters = maintenance_helpers::find_nearest_clusters(
+        reinterpret_cast<const char*>(descriptors.data()), 3000, &index->root);
+
+    ASSERT_EQ(clusters.size(), 3000);
+    for (unsigned i = 0; i < 3000; ++i) {
+      EXPECT_EQ(clusters[i], traversal::find_nearest_leaf(&descriptors[i * 3], index->root.children));
+    }
+  }
+
+  delete index;
+}
+
+TEST(maintenance_tests, insert_batch_given_batch_overfilling_many_clusters_reclusters_and_grows_index)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+
+  for (auto policy : {ReclusteringPolicy::AVERAGE, ReclusteringPolicy::ABSOLUTE, ReclusteringPolicy::SPLIT}) {
+    std::vector<std::vector<float>> initial{{0, 0, 0}, {5, 5, 5}, {9, 9, 9}};
+    Index* index = pre_processing::create_index(initial, 3, 0.0, 0.0, policy, policy);
+    std::vector<float> descriptors;
+    for (unsigned i = 0; i < 500; ++i) {
+      descriptors.insert(descriptors.end(), {float(i % 23), float(i % 29), float(i % 31)});
+    }
+
+    maintenance::insert_batch(descriptors.data(), 500, index);
+
+    EXPECT_EQ(index->size, 503);
+    EXPECT_GT(index->L, 2);
+    EXPECT_LE(index->root.children.size(), 3);
+
+    std::vector<unsigned long> ids;
+    for (Node* cluster : collect_clusters(index->root)) {
+      for (auto& point : cluster->points) {
+        ids.emplace_back(point.id);
+      }
+    }
+    std::sort(ids.begin(), ids.end());
+    std::vector<unsigned long> expected(503);
+    std::iota(expected.begin(), expected.end(), 0);
+    EXPECT_EQ(ids, expected);
+
+    auto recounted = index->root;
+    recounted.count_subtree();
+    expect_counts_as_recounted(index->root, recounted);
+    EXPECT_EQ(testhelpers::measure_depth_from(index->root), index->L);
+
+    delete index;
+  }
+}
+
+TEST(maintenance_tests, read_version_given_publish_interval_returns_version_until_published)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_background_maintenance(&index, 1000);
+  auto first = maintenance::read_version(&index);
+
+  float descriptor[3] = {2, 2, 2};
+  maintenance::insert(descriptor, &index);
+  maintenance::erase(0, &index);
+  auto unpublished = maintenance::read_version(&index);
+  maintenance::publish(&index);
+  auto published = maintenance::read_version(&index);
+  maintenance::disable_background_maintenance(&index);
+
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(unpublished, first);
+  EXPECT_EQ(first->root->node->point_count, 4);
+  EXPECT_TRUE(first->tombstones.empty());
+  EXPECT_EQ(first->L, index.L);
+
+  ASSERT_NE(published, first);
+  EXPECT_EQ(published->root->node->point_count, 5);
+  EXPECT_EQ(published->tombstones, index.tombstones);
+  EXPECT_NE(published->root->node->get_leader()->descriptor, index.root.get_leader()->descriptor);  // Copy.
+}
+
+TEST(maintenance_tests, publish_given_changed_clusters_copies_only_them_and_shares_the_rest)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_background_maintenance(&index, 1000);
+  auto first = maintenance::read_version(&index);
+
+  float inserted[3] = {10, 11, 10};
+  maintenance::insert(inserted, &index);
+  maintenance::publish(&index);
+  auto second = maintenance::read_version(&index);
+
+  float updated[3] = {0.5, 0.5, 0.5};  // Closer to its leader, thus overwritten in place.
+  maintenance::update(1, updated, &index);
+  maintenance::publish(&index);
+  auto third = maintenance::read_version(&index);
+  maintenance::disable_background_maintenance(&index);
+
+  ASSERT_EQ(second->root->children.size(), 2);
+  EXPECT_NE(second->root, first->root);
+  EXPECT_EQ(second->root->children[0], first->root->children[0]);  // Unchanged, thus shared.
+  EXPECT_NE(second->root->children[1], first->root->children[1]);
+  EXPECT_EQ(second->root->children[1]->node->points.size(), 3);
+  EXPECT_EQ(first->root->children[1]->node->points.size(), 2);
+
+  EXPECT_NE(third->root->children[0], second->root->children[0]);
+  EXPECT_EQ(third->root->children[1], second->root->children[1]);
+  const float* copied = third->root->children[0]->node->points[1].descriptor;
+  EXPECT_EQ(std::vector<float>(copied, copied + 3), (std::vector<float>{0.5, 0.5, 0.5}));
+}
+
+TEST(maintenance_tests, read_version_given_publish_interval_is_refreshed_by_background_thread)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_background_maintenance(&index, 10);
+  auto first = maintenance::read_version(&index);
+
+  for (unsigned i = 0; i < 10; ++i) {
+    float descriptor[3] = {static_cast<float>(i), 2, 2};
+    maintenance::insert(descriptor, &index);
+  }
+  maintenance::disable_background_maintenance(&index);  // Processes the due version before stopping.
+
+  EXPECT_EQ(maintenance::read_version(&index), nullptr);
+  EXPECT_EQ(first->root->node->point_count, 4);  // Still valid while pinned.
+}
+
+TEST(maintenance_tests, insert_given_parallel_insertions_inserts_every_descriptor_once)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+
+  const std::vector<std::pair<ReclusteringPolicy, unsigned>> cases{
+      {ReclusteringPolicy::AVERAGE, 0}, {ReclusteringPolicy::AVERAGE, 50},  // Without and with versions.
+      {ReclusteringPolicy::SPLIT, 0}, {ReclusteringPolicy::SPLIT, 50}};
+
+  for (auto& test_case : cases) {
+    const auto policy = test_case.first;
+    const auto publish_interval = test_case.second;
+    std::vector<std::vector<float>> dataset{{0, 0, 0}, {50, 50, 50}};
+    Index* index = pre_processing::create_index(dataset, 3, 0.0, 0.0, policy, policy);
+    maintenance::update(0, dataset[0].data(), index);  // Locations must follow parallel insertions.
+
+    maintenance::enable_background_maintenance(index, publish_interval);
+    auto insert = [index](unsigned thread) {
+      for (unsigned i = 0; i < 250; ++i) {
+        float descriptor[3] = {static_cast<float>(i % 23), static_cast<float>(thread), static_cast<float>(i)};
+        maintenance::insert(descriptor, index);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned thread = 0; thread < 4; ++thread) {
+      threads.emplace_back(insert, thread);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    maintenance::disable_background_maintenance(index);
+
+    EXPECT_EQ(index->size, 1002);
+    EXPECT_GT(index->L, 1);
+
+    std::vector<bool> found(index->size, false);
+    for (Node* cluster : collect_clusters(index->root)) {
+      if (policy == ReclusteringPolicy::SPLIT) {
+        EXPECT_LE(cluster->points.size(), index->scheme.hi_bound);
+      }
+      for (auto& point : cluster->points) {
+        EXPECT_FALSE(found[point.id]);
+        found[point.id] = true;
+        EXPECT_EQ(index->locations[point.id].descriptor, point.descriptor);
+      }
+    }
+    EXPECT_EQ(std::count(found.begin(), found.end(), true), 1002);
+
+    auto recounted = index->root;
+    recounted.count_subtree();
+    expect_counts_as_recounted(index->root, recounted);
+
+    delete index;
+  }
+}
+
+TEST(maintenance_tests, read_version_given_no_publish_interval_returns_nullptr)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_background_maintenance(&index);
+
+  EXPECT_EQ(maintenance::read_version(&index), nullptr);
+
+  maintenance::disable_background_maintenance(&index);
+}
+
+TEST(maintenance_helpers_tests, publish_version_given_unpinned_retired_versions_releases_them)
+{
+  auto index = get_test_index_B();
+  maintenance::enable_background_maintenance(&index, 1000);
+  auto pinned = maintenance::read_version(&index);
+
+  maintenance::publish(&index);
+  maintenance::publish(&index);
+  const auto retired_while_pinned = index.maintainer->retired.size();
+  pinned.reset();
+  maintenance::publish(&index);
+  const auto retired_after_unpinned = index.maintainer->retired.size();
+  maintenance::disable_background_maintenance(&index);
+
+  EXPECT_EQ(retired_while_pinned, 1);
+  EXPECT_EQ(retired_after_unpinned, 0);
+}
+
+TEST(maintenance_tests, insert_given_background_maintenance_defers_reclustering_until_processed)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset{{0, 0, 0}};
+  Index* index = pre_processing::create_index(dataset, 3, 0.3, 0.3, ReclusteringPolicy::AVERAGE,
+                                              ReclusteringPolicy::AVERAGE);
+  maintenance::update(0, dataset[0].data(), index);  // Locations must follow background reclusterings.
+
+  // Act
+  maintenance::enable_background_maintenance(index);
+  for (unsigned i = 1; i < 300; ++i) {
+    float descriptor[3] = {static_cast<float>(i % 17), static_cast<float>(i % 5), static_cast<float>(i)};
+    maintenance::insert(descriptor, index);
+  }
+  maintenance::disable_background_maintenance(index);
+
+  // Assert
+  EXPECT_EQ(index->maintainer, nullptr);
+  EXPECT_GT(index->L, 1);
+
+  std::vector<bool> found(index->size, false);
+  for (Node* cluster : collect_clusters(index->root)) {
+    for (auto& point : cluster->points) {
+      EXPECT_FALSE(found[point.id]);
+      found[point.id] = true;
+      EXPECT_EQ(index->locations[point.id].descriptor, point.descriptor);
+      EXPECT_EQ(index->locations[point.id].leader, cluster->get_leader()->descriptor);
+    }
+  }
+  EXPECT_EQ(std::count(found.begin(), found.end(), true), 300);
+
+  delete index;
+}
+
 /*
  * maintenance_helpers_tests below -------------------------------------
  */
@@ -349,3 +1320,116 @@ TEST(
 
   EXPECT_EQ(result, false);
 }
+
+TEST(maintenance_helpers_tests, remove_erased_points_given_erased_leader_elects_first_remaining_point)
+{
+  globals::g_vector_dimensions = 3;
+  auto cluster = Node{Point{{1, 1, 1}, 0}};
+  cluster.points.emplace_back(Point{{2, 2, 2}, 1});
+  cluster.points.emplace_back(Point{{3, 3, 3}, 2});
+  std::vector<bool> tombstones{true, false, true};
+
+  auto result = maintenance_helpers::remove_erased_points(cluster, tombstones);
+
+  EXPECT_FALSE(result);
+  ASSERT_EQ(cluster.points.size(), 1);
+  EXPECT_EQ(cluster.get_leader()->id, 1);
+}
+
+TEST(maintenance_helpers_tests, remove_erased_points_given_only_erased_points_keeps_leader_and_returns_true)
+{
+  globals::g_vector_dimensions = 3;
+  auto cluster = Node{Point{{1, 1, 1}, 0}};
+  cluster.points.emplace_back(Point{{2, 2, 2}, 1});
+  std::vector<bool> tombstones{true, true};
+
+  auto result = maintenance_helpers::remove_erased_points(cluster, tombstones);
+
+  EXPECT_TRUE(result);
+  ASSERT_EQ(cluster.points.size(), 1);
+  EXPECT_EQ(cluster.get_leader()->id, 0);
+}
+
+TEST(maintenance_helpers_tests, plan_split_given_descriptors_splits_between_first_and_farthest_descriptor)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 1;
+  std::vector<float> values{1, 0, 12, 2, 10};
+  std::vector<const float*> descriptors;
+  for (auto& value : values) {
+    descriptors.emplace_back(&value);
+  }
+
+  auto plan = maintenance_helpers::plan_split(descriptors);
+
+  EXPECT_EQ(plan.leaders, (std::vector<unsigned>{0, 2}));
+  EXPECT_EQ(plan.assignments, (std::vector<unsigned>{0, 0, 1, 0, 1}));
+}
+
+TEST(maintenance_helpers_tests, plan_clusters_given_descriptors_assigns_each_to_its_nearest_leader)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 1;
+  std::vector<float> values{0, 1, 2, 10, 11, 12};
+  std::vector<const float*> descriptors;
+  for (auto& value : values) {
+    descriptors.emplace_back(&value);
+  }
+
+  auto plan = maintenance_helpers::plan_clusters(descriptors, 3);
+
+  ASSERT_EQ(plan.leaders.size(), 2);
+  ASSERT_EQ(plan.assignments.size(), 6);
+  for (unsigned i = 0; i < descriptors.size(); ++i) {
+    const unsigned leader = plan.leaders[plan.assignments[i]];
+    for (unsigned other : plan.leaders) {
+      EXPECT_LE(std::abs(values[i] - values[leader]), std::abs(values[i] - values[other]));
+    }
+  }
+}
+
+TEST(maintenance_helpers_tests, match_cluster_points_given_appended_point_collects_it_last)
+{
+  auto index = get_test_index_B();
+  auto snapshot = maintenance_helpers::take_cluster_snapshot(&index.root);
+  index.root.children[0].points.emplace_back(Point{{2, 2, 2}, 4});
+  std::vector<Point*> points;
+
+  auto result =
+      maintenance_helpers::match_cluster_points(&index.root, snapshot.sizes, snapshot.identities, points);
+
+  ASSERT_TRUE(result);
+  ASSERT_EQ(points.size(), 5);
+  EXPECT_EQ(points[2]->id, 2);
+  EXPECT_EQ(points[4]->id, 4);
+  EXPECT_EQ(snapshot.descriptors[3][0], 11);
+}
+
+TEST(maintenance_helpers_tests, match_cluster_points_given_removed_point_returns_false)
+{
+  auto index = get_test_index_B();
+  auto snapshot = maintenance_helpers::take_cluster_snapshot(&index.root);
+  index.root.children[1].points.pop_back();
+  std::vector<Point*> points;
+
+  EXPECT_FALSE(
+      maintenance_helpers::match_cluster_points(&index.root, snapshot.sizes, snapshot.identities, points));
+}
+
+TEST(maintenance_helpers_tests, finish_incremental_reclustering_given_removed_point_restarts_reclustering)
+{
+  auto index = get_test_index_B();
+  index.scheme.children_per_insert = 1;
+  NodePath path;
+  path.emplace(&index.root);
+
+  maintenance_helpers::start_incremental_reclustering(path, &index);
+  maintenance_helpers::continue_incremental_reclustering(&index);
+  index.root.children[0].points.pop_back();
+  maintenance_helpers::continue_incremental_reclustering(&index);
+
+  EXPECT_FALSE(index.progress.path.empty());
+  EXPECT_EQ(index.progress.next_child, 0);
+  EXPECT_EQ(index.progress.members.size(), 3);
+  EXPECT_EQ(index.root.children.size(), 2);
+}
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <eCP/index/eCP.hpp>
 #include <eCP/index/pre-processing.hpp>
+#include <eCP/index/serialization.hpp>
 #include <eCP/index/shared/distance.hpp>
 #include <eCP/index/shared/globals.hpp>
 #include <helpers/testhelpers.hpp>
@@ -98,6 +101,47 @@ TEST(pre_processing_tests,
   EXPECT_EQ(result, 4);
 }
 
+TEST(pre_processing_tests, create_disk_index_given_small_memory_budget_writes_every_descriptor_once)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  globals::g_vector_dimensions = 3;
+
+  std::vector<float> dataset;
+  for (unsigned i = 0; i < 500; ++i) {
+    dataset.insert(dataset.end(),
+                   {static_cast<float>(i % 19), static_cast<float>(i % 23), static_cast<float>(i)});
+  }
+  auto read = [&dataset](std::size_t begin, std::size_t count, char* destination) {
+    std::memcpy(destination, &dataset[begin * 3], count * 3 * sizeof(float));
+  };
+
+  // A budget of a few records spills many runs, a large budget none.
+  for (std::size_t memory_budget : {100, 1 << 20}) {
+    const auto path = testing::TempDir() + "eCP_out_of_core.disk";
+    pre_processing::create_disk_index(read, 500, 10, memory_budget, path);
+
+    DiskIndex* disk = serialization::open_on_disk(path, 0, 2);
+    std::uint64_t point_count{0};
+    unsigned cluster_count{0};
+    for (const auto& node : disk->nodes) {
+      point_count += node.point_count;
+      cluster_count += (node.child_count == 0);
+    }
+    EXPECT_EQ(point_count, 500);
+    EXPECT_EQ(disk->routing.size, 500);
+
+    for (unsigned i = 0; i < 500; i += 7) {
+      const auto result = eCP::query(disk, &dataset[i * 3], 1, cluster_count);
+      EXPECT_EQ(result.first.front(), i);
+      EXPECT_FLOAT_EQ(result.second.front(), 0);
+    }
+
+    serialization::close_on_disk(disk);
+    EXPECT_NE(::access((path + ".spill").c_str(), F_OK), 0);  // The spill file is removed.
+  }
+}
+
 /*
  * pre-processing_helpers_tests
  */
@@ -143,3 +187,139 @@ TEST(pre_processing_helpers_tests,
   EXPECT_NEAR(lo_res, lo, 0.0001);
   EXPECT_NEAR(hi_res, hi, 0.0001);
 }
+
+TEST(pre_processing_helpers_tests, spill_run_given_two_runs_reads_records_back_by_cluster)
+{
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  globals::g_vector_dimensions = 1;
+  const auto path = testing::TempDir() + "eCP_runs.spill";
+  pre_processing_helpers::Spill spill{::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600), 0, {},
+                                      std::vector<std::vector<char>>(3), 0};
+  ASSERT_GE(spill.file, 0);
+
+  // Records of id and descriptor, where the descriptor equals the id.
+  auto append = [&spill](std::size_t cluster, std::uint64_t id) {
+    const float descriptor = id;
+    auto& bucket = spill.buckets[cluster];
+    bucket.insert(bucket.end(), reinterpret_cast<const char*>(&id), reinterpret_cast<const char*>(&id + 1));
+    bucket.insert(bucket.end(), reinterpret_cast<const char*>(&descriptor),
+                  reinterpret_cast<const char*>(&descriptor + 1));
+    spill.buffered += 12;
+  };
+
+  append(0, 1);
+  append(2, 2);
+  append(2, 3);
+  pre_processing_helpers::spill_run(spill);
+  append(1, 4);
+  append(2, 5);
+  pre_processing_helpers::spill_run(spill);
+
+  EXPECT_EQ(spill.run_offsets, (std::vector<std::uint64_t>{0, 2 * 16 + 3 * 12}));
+  EXPECT_EQ(spill.buffered, 0);
+  EXPECT_TRUE(spill.buckets[2].empty());
+
+  pre_processing_helpers::RunReader first{spill.file, 0, spill.run_offsets[1], {}, 0, 0, 0};
+  pre_processing_helpers::RunReader second{spill.file, spill.run_offsets[1], spill.size, {}, 0, 0, 0};
+  first.advance();
+  second.advance();
+  EXPECT_EQ(first.cluster, 0);
+  EXPECT_EQ(second.cluster, 1);
+
+  // Skip the single records of clusters 0 and 1.
+  std::vector<char> records(3 * 12);
+  first.read(records.data(), 12);
+  second.read(records.data(), 12);
+  first.advance();
+  second.advance();
+  EXPECT_EQ(first.cluster, 2);
+  EXPECT_EQ(second.cluster, 2);
+
+  // Cluster 2 holds three points in total, placed run by run.
+  std::vector<char> block(3 * 12);
+  std::uint64_t placed{0};
+  for (auto* run : {&first, &second}) {
+    run->read(records.data(), run->count * 12);
+    pre_processing_helpers::place_records(records.data(), run->count, block.data(), 3, placed);
+    run->advance();
+    EXPECT_EQ(run->cluster, pre_processing_helpers::NO_CLUSTER);
+  }
+
+  const auto* ids = reinterpret_cast<const std::uint64_t*>(block.data());
+  const auto* descriptors = reinterpret_cast<const float*>(block.data() + 3 * sizeof(std::uint64_t));
+  EXPECT_EQ(std::vector<std::uint64_t>(ids, ids + 3), (std::vector<std::uint64_t>{2, 3, 5}));
+  EXPECT_EQ(std::vector<float>(descriptors, descriptors + 3), (std::vector<float>{2, 3, 5}));
+
+  ::close(spill.file);
+  std::remove(path.c_str());
+}
+
+TEST(pre_processing_helpers_tests, parallel_chunks_given_more_threads_than_items_visits_each_item_once)
+{
+  std::vector<unsigned> visits(3, 0);
+  std::vector<unsigned> chunks(3, 0);
+
+  pre_processing_helpers::parallel_chunks(3, 8, [&](unsigned chunk, std::size_t begin, std::size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      ++visits[i];
+    }
+    chunks[chunk] = end - begin;
+  });
+
+  EXPECT_EQ(visits, (std::vector<unsigned>{1, 1, 1}));
+  EXPECT_EQ(chunks, (std::vector<unsigned>{1, 1, 1}));  // One chunk per item at most.
+}
+
+TEST(pre_processing_helpers_tests, parallel_chunks_given_throwing_chunk_rethrows_after_all_chunks)
+{
+  std::vector<unsigned> visits(100, 0);
+  auto visit = [&visits](unsigned chunk, std::size_t begin, std::size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      ++visits[i];
+    }
+    if (chunk == 2) {
+      throw std::runtime_error("chunk");
+    }
+  };
+
+  EXPECT_THROW(pre_processing_helpers::parallel_chunks(100, 4, visit), std::runtime_error);
+  EXPECT_EQ(std::count(visits.begin(), visits.end(), 1), 100);
+}
+
+TEST(pre_processing_helpers_tests, assign_points_given_threads_adds_points_to_nearest_cluster_in_order_of_id)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  globals::g_vector_dimensions = 3;
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < 1000; ++i) {
+    dataset.push_back({static_cast<float>(i % 19), static_cast<float>(i % 23), static_cast<float>(i % 7)});
+  }
+  auto row = [&dataset](std::size_t i) { return dataset[i].data(); };
+
+  const auto params = pre_processing_helpers::calculate_initial_index_params(dataset.size(), 10, 0, 0);
+  const auto leaders =
+      pre_processing_helpers::generate_leaders_indexes(dataset.size(), params.level_sizes, params.L);
+  auto top_level = pre_processing_helpers::build_levels(row, leaders, params.hi_bound, 4);
+  std::vector<bool> is_leader(dataset.size(), false);
+  for (auto id : leaders.front()) {
+    is_leader[id] = true;
+  }
+
+  pre_processing_helpers::assign_points(row, dataset.size(), is_leader, top_level, 4);
+
+  std::vector<Node*> clusters;
+  pre_processing_helpers::collect_leaves(top_level, clusters);
+  std::size_t point_count{0};
+  for (const Node* cluster : clusters) {
+    point_count += cluster->points.size();
+    for (std::size_t i = 1; i < cluster->points.size(); ++i) {
+      const auto& point = cluster->points[i];
+      EXPECT_EQ(traversal::find_nearest_leaf(point.descriptor, top_level), cluster);
+      if (i > 1) {
+        EXPECT_LT(cluster->points[i - 1].id, point.id);  // The leader is the first point.
+      }
+    }
+  }
+  EXPECT_EQ(point_count, dataset.size());
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <eCP/index/shared/data_structure.hpp>
+#include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/globals.hpp>
+#include <eCP/index/shared/quantization.hpp>
+
+/*
+ * quantization_tests
+ */
+
+TEST(quantization_tests, train_given_descriptors_encodes_range_endpoints_as_lowest_and_highest_level)
+{
+  // Arrange
+  globals::g_vector_dimensions = 2;
+  float a[2] = {0, 10};
+  float b[2] = {255, 20};
+  std::uint8_t code[2];
+
+  // Act
+  quantization::train({a, b});
+  quantization::encode(b, code);
+
+  // Assert
+  EXPECT_TRUE(quantization::is_enabled());
+  EXPECT_EQ(code[0], 255);
+  EXPECT_EQ(code[1], 255);
+
+  quantization::encode(a, code);
+  EXPECT_EQ(code[0], 0);
+  EXPECT_EQ(code[1], 0);
+
+  quantization::reset();
+}
+
+TEST(quantization_tests, encode_given_value_outside_trained_range_clamps_code)
+{
+  // Arrange
+  globals::g_vector_dimensions = 1;
+  float a[1] = {0};
+  float b[1] = {10};
+  float outside[1] = {-5};
+  std::uint8_t code[1];
+
+  // Act
+  quantization::train({a, b});
+  quantization::encode(outside, code);
+
+  // Assert
+  EXPECT_EQ(code[0], 0);
+
+  quantization::reset();
+}
+
+TEST(quantization_tests, encode_points_given_enabled_compression_stores_codes_that_approximate_descriptors)
+{
+  // Arrange
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  float a[3] = {0, 0, 0};
+  float b[3] = {100, 100, 100};
+  quantization::train({a, b});
+  auto cluster = Node{Point{std::vector<float>{42, 42, 42}, 0}};
+  cluster.points.emplace_back(std::vector<float>{7, 7, 7}, 1);
+
+  // Act
+  cluster.encode_points();
+
+  // Assert
+  ASSERT_EQ(cluster.codes.size(), 6);
+  for (unsigned i = 0; i < 2; ++i) {
+    const auto query = distance::prepare_code_query(cluster.points[i].descriptor);
+    const auto* code = cluster.codes.data() + i * 3;
+    EXPECT_LT(distance::g_code_distance_function(query, code, globals::FLOAT_MAX), 0.1);
+  }
+
+  quantization::reset();
+}
+
+TEST(quantization_tests, encode_points_given_disabled_compression_clears_codes)
+{
+  globals::g_vector_dimensions = 3;
+  quantization::reset();
+  auto cluster = Node{Point{std::vector<float>{42, 42, 42}, 0}};
+  cluster.codes.resize(3);
+
+  cluster.encode_points();
+
+  EXPECT_FALSE(quantization::is_enabled());
+  EXPECT_TRUE(cluster.codes.empty());
+}
+
+TEST(quantization_tests, erase_point_given_compressed_cluster_removes_code_of_point)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 1;
+  float a[1] = {0};
+  float b[1] = {255};
+  quantization::train({a, b});
+  auto cluster = Node{Point{std::vector<float>{1}, 0}};
+  cluster.points.emplace_back(std::vector<float>{2}, 1);
+  cluster.points.emplace_back(std::vector<float>{3}, 2);
+  cluster.encode_points();
+
+  cluster.erase_point(1);
+
+  EXPECT_EQ(cluster.codes, (std::vector<std::uint8_t>{1, 3}));
+
+  quantization::reset();
+}
+
+TEST(quantization_tests, code_distance_given_threshold_exceeded_returns_float_max)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 16;
+  std::vector<float> lo(16, 0);
+  std::vector<float> hi(16, 255);
+  quantization::train({lo.data(), hi.data()});
+  std::vector<std::uint8_t> code(16, 10);
+
+  const auto query = distance::prepare_code_query(lo.data());
+
+  EXPECT_FLOAT_EQ(distance::g_code_distance_function(query, code.data(), globals::FLOAT_MAX), 1600);
+  EXPECT_EQ(distance::g_code_distance_function(query, code.data(), 799), globals::FLOAT_MAX);
+
+  quantization::reset();
+}
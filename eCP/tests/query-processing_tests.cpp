@@ -2,6 +2,7 @@
 #include <eCP/index/query-processing.hpp>
 #include <eCP/index/shared/distance.hpp>
 #include <eCP/index/shared/globals.hpp>
+#include <eCP/index/shared/quantization.hpp>
 #include <gtest/gtest.h>
 
 /* Helpers */
@@ -60,6 +61,27 @@ TEST(query_processing_tests, index_to_max_element_given_morethan_elem_returns_in
   EXPECT_TRUE(expected_index == actual_index);
 }
 
+TEST(query_processing_tests, scan_leaf_node_given_tombstones_skips_erased_points)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+
+  std::vector<Point> points;
+  points.emplace_back(Point(new float[3]{4, 4, 4}, 0));
+  points.emplace_back(Point(new float[3]{5, 5, 5}, 1));
+  points.emplace_back(Point(new float[3]{9, 9, 9}, 2));
+  std::vector<bool> tombstones{true};  // Ids beyond the tombstones are not erased.
+
+  float* q = new float[3]{4, 4, 4};
+  std::vector<std::pair<unsigned int, float>> nearest;
+  query_processing::scan_leaf_node(q, points, 2, nearest, &tombstones);
+
+  ASSERT_EQ(nearest.size(), 2);
+  EXPECT_EQ(nearest[0].first, 1);
+  EXPECT_EQ(nearest[1].first, 2);
+  delete[] q;
+}
+
 TEST(query_processing_tests, find_k_nearest_points_given_k_1_returns_k_closest_points)
 {
   distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
@@ -214,3 +236,64 @@ TEST(query_processing_tests, scan_node_given_b_2_returns_two_closest_elements)
   EXPECT_TRUE(*next_level_best_nodes[0]->points[0].descriptor == *first_element);
   EXPECT_TRUE(*next_level_best_nodes[1]->points[0].descriptor == *second_element);
 }
+
+TEST(query_processing_tests,
+     k_nearest_neighbors_given_compressed_points_and_rerank_factor_returns_exact_distances)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  float lo[3] = {0, 0, 0};
+  float hi[3] = {9, 9, 9};
+  quantization::train({lo, hi});
+
+  std::vector<Node> root = {Node{Point(std::vector<float>{1, 1, 1}, 0)}};
+  root[0].points.emplace_back(Point(std::vector<float>{3, 3, 3}, 1));
+  root[0].points.emplace_back(Point(std::vector<float>{4, 4, 4}, 2));
+  root[0].points.emplace_back(Point(std::vector<float>{6, 6, 6}, 3));
+  root[0].points.emplace_back(Point(std::vector<float>{9, 9, 9}, 4));
+  root[0].encode_points();
+
+  float* q = new float[3]{4, 4, 4};
+  unsigned int k = 2;
+  unsigned int b = 1;
+  unsigned int L = 1;
+  unsigned int r = 2;
+
+  auto actual = query_processing::k_nearest_neighbors(root, q, k, b, L, r);
+
+  EXPECT_EQ(actual.size(), 2);
+  EXPECT_EQ(actual[0].first, 2);
+  EXPECT_FLOAT_EQ(actual[0].second, 0);
+  EXPECT_EQ(actual[1].first, 1);
+  EXPECT_FLOAT_EQ(actual[1].second, 3);
+
+  quantization::reset();
+  delete[] q;
+}
+
+TEST(query_processing_tests, k_nearest_neighbors_given_delta_buffer_merges_buffered_points)
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+
+  std::vector<Node> root = {Node{Point(std::vector<float>{1, 1, 1}, 0)}};
+  root[0].points.emplace_back(Point(std::vector<float>{9, 9, 9}, 1));
+
+  std::vector<float> buffered{5, 5, 5, 4, 4, 4, 3.5, 3.5, 3.5};
+  DeltaBuffer delta{};
+  delta.storage.assign(reinterpret_cast<char*>(buffered.data()),
+                       reinterpret_cast<char*>(buffered.data() + buffered.size()));
+  delta.ids = {2, 3, 4};
+  std::vector<bool> tombstones{false, false, false, true};
+
+  float* q = new float[3]{4, 4, 4};
+  auto actual = query_processing::k_nearest_neighbors(root, q, 2, 1, 1, 0, &tombstones, &delta);
+
+  ASSERT_EQ(actual.size(), 2);
+  EXPECT_EQ(actual[0].first, 4);
+  EXPECT_FLOAT_EQ(actual[0].second, 0.75);
+  EXPECT_EQ(actual[1].first, 2);
+  EXPECT_FLOAT_EQ(actual[1].second, 3);
+
+  delete[] q;
+}
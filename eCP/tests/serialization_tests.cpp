@@ -0,0 +1,614 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <eCP/index/eCP.hpp>
+#include <eCP/index/maintenance.hpp>
+#include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/globals.hpp>
+#include <eCP/index/shared/quantization.hpp>
+#include <fstream>
+#include <sys/wait.h>
+
+// Include to test helpers, which are compilation unit only.
+#include <eCP/index/serialization.cpp>
+
+/*
+ * Helpers
+ */
+
+std::vector<std::vector<float>> get_serialization_test_dataset(unsigned n)
+{
+  std::vector<std::vector<float>> dataset;
+  for (unsigned i = 0; i < n; ++i) {
+    dataset.push_back({static_cast<float>(i % 17), static_cast<float>(i % 13), static_cast<float>(i % 7),
+                       static_cast<float>(i % 5), static_cast<float>(i)});
+  }
+  return dataset;
+}
+
+std::string get_index_path(const std::string& name)
+{
+  const auto path = testing::TempDir() + "eCP_" + name + ".index";
+  std::remove(path.c_str());
+  return path;
+}
+
+void expect_equal_nodes(Node& expected, Node& actual)
+{
+  const std::size_t bytes = globals::descriptor_size_in_bytes();
+  ASSERT_EQ(expected.children.size(), actual.children.size());
+  ASSERT_EQ(expected.points.size(), actual.points.size());
+  EXPECT_EQ(expected.point_count, actual.point_count);
+  EXPECT_EQ(expected.grandchild_count, actual.grandchild_count);
+
+  for (std::size_t i = 0; i < expected.points.size(); ++i) {
+    EXPECT_EQ(expected.points[i].id, actual.points[i].id);
+    EXPECT_EQ(std::memcmp(expected.points[i].descriptor, actual.points[i].descriptor, bytes), 0);
+  }
+
+  for (std::size_t i = 0; i < expected.children.size(); ++i) {
+    expect_equal_nodes(expected.children[i], actual.children[i]);
+  }
+}
+
+/*
+ * serialization_tests
+ */
+
+TEST(serialization_tests, load_given_saved_index_restores_index)
+{
+  const auto path = get_index_path("restores");
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  index->scheme.children_per_insert = 4;
+
+  serialization::save(index, path);
+  Index* loaded = serialization::load(path);
+
+  EXPECT_EQ(loaded->L, index->L);
+  EXPECT_EQ(loaded->size, index->size);
+  EXPECT_EQ(loaded->scheme.lo_bound, index->scheme.lo_bound);
+  EXPECT_EQ(loaded->scheme.hi_bound, index->scheme.hi_bound);
+  EXPECT_EQ(loaded->scheme.cluster_policy, index->scheme.cluster_policy);
+  EXPECT_EQ(loaded->scheme.node_policy, index->scheme.node_policy);
+  EXPECT_EQ(loaded->scheme.children_per_insert, 4);
+  expect_equal_nodes(index->root, loaded->root);
+
+  for (unsigned i = 0; i < 10; ++i) {
+    EXPECT_EQ(eCP::query(loaded, dataset[i * 37], 5, 3), eCP::query(index, dataset[i * 37], 5, 3));
+  }
+
+  delete index;
+  delete loaded;
+}
+
+TEST(serialization_tests, load_given_saved_index_restores_globals)
+{
+  const auto path = get_index_path("globals");
+  std::vector<std::vector<std::uint8_t>> dataset{{1, 2, 3}, {4, 5, 6}, {7, 8, 9}, {10, 11, 12}};
+  Index* index = eCP::eCP_Index(dataset, 2, distance::Metric::ANGULAR);
+  serialization::save(index, path);
+
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  globals::g_vector_dimensions = 7;
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  Index* loaded = serialization::load(path);
+
+  EXPECT_EQ(globals::g_descriptor_type, globals::DescriptorType::UINT8);
+  EXPECT_EQ(globals::g_vector_dimensions, 3);
+  EXPECT_EQ(distance::g_metric, distance::Metric::ANGULAR);
+  expect_equal_nodes(index->root, loaded->root);
+
+  delete index;
+  delete loaded;
+}
+
+TEST(serialization_tests, load_given_erased_and_buffered_descriptors_restores_them)
+{
+  const auto path = get_index_path("modified");
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  std::vector<float> descriptor{3.5, 3.5, 3.5, 3.5, 3.5};
+
+  maintenance::erase(3, index);
+  maintenance::erase(70, index);
+  maintenance::enable_delta_buffer(index, 10, 1000);
+  maintenance::insert(descriptor.data(), index);
+
+  serialization::save(index, path);
+  Index* loaded = serialization::load(path);
+
+  EXPECT_EQ(loaded->tombstones, index->tombstones);
+  EXPECT_EQ(loaded->delta.ids, index->delta.ids);
+  EXPECT_EQ(loaded->delta.storage, index->delta.storage);
+  EXPECT_EQ(loaded->delta.capacity, 10);
+  EXPECT_EQ(loaded->delta.max_age, 1000);
+  EXPECT_EQ(eCP::query(loaded, descriptor, 1, 1).first, std::vector<unsigned>{100});
+
+  delete index;
+  delete loaded;
+}
+
+TEST(serialization_tests, load_given_compressed_index_restores_codes)
+{
+  const auto path = get_index_path("compressed");
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  eCP::enable_compression(index);
+  const auto quantizer = quantization::g_quantizer;
+
+  serialization::save(index, path);
+  quantization::reset();
+  Index* loaded = serialization::load(path);
+
+  EXPECT_EQ(quantization::g_quantizer.offsets, quantizer.offsets);
+  EXPECT_EQ(quantization::g_quantizer.scales, quantizer.scales);
+  const auto& cluster = loaded->root.children.front();
+  EXPECT_EQ(cluster.codes.size(), cluster.points.size() * globals::g_vector_dimensions);
+  EXPECT_EQ(cluster.codes, index->root.children.front().codes);
+
+  delete index;
+  delete loaded;
+  quantization::reset();
+}
+
+TEST(serialization_tests, load_given_other_file_throws)
+{
+  const auto path = get_index_path("other");
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "not an index file";
+  }
+
+  EXPECT_THROW(serialization::load(path), std::invalid_argument);
+}
+
+TEST(serialization_tests, load_given_truncated_file_throws)
+{
+  const auto path = get_index_path("truncated");
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save(index, path);
+  delete index;
+
+  std::ifstream input(path, std::ios::binary);
+  std::vector<char> contents(std::istreambuf_iterator<char>(input), {});
+  contents.resize(contents.size() - 1);
+  std::ofstream(path, std::ios::binary).write(contents.data(), contents.size());
+
+  EXPECT_THROW(serialization::load(path), std::invalid_argument);
+}
+
+TEST(serialization_tests, checkpoint_given_few_insertions_writes_changed_clusters_only)
+{
+  const auto base_path = get_index_path("base");
+  const auto checkpoint_path = get_index_path("checkpoint");
+  auto dataset = get_serialization_test_dataset(2000);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  index->scheme.hi_bound = 100;  // Insertions only append to their clusters.
+
+  serialization::save(index, base_path);
+  for (unsigned i = 0; i < 3; ++i) {
+    maintenance::insert(dataset[i * 101].data(), index);
+  }
+  serialization::checkpoint(index, checkpoint_path);
+
+  std::ifstream base(base_path, std::ios::binary | std::ios::ate);
+  std::ifstream checkpoint(checkpoint_path, std::ios::binary | std::ios::ate);
+  EXPECT_LT(checkpoint.tellg() * 10, base.tellg());
+
+  Index* loaded = serialization::load_checkpoint(checkpoint_path);
+  EXPECT_EQ(loaded->size, index->size);
+  expect_equal_nodes(index->root, loaded->root);
+
+  delete loaded;
+  delete index;
+}
+
+TEST(serialization_tests, load_checkpoint_given_reclusterings_updates_and_erases_restores_index)
+{
+  const auto base_path = get_index_path("base_modified");
+  const auto checkpoint_path = get_index_path("checkpoint_modified");
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  serialization::save(index, base_path);
+  for (unsigned i = 0; i < 300; ++i) {
+    maintenance::insert(dataset[(i * 7) % 500].data(), index);
+  }
+  maintenance::update(11, dataset[400].data(), index);
+  maintenance::erase(3, index);
+  serialization::checkpoint(index, checkpoint_path);
+
+  Index* loaded = serialization::load_checkpoint(checkpoint_path);
+  EXPECT_EQ(loaded->L, index->L);
+  EXPECT_EQ(loaded->size, index->size);
+  EXPECT_EQ(loaded->tombstones, index->tombstones);
+  expect_equal_nodes(index->root, loaded->root);
+
+  // Later checkpoints of the loaded index are written against the same base snapshot.
+  maintenance::insert(dataset[1].data(), loaded);
+  serialization::checkpoint(loaded, checkpoint_path);
+  Index* reloaded = serialization::load_checkpoint(checkpoint_path);
+  expect_equal_nodes(loaded->root, reloaded->root);
+
+  delete reloaded;
+  delete loaded;
+  delete index;
+}
+
+TEST(serialization_tests, load_checkpoint_given_update_in_place_restores_descriptor)
+{
+  const auto base_path = get_index_path("base_updated");
+  const auto checkpoint_path = get_index_path("checkpoint_updated");
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  maintenance::update(5, dataset[5].data(), index);  // Locates the points without changing them.
+  serialization::save(index, base_path);
+
+  // Moved towards its leader, thus overwritten in place without visiting its cluster. Leaders are random.
+  unsigned long id{0};
+  while (index->locations[id].descriptor == index->locations[id].leader) {
+    ++id;
+  }
+  const PointLocation location = index->locations[id];
+  std::vector<float> closer(5);
+  for (unsigned d = 0; d < 5; ++d) {
+    closer[d] = (location.descriptor[d] + location.leader[d]) / 2;
+  }
+  maintenance::update(id, closer.data(), index);
+  ASSERT_EQ(index->locations[id].descriptor, location.descriptor);
+  serialization::checkpoint(index, checkpoint_path);
+
+  Index* loaded = serialization::load_checkpoint(checkpoint_path);
+  expect_equal_nodes(index->root, loaded->root);
+
+  delete loaded;
+  delete index;
+}
+
+TEST(serialization_tests, fold_checkpoint_given_checkpoint_writes_new_base_snapshot)
+{
+  const auto base_path = get_index_path("base_folded");
+  const auto checkpoint_path = get_index_path("checkpoint_folded");
+  const auto folded_path = get_index_path("folded");
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  serialization::save(index, base_path);
+  for (unsigned i = 0; i < 100; ++i) {
+    maintenance::insert(dataset[(i * 3) % 500].data(), index);
+  }
+  serialization::checkpoint(index, checkpoint_path);
+  serialization::fold_checkpoint(checkpoint_path, folded_path);
+
+  Index* folded = serialization::load(folded_path);
+  EXPECT_EQ(folded->size, index->size);
+  expect_equal_nodes(index->root, folded->root);
+
+  // The folded file is a base snapshot itself.
+  maintenance::insert(dataset[1].data(), folded);
+  serialization::checkpoint(folded, checkpoint_path);
+  Index* loaded = serialization::load_checkpoint(checkpoint_path);
+  expect_equal_nodes(folded->root, loaded->root);
+
+  delete loaded;
+  delete folded;
+  delete index;
+}
+
+TEST(serialization_tests, checkpoint_given_index_without_base_snapshot_throws)
+{
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  EXPECT_THROW(serialization::checkpoint(index, get_index_path("no_base")), std::invalid_argument);
+  delete index;
+}
+
+TEST(serialization_tests, load_checkpoint_given_replaced_base_snapshot_throws)
+{
+  const auto base_path = get_index_path("base_replaced");
+  const auto checkpoint_path = get_index_path("checkpoint_replaced");
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  serialization::save(index, base_path);
+  serialization::checkpoint(index, checkpoint_path);
+  serialization::save(index, base_path);
+
+  EXPECT_THROW(serialization::load_checkpoint(checkpoint_path), std::invalid_argument);
+  delete index;
+}
+
+TEST(serialization_tests, open_mapped_given_saved_index_queries_like_index)
+{
+  const auto path = get_index_path("mapped");
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  serialization::save_mapped(index, path);
+  MappedIndex* mapped = serialization::open_mapped(path);
+
+  EXPECT_EQ(mapped->L, index->L);
+  EXPECT_EQ(mapped->size, index->size);
+  EXPECT_EQ(mapped->point_count, index->size);
+  EXPECT_EQ(mapped->codes, nullptr);
+  for (unsigned i = 0; i < 20; ++i) {
+    EXPECT_EQ(eCP::query(mapped, dataset[i * 23], 5, 3), eCP::query(index, dataset[i * 23], 5, 3));
+  }
+
+  serialization::close_mapped(mapped);
+  delete index;
+}
+
+TEST(serialization_tests, open_mapped_given_erased_and_buffered_descriptors_queries_like_index)
+{
+  const auto path = get_index_path("mapped_modified");
+  auto dataset = get_serialization_test_dataset(200);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  std::vector<float> descriptor{3.5, 3.5, 3.5, 3.5, 3.5};
+
+  maintenance::enable_delta_buffer(index, 10);
+  maintenance::insert(descriptor.data(), index);
+  maintenance::insert(dataset[7].data(), index);
+  for (unsigned long id : {3, 7, 8, 150, 201}) {
+    maintenance::erase(id, index);
+  }
+
+  serialization::save_mapped(index, path);
+  MappedIndex* mapped = serialization::open_mapped(path);
+
+  EXPECT_EQ(mapped->buffered_count, 1);
+  EXPECT_EQ(mapped->point_count, 197);
+  EXPECT_EQ(eCP::query(mapped, descriptor, 1, 1).first, std::vector<unsigned>{200});
+  for (unsigned i = 0; i < 20; ++i) {
+    EXPECT_EQ(eCP::query(mapped, dataset[i * 9], 5, 2), eCP::query(index, dataset[i * 9], 5, 2));
+  }
+
+  serialization::close_mapped(mapped);
+  delete index;
+}
+
+TEST(serialization_tests, open_mapped_given_compressed_index_queries_like_index)
+{
+  const auto path = get_index_path("mapped_compressed");
+  auto dataset = get_serialization_test_dataset(300);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  eCP::enable_compression(index);
+
+  serialization::save_mapped(index, path);
+  quantization::reset();
+  MappedIndex* mapped = serialization::open_mapped(path);
+
+  ASSERT_NE(mapped->codes, nullptr);
+  EXPECT_TRUE(quantization::is_enabled());
+  for (unsigned i = 0; i < 20; ++i) {
+    EXPECT_EQ(eCP::query(mapped, dataset[i * 13], 5, 3, 4).first,
+              eCP::query(index, dataset[i * 13], 5, 3, 4).first);
+  }
+
+  serialization::close_mapped(mapped);
+  delete index;
+  quantization::reset();
+}
+
+TEST(serialization_tests, open_mapped_given_saved_index_of_other_format_throws)
+{
+  const auto path = get_index_path("mapped_other");
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save(index, path);
+  delete index;
+
+  EXPECT_THROW(serialization::open_mapped(path), std::invalid_argument);
+}
+
+TEST(serialization_tests, open_shared_given_saved_index_queries_like_index_in_other_process)
+{
+  const std::string name = "eCP_serialization_tests_shared";
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save_shared(index, name);
+
+  // The child attaches to the shared index and exits with the number of queries that differ.
+  const pid_t child = ::fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    MappedIndex* shared = serialization::open_shared(name);
+    int differing = 0;
+    for (unsigned i = 0; i < 20; ++i) {
+      differing += eCP::query(shared, dataset[i * 23], 5, 3) != eCP::query(index, dataset[i * 23], 5, 3);
+    }
+    serialization::close_mapped(shared);
+    ::_exit(differing);
+  }
+
+  MappedIndex* shared = serialization::open_shared(name);
+  EXPECT_EQ(shared->point_count, index->size);
+  int status;
+  ASSERT_EQ(::waitpid(child, &status, 0), child);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  serialization::remove_shared(name);
+  EXPECT_EQ(eCP::query(shared, dataset[42], 5, 3), eCP::query(index, dataset[42], 5, 3));  // Still mapped.
+  EXPECT_THROW(serialization::open_shared(name), std::runtime_error);
+
+  serialization::close_mapped(shared);
+  delete index;
+}
+
+TEST(serialization_tests, open_shared_given_name_with_slash_throws)
+{
+  EXPECT_THROW(serialization::open_shared("eCP/index"), std::invalid_argument);
+  EXPECT_THROW(serialization::open_shared(""), std::invalid_argument);
+}
+
+TEST(serialization_tests, open_on_disk_given_saved_index_queries_like_index)
+{
+  const auto path = get_index_path("disk");
+  auto dataset = get_serialization_test_dataset(500);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+
+  serialization::save_on_disk(index, path);
+  DiskIndex* disk = serialization::open_on_disk(path, 0, 0);  // Reads in the order of the clusters.
+
+  EXPECT_EQ(disk->routing.L, index->L);
+  EXPECT_EQ(disk->routing.size, index->size);
+  EXPECT_EQ(disk->buffered_count, 0);
+  for (unsigned i = 0; i < 20; ++i) {
+    EXPECT_EQ(eCP::query(disk, dataset[i * 23], 5, 3), eCP::query(index, dataset[i * 23], 5, 3));
+  }
+
+  serialization::close_on_disk(disk);
+  delete index;
+}
+
+TEST(serialization_tests, open_on_disk_given_erased_and_buffered_descriptors_queries_like_index)
+{
+  const auto path = get_index_path("disk_modified");
+  auto dataset = get_serialization_test_dataset(200);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  std::vector<float> descriptor{3.5, 3.5, 3.5, 3.5, 3.5};
+
+  maintenance::enable_delta_buffer(index, 10);
+  maintenance::insert(descriptor.data(), index);
+  maintenance::insert(dataset[7].data(), index);
+  for (unsigned long id : {3, 7, 8, 150, 201}) {
+    maintenance::erase(id, index);
+  }
+
+  serialization::save_on_disk(index, path);
+  DiskIndex* disk = serialization::open_on_disk(path, 0, 0);
+
+  EXPECT_EQ(disk->buffered_count, 1);
+  EXPECT_EQ(eCP::query(disk, descriptor, 1, 1).first, std::vector<unsigned>{200});
+  for (unsigned i = 0; i < 20; ++i) {
+    EXPECT_EQ(eCP::query(disk, dataset[i * 9], 5, 2), eCP::query(index, dataset[i * 9], 5, 2));
+  }
+
+  serialization::close_on_disk(disk);
+  delete index;
+}
+
+TEST(serialization_tests, open_on_disk_given_compressed_index_disables_compression)
+{
+  const auto path = get_index_path("disk_compressed");
+  auto dataset = get_serialization_test_dataset(300);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  eCP::enable_compression(index);
+
+  serialization::save_on_disk(index, path);
+  DiskIndex* disk = serialization::open_on_disk(path, 0, 0);
+
+  EXPECT_FALSE(quantization::is_enabled());
+  for (unsigned i = 0; i < 20; ++i) {
+    EXPECT_EQ(eCP::query(disk, dataset[i * 13], 5, 3), eCP::query(index, dataset[i * 13], 5, 3, 0));
+  }
+
+  serialization::close_on_disk(disk);
+  delete index;
+}
+
+TEST(serialization_tests, open_on_disk_given_saved_index_of_other_format_throws)
+{
+  const auto path = get_index_path("disk_other");
+  auto dataset = get_serialization_test_dataset(100);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save_mapped(index, path);
+  delete index;
+
+  EXPECT_THROW(serialization::open_on_disk(path, 0, 0), std::invalid_argument);
+}
+
+TEST(serialization_helpers_tests, collect_nodes_breadth_first_given_tree_keeps_children_consecutive)
+{
+  globals::g_vector_dimensions = 1;
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  auto child_a = Node{Point{std::vector<float>{1}, 1}};
+  child_a.children.emplace_back(Node{Point{std::vector<float>{3}, 3}});
+  auto child_b = Node{Point{std::vector<float>{2}, 2}};
+  child_b.children.emplace_back(Node{Point{std::vector<float>{4}, 4}});
+  child_b.children.emplace_back(Node{Point{std::vector<float>{5}, 5}});
+  auto root = Node{Point{std::vector<float>{0}, 0}};
+  root.children.emplace_back(std::move(child_a));
+  root.children.emplace_back(std::move(child_b));
+
+  const auto nodes = serialization_helpers::collect_nodes_breadth_first(root);
+
+  std::vector<unsigned long> ids;
+  for (const Node* node : nodes) {
+    ids.emplace_back(node->points.front().id);
+  }
+  EXPECT_EQ(ids, (std::vector<unsigned long>{0, 1, 2, 3, 4, 5}));
+}
+
+TEST(serialization_helpers_tests, carry_dirty_up_given_dirty_cluster_marks_its_ancestors_only)
+{
+  globals::g_vector_dimensions = 1;
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  auto root = Node{Point{std::vector<float>{0}, 0}};
+  for (unsigned i = 1; i <= 2; ++i) {
+    auto child = Node{Point{std::vector<float>{static_cast<float>(i)}, i}};
+    child.children.emplace_back(Node{Point{std::vector<float>{static_cast<float>(i)}, i}});
+    child.children.emplace_back(Node{Point{std::vector<float>{static_cast<float>(i + 2)}, i + 2}});
+    root.children.emplace_back(std::move(child));
+  }
+  serialization_helpers::locate_in_base(root, 0);
+
+  root.children[1].children[0].points.emplace_back(std::vector<float>{5}, 5);
+  root.children[1].children[0].dirty = true;
+  const float* updated_leader = root.children[0].children[1].get_leader()->descriptor;
+  const std::unordered_set<const float*> updated_leaders{updated_leader};
+  EXPECT_TRUE(serialization_helpers::carry_dirty_up(root, updated_leaders));
+
+  EXPECT_TRUE(root.children[0].dirty);
+  EXPECT_FALSE(root.children[0].children[0].dirty);
+  EXPECT_TRUE(root.children[0].children[1].dirty);
+  EXPECT_TRUE(root.children[1].dirty);
+  EXPECT_TRUE(root.children[1].children[0].dirty);
+  EXPECT_FALSE(root.children[1].children[1].dirty);
+}
+
+TEST(serialization_helpers_tests, locate_in_base_given_tree_matches_offsets_read_from_file)
+{
+  const auto path = get_index_path("offsets");
+  auto dataset = get_serialization_test_dataset(300);
+  Index* index = eCP::eCP_Index(dataset, 10, distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  serialization::save(index, path);
+  Index* loaded = serialization::load(path);
+
+  auto expect_equal_offsets = [](const Node& expected, const Node& actual, auto& recurse) -> void {
+    EXPECT_FALSE(actual.dirty);
+    EXPECT_EQ(expected.base_offset, actual.base_offset);
+    EXPECT_EQ(expected.base_size, actual.base_size);
+    for (std::size_t i = 0; i < expected.children.size(); ++i) {
+      recurse(expected.children[i], actual.children[i], recurse);
+    }
+  };
+  expect_equal_offsets(index->root, loaded->root, expect_equal_offsets);
+
+  delete loaded;
+  delete index;
+}
+
+TEST(serialization_helpers_tests, reader_given_values_spanning_blocks_reads_them)
+{
+  const auto path = get_index_path("blocks");
+  const int output = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  serialization_helpers::Writer writer{output, {}, 0};
+  for (std::uint64_t i = 0; i < 10; ++i) {
+    writer.write_value(i);
+  }
+  writer.flush();
+  ::close(output);
+
+  const int input = ::open(path.c_str(), O_RDONLY);
+  serialization_helpers::Reader reader{input, std::vector<char>(12), 0, 0};  // Smaller than two values.
+  for (std::uint64_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(reader.read_value<std::uint64_t>(), i);
+  }
+  EXPECT_THROW(reader.read_value<std::uint64_t>(), std::invalid_argument);
+  ::close(input);
+}
@@ -1,7 +1,59 @@
 ﻿#include <gtest/gtest.h>
 
+#include <H5Cpp.h>
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <eCP/index/eCP.hpp>
+#include <eCP/index/shared/distance.hpp>
 #include <eCP/utilities/utilities.hpp>
+#include <unistd.h>
+
+/* Helpers */
+
+std::string get_hdf5_path(const std::string& name)
+{
+  const auto path = testing::TempDir() + "eCP_" + name + ".hdf5";
+  std::remove(path.c_str());
+  return path;
+}
+
+/**
+ * @brief write_hdf5_dataset writes a rows x cols dataset with element i * cols + j at row i and column j.
+ */
+template <typename T>
+void write_hdf5_dataset(const std::string& path, const std::string& name, std::size_t rows, std::size_t cols,
+                        const H5::PredType& type)
+{
+  std::vector<T> elements(rows * cols);
+  for (std::size_t i = 0; i < elements.size(); ++i) {
+    elements[i] = static_cast<T>(i);
+  }
+
+  H5::H5File file(path, H5F_ACC_RDWR | H5F_ACC_CREAT);
+  const hsize_t extent[2] = {rows, cols};
+  H5::DataSpace space(2, extent);
+  auto dataset = file.createDataSet(name, type, space);
+  dataset.write(elements.data(), type);
+}
+
+/**
+ * @brief write_vecs_file writes rows x cols elements as a .fvecs, .bvecs or .ivecs file with element
+ * i * cols + j at row i and column j.
+ */
+template <typename T>
+void write_vecs_file(const std::string& path, std::size_t rows, std::int32_t cols)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  for (std::size_t i = 0; i < rows; ++i) {
+    std::fwrite(&cols, sizeof(cols), 1, file);
+    for (std::int32_t j = 0; j < cols; ++j) {
+      const auto element = static_cast<T>(i * cols + j);
+      std::fwrite(&element, sizeof(element), 1, file);
+    }
+  }
+  std::fclose(file);
+}
 
 /* Tests */
 
@@ -25,6 +77,165 @@ TEST(utilities_tests, get_random_unique_indexes_given_10_10_returns_complete_set
   }
 }
 
+TEST(utilities_tests, load_hdf5_dataset_given_float32_float64_and_uint8_returns_aligned_contiguous_rows)
+{
+  const auto path = get_hdf5_path("types");
+  write_hdf5_dataset<float>(path, "float32", 10, 3, H5::PredType::NATIVE_FLOAT);
+  write_hdf5_dataset<double>(path, "float64", 10, 3, H5::PredType::NATIVE_DOUBLE);
+  write_hdf5_dataset<std::uint8_t>(path, "uint8", 10, 3, H5::PredType::NATIVE_UINT8);
+
+  for (const std::string dataset : {"float32", "float64", "uint8"}) {
+    auto matrix = utilities::load_hdf5_dataset(path, dataset, 4);  // Last chunk is partial.
+
+    EXPECT_EQ(matrix.rows, 10);
+    EXPECT_EQ(matrix.cols, 3);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(matrix.data.get()) % utilities::MATRIX_ALIGNMENT, 0);
+    for (std::size_t i = 0; i < 30; ++i) {
+      EXPECT_FLOAT_EQ(matrix.data[i], i);
+    }
+  }
+}
+
+TEST(utilities_tests, hdf5_stream_given_chunk_rows_reads_all_rows_in_chunks)
+{
+  const auto path = get_hdf5_path("stream");
+  write_hdf5_dataset<float>(path, "train", 10, 2, H5::PredType::NATIVE_FLOAT);
+
+  auto* stream = utilities::open_hdf5_stream(path, "train", 4);
+  EXPECT_EQ(stream->rows, 10);
+  EXPECT_EQ(stream->cols, 2);
+
+  std::vector<std::size_t> chunk_rows;
+  std::vector<float> elements;
+  while (utilities::next_chunk(stream)) {
+    chunk_rows.emplace_back(stream->chunk.rows);
+    elements.insert(elements.end(), stream->chunk.data.get(),
+                    stream->chunk.data.get() + stream->chunk.rows * stream->cols);
+  }
+  EXPECT_FALSE(utilities::next_chunk(stream));
+  utilities::close_hdf5_stream(stream);
+
+  EXPECT_EQ(chunk_rows, (std::vector<std::size_t>{4, 4, 2}));
+  ASSERT_EQ(elements.size(), 20);
+  for (std::size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_FLOAT_EQ(elements[i], i);
+  }
+}
+
+TEST(utilities_tests, load_hdf5_file_given_dataset_returns_rows_as_vectors)
+{
+  std::string path = get_hdf5_path("vectors");
+  std::string dataset = "test";
+  write_hdf5_dataset<double>(path, dataset, 3, 2, H5::PredType::NATIVE_DOUBLE);
+
+  EXPECT_EQ(utilities::load_hdf5_file(path, dataset),
+            (std::vector<std::vector<float>>{{0, 1}, {2, 3}, {4, 5}}));
+}
+
+TEST(utilities_tests, load_hdf5_dataset_given_missing_file_or_dataset_throws)
+{
+  const auto path = get_hdf5_path("missing");
+  EXPECT_THROW(utilities::load_hdf5_dataset(path, "train"), std::runtime_error);
+
+  write_hdf5_dataset<float>(path, "train", 2, 2, H5::PredType::NATIVE_FLOAT);
+  EXPECT_THROW(utilities::load_hdf5_dataset(path, "test"), std::runtime_error);
+  EXPECT_THROW(utilities::open_hdf5_stream(path, "train", 0), std::invalid_argument);
+}
+
+TEST(utilities_tests, load_hdf5_dataset_given_unsupported_type_or_rank_throws_invalid_argument)
+{
+  const auto path = get_hdf5_path("unsupported");
+  write_hdf5_dataset<std::int32_t>(path, "int32", 2, 2, H5::PredType::NATIVE_INT32);
+
+  H5::H5File file(path, H5F_ACC_RDWR);
+  const hsize_t extent[1] = {4};
+  H5::DataSpace space(1, extent);
+  file.createDataSet("rank1", H5::PredType::NATIVE_FLOAT, space);
+  file.close();
+
+  EXPECT_THROW(utilities::load_hdf5_dataset(path, "int32"), std::invalid_argument);
+  EXPECT_THROW(utilities::load_hdf5_dataset(path, "rank1"), std::invalid_argument);
+}
+
+TEST(utilities_tests, eCP_Index_given_loaded_matrix_returns_same_results_as_nested_vectors)
+{
+  const auto path = get_hdf5_path("build");
+  write_hdf5_dataset<float>(path, "train", 200, 3, H5::PredType::NATIVE_FLOAT);
+  std::string file = path;
+  std::string dataset = "train";
+  const auto descriptors = utilities::load_hdf5_file(file, dataset);
+  const auto matrix = utilities::load_hdf5_dataset(path, dataset);
+
+  for (bool batch_build : {true, false}) {
+    Index* index = eCP::eCP_Index(matrix.data.get(), matrix.rows, matrix.cols, matrix.cols, 10,
+                                  distance::Metric::EUCLIDEAN_OPT_UNROLL, batch_build);
+    EXPECT_EQ(index->size, 200);
+
+    for (unsigned i = 0; i < 200; i += 17) {
+      const auto result = eCP::query(index, descriptors[i], 1, 200);
+      EXPECT_EQ(result.first.front(), i);
+      EXPECT_FLOAT_EQ(result.second.front(), 0);
+    }
+    delete index;
+  }
+}
+
+TEST(utilities_tests, open_vecs_file_given_fvecs_bvecs_and_ivecs_returns_strided_views_of_rows)
+{
+  const auto fvecs = testing::TempDir() + "eCP_views.fvecs";
+  const auto bvecs = testing::TempDir() + "eCP_views.bvecs";
+  const auto ivecs = testing::TempDir() + "eCP_views.ivecs";
+  write_vecs_file<float>(fvecs, 5, 3);
+  write_vecs_file<std::uint8_t>(bvecs, 5, 3);
+  write_vecs_file<std::int32_t>(ivecs, 5, 3);
+
+  auto* file = utilities::open_vecs_file(fvecs);
+  EXPECT_EQ(file->type, utilities::VecsType::FVECS);
+  EXPECT_EQ(file->rows, 5);
+  EXPECT_EQ(file->cols, 3);
+  EXPECT_EQ(file->stride, 16);
+  const auto* row = reinterpret_cast<const float*>(utilities::vecs_row(file, 2));
+  EXPECT_EQ(std::vector<float>(row, row + 3), (std::vector<float>{6, 7, 8}));
+  utilities::close_vecs_file(file);
+
+  file = utilities::open_vecs_file(bvecs);
+  EXPECT_EQ(file->type, utilities::VecsType::BVECS);
+  EXPECT_EQ(file->stride, 7);
+  std::vector<std::uint8_t> copied(6);
+  utilities::copy_vecs_rows(file, 3, 2, reinterpret_cast<char*>(copied.data()));
+  EXPECT_EQ(copied, (std::vector<std::uint8_t>{9, 10, 11, 12, 13, 14}));
+  utilities::close_vecs_file(file);
+
+  file = utilities::open_vecs_file(ivecs);
+  EXPECT_EQ(file->type, utilities::VecsType::IVECS);
+  EXPECT_EQ(*reinterpret_cast<const std::int32_t*>(utilities::vecs_row(file, 4)), 12);
+  utilities::close_vecs_file(file);
+}
+
+TEST(utilities_tests, open_vecs_file_given_empty_file_returns_no_rows)
+{
+  const auto path = testing::TempDir() + "eCP_empty.fvecs";
+  write_vecs_file<float>(path, 0, 3);
+
+  auto* file = utilities::open_vecs_file(path);
+  EXPECT_EQ(file->rows, 0);
+  utilities::close_vecs_file(file);
+}
+
+TEST(utilities_tests, open_vecs_file_given_invalid_file_throws)
+{
+  const auto truncated = testing::TempDir() + "eCP_truncated.fvecs";
+  write_vecs_file<float>(truncated, 3, 4);
+  ASSERT_EQ(truncate(truncated.c_str(), 3 * 20 - 1), 0);
+
+  const auto unknown = testing::TempDir() + "eCP_unknown.vecs";
+  write_vecs_file<float>(unknown, 3, 4);
+
+  EXPECT_THROW(utilities::open_vecs_file(truncated), std::invalid_argument);
+  EXPECT_THROW(utilities::open_vecs_file(unknown), std::invalid_argument);
+  EXPECT_THROW(utilities::open_vecs_file(testing::TempDir() + "eCP_missing.fvecs"), std::runtime_error);
+}
+
 // !!! Tests below are unnecessary because assertions are used in the function to circumvent this
 
 // TEST(utilities_tests, get_random_unique_indexes_given_0_10_returns_0_elements_in_set) {
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <eCP/index/maintenance.hpp>
+#include <eCP/index/shared/distance.hpp>
+#include <eCP/index/shared/globals.hpp>
+
+// Include to test helpers, which are compilation unit only.
+#include <eCP/index/write-ahead-log.cpp>
+
+/*
+ * Helpers
+ */
+
+Index get_logged_test_index()
+{
+  distance::set_distance_function(distance::Metric::EUCLIDEAN_OPT_UNROLL);
+  globals::g_vector_dimensions = 3;
+  globals::g_descriptor_type = globals::DescriptorType::FLOAT32;
+  auto policy = ReclusteringPolicy::ABSOLUTE;
+
+  auto cluster_a = Node{Point{{0, 0, 0}, 0}};
+  cluster_a.points.emplace_back(Point{{1, 1, 1}, 1});
+  auto cluster_b = Node{Point{{10, 10, 10}, 2}};
+  cluster_b.points.emplace_back(Point{{11, 11, 11}, 3});
+
+  auto index = Index{};
+  index.L = 1;
+  index.size = 4;
+  index.root = Node{Point{{0, 0, 0}, 0}};
+  index.root.children.emplace_back(std::move(cluster_a));
+  index.root.children.emplace_back(std::move(cluster_b));
+  index.root.count_subtree();
+  index.scheme = ReclusteringScheme{10, 10, policy, policy};
+
+  return index;
+}
+
+std::string get_log_path(const std::string& name)
+{
+  const auto path = testing::TempDir() + "eCP_" + name + ".wal";
+  std::remove(path.c_str());
+  return path;
+}
+
+std::vector<std::pair<unsigned long, float>> collect_points(Node& node)
+{
+  std::vector<std::pair<unsigned long, float>> points;
+  for (auto& cluster : node.children) {
+    for (auto& point : cluster.points) {
+      points.emplace_back(point.id, point.descriptor[0]);
+    }
+  }
+  std::sort(points.begin(), points.end());
+  return points;
+}
+
+/*
+ * write_ahead_log_tests
+ */
+
+TEST(write_ahead_log_tests, replay_given_logged_modifications_recovers_index)
+{
+  const auto path = get_log_path("recovers");
+  auto index = get_logged_test_index();
+  auto recovered = get_logged_test_index();
+  std::vector<float> descriptors{12, 12, 12, 2, 2, 2, 3, 3, 3};
+
+  write_ahead_log::enable(&index, path);
+  maintenance::insert(&descriptors[0], &index);
+  maintenance::insert_batch(&descriptors[3], 2, &index);
+  maintenance::update(1, &descriptors[0], &index);
+  maintenance::erase(5, &index);
+  write_ahead_log::disable(&index);
+
+  const auto applied = write_ahead_log::replay(path, &recovered);
+
+  EXPECT_EQ(applied, 5);
+  EXPECT_EQ(index.log, nullptr);
+  EXPECT_EQ(recovered.size, 7);
+  EXPECT_EQ(recovered.tombstones, index.tombstones);
+  EXPECT_EQ(collect_points(recovered.root), collect_points(index.root));
+}
+
+TEST(write_ahead_log_tests, replay_given_index_containing_insertions_skips_them)
+{
+  const auto path = get_log_path("skips");
+  auto index = get_logged_test_index();
+  std::vector<float> descriptors{12, 12, 12, 2, 2, 2};
+
+  write_ahead_log::enable(&index, path);
+  maintenance::insert(&descriptors[0], &index);
+  write_ahead_log::disable(&index);
+  maintenance::insert(&descriptors[3], &index);  // Not logged.
+
+  EXPECT_EQ(write_ahead_log::replay(path, &index), 0);
+  EXPECT_EQ(index.size, 6);
+}
+
+TEST(write_ahead_log_tests, replay_given_index_missing_unlogged_insertions_throws)
+{
+  const auto path = get_log_path("missing");
+  auto index = get_logged_test_index();
+  auto recovered = get_logged_test_index();
+  float descriptor[3] = {12, 12, 12};
+
+  maintenance::insert(descriptor, &index);  // Not logged.
+  write_ahead_log::enable(&index, path);
+  maintenance::insert(descriptor, &index);
+  write_ahead_log::disable(&index);
+
+  EXPECT_THROW(write_ahead_log::replay(path, &recovered), std::invalid_argument);
+}
+
+TEST(write_ahead_log_tests, enable_given_torn_tail_continues_after_last_intact_record)
+{
+  const auto path = get_log_path("torn");
+  auto index = get_logged_test_index();
+  auto recovered = get_logged_test_index();
+  std::vector<float> descriptors{12, 12, 12, 2, 2, 2};
+
+  write_ahead_log::enable(&index, path);
+  maintenance::insert(&descriptors[0], &index);
+  write_ahead_log::disable(&index);
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "torn record";
+  }
+  write_ahead_log::enable(&index, path);
+  maintenance::insert(&descriptors[3], &index);
+  write_ahead_log::disable(&index);
+
+  EXPECT_EQ(write_ahead_log::replay(path, &recovered), 2);
+  EXPECT_EQ(collect_points(recovered.root), collect_points(index.root));
+}
+
+TEST(write_ahead_log_tests, append_given_commit_interval_writes_records_once_committed)
+{
+  const auto path = get_log_path("group");
+  auto index = get_logged_test_index();
+  float descriptor[3] = {12, 12, 12};
+
+  write_ahead_log::enable(&index, path, 3);
+  maintenance::insert(descriptor, &index);
+  maintenance::erase(0, &index);
+  const auto uncommitted = write_ahead_log_helpers::read_file(path).size();
+  maintenance::insert(descriptor, &index);
+  const auto committed = write_ahead_log_helpers::read_file(path).size();
+  maintenance::erase(1, &index);
+  write_ahead_log::commit(&index);
+  const auto explicitly_committed = write_ahead_log_helpers::read_file(path).size();
+  write_ahead_log::disable(&index);
+
+  const auto insert_size = write_ahead_log_helpers::RECORD_HEADER_SIZE +
+                           write_ahead_log_helpers::PAYLOAD_HEADER_SIZE + 3 * sizeof(float);
+  const auto erase_size =
+      write_ahead_log_helpers::RECORD_HEADER_SIZE + write_ahead_log_helpers::PAYLOAD_HEADER_SIZE;
+  EXPECT_EQ(uncommitted, write_ahead_log_helpers::HEADER_SIZE);
+  EXPECT_EQ(committed, write_ahead_log_helpers::HEADER_SIZE + 2 * insert_size + erase_size);
+  EXPECT_EQ(explicitly_committed, committed + erase_size);
+}
+
+TEST(write_ahead_log_tests, replay_given_log_of_other_dimensionality_throws)
+{
+  const auto path = get_log_path("dimensions");
+  auto index = get_logged_test_index();
+  write_ahead_log::enable(&index, path);
+  write_ahead_log::disable(&index);
+
+  globals::g_vector_dimensions = 4;
+
+  EXPECT_THROW(write_ahead_log::replay(path, &index), std::invalid_argument);
+
+  globals::g_vector_dimensions = 3;
+}
+
+TEST(write_ahead_log_helpers_tests, crc32_given_check_input_returns_check_value)
+{
+  const std::string input = "123456789";
+
+  EXPECT_EQ(write_ahead_log_helpers::crc32(input.data(), input.size()), 0xCBF43926u);
+}